@@ -21,10 +21,12 @@
 #define TKPATH_PATCHLEVEL "0.3.3"
 #define TKPATH_REQUIRE    "8.5"
 
-int gAntiAlias = 1;
-int gSurfaceCopyPremultiplyAlpha = 1;
-int gDepixelize = 1;
-Tcl_Interp *gInterp = NULL;
+typedef struct ThreadSpecificData {
+    TkPathSettings settings;
+    int initialized;
+} ThreadSpecificData;
+
+static Tcl_ThreadDataKey dataKey;
 
 extern int 	PixelAlignObjCmd(ClientData clientData, Tcl_Interp* interp,
                     int objc, Tcl_Obj* CONST objv[]);
@@ -41,6 +43,39 @@ extern int	SurfaceInit(Tcl_Interp *interp);
     }
 #endif
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPathGetSettings --
+ *
+ *		Returns the settings of this thread that the ::tkp variables
+ *		are linked to.
+ *
+ * Results:
+ *		Pointer to the settings.
+ *
+ * Side Effects:
+ *   	The settings get their defaults on first use in a thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+TkPathSettings *
+TkPathGetSettings(void)
+{
+    ThreadSpecificData *tsdPtr = (ThreadSpecificData *)
+	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+
+    if (!tsdPtr->initialized) {
+	tsdPtr->settings.antiAlias = 1;
+	tsdPtr->settings.surfaceCopyPremultiplyAlpha = 1;
+	tsdPtr->settings.depixelize = 1;
+	tsdPtr->settings.simd = 1;
+	tsdPtr->initialized = 1;
+    }
+    return &tsdPtr->settings;
+}
+
 
 /*
  *----------------------------------------------------------------------
@@ -66,6 +101,7 @@ extern "C" {
 
 int Tkpath_Init(Tcl_Interp *interp)		/* Tcl interpreter. */
 {
+    TkPathSettings *settingsPtr;
         
 #if defined(USE_TCL_STUBS)
     if (Tcl_InitStubs(interp, TKPATH_REQUIRE, 0) == NULL) {
@@ -89,13 +125,12 @@ int Tkpath_Init(Tcl_Interp *interp)		/* Tcl interpreter. */
     Tcl_CreateObjCommand(interp, "::tkp::canvas", Tk_PathCanvasObjCmd,
 	    (ClientData) Tk_MainWindow(interp), NULL);
 
-    gInterp = interp;
-
     /*
      * Link the ::tkp::antialias variable to control antialiasing. 
      */
+    settingsPtr = TkPathGetSettings();
     if (Tcl_LinkVar(interp, "::tkp::antialias",
-            (char *) &gAntiAlias, TCL_LINK_BOOLEAN) != TCL_OK) {
+            (char *) &settingsPtr->antiAlias, TCL_LINK_BOOLEAN) != TCL_OK) {
         Tcl_ResetResult(interp);
     }
     
@@ -105,11 +140,19 @@ int Tkpath_Init(Tcl_Interp *interp)		/* Tcl interpreter. */
      * to get "true" values.
      */
     if (Tcl_LinkVar(interp, "::tkp::premultiplyalpha",
-            (char *) &gSurfaceCopyPremultiplyAlpha, TCL_LINK_BOOLEAN) != TCL_OK) {
+            (char *) &settingsPtr->surfaceCopyPremultiplyAlpha, TCL_LINK_BOOLEAN) != TCL_OK) {
         Tcl_ResetResult(interp);
     }    
     if (Tcl_LinkVar(interp, "::tkp::depixelize",
-            (char *) &gDepixelize, TCL_LINK_BOOLEAN) != TCL_OK) {
+            (char *) &settingsPtr->depixelize, TCL_LINK_BOOLEAN) != TCL_OK) {
+        Tcl_ResetResult(interp);
+    }    
+    
+    /*
+     * Lets the pixel copying use SSSE3 or AVX2 when the CPU has it.
+     */
+    if (Tcl_LinkVar(interp, "::tkp::simd",
+            (char *) &settingsPtr->simd, TCL_LINK_BOOLEAN) != TCL_OK) {
         Tcl_ResetResult(interp);
     }    
     Tcl_CreateObjCommand(interp, "::tkp::pixelalign",
@@ -235,6 +235,8 @@ getSegmentsFromPathAtomList(PathAtom *firstAtom,
         PathPoint *penultPt, PathPoint **lastPt)
 {
     PathAtom *atom;
+    PathPoint flinePt;		/* Last point of a FloatLineAtom. It can't
+				 * be adjusted in place. */
     int i;
 
     *firstPt = *lastPt = NULL;
@@ -272,6 +274,24 @@ getSegmentsFromPathAtomList(PathAtom *firstAtom,
                 *lastPt = (PathPointPtr)&lineto->x;
                 break;
             }
+            case PATH_ATOM_FLINE:
+            {
+                FloatLineAtom *fline = (FloatLineAtom *)atom;
+                float *pts = fline->points;
+                int j;
+                for (j = 0; j < fline->numPoints; j++, pts += 2) {
+                    if (i == 1) {
+                        secondPt->x = fline->x0 + pts[0];
+                        secondPt->y = fline->y0 + pts[1];
+                        i++;
+                    }
+                    *penultPt = **lastPt;
+                    flinePt.x = fline->x0 + pts[0];
+                    flinePt.y = fline->y0 + pts[1];
+                    *lastPt = &flinePt;
+                }
+                break;
+            }
             case PATH_ATOM_A: {
                 ArcAtom *arc = (ArcAtom *) atom;
 
@@ -378,6 +398,10 @@ getSegmentsFromPathAtomList(PathAtom *firstAtom,
                 break;
         }
     }
+    if (*lastPt == &flinePt) {
+        *lastPt = NULL;
+        return TCL_ERROR;
+    }
     return (i >= 2) ? TCL_OK : TCL_ERROR;
 }
 
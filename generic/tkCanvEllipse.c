@@ -14,22 +14,42 @@
 #include "tkCanvPathUtil.h"
 #include "tkPathStyle.h"
 
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 /*
- * The structure below defines the record for each circle and ellipse item.
+ * The structure below holds the geometry of each circle and ellipse item.
+ * It is shared by the regular items and the lean ones that have no
+ * style options of their own.
  */
 
-typedef struct EllipseItem  {
-    Tk_PathItemEx headerEx; /* Generic stuff that's the same for all
-                             * path types.  MUST BE FIRST IN STRUCTURE. */
+typedef struct EllipseShape {
     char type;		    /* Circle or ellipse. */
     double center[2];	    /* Center coord. */
     double rx;		    /* Radius. Circle uses rx for overall radius. */
     double ry;
+} EllipseShape;
+
+/*
+ * The structures below define the record for each circle and ellipse item,
+ * and for each lcircle and lellipse item.
+ */
+
+typedef struct EllipseItem  {
+    Tk_PathItemEx headerEx; /* Generic stuff that's the same for all
+                             * path types.  MUST BE FIRST IN STRUCTURE. */
+    EllipseShape shape;
 } EllipseItem;
 
+typedef struct LeanEllipseItem  {
+    Tk_PathItemLean headerLean;
+			    /* Generic stuff that's the same for all
+                             * lean types.  MUST BE FIRST IN STRUCTURE. */
+    EllipseShape shape;
+} LeanEllipseItem;
+
+#define GetEllipseShape(itemPtr)				\
+    (TkPathItemIsLean(itemPtr)					\
+	? &((LeanEllipseItem *) (itemPtr))->shape		\
+	: &((EllipseItem *) (itemPtr))->shape)
+
 enum {
     kOvalTypeCircle,
     kOvalTypeEllipse
@@ -39,7 +59,7 @@ enum {
  * Prototypes for procedures defined in this file:
  */
 
-static void	ComputeEllipseBbox(Tk_PathCanvas canvas, EllipseItem *ellPtr);
+static void	ComputeEllipseBbox(Tk_PathCanvas canvas, Tk_PathItem *itemPtr);
 static int	ConfigureEllipse(Tcl_Interp *interp, Tk_PathCanvas canvas, 
 		    Tk_PathItem *itemPtr, int objc,
 		    Tcl_Obj *CONST objv[], int flags);
@@ -51,6 +71,12 @@ static int	CreateCircle(Tcl_Interp *interp,
 static int	CreateEllipse(Tcl_Interp *interp,
 		    Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
 		    int objc, Tcl_Obj *CONST objv[]);
+static int	CreateLeanCircle(Tcl_Interp *interp,
+		    Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
+		    int objc, Tcl_Obj *CONST objv[]);
+static int	CreateLeanEllipse(Tcl_Interp *interp,
+		    Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
+		    int objc, Tcl_Obj *CONST objv[]);
 static void	DeleteEllipse(Tk_PathCanvas canvas,
 		    Tk_PathItem *itemPtr, Display *display);
 static void	DisplayEllipse(Tk_PathCanvas canvas,
@@ -88,17 +114,17 @@ PATH_OPTION_STRING_TABLES_STATE
 
 #define PATH_OPTION_SPEC_R(typeName)		    \
     {TK_OPTION_DOUBLE, "-rx", NULL, NULL,	    \
-        "0.0", -1, Tk_Offset(typeName, rx),	    \
+        "0.0", -1, Tk_Offset(typeName, shape.rx),    \
 	0, 0, ELLIPSE_OPTION_INDEX_R}
 
 #define PATH_OPTION_SPEC_RX(typeName)		    \
     {TK_OPTION_DOUBLE, "-rx", NULL, NULL,	    \
-        "0.0", -1, Tk_Offset(typeName, rx),	    \
+        "0.0", -1, Tk_Offset(typeName, shape.rx),    \
 	0, 0, ELLIPSE_OPTION_INDEX_RX}
 
 #define PATH_OPTION_SPEC_RY(typeName)		    \
     {TK_OPTION_DOUBLE, "-ry", NULL, NULL,	    \
-        "0.0", -1, Tk_Offset(typeName, ry),	    \
+        "0.0", -1, Tk_Offset(typeName, shape.ry),    \
 	0, 0, ELLIPSE_OPTION_INDEX_RY}
 
 static Tk_OptionSpec optionSpecsCircle[] = {
@@ -122,8 +148,25 @@ static Tk_OptionSpec optionSpecsEllipse[] = {
     PATH_OPTION_SPEC_END
 };
 
+static Tk_OptionSpec optionSpecsLeanCircle[] = {
+    PATH_OPTION_SPEC_CORE(Tk_PathItemLean),
+    PATH_OPTION_SPEC_PARENT,
+    PATH_OPTION_SPEC_R(LeanEllipseItem),
+    PATH_OPTION_SPEC_END
+};
+
+static Tk_OptionSpec optionSpecsLeanEllipse[] = {
+    PATH_OPTION_SPEC_CORE(Tk_PathItemLean),
+    PATH_OPTION_SPEC_PARENT,
+    PATH_OPTION_SPEC_RX(LeanEllipseItem),
+    PATH_OPTION_SPEC_RY(LeanEllipseItem),
+    PATH_OPTION_SPEC_END
+};
+
 static Tk_OptionTable optionTableCircle = NULL;
 static Tk_OptionTable optionTableEllipse = NULL;
+static Tk_OptionTable optionTableLeanCircle = NULL;
+static Tk_OptionTable optionTableLeanEllipse = NULL;
 
 /*
  * The structures below define the 'circle' and 'ellipse' item types by means
@@ -177,6 +220,54 @@ Tk_PathItemType tkEllipseType = {
     (Tk_PathItemDCharsProc *) NULL,	/* dTextProc */
     (Tk_PathItemType *) NULL,		/* nextPtr */
 };
+
+Tk_PathItemType tkLeanCircleType = {
+    "lcircle",				/* name */
+    sizeof(LeanEllipseItem),		/* itemSize */
+    CreateLeanCircle,			/* createProc */
+    optionSpecsLeanCircle,		/* optionSpecs */
+    ConfigureEllipse,			/* configureProc */
+    EllipseCoords,			/* coordProc */
+    DeleteEllipse,			/* deleteProc */
+    DisplayEllipse,			/* displayProc */
+    TK_PATH_ITEMTYPE_LEAN,		/* flags */
+    EllipseBbox,			/* bboxProc */
+    EllipseToPoint,			/* pointProc */
+    EllipseToArea,			/* areaProc */
+    EllipseToPostscript,		/* postscriptProc */
+    ScaleEllipse,			/* scaleProc */
+    TranslateEllipse,			/* translateProc */
+    (Tk_PathItemIndexProc *) NULL,	/* indexProc */
+    (Tk_PathItemCursorProc *) NULL,	/* icursorProc */
+    (Tk_PathItemSelectionProc *) NULL,	/* selectionProc */
+    (Tk_PathItemInsertProc *) NULL,	/* insertProc */
+    (Tk_PathItemDCharsProc *) NULL,	/* dTextProc */
+    (Tk_PathItemType *) NULL,		/* nextPtr */
+};
+
+Tk_PathItemType tkLeanEllipseType = {
+    "lellipse",				/* name */
+    sizeof(LeanEllipseItem),		/* itemSize */
+    CreateLeanEllipse,			/* createProc */
+    optionSpecsLeanEllipse,		/* optionSpecs */
+    ConfigureEllipse,			/* configureProc */
+    EllipseCoords,			/* coordProc */
+    DeleteEllipse,			/* deleteProc */
+    DisplayEllipse,			/* displayProc */
+    TK_PATH_ITEMTYPE_LEAN,		/* flags */
+    EllipseBbox,			/* bboxProc */
+    EllipseToPoint,			/* pointProc */
+    EllipseToArea,			/* areaProc */
+    EllipseToPostscript,		/* postscriptProc */
+    ScaleEllipse,			/* scaleProc */
+    TranslateEllipse,			/* translateProc */
+    (Tk_PathItemIndexProc *) NULL,	/* indexProc */
+    (Tk_PathItemCursorProc *) NULL,	/* icursorProc */
+    (Tk_PathItemSelectionProc *) NULL,	/* selectionProc */
+    (Tk_PathItemInsertProc *) NULL,	/* insertProc */
+    (Tk_PathItemDCharsProc *) NULL,	/* dTextProc */
+    (Tk_PathItemType *) NULL,		/* nextPtr */
+};
                         
 static int		
 CreateCircle(Tcl_Interp *interp, Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
@@ -192,44 +283,68 @@ CreateEllipse(Tcl_Interp *interp, Tk_PathCanvas canvas, struct Tk_PathItem *item
     return CreateAny(interp, canvas, itemPtr, objc, objv, kOvalTypeEllipse);
 }
 
+static int		
+CreateLeanCircle(Tcl_Interp *interp, Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
+        int objc, Tcl_Obj *CONST objv[])
+{
+    return CreateAny(interp, canvas, itemPtr, objc, objv, kOvalTypeCircle);
+}
+
+static int		
+CreateLeanEllipse(Tcl_Interp *interp, Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
+        int objc, Tcl_Obj *CONST objv[])
+{
+    return CreateAny(interp, canvas, itemPtr, objc, objv, kOvalTypeEllipse);
+}
+
 static int		
 CreateAny(Tcl_Interp *interp, Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
         int objc, Tcl_Obj *CONST objv[], char type)
 {
-    EllipseItem *ellPtr = (EllipseItem *) itemPtr;
-    Tk_PathItemEx *itemExPtr = &ellPtr->headerEx;
-    Tk_OptionTable optionTable;
+    EllipseShape *ellPtr = GetEllipseShape(itemPtr);
+    Tk_PathItemEx *itemExPtr = (Tk_PathItemEx *) itemPtr;
+    Tk_OptionTable *optionTablePtr;
+    Tk_OptionSpec *optionSpecs;
     int	i;
 
     if (objc == 0) {
         Tcl_Panic("canvas did not pass any coords\n");
     }
-    gInterp = interp;
-
     /*
      * Carry out initialization that is needed to set defaults and to
      * allow proper cleanup after errors during the the remainder of
-     * this procedure.
+     * this procedure. Lean items have no style record.
      */
-    TkPathInitStyle(&itemExPtr->style);
+    if (!TkPathItemIsLean(itemPtr)) {
+	TkPathInitStyle(&itemExPtr->style);
+    }
     itemExPtr->canvas = canvas;
     itemExPtr->styleObj = NULL;
     itemExPtr->styleInst = NULL;
     ellPtr->type = type;
 
-    if (ellPtr->type == kOvalTypeCircle) {
-	if (optionTableCircle == NULL) {
-	    optionTableCircle = Tk_CreateOptionTable(interp, optionSpecsCircle);
+    if (TkPathItemIsLean(itemPtr)) {
+	if (ellPtr->type == kOvalTypeCircle) {
+	    optionTablePtr = &optionTableLeanCircle;
+	    optionSpecs = optionSpecsLeanCircle;
+	} else {
+	    optionTablePtr = &optionTableLeanEllipse;
+	    optionSpecs = optionSpecsLeanEllipse;
 	}
-	optionTable = optionTableCircle;
     } else {
-	if (optionTableEllipse == NULL) {
-	    optionTableEllipse = Tk_CreateOptionTable(interp, optionSpecsEllipse);
+	if (ellPtr->type == kOvalTypeCircle) {
+	    optionTablePtr = &optionTableCircle;
+	    optionSpecs = optionSpecsCircle;
+	} else {
+	    optionTablePtr = &optionTableEllipse;
+	    optionSpecs = optionSpecsEllipse;
 	}
-	optionTable = optionTableEllipse;    
     }
-    itemPtr->optionTable = optionTable;
-    if (Tk_InitOptions(interp, (char *) ellPtr, optionTable, 
+    if (*optionTablePtr == NULL) {
+	*optionTablePtr = Tk_CreateOptionTable(interp, optionSpecs);
+    }
+    itemPtr->optionTable = *optionTablePtr;
+    if (Tk_InitOptions(interp, (char *) itemPtr, itemPtr->optionTable, 
 	    Tk_PathCanvasTkwin(canvas)) != TCL_OK) {
         goto error;
     }
@@ -261,18 +376,18 @@ static int
 EllipseCoords(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr, 
         int objc, Tcl_Obj *CONST objv[])
 {
-    EllipseItem *ellPtr = (EllipseItem *) itemPtr;
+    EllipseShape *ellPtr = GetEllipseShape(itemPtr);
     int result;
 
     result = CoordsForPointItems(interp, canvas, ellPtr->center, objc, objv);
     if ((result == TCL_OK) && ((objc == 1) || (objc == 2))) {
-        ComputeEllipseBbox(canvas, ellPtr);
+        ComputeEllipseBbox(canvas, itemPtr);
     }
     return result;
 }
 
 static PathRect
-GetBareBbox(EllipseItem *ellPtr)
+GetBareBbox(EllipseShape *ellPtr)
 {
     PathRect bbox;
     
@@ -284,20 +399,22 @@ GetBareBbox(EllipseItem *ellPtr)
 }
 
 static void
-ComputeEllipseBbox(Tk_PathCanvas canvas, EllipseItem *ellPtr)
+ComputeEllipseBbox(Tk_PathCanvas canvas, Tk_PathItem *itemPtr)
 {
-    Tk_PathItemEx *itemExPtr = &ellPtr->headerEx;
-    Tk_PathItem *itemPtr = &itemExPtr->header;
+    EllipseShape *ellPtr = GetEllipseShape(itemPtr);
     Tk_PathStyle style;
-    Tk_PathState state = itemExPtr->header.state;
+    Tk_PathState state = itemPtr->state;
     PathRect totalBbox, bbox;
 
+    if (TkPathCanvasDeferItemBbox(canvas, itemPtr)) {
+	return;
+    }
     if(state == TK_PATHSTATE_NULL) {
 	state = TkPathCanvasState(canvas);
     }
     if (state == TK_PATHSTATE_HIDDEN) {
-        itemExPtr->header.x1 = itemExPtr->header.x2 =
-        itemExPtr->header.y1 = itemExPtr->header.y2 = -1;
+        itemPtr->x1 = itemPtr->x2 =
+        itemPtr->y1 = itemPtr->y2 = -1;
         return;
     }
     style = TkPathCanvasInheritStyle(itemPtr, kPathMergeStyleNotFill);
@@ -305,7 +422,7 @@ ComputeEllipseBbox(Tk_PathCanvas canvas, EllipseItem *ellPtr)
     totalBbox = GetGenericPathTotalBboxFromBare(NULL, &style, &bbox);
     itemPtr->bbox = bbox;
     itemPtr->totalBbox = totalBbox;
-    SetGenericPathHeaderBbox(&itemExPtr->header, style.matrixPtr, &totalBbox);
+    SetGenericPathHeaderBbox(itemPtr, style.matrixPtr, &totalBbox);
     TkPathCanvasFreeInheritedStyle(&style);
 }
 
@@ -313,8 +430,8 @@ static int
 ConfigureEllipse(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr, 
         int objc, Tcl_Obj *CONST objv[], int flags)
 {
-    EllipseItem *ellPtr = (EllipseItem *) itemPtr;
-    Tk_PathItemEx *itemExPtr = &ellPtr->headerEx;
+    EllipseShape *ellPtr = GetEllipseShape(itemPtr);
+    Tk_PathItemEx *itemExPtr = (Tk_PathItemEx *) itemPtr;
     Tk_PathStyle *stylePtr = &itemExPtr->style;
     Tk_Window tkwin;
     //Tk_PathState state;
@@ -325,9 +442,7 @@ ConfigureEllipse(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
     tkwin = Tk_PathCanvasTkwin(canvas);
     for (error = 0; error <= 1; error++) {
 	if (!error) {
-	    Tk_OptionTable optionTable;
-	    optionTable = (ellPtr->type == kOvalTypeCircle) ? optionTableCircle : optionTableEllipse;
-	    if (Tk_SetOptions(interp, (char *) ellPtr, optionTable, 
+	    if (Tk_SetOptions(interp, (char *) itemPtr, itemPtr->optionTable, 
 		    objc, objv, tkwin, &savedOptions, &mask) != TCL_OK) {
 		continue;
 	    }
@@ -347,11 +462,14 @@ ConfigureEllipse(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
     }
     if (!error) {
 	Tk_FreeSavedOptions(&savedOptions);
-	stylePtr->mask |= mask;
     }
-    
-    stylePtr->strokeOpacity = MAX(0.0, MIN(1.0, stylePtr->strokeOpacity));
-    stylePtr->fillOpacity   = MAX(0.0, MIN(1.0, stylePtr->fillOpacity));
+    if (!TkPathItemIsLean(itemPtr)) {
+	if (!error) {
+	    stylePtr->mask |= mask;
+	}
+	stylePtr->strokeOpacity = MAX(0.0, MIN(1.0, stylePtr->strokeOpacity));
+	stylePtr->fillOpacity   = MAX(0.0, MIN(1.0, stylePtr->fillOpacity));
+    }
     ellPtr->rx = MAX(0.0, ellPtr->rx);
     ellPtr->ry = MAX(0.0, ellPtr->ry);
     if (ellPtr->type == kOvalTypeCircle) {
@@ -372,7 +490,7 @@ ConfigureEllipse(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
 	Tcl_DecrRefCount(errorResult);
 	return TCL_ERROR;
     } else {
-	ComputeEllipseBbox(canvas, ellPtr);
+	ComputeEllipseBbox(canvas, itemPtr);
 	return TCL_OK;
     }
 }
@@ -380,26 +498,23 @@ ConfigureEllipse(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
 static void		
 DeleteEllipse(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display)
 {
-    EllipseItem *ellPtr = (EllipseItem *) itemPtr;
-    Tk_PathItemEx *itemExPtr = &ellPtr->headerEx;
+    Tk_PathItemEx *itemExPtr = (Tk_PathItemEx *) itemPtr;
     Tk_PathStyle *stylePtr = &itemExPtr->style;
-    Tk_OptionTable optionTable;
 
-    if (stylePtr->fill != NULL) {
+    if (!TkPathItemIsLean(itemPtr) && (stylePtr->fill != NULL)) {
 	TkPathFreePathColor(stylePtr->fill);
     }
     if (itemExPtr->styleInst != NULL) {
 	TkPathFreeStyle(itemExPtr->styleInst);
     }
-    optionTable = (ellPtr->type == kOvalTypeCircle) ? optionTableCircle : optionTableEllipse;
-    Tk_FreeConfigOptions((char *) itemPtr, optionTable, Tk_PathCanvasTkwin(canvas));
+    Tk_FreeConfigOptions((char *) itemPtr, itemPtr->optionTable, Tk_PathCanvasTkwin(canvas));
 }
 
 static void		
 DisplayEllipse(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display, Drawable drawable,
         int x, int y, int width, int height)
 {
-    EllipseItem *ellPtr = (EllipseItem *) itemPtr;
+    EllipseShape *ellPtr = GetEllipseShape(itemPtr);
     TMatrix m = GetCanvasTMatrix(canvas);
     PathRect bbox;
     PathAtom *atomPtr;
@@ -430,14 +545,13 @@ DisplayEllipse(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display, Dra
 static void	
 EllipseBbox(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, int mask)
 {
-    EllipseItem *ellPtr = (EllipseItem *) itemPtr;
-    ComputeEllipseBbox(canvas, ellPtr);
+    ComputeEllipseBbox(canvas, itemPtr);
 }
 
 static double	
 EllipseToPoint(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *pointPtr)
 {
-    EllipseItem *ellPtr = (EllipseItem *) itemPtr;
+    EllipseShape *ellPtr = GetEllipseShape(itemPtr);
     Tk_PathStyle style;
     TMatrix *mPtr;
     double bareOval[4];
@@ -514,7 +628,7 @@ EllipseToPoint(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *pointPtr)
 static int		
 EllipseToArea(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *areaPtr)
 {
-    EllipseItem *ellPtr = (EllipseItem *) itemPtr;
+    EllipseShape *ellPtr = GetEllipseShape(itemPtr);
     Tk_PathStyle style;
     TMatrix *mPtr;
     double bareOval[4], halfWidth;
@@ -616,7 +730,7 @@ static void
 ScaleEllipse(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double originX, double originY,
         double scaleX, double scaleY)
 {
-    EllipseItem *ellPtr = (EllipseItem *) itemPtr;
+    EllipseShape *ellPtr = GetEllipseShape(itemPtr);
 
     ellPtr->center[0] = originX + scaleX*(ellPtr->center[0] - originX);
     ellPtr->center[1] = originY + scaleY*(ellPtr->center[1] - originY);
@@ -630,7 +744,7 @@ ScaleEllipse(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double originX, double
 static void		
 TranslateEllipse(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double deltaX, double deltaY)
 {
-    EllipseItem *ellPtr = (EllipseItem *) itemPtr;
+    EllipseShape *ellPtr = GetEllipseShape(itemPtr);
 
     ellPtr->center[0] += deltaX;
     ellPtr->center[1] += deltaY;
@@ -15,9 +15,6 @@
 #include "tkCanvPathUtil.h"
 #include "tkPathStyle.h"
 
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 enum {
     /* When childs update themself so they set all
      * its ancestors dirty bbox flag so they know
@@ -353,7 +350,7 @@ void
 TkPathCanvasSetGroupDirtyBbox(Tk_PathItem *itemPtr)
 {
     GroupItem *groupPtr = (GroupItem *) itemPtr;
-    groupPtr->flags &= GROUP_FLAG_DIRTY_BBOX;
+    groupPtr->flags |= GROUP_FLAG_DIRTY_BBOX;
 }
 
 void	
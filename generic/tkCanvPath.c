@@ -38,6 +38,15 @@ typedef struct PathItem  {
     PathAtom *atomPtr;
     int maxNumSegments;     /* Max number of straight segments (for subpath)
                              * needed for Area and Point functions. */
+    int numSegmentsOpen;    /* Number of straight segments of the last
+                             * subpath, which 'coords -append' continues. */
+    PathAtom *lastAtomPtr;  /* The last atom of the path. */
+    PathAtom *moveAtomPtr;  /* The atom that starts the last subpath. */
+    double simplify;        /* If > 0, draw and hit test a copy of the
+                             * path where straight segments deviate at
+                             * most this many device pixels. */
+    PathAtom *simplifiedPtr;/* Cached simplified atoms, or NULL. */
+    int simplifiedZoom;     /* The zoom bucket they were made for. */
     ArrowDescr startarrow;
     ArrowDescr endarrow;
     long flags;             /* Various flags, see enum. */
@@ -83,7 +92,13 @@ static int      ConfigureArrows(Tk_PathCanvas canvas, PathItem *pathPtr);
 
 /* Support functions. */
 
-static int		GetSubpathMaxNumSegments(PathAtom *atomPtr);
+static void		CountPathSegments(PathItem *pathPtr, PathAtom *firstPtr);
+static int		ModifyPath(Tcl_Interp *interp, Tk_PathCanvas canvas,
+                        PathItem *pathPtr, int objc, Tcl_Obj *CONST objv[]);
+static int		AppendPath(Tcl_Interp *interp, Tk_PathCanvas canvas,
+                        PathItem *pathPtr, Tcl_Obj *pathObj, int *needBboxPtr);
+static int		GetPathLength(PathAtom *atomPtr);
+static PathAtom *	DrawnAtoms(PathItem *pathPtr, Tk_PathStyle *stylePtr);
 
 
 PATH_STYLE_CUSTOM_OPTION_RECORDS
@@ -92,12 +107,22 @@ PATH_OPTION_STRING_TABLES_FILL
 PATH_OPTION_STRING_TABLES_STROKE
 PATH_OPTION_STRING_TABLES_STATE
 
+enum {
+    PATH_OPTION_INDEX_SIMPLIFY = (1L << (PATH_STYLE_OPTION_INDEX_END + 1))
+};
+
+#define PATH_OPTION_SPEC_SIMPLIFY				\
+    {TK_OPTION_DOUBLE, "-simplify", NULL, NULL,			\
+        "0", -1, Tk_Offset(PathItem, simplify),			\
+        0, 0, PATH_OPTION_INDEX_SIMPLIFY}
+
 static Tk_OptionSpec optionSpecs[] = {
     PATH_OPTION_SPEC_CORE(Tk_PathItemEx),
     PATH_OPTION_SPEC_PARENT,
     PATH_OPTION_SPEC_STYLE_FILL(Tk_PathItemEx, ""),
     PATH_OPTION_SPEC_STYLE_MATRIX(Tk_PathItemEx),
     PATH_OPTION_SPEC_STYLE_STROKE(Tk_PathItemEx, "black"),
+    PATH_OPTION_SPEC_SIMPLIFY,
     PATH_OPTION_SPEC_STARTARROW_GRP(PathItem),
     PATH_OPTION_SPEC_ENDARROW_GRP(PathItem),
     PATH_OPTION_SPEC_END
@@ -220,6 +245,12 @@ CreatePath(
     itemPtr->bbox = NewEmptyPathRect();
     itemPtr->totalBbox = NewEmptyPathRect();
     pathPtr->maxNumSegments = 0;
+    pathPtr->numSegmentsOpen = 0;
+    pathPtr->lastAtomPtr = NULL;
+    pathPtr->moveAtomPtr = NULL;
+    pathPtr->simplify = 0.0;
+    pathPtr->simplifiedPtr = NULL;
+    pathPtr->simplifiedZoom = 0;
     TkPathArrowDescrInit(&pathPtr->startarrow);
     TkPathArrowDescrInit(&pathPtr->endarrow);
     pathPtr->flags = 0L;
@@ -312,13 +343,14 @@ ProcessPath(
             if (pathPtr->atomPtr != NULL) {
                 TkPathFreeAtoms(pathPtr->atomPtr);
             }
+            FreeSimplifiedAtoms(&pathPtr->simplifiedPtr);
             pathPtr->atomPtr = atomPtr;
             pathPtr->pathLen = len;
             if (pathPtr->pathObjPtr != NULL) {
 		Tcl_DecrRefCount(pathPtr->pathObjPtr);
 	    }
             pathPtr->pathObjPtr = objv[0];
-            pathPtr->maxNumSegments = GetSubpathMaxNumSegments(atomPtr);
+            CountPathSegments(pathPtr, atomPtr);
             Tcl_IncrRefCount(pathPtr->pathObjPtr);
         }
         return result;
@@ -358,6 +390,9 @@ PathCoords(
     PathItem *pathPtr = (PathItem *) itemPtr;
     int result;
     
+    if ((objc > 0) && TkPathCanvasIsCoordsModifier(objv[0])) {
+        return ModifyPath(interp, canvas, pathPtr, objc, objv);
+    }
     result = ProcessPath(interp, canvas, itemPtr, objc, objv);
     if ((result == TCL_OK) && (objc == 1)) {
         ConfigureArrows(canvas, pathPtr);
@@ -366,6 +401,366 @@ PathCoords(
     return result;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * TruncatePath --
+ *
+ *	Keeps the first numSegments drawn segments of the path. A
+ *	moveto is not a segment, a closepath is, and each point of a
+ *	float lineto is one. Movetos following the last segment kept
+ *	are dropped too.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Atoms freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+TruncatePath(PathItem *pathPtr, int numSegments)
+{
+    PathAtom *atomPtr;
+    int numAtoms = 0, num = 0;
+
+    for (atomPtr = pathPtr->atomPtr; atomPtr != NULL; atomPtr = atomPtr->nextPtr) {
+        numAtoms++;
+        if (atomPtr->type == PATH_ATOM_M) {
+            continue;
+        }
+        if (atomPtr->type == PATH_ATOM_FLINE) {
+            FloatLineAtom *flinePtr = (FloatLineAtom *) atomPtr;
+            
+            flinePtr->numPoints = MIN(flinePtr->numPoints, numSegments - num);
+            num += flinePtr->numPoints;
+        } else {
+            num++;
+        }
+        if (num == numSegments) {
+            TkPathTruncateAtoms(pathPtr->atomPtr, numAtoms);
+            break;
+        }
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ModifyPath --
+ *
+ *	Processes the options to "coords" that change the path in
+ *	place:
+ *
+ *	    -truncate numSegments   keeps the first numSegments segments,
+ *				    movetos not counted
+ *	    -append pathSpec        continues the path with pathSpec
+ *
+ *	They are processed from left to right, so truncating and then
+ *	appending replaces the end of the path. The new atoms of an
+ *	append are linked to the existing ones and, when possible, the
+ *	bounding box is grown and only the appended area is redrawn.
+ *	The canvas leaves all redrawing to us for these options.
+ *
+ * Results:
+ *	Returns TCL_OK or TCL_ERROR, and sets the interp's result.
+ *
+ * Side effects:
+ *	The path may be changed and parts of the canvas redrawn.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ModifyPath(
+    Tcl_Interp *interp,     /* Used for error reporting. */
+    Tk_PathCanvas canvas,   /* Canvas containing item. */
+    PathItem *pathPtr,      /* Item whose path is to be modified. */
+    int objc,               /* Number of options and values. */
+    Tcl_Obj *CONST objv[])  /* Options and values. */
+{
+    Tk_PathItem *itemPtr = &pathPtr->headerEx.header;
+    static CONST char *modifiers[] = {
+        "-append", "-truncate", (char *) NULL
+    };
+    enum {
+        PATH_COORDS_APPEND, PATH_COORDS_TRUNCATE
+    };
+    int i, index, num;
+    int result = TCL_OK;
+    int needBbox = 0;       /* The bbox must be computed from scratch. */
+    
+    if (objc % 2) {
+        Tcl_WrongNumArgs(interp, 0, objv,
+                "pathName coords id ?-truncate numSegments? ?-append pathSpec?");
+        return TCL_ERROR;
+    }
+    for (i = 0; i < objc; i += 2) {
+        if (Tcl_GetIndexFromObj(interp, objv[i], modifiers, "option", 0,
+                &index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (index == PATH_COORDS_TRUNCATE) {
+            if (Tcl_GetIntFromObj(interp, objv[i+1], &num) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            if (num < 1) {
+                Tcl_SetObjResult(interp, Tcl_NewStringObj(
+                        "number of segments must be at least 1", -1));
+                return TCL_ERROR;
+            }
+        }
+    }
+    
+    FreeSimplifiedAtoms(&pathPtr->simplifiedPtr);
+    for (i = 0; (i < objc) && (result == TCL_OK); i += 2) {
+        Tcl_GetIndexFromObj(NULL, objv[i], modifiers, "option", 0, &index);
+        
+        switch (index) {
+            case PATH_COORDS_APPEND: {
+                result = AppendPath(interp, canvas, pathPtr, objv[i+1],
+                        &needBbox);
+                break;
+            }
+            case PATH_COORDS_TRUNCATE: {
+                if (pathPtr->atomPtr == NULL) {
+                    break;
+                }
+                if (!needBbox) {
+                    Tk_PathCanvasEventuallyRedraw(canvas, itemPtr->x1,
+                            itemPtr->y1, itemPtr->x2, itemPtr->y2);
+                    needBbox = 1;
+                }
+                Tcl_GetIntFromObj(NULL, objv[i+1], &num);
+                TruncatePath(pathPtr, num);
+                CountPathSegments(pathPtr, pathPtr->atomPtr);
+                pathPtr->pathLen = GetPathLength(pathPtr->atomPtr);
+                pathPtr->flags |= kPathItemNeedNewNormalizedPath;
+                break;
+            }
+        }
+    }
+    if (needBbox) {
+        ConfigureArrows(canvas, pathPtr);
+        ComputePathBbox(canvas, pathPtr);
+        Tk_PathCanvasEventuallyRedraw(canvas, itemPtr->x1, itemPtr->y1,
+                itemPtr->x2, itemPtr->y2);
+    }
+    return result;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * AppendPath --
+ *
+ *	Continues the path with the instructions of pathObj. If the
+ *	item is visible, has no arrows and no gradient fill, its
+ *	bounding box is grown and only the area of the new segments
+ *	is redrawn. Otherwise the old area is redrawn and *needBboxPtr
+ *	set, and the caller recomputes the bounding box.
+ *
+ * Results:
+ *	Returns TCL_OK or TCL_ERROR, and sets the interp's result.
+ *
+ * Side effects:
+ *	Atoms are added to the path.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+AppendPath(
+    Tcl_Interp *interp,     /* Used for error reporting. */
+    Tk_PathCanvas canvas,   /* Canvas containing item. */
+    PathItem *pathPtr,      /* Item whose path is to be extended. */
+    Tcl_Obj *pathObj,       /* The path instructions to append. */
+    int *needBboxPtr)       /* Set if the bbox must be recomputed. */
+{
+    Tk_PathItem *itemPtr = &pathPtr->headerEx.header;
+    Tk_PathState state = itemPtr->state;
+    Tk_PathStyle style;
+    Tk_PathItem damage;
+    PathAtom *atomPtr = NULL;
+    PathAtom *lastAtomPtr = pathPtr->lastAtomPtr;
+    PathRect bare, total;
+    double joinX, joinY, startX = 0.0, startY = 0.0;
+    int len;
+    
+    if (lastAtomPtr == NULL) {
+        
+        /* Nothing to continue; same as setting the path. */
+        if (TkPathParseToAtoms(interp, pathObj, &atomPtr, &len) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (!*needBboxPtr) {
+            Tk_PathCanvasEventuallyRedraw(canvas, itemPtr->x1, itemPtr->y1,
+                    itemPtr->x2, itemPtr->y2);
+            *needBboxPtr = 1;
+        }
+        pathPtr->atomPtr = atomPtr;
+        pathPtr->pathLen = len;
+        CountPathSegments(pathPtr, atomPtr);
+        pathPtr->flags |= kPathItemNeedNewNormalizedPath;
+        return TCL_OK;
+    }
+    if(state == TK_PATHSTATE_NULL) {
+        state = TkPathCanvasState(canvas);
+    }
+    
+    /*
+     * An end arrow has moved the last point back; restore it so the 
+     * path continues from the point that was given.
+     */
+    if (pathPtr->endarrow.arrowPointsPtr != NULL) {
+        PathPoint *pfirstp, *plastp;
+        PathPoint psecond, ppenult;
+        
+        if (getSegmentsFromPathAtomList(pathPtr->atomPtr, &pfirstp, 
+                &psecond, &ppenult, &plastp) == TCL_OK) {
+            TkPathPreconfigureArrow(plastp, &pathPtr->endarrow);
+        }
+    }
+    if (pathPtr->moveAtomPtr != NULL) {
+        TkPathAtomEndPoint(pathPtr->moveAtomPtr, &startX, &startY);
+    }
+    if (TkPathParseToAtomsAppend(interp, pathObj, lastAtomPtr, startX, startY,
+            &atomPtr, &len) != TCL_OK) {
+        ConfigureArrows(canvas, pathPtr);
+        return TCL_ERROR;
+    }
+    TkPathAtomEndPoint(lastAtomPtr, &joinX, &joinY);
+    
+    /* Link the new atoms; see TkPathFreeAtoms. */
+    lastAtomPtr->nextPtr = atomPtr;
+    if (pathPtr->atomPtr->flags & PATH_ATOM_PACKED) {
+        pathPtr->atomPtr->flags |= PATH_ATOM_CHAINED;
+    }
+    CountPathSegments(pathPtr, atomPtr);
+    pathPtr->pathLen += len;
+    pathPtr->flags |= kPathItemNeedNewNormalizedPath;
+    
+    if (*needBboxPtr) {
+        return TCL_OK;
+    }
+    style = TkPathCanvasInheritStyle(itemPtr, 0);
+    if ((state == TK_PATHSTATE_HIDDEN) || (pathPtr->pathLen - len < 4)
+            || pathPtr->startarrow.arrowEnabled
+            || pathPtr->endarrow.arrowEnabled
+            || ((style.fill != NULL) && (style.fill->gradientInstPtr != NULL))) {
+        TkPathCanvasFreeInheritedStyle(&style);
+        Tk_PathCanvasEventuallyRedraw(canvas, itemPtr->x1, itemPtr->y1,
+                itemPtr->x2, itemPtr->y2);
+        *needBboxPtr = 1;
+        return TCL_OK;
+    }
+    
+    /*
+     * The new segments are drawn from the join point. A filled subpath
+     * is also closed differently, which involves its start point.
+     */
+    bare = GetGenericBarePathBbox(atomPtr);
+    IncludePointInRect(&itemPtr->bbox, bare.x1, bare.y1);
+    IncludePointInRect(&itemPtr->bbox, bare.x2, bare.y2);
+    IncludePointInRect(&bare, joinX, joinY);
+    if (style.fill != NULL) {
+        IncludePointInRect(&bare, startX, startY);
+    }
+    total = GetGenericPathTotalBboxFromBare(atomPtr, &style, &bare);
+    if ((style.joinStyle == JoinMiter) && (style.strokeWidth > 1.0)) {
+        double miter = 0.5 * style.miterLimit * style.strokeWidth;
+        
+        IncludePointInRect(&total, joinX - miter, joinY - miter);
+        IncludePointInRect(&total, joinX + miter, joinY + miter);
+    }
+    IncludePointInRect(&itemPtr->totalBbox, total.x1, total.y1);
+    IncludePointInRect(&itemPtr->totalBbox, total.x2, total.y2);
+    SetGenericPathHeaderBbox(itemPtr, style.matrixPtr, &itemPtr->totalBbox);
+    SetGenericPathHeaderBbox(&damage, style.matrixPtr, &total);
+    TkPathCanvasFreeInheritedStyle(&style);
+    Tk_PathCanvasEventuallyRedraw(canvas, damage.x1, damage.y1, 
+            damage.x2, damage.y2);
+    return TCL_OK;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetPathLength --
+ *
+ *	Counts the number of elements of the normalized path spec
+ *	that the atoms correspond to.
+ *
+ * Results:
+ *	The length.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+GetPathLength(PathAtom *atomPtr)
+{
+    int len = 0;
+    
+    for (; atomPtr != NULL; atomPtr = atomPtr->nextPtr) {
+        switch (atomPtr->type) {
+            case PATH_ATOM_M:
+            case PATH_ATOM_L:
+                len += 3;
+                break;
+            case PATH_ATOM_A:
+                len += 8;
+                break;
+            case PATH_ATOM_Q:
+                len += 5;
+                break;
+            case PATH_ATOM_C:
+                len += 7;
+                break;
+            case PATH_ATOM_Z:
+                len += 1;
+                break;
+            default:
+                break;
+        }
+    }
+    return len;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * DrawnAtoms --
+ *
+ *	Gets the atoms that are drawn and hit tested. With -simplify
+ *	this is a copy where runs of straight segments are simplified
+ *	in device space, which is cached for the current zoom bucket.
+ *
+ * Results:
+ *	The atoms, owned by the item.
+ *
+ * Side effects:
+ *	May make the simplified atoms.
+ *
+ *--------------------------------------------------------------
+ */
+
+static PathAtom *
+DrawnAtoms(PathItem *pathPtr, Tk_PathStyle *stylePtr)
+{
+    if ((pathPtr->simplify > 0.0) && (pathPtr->atomPtr != NULL)) {
+        return GetSimplifiedAtoms(pathPtr->atomPtr, pathPtr->simplify,
+                stylePtr->matrixPtr, &pathPtr->simplifiedPtr,
+                &pathPtr->simplifiedZoom);
+    }
+    return pathPtr->atomPtr;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -395,23 +790,33 @@ ComputePathBbox(
     Tk_PathStyle style;
     Tk_PathState state = itemExPtr->header.state;
 
+    if (TkPathCanvasDeferItemBbox(canvas, itemPtr)) {
+	return;
+    }
     if(state == TK_PATHSTATE_NULL) {
         state = TkPathCanvasState(canvas);
     }
-    if (pathPtr->pathObjPtr == NULL || (pathPtr->pathLen < 4) || (state == TK_PATHSTATE_HIDDEN)) {
+    FreeSimplifiedAtoms(&pathPtr->simplifiedPtr);
+    if (pathPtr->pathObjPtr == NULL || (pathPtr->pathLen < 4)) {
         itemExPtr->header.x1 = itemExPtr->header.x2 =
         itemExPtr->header.y1 = itemExPtr->header.y2 = -1;
         return;
     }
-    style = TkPathCanvasInheritStyle(itemPtr, kPathMergeStyleNotFill);
     
     /*
      * Get an approximation of the path's bounding box
-     * assuming zero stroke width.
+     * assuming zero stroke width. This is done also for hidden
+     * items since use items may refer to them.
      */
     itemPtr->bbox = GetGenericBarePathBbox(pathPtr->atomPtr);
     IncludeArrowPointsInRect(&itemPtr->bbox, &pathPtr->startarrow);
     IncludeArrowPointsInRect(&itemPtr->bbox, &pathPtr->endarrow);
+    if (state == TK_PATHSTATE_HIDDEN) {
+        itemExPtr->header.x1 = itemExPtr->header.x2 =
+        itemExPtr->header.y1 = itemExPtr->header.y2 = -1;
+        return;
+    }
+    style = TkPathCanvasInheritStyle(itemPtr, kPathMergeStyleNotFill);
     itemPtr->totalBbox = GetGenericPathTotalBboxFromBare(pathPtr->atomPtr,
             &style, &itemPtr->bbox);
     SetGenericPathHeaderBbox(&itemExPtr->header, style.matrixPtr, &itemPtr->totalBbox);
@@ -512,6 +917,7 @@ ConfigurePath(
     
     stylePtr->strokeOpacity = MAX(0.0, MIN(1.0, stylePtr->strokeOpacity));
     stylePtr->fillOpacity   = MAX(0.0, MIN(1.0, stylePtr->fillOpacity));
+    pathPtr->simplify = MAX(0.0, pathPtr->simplify);
 
 #if 0	    // From old code. Needed?
     state = itemPtr->state;
@@ -583,6 +989,7 @@ DeletePath(
         TkPathFreeAtoms(pathPtr->atomPtr);
         pathPtr->atomPtr = NULL;
     }
+    FreeSimplifiedAtoms(&pathPtr->simplifiedPtr);
     TkPathFreeArrow(&pathPtr->startarrow);
     TkPathFreeArrow(&pathPtr->endarrow);
     Tk_FreeConfigOptions((char *) pathPtr, optionTable, Tk_PathCanvasTkwin(canvas));
@@ -626,8 +1033,8 @@ DisplayPath(
     
     if (pathPtr->pathLen > 2) {
         style = TkPathCanvasInheritStyle(itemPtr, 0);
-        TkPathDrawPath(Tk_PathCanvasTkwin(canvas), drawable, pathPtr->atomPtr, 
-                &style, &m, &itemPtr->bbox);
+        TkPathDrawPath(Tk_PathCanvasTkwin(canvas), drawable, 
+                DrawnAtoms(pathPtr, &style), &style, &m, &itemPtr->bbox);
         /*
          * Display arrowheads, if they are wanted.
          */
@@ -681,12 +1088,11 @@ PathToPoint(
     double *pointPtr)		/* Pointer to x and y coordinates. */
 {
     PathItem        *pathPtr = (PathItem *) itemPtr;
-    PathAtom        *atomPtr = pathPtr->atomPtr;
     Tk_PathStyle style;
     double dist;
 
     style = TkPathCanvasInheritStyle(itemPtr, 0);
-    dist = GenericPathToPoint(canvas, itemPtr, &style, atomPtr, 
+    dist = GenericPathToPoint(canvas, itemPtr, &style, DrawnAtoms(pathPtr, &style), 
             pathPtr->maxNumSegments, pointPtr);
     TkPathCanvasFreeInheritedStyle(&style);
     return dist;
@@ -789,9 +1195,30 @@ GetArcNumSegments(double currentX, double currentY, ArcAtom *arc)
     return numSteps;
 }
 
-static int
-GetSubpathMaxNumSegments(PathAtom *atomPtr)
+/*
+ *--------------------------------------------------------------
+ *
+ * CountPathSegments --
+ *
+ *	Counts the straight segments needed for each subpath, starting
+ *	at firstPtr which is either the first atom of the path or the
+ *	first atom appended by 'coords -append'. In the latter case the
+ *	count of the last subpath continues where it was.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The maxNumSegments, numSegmentsOpen, lastAtomPtr and
+ *	moveAtomPtr fields are updated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+CountPathSegments(PathItem *pathPtr, PathAtom *firstPtr)
 {
+    PathAtom		*atomPtr = firstPtr;
     int			num;
     int 		maxNumSegments;
     double 		currentX = 0.0, currentY = 0.0;
@@ -802,8 +1229,19 @@ GetSubpathMaxNumSegments(PathAtom *atomPtr)
     QuadBezierAtom *quad;
     CurveToAtom *curve;
     
-    num = 0;
-    maxNumSegments = 0;
+    if (firstPtr == pathPtr->atomPtr) {
+        num = 0;
+        maxNumSegments = 0;
+        pathPtr->lastAtomPtr = NULL;
+        pathPtr->moveAtomPtr = NULL;
+    } else {
+        num = pathPtr->numSegmentsOpen;
+        maxNumSegments = pathPtr->maxNumSegments;
+        TkPathAtomEndPoint(pathPtr->lastAtomPtr, &currentX, &currentY);
+        if (pathPtr->moveAtomPtr != NULL) {
+            TkPathAtomEndPoint(pathPtr->moveAtomPtr, &startX, &startY);
+        }
+    }
     
     while (atomPtr != NULL) {
     
@@ -815,6 +1253,7 @@ GetSubpathMaxNumSegments(PathAtom *atomPtr)
                 currentY = move->y;
                 startX = currentX;
                 startY = currentY;
+                pathPtr->moveAtomPtr = atomPtr;
                 break;
             }
             case PATH_ATOM_L: {
@@ -824,6 +1263,12 @@ GetSubpathMaxNumSegments(PathAtom *atomPtr)
                 currentY = line->y;
                 break;
             }
+            case PATH_ATOM_FLINE: {
+                /* Same as a lineto for each point. */
+                num += ((FloatLineAtom *) atomPtr)->numPoints;
+                TkPathAtomEndPoint(atomPtr, &currentX, &currentY);
+                break;
+            }
             case PATH_ATOM_A: {
                 arc = (ArcAtom *) atomPtr;
                 num += GetArcNumSegments(currentX, currentY, arc);
@@ -860,9 +1305,11 @@ GetSubpathMaxNumSegments(PathAtom *atomPtr)
         if (num > maxNumSegments) {
             maxNumSegments = num;
         }
+        pathPtr->lastAtomPtr = atomPtr;
         atomPtr = atomPtr->nextPtr;
     }
-    return maxNumSegments;
+    pathPtr->maxNumSegments = maxNumSegments;
+    pathPtr->numSegmentsOpen = num;
 }
 
 /*
@@ -902,7 +1349,7 @@ PathToArea(
    
     style = TkPathCanvasInheritStyle(itemPtr, 0);
     area = GenericPathToArea(canvas, itemPtr, &style, 
-            pathPtr->atomPtr, pathPtr->maxNumSegments, areaPtr);
+            DrawnAtoms(pathPtr, &style), pathPtr->maxNumSegments, areaPtr);
     TkPathCanvasFreeInheritedStyle(&style);            
     return area;
 }
@@ -941,6 +1388,7 @@ ScalePath(
     
     /* @@@ TODO: Arc atoms with nonzero rotation angle is WRONG! */
 
+    FreeSimplifiedAtoms(&pathPtr->simplifiedPtr);
     ScalePathAtoms(atomPtr, originX, originY, scaleX, scaleY);
     
     /* 
@@ -989,6 +1437,7 @@ TranslatePath(
     PathItem *pathPtr = (PathItem *) itemPtr;
     PathAtom *atomPtr = pathPtr->atomPtr;
     
+    FreeSimplifiedAtoms(&pathPtr->simplifiedPtr);
     TranslatePathAtoms(atomPtr, deltaX, deltaY);
     
     /* 
@@ -1040,4 +1489,36 @@ PathToPostscript(
     return TCL_ERROR;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * TkPathCanvasPathGeometry --
+ *
+ *	Gives access to the parsed path of a path item so that use
+ *	items can draw it without keeping a copy of their own.
+ *
+ * Results:
+ *	The first path atom, or NULL if itemPtr is not a path item
+ *	or has no path. The max number of segments and the bare bbox
+ *	are filled in.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+PathAtom *
+TkPathCanvasPathGeometry(Tk_PathItem *itemPtr, int *maxNumSegmentsPtr, 
+        PathRect *bboxPtr)
+{
+    PathItem *pathPtr = (PathItem *) itemPtr;
+
+    if ((itemPtr->typePtr != &tkPathType) || (pathPtr->pathLen < 4)) {
+        return NULL;
+    }
+    *maxNumSegmentsPtr = pathPtr->maxNumSegments;
+    *bboxPtr = itemPtr->bbox;
+    return pathPtr->atomPtr;
+}
 
@@ -13,9 +13,6 @@
 #include "tkpCanvas.h"
 #include "tkCanvPathUtil.h"
 
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 /*
  * For wider strokes we must make a more detailed analysis
  * when doing hit tests and area tests.
@@ -89,6 +86,118 @@ CoordsForPointItems(
     return TCL_OK;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * IsBinaryCoords --
+ *
+ *	Checks if the coords start with the word double or float which
+ *	means that the next argument is packed binary data. Create procs
+ *	use this to avoid looking for options inside the data.
+ *
+ * Results:
+ *	1 if binary, else 0.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+IsBinaryCoords(int objc, Tcl_Obj *CONST objv[])
+{
+    char *str;
+
+    if (objc < 2) {
+        return 0;
+    }
+    str = Tcl_GetString(objv[0]);
+    return ((strcmp(str, "double") == 0) || (strcmp(str, "float") == 0));
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * CoordsFromBinary --
+ *
+ *	Checks if coords are given as packed binary data, that is,
+ *	the word double or float followed by a byte array of little
+ *	endian numbers as made by 'binary format q*' or 'binary format r*'.
+ *	The numbers are copied without any parsing.
+ *
+ * Results:
+ *	Standard tcl result. If the coords are binary *pointsPtr is set
+ *	to an array of *numValuesPtr numbers, which must be freed with
+ *	ckfree, else it is set to NULL. It is an error if anything
+ *	follows the binary data.
+ *
+ * Side effects:
+ *	Memory allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+CoordsFromBinary(
+        Tcl_Interp *interp, 
+        int objc, 
+        Tcl_Obj *CONST objv[],
+        double **pointsPtr,		/* Gets the numbers here. */
+        int *numValuesPtr)
+{
+    unsigned char *bytes;
+    double *points;
+    char *str;
+    int length, size, i;
+
+    *pointsPtr = NULL;
+    if (!IsBinaryCoords(objc, objv)) {
+        return TCL_OK;
+    }
+    str = Tcl_GetString(objv[0]);
+    if (objc != 2) {
+        Tcl_AppendResult(interp, "wrong # coordinates: expected ", str,
+                " and a byte array", (char *) NULL);
+        return TCL_ERROR;
+    }
+    size = (str[0] == 'd') ? sizeof(double) : sizeof(float);
+    bytes = Tcl_GetByteArrayFromObj(objv[1], &length);
+    if (length % size) {
+        char buf[64 + TCL_INTEGER_SPACE];
+        sprintf(buf, "binary coordinates must be a multiple of %d bytes", size);
+        Tcl_SetResult(interp, buf, TCL_VOLATILE);
+        return TCL_ERROR;
+    }
+    *numValuesPtr = length/size;
+    points = (double *) ckalloc((unsigned) ((length/size + 1) * sizeof(double)));
+    for (i = 0; i < length/size; i++, bytes += size) {
+        unsigned char v[8];
+        int j;
+
+#ifdef WORDS_BIGENDIAN
+        for (j = 0; j < size; j++) {
+            v[j] = bytes[size-1-j];
+        }
+#else
+        for (j = 0; j < size; j++) {
+            v[j] = bytes[j];
+        }
+#endif
+        if (size == sizeof(double)) {
+            double d;
+            memcpy(&d, v, sizeof(double));
+            points[i] = d;
+        } else {
+            float f;
+            memcpy(&f, v, sizeof(float));
+            points[i] = f;
+        }
+    }
+    *pointsPtr = points;
+    return TCL_OK;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -321,6 +430,18 @@ GetGenericBarePathBbox(PathAtom *atomPtr)
                 currentY = line->y;
                 break;
             }
+            case PATH_ATOM_FLINE: {
+                FloatLineAtom *fline = (FloatLineAtom *) atomPtr;
+                float *pts = fline->points;
+                int i;
+
+                for (i = 0; i < fline->numPoints; i++, pts += 2) {
+                    currentX = fline->x0 + pts[0];
+                    currentY = fline->y0 + pts[1];
+                    IncludePointInRect(&r, currentX, currentY);
+                }
+                break;
+            }
             case PATH_ATOM_A: {
                 ArcAtom *arc = (ArcAtom *) atomPtr;
                 int result;
@@ -590,6 +711,26 @@ GetMiterBbox(PathAtom *atomPtr, double width, double miterLimit)
                 }
                 break;
             }
+            case PATH_ATOM_FLINE: {
+                FloatLineAtom *fline = (FloatLineAtom *) atomPtr;
+                float *pts = fline->points;
+                int i;
+
+                for (i = 0; i < fline->numPoints; i++, pts += 2) {
+                    current[0] = fline->x0 + pts[0];
+                    current[1] = fline->y0 + pts[1];
+                    CopyPoint(p2, p3);
+                    CopyPoint(p1, p2);
+                    CopyPoint(current, p1);
+                    npts++;
+                    if (npts == 2) {
+                        CopyPoint(current, second);
+                    } else if (npts >= 3) {
+                        IncludeMiterPointsInRect(p1, p2, p3, &bounds, width, sinThetaLimit);
+                    }
+                }
+                break;
+            }
             case PATH_ATOM_A: {
                 ArcAtom *arc = (ArcAtom *) atomPtr;
                 current[0] = arc->x;
@@ -1532,6 +1673,21 @@ MakeSubPathSegments(PathAtom **atomPtrPtr, double *polyPtr,
                 numPoints++;;
                 break;
             }
+            case PATH_ATOM_FLINE: {
+                FloatLineAtom *fline = (FloatLineAtom *) atomPtr;
+                float *pts = fline->points;
+                int i;
+                
+                for (i = 0; i < fline->numPoints; i++, pts += 2) {
+                    current[0] = fline->x0 + pts[0];
+                    current[1] = fline->y0 + pts[1];
+                    PathApplyTMatrixToPoint(matrixPtr, current, coordPtr);
+                    currentTPtr = coordPtr;
+                    coordPtr += 2;
+                }
+                numPoints += fline->numPoints;
+                break;
+            }
             case PATH_ATOM_A: {
                 ArcAtom *arc = (ArcAtom *) atomPtr;
                 
@@ -1736,6 +1892,14 @@ TranslatePathAtoms(
                 line->y += deltaY;
                 break;
             }
+            case PATH_ATOM_FLINE: {
+                FloatLineAtom *fline = (FloatLineAtom *) atomPtr;
+                
+                /* The points are relative to the origin. */
+                fline->x0 += deltaX;
+                fline->y0 += deltaY;
+                break;
+            }
             case PATH_ATOM_A: {
                 ArcAtom *arc = (ArcAtom *) atomPtr;
                 
@@ -1823,6 +1987,19 @@ ScalePathAtoms(
                 line->y = originY + scaleY*(line->y - originY);
                 break;
             }
+            case PATH_ATOM_FLINE: {
+                FloatLineAtom *fline = (FloatLineAtom *) atomPtr;
+                float *pts = fline->points;
+                int i;
+                
+                fline->x0 = originX + scaleX*(fline->x0 - originX);
+                fline->y0 = originY + scaleY*(fline->y0 - originY);
+                for (i = 0; i < fline->numPoints; i++, pts += 2) {
+                    pts[0] = (float) (scaleX*pts[0]);
+                    pts[1] = (float) (scaleY*pts[1]);
+                }
+                break;
+            }
             case PATH_ATOM_A: {
                 ArcAtom *arc = (ArcAtom *) atomPtr;
 		/*
@@ -1996,6 +2173,139 @@ ScaleItemHeader(Tk_PathItem *itemPtr, double originX, double originY,
     }
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * DecimatePoints --
+ *
+ *	Reduces the points of a polyline to at most four in each device
+ *	pixel column: the first, the lowest, the highest and the last
+ *	point of each run of consecutive points in that column. For data
+ *	that is monotone in x the stroked line covers the same pixels.
+ *	The points kept are copied untransformed; mPtr only decides the
+ *	columns, and may be NULL for the identity.
+ *
+ * Results:
+ *	The number of points stored in outPtr, which must have room for
+ *	numPoints points.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+DecimatePoints(
+    double *points,		/* Array of x and y coordinates. */
+    int numPoints,
+    TMatrix *mPtr,		/* From points to device pixels. */
+    double *outPtr)		/* Where to store the points kept. */
+{
+    TMatrix m = {1.0, 0.0, 0.0, 1.0, 0.0, 0.0};
+    int i, j, k, n = 0;
+    int last;			/* Index of the last point stored. */
+    int keep[4];
+    double col, y, loY, hiY;
+
+    if (mPtr != NULL) {
+	m = *mPtr;
+    }
+    last = -1;
+    for (i = 0; i < numPoints; i = j) {
+	col = floor(m.a*points[2*i] + m.c*points[2*i+1] + m.tx);
+	loY = hiY = m.b*points[2*i] + m.d*points[2*i+1];
+	keep[0] = keep[1] = keep[2] = i;
+	for (j = i+1; j < numPoints; j++) {
+	    if (floor(m.a*points[2*j] + m.c*points[2*j+1] + m.tx) != col) {
+		break;
+	    }
+	    y = m.b*points[2*j] + m.d*points[2*j+1];
+	    if (y < loY) {
+		loY = y;
+		keep[1] = j;
+	    } else if (y > hiY) {
+		hiY = y;
+		keep[2] = j;
+	    }
+	}
+	keep[3] = j-1;
+
+	/* Keep them in their original order. */
+	if (keep[1] > keep[2]) {
+	    k = keep[1];
+	    keep[1] = keep[2];
+	    keep[2] = k;
+	}
+	for (k = 0; k < 4; k++) {
+	    if (keep[k] != last) {
+		last = keep[k];
+		*outPtr++ = points[2*last];
+		*outPtr++ = points[2*last+1];
+		n++;
+	    }
+	}
+    }
+    return n;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetSimplifiedAtoms --
+ *
+ *	Gets a simplified copy of an item's atoms where no line
+ *	deviates more than tolerance device pixels from the original.
+ *	The copy is cached in *cachePtrPtr for the zoom bucket in
+ *	*zoomPtr. A bucket spans a factor two in scale and the copy is
+ *	made for its largest scale, so it can be reused until the zoom
+ *	crosses a power of two.
+ *
+ * Results:
+ *	The simplified atoms.
+ *
+ * Side effects:
+ *	A stale copy is freed and a new one is made.
+ *
+ *--------------------------------------------------------------
+ */
+
+PathAtom *
+GetSimplifiedAtoms(
+    PathAtom *atomPtr,		/* The atoms to simplify. */
+    double tolerance,		/* In device pixels. */
+    TMatrix *mPtr,		/* From atoms to device; may be NULL. */
+    PathAtom **cachePtrPtr,	/* The cached copy, or NULL. */
+    int *zoomPtr)		/* The zoom bucket of the cached copy. */
+{
+    double scale = 1.0;
+    int zoom;
+
+    if (mPtr != NULL) {
+	scale = MAX(mPtr->a*mPtr->a + mPtr->b*mPtr->b,
+		mPtr->c*mPtr->c + mPtr->d*mPtr->d);
+	scale = (scale > 0.0) ? sqrt(scale) : 1.0;
+    }
+    zoom = (int) floor(log(scale)/log(2.0));
+    if ((*cachePtrPtr != NULL) && (*zoomPtr == zoom)) {
+	return *cachePtrPtr;
+    }
+    FreeSimplifiedAtoms(cachePtrPtr);
+    *cachePtrPtr = TkPathSimplifyAtoms(atomPtr, tolerance/ldexp(1.0, zoom+1));
+    *zoomPtr = zoom;
+    return *cachePtrPtr;
+}
+
+void
+FreeSimplifiedAtoms(
+    PathAtom **cachePtrPtr)
+{
+    if (*cachePtrPtr != NULL) {
+	TkPathFreeAtoms(*cachePtrPtr);
+	*cachePtrPtr = NULL;
+    }
+}
+
 /*
  *--------------------------------------------------------------
  *
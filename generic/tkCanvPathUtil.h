@@ -19,6 +19,9 @@ extern "C" {
 
 int	    CoordsForPointItems(Tcl_Interp *interp, Tk_PathCanvas canvas, 
                     double *pointPtr, int objc, Tcl_Obj *CONST objv[]);
+int	    IsBinaryCoords(int objc, Tcl_Obj *CONST objv[]);
+int	    CoordsFromBinary(Tcl_Interp *interp, int objc, Tcl_Obj *CONST objv[],
+                    double **pointsPtr, int *numValuesPtr);
 int	    CoordsForRectangularItems(Tcl_Interp *interp, Tk_PathCanvas canvas, 
                     PathRect *rectPtr, int objc, Tcl_Obj *CONST objv[]);
 PathRect    GetGenericBarePathBbox(PathAtom *atomPtr);
@@ -42,6 +45,11 @@ void	    ScalePathRect(PathRect *r, double originX, double originY,
 void	    TranslateItemHeader(Tk_PathItem *itemPtr, double deltaX, double deltaY);
 void	    ScaleItemHeader(Tk_PathItem *itemPtr, double originX, double originY,
 		    double scaleX, double scaleY);
+int	    DecimatePoints(double *points, int numPoints, TMatrix *mPtr,
+		    double *outPtr);
+PathAtom *  GetSimplifiedAtoms(PathAtom *atomPtr, double tolerance,
+		    TMatrix *mPtr, PathAtom **cachePtrPtr, int *zoomPtr);
+void	    FreeSimplifiedAtoms(PathAtom **cachePtrPtr);
 
 /*
  * The canvas 'Area' and 'Point' functions.
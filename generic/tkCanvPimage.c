@@ -9,14 +9,16 @@
  * $Id$
  */
 
+/* The tiles are put into photos using the interp form of Tk_PhotoPutBlock. */
+#ifdef USE_PANIC_ON_PHOTO_ALLOC_FAILURE
+#undef USE_PANIC_ON_PHOTO_ALLOC_FAILURE
+#endif
+
 #include "tkIntPath.h"
 #include "tkpCanvas.h"
 #include "tkCanvPathUtil.h"
 #include "tkPathStyle.h"
 
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 #define BBOX_OUT 2.0
 
 /*
@@ -48,8 +50,52 @@ typedef struct PimageItem  {
     double tintAmount;
     int interpolation;
     PathRect *srcRegionPtr;
+    int tileSize;	    /* If > 0 only the visible tiles of this size
+			     * are converted and drawn. */
+    Tcl_Obj *tileCmdObj;    /* Script that supplies the tiles, or NULL to
+			     * cut them out of the photo. */
+    int tileCache;	    /* Number of tiles kept around. */
+    Tcl_HashTable tileTable;/* Tiles keyed by column and row. */
+    struct PimageTile *tileFirstPtr;
+			    /* Most recently drawn tile first. */
+    struct PimageTile *tileLastPtr;
+    int numTiles;
+    int tileGrid[2];	    /* Image size the tiles were cut for. */
+    unsigned long tileStamp;/* Counts the tiled redisplays. */
+    int fetchScheduled;	    /* FetchTiles is an idle handler. */
+    int *deletedPtr;	    /* While FetchTiles runs, set to 1 when the
+			     * item is deleted. */
 } PimageItem;
 
+/*
+ * A tile is a photo of its own holding a tileSize square piece of the
+ * full image; the ones at the right and bottom edges may be smaller.
+ * It is owned by the item and deleted when evicted. Tiles are fetched
+ * from an idle handler, never while displaying, since that evaluates
+ * scripts.
+ */
+
+enum {
+    TILE_FETCHED	= (1L << 0),	/* Photo, if any, is there. */
+    TILE_FETCHING	= (1L << 1),	/* FetchTile evaluates a script. */
+    TILE_FREED		= (1L << 2)	/* Freed while fetching; the
+					 * fetcher frees the record. */
+};
+
+typedef struct PimageTile {
+    int key[2];		    /* Column and row. */
+    int flags;
+    Tcl_Obj *nameObj;	    /* Name of tile photo, or NULL if there is
+			     * nothing to draw. */
+    Tk_Image image;
+    Tk_PhotoHandle photo;
+    unsigned long stamp;    /* Redisplay the tile was last drawn in. */
+    Tcl_HashEntry *hPtr;
+    PimageItem *pimagePtr;
+    struct PimageTile *prevPtr;
+    struct PimageTile *nextPtr;
+} PimageTile;
+
 
 /*
  * Prototypes for procedures defined in this file:
@@ -85,6 +131,14 @@ static void	TranslatePimage(Tk_PathCanvas canvas,
 static void	ImageChangedProc _ANSI_ARGS_((ClientData clientData,
 		    int x, int y, int width, int height, int imgWidth,
 		    int imgHeight));
+static void	TileChangedProc _ANSI_ARGS_((ClientData clientData,
+		    int x, int y, int width, int height, int imgWidth,
+		    int imgHeight));
+static void	DisplayTiles(PimageItem *pimagePtr, TkPathContext ctx,
+		    TMatrix *mPtr, int x, int y, int width, int height);
+static void	FreeTiles(PimageItem *pimagePtr, int x, int y,
+		    int width, int height);
+static void	FetchTiles(ClientData clientData);
 void		PimageStyleChangedProc(ClientData clientData, int flags);
 
 
@@ -98,7 +152,10 @@ enum {
     PIMAGE_OPTION_INDEX_TINTCOLOR   = (1L << (PATH_STYLE_OPTION_INDEX_END + 7)),
     PIMAGE_OPTION_INDEX_TINTAMOUNT  = (1L << (PATH_STYLE_OPTION_INDEX_END + 8)),
     PIMAGE_OPTION_INDEX_INTERPOLATION = (1L << (PATH_STYLE_OPTION_INDEX_END + 9)),
-    PIMAGE_OPTION_INDEX_SRCREGION   = (1L << (PATH_STYLE_OPTION_INDEX_END + 10))
+    PIMAGE_OPTION_INDEX_SRCREGION   = (1L << (PATH_STYLE_OPTION_INDEX_END + 10)),
+    PIMAGE_OPTION_INDEX_TILESIZE    = (1L << (PATH_STYLE_OPTION_INDEX_END + 11)),
+    PIMAGE_OPTION_INDEX_TILECOMMAND = (1L << (PATH_STYLE_OPTION_INDEX_END + 12)),
+    PIMAGE_OPTION_INDEX_TILECACHE   = (1L << (PATH_STYLE_OPTION_INDEX_END + 13))
 };
 
 static char *imageAnchorST[] = {
@@ -184,6 +241,21 @@ PATH_STYLE_CUSTOM_OPTION_PATHRECT
     TK_OPTION_NULL_OK, (ClientData) &pathRectCO,      \
     PIMAGE_OPTION_INDEX_SRCREGION}
 
+#define PATH_OPTION_SPEC_TILESIZE                  \
+    {TK_OPTION_INT, "-tilesize", NULL, NULL,           \
+        "0", -1, Tk_Offset(PimageItem, tileSize),      \
+        0, 0, PIMAGE_OPTION_INDEX_TILESIZE}
+
+#define PATH_OPTION_SPEC_TILECOMMAND               \
+    {TK_OPTION_STRING, "-tilecommand", NULL, NULL,     \
+        NULL, Tk_Offset(PimageItem, tileCmdObj), -1,   \
+        TK_OPTION_NULL_OK, 0, PIMAGE_OPTION_INDEX_TILECOMMAND}
+
+#define PATH_OPTION_SPEC_TILECACHE                 \
+    {TK_OPTION_INT, "-tilecache", NULL, NULL,          \
+        "64", -1, Tk_Offset(PimageItem, tileCache),    \
+        0, 0, PIMAGE_OPTION_INDEX_TILECACHE}
+
 
 static Tk_OptionSpec optionSpecs[] = {
     PATH_OPTION_SPEC_CORE(PimageItem),
@@ -198,6 +270,9 @@ static Tk_OptionSpec optionSpecs[] = {
     PATH_OPTION_SPEC_TINTAMOUNT,
     PATH_OPTION_SPEC_INTERPOLATION,
     PATH_OPTION_SPEC_SRCREGION,
+    PATH_OPTION_SPEC_TILESIZE,
+    PATH_OPTION_SPEC_TILECOMMAND,
+    PATH_OPTION_SPEC_TILECACHE,
     PATH_OPTION_SPEC_END
 };
 
@@ -265,6 +340,17 @@ CreatePimage(Tcl_Interp *interp, Tk_PathCanvas canvas, struct Tk_PathItem *itemP
     pimagePtr->tintAmount = 0.0;
     pimagePtr->interpolation = kPathImageInterpolationFast;
     pimagePtr->srcRegionPtr = NULL;
+    pimagePtr->tileSize = 0;
+    pimagePtr->tileCmdObj = NULL;
+    pimagePtr->tileCache = 64;
+    Tcl_InitHashTable(&pimagePtr->tileTable, 2);
+    pimagePtr->tileFirstPtr = NULL;
+    pimagePtr->tileLastPtr = NULL;
+    pimagePtr->numTiles = 0;
+    pimagePtr->tileGrid[0] = pimagePtr->tileGrid[1] = 0;
+    pimagePtr->tileStamp = 0;
+    pimagePtr->fetchScheduled = 0;
+    pimagePtr->deletedPtr = NULL;
     itemPtr->bbox = NewEmptyPathRect();
 
     if (optionTable == NULL) {
@@ -346,15 +432,21 @@ ComputePimageBbox(Tk_PathCanvas canvas, PimageItem *pimagePtr)
     double width = 0.0, height = 0.0;
     PathRect bbox;
 
+    if (TkPathCanvasDeferItemBbox(canvas, itemPtr)) {
+	return;
+    }
     if (state == TK_PATHSTATE_NULL) {
 	state = TkPathCanvasState(canvas);
     }
-    if (pimagePtr->image == NULL) {
+    if ((pimagePtr->image == NULL) && ((pimagePtr->tileCmdObj == NULL)
+            || (pimagePtr->width <= 0.0) || (pimagePtr->height <= 0.0))) {
         pimagePtr->header.x1 = pimagePtr->header.x2 =
         pimagePtr->header.y1 = pimagePtr->header.y2 = -1;
         return;
     }
-    if (pimagePtr->srcRegionPtr) {
+    if (pimagePtr->image == NULL) {
+        /* Tiles from a -tilecommand only; the size is set below. */
+    } else if (pimagePtr->srcRegionPtr) {
         width  = pimagePtr->srcRegionPtr->x2 - pimagePtr->srcRegionPtr->x1;
         height = pimagePtr->srcRegionPtr->y2 - pimagePtr->srcRegionPtr->y1;
     } else {
@@ -517,9 +609,21 @@ ConfigurePimage(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
 	    if (pimagePtr->image != NULL) {
 		Tk_FreeImage(pimagePtr->image);
 	    }
+
+	    /*
+	     * Without an item holding on to the old photo nobody would
+	     * tell the shared cache when it changes or goes away.
+	     */
+	    if ((pimagePtr->photo != NULL) && (pimagePtr->photo != photo)) {
+		TkPathImageChanged(pimagePtr->photo);
+	    }
 	    pimagePtr->image = image;
 	    pimagePtr->photo = photo;
 	}
+	if (mask & (PIMAGE_OPTION_INDEX_IMAGE | PIMAGE_OPTION_INDEX_TILESIZE
+		| PIMAGE_OPTION_INDEX_TILECOMMAND)) {
+	    FreeTiles(pimagePtr, 0, 0, -1, -1);
+	}
 
 	/*
 	 * If we reach this on the first pass we are OK and continue below.
@@ -530,6 +634,8 @@ ConfigurePimage(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
 	Tk_FreeSavedOptions(&savedOptions);
     }
     pimagePtr->fillOpacity = MAX(0.0, MIN(1.0, pimagePtr->fillOpacity));
+    pimagePtr->tileSize = MAX(0, pimagePtr->tileSize);
+    pimagePtr->tileCache = MAX(1, pimagePtr->tileCache);
 
 #if 0	    // From old code. Needed?
     state = itemPtr->state;
@@ -561,6 +667,17 @@ DeletePimage(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display)
     if (pimagePtr->styleInst != NULL) {
 	TkPathFreeStyle(pimagePtr->styleInst);
     }
+    if (pimagePtr->fetchScheduled) {
+        Tcl_CancelIdleCall(FetchTiles, (ClientData) pimagePtr);
+    }
+    if (pimagePtr->deletedPtr != NULL) {
+        *pimagePtr->deletedPtr = 1;
+    }
+    FreeTiles(pimagePtr, 0, 0, -1, -1);
+    Tcl_DeleteHashTable(&pimagePtr->tileTable);
+    if (pimagePtr->photo != NULL) {
+        TkPathImageChanged(pimagePtr->photo);
+    }
     if (pimagePtr->image != NULL) {
         Tk_FreeImage(pimagePtr->image);
     }
@@ -584,6 +701,12 @@ DisplayPimage(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display, Draw
     TkPathPushTMatrix(ctx, &m);
     m = GetTMatrix(pimagePtr);
     TkPathPushTMatrix(ctx, &m);
+    if ((pimagePtr->tileSize > 0) && ((pimagePtr->tileCmdObj != NULL)
+            || (pimagePtr->photo != NULL))) {
+        DisplayTiles(pimagePtr, ctx, &m, x, y, width, height);
+        TkPathFree(ctx);
+        return;
+    }
     /* @@@ Maybe we should taking care of x, y etc.? */
     TkPathImage(ctx, pimagePtr->image, pimagePtr->photo,
             itemPtr->bbox.x1+BBOX_OUT, itemPtr->bbox.y1+BBOX_OUT,
@@ -653,6 +776,14 @@ ImageChangedProc(
 {
     PimageItem *pimagePtr = (PimageItem *) clientData;
 
+    /* The converted pixels that are shared by all items are stale. */
+    if (pimagePtr->photo != NULL) {
+        TkPathImageChanged(pimagePtr->photo);
+    }
+    if (pimagePtr->tileCmdObj == NULL) {
+        FreeTiles(pimagePtr, x, y, width, height);
+    }
+
     /*
      * If the image's size changed and it's not anchored at its
      * northwest corner then just redisplay the entire area of the
@@ -676,6 +807,425 @@ ImageChangedProc(
             (int) (pimagePtr->header.y1 + y + height));
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * FreeTiles --
+ *
+ *	Frees the tiles that intersect the given rectangle of the
+ *	full image, or all of them if width is negative.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Tile photos are deleted. A tile that is being fetched is only
+ *	marked; FetchTile frees it.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+FreeTile(PimageItem *pimagePtr, PimageTile *tilePtr)
+{
+    Tcl_Interp *interp = ((TkPathCanvas *) pimagePtr->canvas)->interp;
+
+    if (tilePtr->prevPtr != NULL) {
+        tilePtr->prevPtr->nextPtr = tilePtr->nextPtr;
+    } else {
+        pimagePtr->tileFirstPtr = tilePtr->nextPtr;
+    }
+    if (tilePtr->nextPtr != NULL) {
+        tilePtr->nextPtr->prevPtr = tilePtr->prevPtr;
+    } else {
+        pimagePtr->tileLastPtr = tilePtr->prevPtr;
+    }
+    Tcl_DeleteHashEntry(tilePtr->hPtr);
+    pimagePtr->numTiles--;
+    if (tilePtr->image != NULL) {
+        Tk_FreeImage(tilePtr->image);
+    }
+    if (tilePtr->photo != NULL) {
+        TkPathImageChanged(tilePtr->photo);
+    }
+    if (tilePtr->nameObj != NULL) {
+        if (!Tcl_InterpDeleted(interp)) {
+            Tk_DeleteImage(interp, Tcl_GetString(tilePtr->nameObj));
+        }
+        Tcl_DecrRefCount(tilePtr->nameObj);
+    }
+    if (tilePtr->flags & TILE_FETCHING) {
+        tilePtr->flags |= TILE_FREED;
+    } else {
+        ckfree((char *) tilePtr);
+    }
+}
+
+static void
+FreeTiles(PimageItem *pimagePtr, int x, int y, int width, int height)
+{
+    PimageTile *tilePtr, *nextPtr;
+    int size = pimagePtr->tileSize;
+
+    for (tilePtr = pimagePtr->tileFirstPtr; tilePtr != NULL; tilePtr = nextPtr) {
+        nextPtr = tilePtr->nextPtr;
+        if ((width < 0) || ((tilePtr->key[0]*size < x + width)
+                && ((tilePtr->key[0] + 1)*size > x)
+                && (tilePtr->key[1]*size < y + height)
+                && ((tilePtr->key[1] + 1)*size > y))) {
+            FreeTile(pimagePtr, tilePtr);
+        }
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetTile --
+ *
+ *	Finds the tile at the given column and row and moves it first
+ *	in the list. A missing tile is added without a photo; it is
+ *	fetched later by FetchTiles.
+ *
+ * Results:
+ *	The tile.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static PimageTile *
+GetTile(PimageItem *pimagePtr, int col, int row)
+{
+    Tcl_HashEntry *hPtr;
+    PimageTile *tilePtr;
+    int key[2], isNew;
+
+    key[0] = col;
+    key[1] = row;
+    hPtr = Tcl_CreateHashEntry(&pimagePtr->tileTable, (char *) key, &isNew);
+    if (!isNew) {
+        tilePtr = (PimageTile *) Tcl_GetHashValue(hPtr);
+        if (tilePtr == pimagePtr->tileFirstPtr) {
+            return tilePtr;
+        }
+        tilePtr->prevPtr->nextPtr = tilePtr->nextPtr;
+        if (tilePtr->nextPtr != NULL) {
+            tilePtr->nextPtr->prevPtr = tilePtr->prevPtr;
+        } else {
+            pimagePtr->tileLastPtr = tilePtr->prevPtr;
+        }
+    } else {
+        tilePtr = (PimageTile *) ckalloc(sizeof(PimageTile));
+        memset(tilePtr, 0, sizeof(PimageTile));
+        tilePtr->key[0] = col;
+        tilePtr->key[1] = row;
+        tilePtr->hPtr = hPtr;
+        tilePtr->pimagePtr = pimagePtr;
+        Tcl_SetHashValue(hPtr, tilePtr);
+        pimagePtr->numTiles++;
+    }
+    tilePtr->prevPtr = NULL;
+    tilePtr->nextPtr = pimagePtr->tileFirstPtr;
+    if (pimagePtr->tileFirstPtr != NULL) {
+        pimagePtr->tileFirstPtr->prevPtr = tilePtr;
+    } else {
+        pimagePtr->tileLastPtr = tilePtr;
+    }
+    pimagePtr->tileFirstPtr = tilePtr;
+    return tilePtr;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * FetchTile --
+ *
+ *	Gets the photo of a tile. With a -tilecommand the command is
+ *	evaluated with the column and row appended; it returns the name
+ *	of a photo which the item then owns, or an empty string if
+ *	there is nothing to draw. Else a photo named ::tkp::tile...
+ *	is created and the tile is cut out of the -image photo into it.
+ *
+ *	The script may do anything, so afterwards the tile is only
+ *	used if it was not freed meanwhile.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Evaluates a script and creates a photo image. Errors are
+ *	reported as background errors and leave the tile empty.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+FetchTile(PimageItem *pimagePtr, PimageTile *tilePtr)
+{
+    Tcl_Interp *interp = ((TkPathCanvas *) pimagePtr->canvas)->interp;
+    Tk_PhotoImageBlock block;
+    Tk_PhotoHandle photo;
+    Tcl_Obj *cmdObj, *nameObj = NULL;
+    int result, width = 0, height = 0, size = pimagePtr->tileSize;
+    int col = tilePtr->key[0], row = tilePtr->key[1];
+
+    if (pimagePtr->tileCmdObj != NULL) {
+        cmdObj = Tcl_DuplicateObj(pimagePtr->tileCmdObj);
+        Tcl_ListObjAppendElement(NULL, cmdObj, Tcl_NewIntObj(col));
+        Tcl_ListObjAppendElement(NULL, cmdObj, Tcl_NewIntObj(row));
+    } else {
+        cmdObj = Tcl_NewStringObj("image create photo", -1);
+        Tcl_ListObjAppendElement(NULL, cmdObj, Tcl_ObjPrintf(
+                "::tkp::tile%s#%d,%d,%d",
+                Tk_PathName(Tk_PathCanvasTkwin(pimagePtr->canvas)),
+                pimagePtr->header.id, col, row));
+    }
+    Tcl_IncrRefCount(cmdObj);
+    tilePtr->flags |= TILE_FETCHING|TILE_FETCHED;
+    result = Tcl_EvalObjEx(interp, cmdObj, TCL_EVAL_GLOBAL);
+    Tcl_DecrRefCount(cmdObj);
+    if (result == TCL_OK) {
+        nameObj = Tcl_GetObjResult(interp);
+        Tcl_IncrRefCount(nameObj);
+    }
+    if (tilePtr->flags & TILE_FREED) {
+
+        /* Freed, maybe with the whole item, by the script. */
+        if (nameObj != NULL) {
+            if (Tcl_GetCharLength(nameObj) > 0) {
+                Tk_DeleteImage(interp, Tcl_GetString(nameObj));
+            }
+            Tcl_DecrRefCount(nameObj);
+        }
+        ckfree((char *) tilePtr);
+        return;
+    }
+    tilePtr->flags &= ~TILE_FETCHING;
+    if (nameObj == NULL) {
+        Tcl_BackgroundError(interp);
+        return;
+    }
+    if (Tcl_GetCharLength(nameObj) == 0) {
+        Tcl_DecrRefCount(nameObj);
+        return;
+    }
+    tilePtr->nameObj = nameObj;
+    if (pimagePtr->tileCmdObj == NULL) {
+        photo = Tk_FindPhoto(interp, Tcl_GetString(nameObj));
+        Tk_PhotoGetImage(pimagePtr->photo, &block);
+        width = MIN(size, block.width - col*size);
+        height = MIN(size, block.height - row*size);
+        if ((photo != NULL) && (width > 0) && (height > 0)) {
+            block.pixelPtr += row*size*block.pitch + col*size*block.pixelSize;
+            block.width = width;
+            block.height = height;
+            if (Tk_PhotoPutBlock(interp, photo, &block, 0, 0, width, height,
+                    TK_PHOTO_COMPOSITE_SET) != TCL_OK) {
+                Tcl_BackgroundError(interp);
+                return;
+            }
+        }
+    }
+    tilePtr->image = Tk_GetImage(interp, Tk_PathCanvasTkwin(pimagePtr->canvas),
+            Tcl_GetString(nameObj), TileChangedProc, (ClientData) tilePtr);
+    if (tilePtr->image != NULL) {
+        tilePtr->photo = Tk_FindPhoto(interp, Tcl_GetString(nameObj));
+        if (tilePtr->photo == NULL) {
+            Tcl_AppendResult(interp, "image \"", Tcl_GetString(nameObj),
+                    "\" is not a photo", (char *) NULL);
+        }
+    }
+    if (tilePtr->photo == NULL) {
+        Tcl_BackgroundError(interp);
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * FetchTiles --
+ *
+ *	Idle handler that fetches the tiles that the last redisplay
+ *	found missing, and then redisplays the item.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Evaluates scripts and creates photo images.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+FetchTiles(ClientData clientData)
+{
+    PimageItem *pimagePtr = (PimageItem *) clientData;
+    TkPathCanvas *canvasPtr = (TkPathCanvas *) pimagePtr->canvas;
+    Tcl_Interp *interp = canvasPtr->interp;
+    Tcl_InterpState state;
+    PimageTile *tilePtr;
+    int deleted = 0;
+
+    pimagePtr->fetchScheduled = 0;
+    if (pimagePtr->deletedPtr != NULL) {
+        /* Called from a tile script; the outer loop gets all tiles. */
+        return;
+    }
+    pimagePtr->deletedPtr = &deleted;
+    Tcl_Preserve((ClientData) canvasPtr);
+    state = Tcl_SaveInterpState(interp, TCL_OK);
+    while (!deleted && !(canvasPtr->flags & CANVAS_DELETED)) {
+        for (tilePtr = pimagePtr->tileFirstPtr; tilePtr != NULL;
+                tilePtr = tilePtr->nextPtr) {
+            if (!(tilePtr->flags & TILE_FETCHED)) {
+                break;
+            }
+        }
+        if (tilePtr == NULL) {
+            break;
+        }
+        FetchTile(pimagePtr, tilePtr);
+    }
+    Tcl_RestoreInterpState(interp, state);
+    if (!deleted) {
+        pimagePtr->deletedPtr = NULL;
+        if (!(canvasPtr->flags & CANVAS_DELETED)) {
+            Tk_PathCanvasEventuallyRedraw(pimagePtr->canvas,
+                    pimagePtr->header.x1, pimagePtr->header.y1,
+                    pimagePtr->header.x2, pimagePtr->header.y2);
+        }
+    }
+    Tcl_Release((ClientData) canvasPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * DisplayTiles --
+ *
+ *	Draws the tiles of the image that intersect the redisplayed
+ *	area. Only these are converted and they are kept for later
+ *	redisplays. Beyond -tilecache tiles the ones drawn least
+ *	recently are freed, but never those drawn by this redisplay.
+ *	Missing tiles are fetched by an idle handler which redisplays
+ *	the item when they are there.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Tiles are created and freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+DisplayTiles(PimageItem *pimagePtr, TkPathContext ctx, TMatrix *mPtr,
+        int x, int y, int width, int height)
+{
+    Tk_PhotoImageBlock block;
+    PimageTile *tilePtr;
+    TMatrix mi;
+    double ox, oy, sx, sy, px, py, x1, y1, x2, y2;
+    int i, col, row, col1, col2, row1, row2, tw, th;
+    int iwidth, iheight, size = pimagePtr->tileSize;
+    
+    if (pimagePtr->tileCmdObj != NULL) {
+        iwidth = (int) pimagePtr->width;
+        iheight = (int) pimagePtr->height;
+    } else {
+        Tk_PhotoGetImage(pimagePtr->photo, &block);
+        iwidth = block.width;
+        iheight = block.height;
+    }
+    if ((iwidth <= 0) || (iheight <= 0)
+            || (mPtr->a * mPtr->d - mPtr->b * mPtr->c == 0.0)) {
+        return;
+    }
+    if ((iwidth != pimagePtr->tileGrid[0]) || (iheight != pimagePtr->tileGrid[1])) {
+        FreeTiles(pimagePtr, 0, 0, -1, -1);
+        pimagePtr->tileGrid[0] = iwidth;
+        pimagePtr->tileGrid[1] = iheight;
+    }
+    ox = pimagePtr->header.bbox.x1 + BBOX_OUT;
+    oy = pimagePtr->header.bbox.y1 + BBOX_OUT;
+    sx = (pimagePtr->width > 0.0) ? pimagePtr->width/iwidth : 1.0;
+    sy = (pimagePtr->height > 0.0) ? pimagePtr->height/iheight : 1.0;
+
+    /*
+     * Map the redisplayed area back to pixels of the full image.
+     */
+    PathInverseTMatrix(mPtr, &mi);
+    x1 = y1 = 1.0e30;
+    x2 = y2 = -1.0e30;
+    for (i = 0; i < 4; i++) {
+        px = x + ((i & 1) ? width : 0);
+        py = y + ((i & 2) ? height : 0);
+        PathApplyTMatrix(&mi, &px, &py);
+        px = (px - ox)/sx;
+        py = (py - oy)/sy;
+        x1 = MIN(x1, px);
+        y1 = MIN(y1, py);
+        x2 = MAX(x2, px);
+        y2 = MAX(y2, py);
+    }
+    col1 = (int) MAX(0.0, floor(x1/size));
+    row1 = (int) MAX(0.0, floor(y1/size));
+    col2 = (int) MIN((double) (iwidth - 1)/size, floor(x2/size));
+    row2 = (int) MIN((double) (iheight - 1)/size, floor(y2/size));
+    
+    pimagePtr->tileStamp++;
+    for (row = row1; row <= row2; row++) {
+        for (col = col1; col <= col2; col++) {
+            tw = MIN(size, iwidth - col*size);
+            th = MIN(size, iheight - row*size);
+            tilePtr = GetTile(pimagePtr, col, row);
+            tilePtr->stamp = pimagePtr->tileStamp;
+            if (!(tilePtr->flags & TILE_FETCHED)) {
+                if (!pimagePtr->fetchScheduled) {
+                    Tcl_DoWhenIdle(FetchTiles, (ClientData) pimagePtr);
+                    pimagePtr->fetchScheduled = 1;
+                }
+            } else if (tilePtr->photo != NULL) {
+                TkPathImage(ctx, tilePtr->image, tilePtr->photo,
+                        ox + col*size*sx, oy + row*size*sy, tw*sx, th*sy,
+                        pimagePtr->fillOpacity, pimagePtr->tintColor,
+                        pimagePtr->tintAmount, pimagePtr->interpolation, NULL);
+            }
+        }
+    }
+    while ((pimagePtr->numTiles > pimagePtr->tileCache)
+            && (pimagePtr->tileLastPtr->stamp != pimagePtr->tileStamp)) {
+        FreeTile(pimagePtr, pimagePtr->tileLastPtr);
+    }
+}
+
+static void
+TileChangedProc(
+    ClientData clientData,	/* Pointer to the tile. */
+    int x, int y,		/* Upper left pixel (within image)
+                                 * that must be redisplayed. */
+    int width, int height,	/* Dimensions of area to redisplay
+                                 * (may be <= 0). */
+    int imgWidth, int imgHeight)/* New dimensions of image. */
+{
+    PimageTile *tilePtr = (PimageTile *) clientData;
+    PimageItem *pimagePtr = tilePtr->pimagePtr;
+    Tcl_Interp *interp = ((TkPathCanvas *) pimagePtr->canvas)->interp;
+
+    /* The tile photo may also have been deleted. */
+    if (tilePtr->photo != NULL) {
+        TkPathImageChanged(tilePtr->photo);
+    }
+    tilePtr->photo = Tk_FindPhoto(interp, Tcl_GetString(tilePtr->nameObj));
+    Tk_PathCanvasEventuallyRedraw(pimagePtr->canvas, pimagePtr->header.x1,
+            pimagePtr->header.y1, pimagePtr->header.x2, pimagePtr->header.y2);
+}
+
 void	
 PimageStyleChangedProc(ClientData clientData, int flags)
 {
@@ -15,9 +15,6 @@
 #include "tkCanvPathUtil.h"
 #include "tkPathStyle.h"
 
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 /*
  * The structure below defines the record for each path item.
  */
@@ -150,10 +147,15 @@ CreatePline(Tcl_Interp *interp, Tk_PathCanvas canvas, struct Tk_PathItem *itemPt
         goto error;
     }
 
-    for (i = 1; i < objc; i++) {
-        char *arg = Tcl_GetString(objv[i]);
-        if ((arg[0] == '-') && (arg[1] >= 'a') && (arg[1] <= 'z')) {
-            break;
+    if (IsBinaryCoords(objc, objv)) {
+        /* Don't look for options inside the binary data. */
+        i = 2;
+    } else {
+        for (i = 1; i < objc; i++) {
+            char *arg = Tcl_GetString(objv[i]);
+            if ((arg[0] == '-') && (arg[1] >= 'a') && (arg[1] <= 'z')) {
+                break;
+            }
         }
     }
     if (ProcessCoords(interp, canvas, itemPtr, i, objv) != TCL_OK) {
@@ -191,6 +193,23 @@ ProcessCoords(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
         subobj = Tcl_NewDoubleObj(p->y2);
         Tcl_ListObjAppendElement(interp, obj, subobj);
         Tcl_SetObjResult(interp, obj);
+    } else if (IsBinaryCoords(objc, objv)) {
+        double *points;
+        int numValues;
+
+        if (CoordsFromBinary(interp, objc, objv, &points, &numValues) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (numValues != 4) {
+            ckfree((char *) points);
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("wrong # coordinates: expected 0 or 4", -1));
+            return TCL_ERROR;
+        }
+        p->x1 = points[0];
+        p->y1 = points[1];
+        p->x2 = points[2];
+        p->y2 = points[3];
+        ckfree((char *) points);
     } else if ((objc == 1) || (objc == 4)) {
         if (objc==1) {
             if (Tcl_ListObjGetElements(interp, objv[0], &objc,
@@ -222,7 +241,7 @@ PlineCoords(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
     int result;
     
     result = ProcessCoords(interp, canvas, itemPtr, objc, objv);
-    if ((result == TCL_OK) && ((objc == 1) || (objc == 4))) {
+    if ((result == TCL_OK) && (objc > 0)) {
         ConfigureArrows(canvas, plinePtr);
 	ComputePlineBbox(canvas, plinePtr);
     }
@@ -238,6 +257,9 @@ ComputePlineBbox(Tk_PathCanvas canvas, PlineItem *plinePtr)
     Tk_PathState state = itemExPtr->header.state;
     PathRect r;
 
+    if (TkPathCanvasDeferItemBbox(canvas, itemPtr)) {
+	return;
+    }
     if(state == TK_PATHSTATE_NULL) {
 	state = TkPathCanvasState(canvas);
     }
@@ -15,9 +15,6 @@
 #include "tkCanvArrow.h"
 #include "tkPathStyle.h"
 
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 /*
  * The structure below defines the record for each path item.
  */
@@ -26,11 +23,32 @@ typedef struct PpolyItem  {
     Tk_PathItemEx headerEx; /* Generic stuff that's the same for all
                              * path types.  MUST BE FIRST IN STRUCTURE. */
     char type;		    /* Polyline or polygon. */
+    int precision;	    /* How the coordinates are stored, any of
+			     * kPpolyPrecisionDouble or kPpolyPrecisionFloat. */
     PathAtom *atomPtr;
     int maxNumSegments;	    /* Max number of straight segments (for subpath)
 			     * needed for Area and Point functions. */
     ArrowDescr startarrow;
     ArrowDescr endarrow;
+    int capacity;	    /* Polyline only: if > 0 the points are kept in
+			     * a ring buffer of this many points, and the
+			     * oldest ones are dropped when it is full. */
+    LineToAtom *ringPtr;    /* The atoms of the ring buffer, or NULL. They
+			     * are linked from the oldest point, which is
+			     * atomPtr, to the newest one. */
+    int ringFirst;	    /* Index of the oldest point in ringPtr. */
+    int ringCount;	    /* Number of points in the ring buffer. */
+    int numDropped;	    /* Points dropped since the bbox was computed,
+			     * which then may be larger than needed. */
+    int decimate;	    /* Polyline only: if set, draw at most four
+			     * points per device pixel column. */
+    PathAtom *decimatedPtr; /* Cached decimated atoms, or NULL. */
+    TMatrix decimatedMatrix;/* The device matrix they were made for. */
+    double simplify;	    /* If > 0, draw and hit test a copy of the
+			     * line that deviates at most this many device
+			     * pixels from it. */
+    PathAtom *simplifiedPtr;/* Cached simplified atoms, or NULL. */
+    int simplifiedZoom;	    /* The zoom bucket they were made for. */
 } PpolyItem;
 
 enum {
@@ -38,6 +56,22 @@ enum {
     kPpolyTypePolygon
 };
 
+enum {
+    kPpolyPrecisionDouble,
+    kPpolyPrecisionFloat
+};
+
+enum {
+    PPOLY_OPTION_INDEX_PRECISION = (1L << (PATH_STYLE_OPTION_INDEX_END + 1)),
+    PPOLY_OPTION_INDEX_CAPACITY  = (1L << (PATH_STYLE_OPTION_INDEX_END + 2)),
+    PPOLY_OPTION_INDEX_DECIMATE  = (1L << (PATH_STYLE_OPTION_INDEX_END + 3)),
+    PPOLY_OPTION_INDEX_SIMPLIFY  = (1L << (PATH_STYLE_OPTION_INDEX_END + 4))
+};
+
+static char *precisionST[] = {
+    "double", "float", NULL
+};
+
 
 /*
  * Prototypes for procedures defined in this file:
@@ -48,7 +82,8 @@ static int	ConfigurePpoly(Tcl_Interp *interp, Tk_PathCanvas canvas,
                         Tk_PathItem *itemPtr, int objc,
                         Tcl_Obj *CONST objv[], int flags);
 int		CoordsForPolygonline(Tcl_Interp *interp, Tk_PathCanvas canvas, int closed,
-                        int objc, Tcl_Obj *CONST objv[], PathAtom **atomPtrPtr, int *lenPtr);
+                        int precision, int objc, Tcl_Obj *CONST objv[],
+                        PathAtom **atomPtrPtr, int *lenPtr);
 static int	CreateAny(Tcl_Interp *interp,
                         Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
                         int objc, Tcl_Obj *CONST objv[], char type);
@@ -78,6 +113,24 @@ static void	TranslatePpoly(Tk_PathCanvas canvas,
                         Tk_PathItem *itemPtr, double deltaX, double deltaY);
 
 static int      ConfigureArrows(Tk_PathCanvas canvas, PpolyItem *ppolyPtr);
+static double *	GetPolyPoints(PathAtom *atomPtr, int *numPointsPtr);
+static int	GetPolyCoords(Tcl_Interp *interp, Tk_PathCanvas canvas,
+			int objc, Tcl_Obj *CONST objv[], double **pointsPtr,
+			int *numPointsPtr);
+static PathAtom * MakePolyAtoms(double *points, int numPoints, int closed,
+			int precision);
+static void	SetPolyPoints(PpolyItem *ppolyPtr, double *points, 
+			int numPoints);
+static void	FreePolyAtoms(PpolyItem *ppolyPtr);
+static int	ModifyPolyline(Tcl_Interp *interp, Tk_PathCanvas canvas, 
+			PpolyItem *ppolyPtr, int objc, Tcl_Obj *CONST objv[]);
+static void	RingPush(PpolyItem *ppolyPtr, double x, double y);
+static void	RingDrop(PpolyItem *ppolyPtr, int numPoints, 
+			PathRect *damagePtr);
+static PathAtom * GetDecimatedAtoms(PpolyItem *ppolyPtr, TMatrix *mPtr);
+static void	ClearDecimated(PpolyItem *ppolyPtr);
+static PathAtom * HitAtoms(Tk_PathCanvas canvas, PpolyItem *ppolyPtr,
+                    Tk_PathStyle *stylePtr);
 
 PATH_STYLE_CUSTOM_OPTION_RECORDS
 PATH_CUSTOM_OPTION_TAGS
@@ -85,12 +138,36 @@ PATH_OPTION_STRING_TABLES_FILL
 PATH_OPTION_STRING_TABLES_STROKE
 PATH_OPTION_STRING_TABLES_STATE
 
+#define PATH_OPTION_SPEC_PRECISION				\
+    {TK_OPTION_STRING_TABLE, "-precision", NULL, NULL,		\
+        "double", -1, Tk_Offset(PpolyItem, precision),		\
+        0, (ClientData) precisionST, PPOLY_OPTION_INDEX_PRECISION}
+
+#define PATH_OPTION_SPEC_CAPACITY				\
+    {TK_OPTION_INT, "-capacity", NULL, NULL,			\
+        "0", -1, Tk_Offset(PpolyItem, capacity),		\
+        0, 0, PPOLY_OPTION_INDEX_CAPACITY}
+
+#define PATH_OPTION_SPEC_DECIMATE				\
+    {TK_OPTION_BOOLEAN, "-decimate", NULL, NULL,		\
+        "0", -1, Tk_Offset(PpolyItem, decimate),		\
+        0, 0, PPOLY_OPTION_INDEX_DECIMATE}
+
+#define PATH_OPTION_SPEC_SIMPLIFY				\
+    {TK_OPTION_DOUBLE, "-simplify", NULL, NULL,			\
+        "0", -1, Tk_Offset(PpolyItem, simplify),		\
+        0, 0, PPOLY_OPTION_INDEX_SIMPLIFY}
+
 static Tk_OptionSpec optionSpecsPolyline[] = {
     PATH_OPTION_SPEC_CORE(Tk_PathItemEx),
     PATH_OPTION_SPEC_PARENT,
     PATH_OPTION_SPEC_STYLE_FILL(Tk_PathItemEx, ""),
     PATH_OPTION_SPEC_STYLE_MATRIX(Tk_PathItemEx),
     PATH_OPTION_SPEC_STYLE_STROKE(Tk_PathItemEx, "black"),
+    PATH_OPTION_SPEC_PRECISION,
+    PATH_OPTION_SPEC_CAPACITY,
+    PATH_OPTION_SPEC_DECIMATE,
+    PATH_OPTION_SPEC_SIMPLIFY,
     PATH_OPTION_SPEC_STARTARROW_GRP(PpolyItem),
     PATH_OPTION_SPEC_ENDARROW_GRP(PpolyItem),
     PATH_OPTION_SPEC_END
@@ -102,6 +179,8 @@ static Tk_OptionSpec optionSpecsPpolygon[] = {
     PATH_OPTION_SPEC_STYLE_FILL(Tk_PathItemEx, ""),
     PATH_OPTION_SPEC_STYLE_MATRIX(Tk_PathItemEx),
     PATH_OPTION_SPEC_STYLE_STROKE(Tk_PathItemEx, "black"),
+    PATH_OPTION_SPEC_PRECISION,
+    PATH_OPTION_SPEC_SIMPLIFY,
     PATH_OPTION_SPEC_END
 };
 
@@ -200,11 +279,22 @@ CreateAny(Tcl_Interp *interp, Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
     itemExPtr->styleInst = NULL;
     ppolyPtr->atomPtr = NULL;
     ppolyPtr->type = type;
+    ppolyPtr->precision = kPpolyPrecisionDouble;
     itemPtr->bbox = NewEmptyPathRect();
     itemPtr->totalBbox = NewEmptyPathRect();
     ppolyPtr->maxNumSegments = 0;
     TkPathArrowDescrInit(&ppolyPtr->startarrow);
     TkPathArrowDescrInit(&ppolyPtr->endarrow);
+    ppolyPtr->capacity = 0;
+    ppolyPtr->ringPtr = NULL;
+    ppolyPtr->ringFirst = 0;
+    ppolyPtr->ringCount = 0;
+    ppolyPtr->numDropped = 0;
+    ppolyPtr->decimate = 0;
+    ppolyPtr->decimatedPtr = NULL;
+    ppolyPtr->simplify = 0.0;
+    ppolyPtr->simplifiedPtr = NULL;
+    ppolyPtr->simplifiedZoom = 0;
 
     if (ppolyPtr->type == kPpolyTypePolyline) {
 	if (optionTablePolyline == NULL) {
@@ -223,15 +313,20 @@ CreateAny(Tcl_Interp *interp, Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
         goto error;
     }
 
-    for (i = 1; i < objc; i++) {
-        char *arg = Tcl_GetString(objv[i]);
-        if ((arg[0] == '-') && (arg[1] >= 'a') && (arg[1] <= 'z')) {
-            break;
+    if (IsBinaryCoords(objc, objv)) {
+        /* Don't look for options inside the binary data. */
+        i = 2;
+    } else {
+        for (i = 1; i < objc; i++) {
+            char *arg = Tcl_GetString(objv[i]);
+            if ((arg[0] == '-') && (arg[1] >= 'a') && (arg[1] <= 'z')) {
+                break;
+            }
         }
     }
     if (CoordsForPolygonline(interp, canvas, 
 	    (ppolyPtr->type == kPpolyTypePolyline) ? 0 : 1, 
-	    i, objv, &(ppolyPtr->atomPtr), &len) != TCL_OK) {
+	    ppolyPtr->precision, i, objv, &(ppolyPtr->atomPtr), &len) != TCL_OK) {
         goto error;
     }
     ppolyPtr->maxNumSegments = len;
@@ -257,9 +352,27 @@ PpolyCoords(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
     PpolyItem *ppolyPtr = (PpolyItem *) itemPtr;
     int len, closed;
 
+    if ((objc > 0) && TkPathCanvasIsCoordsModifier(objv[0])) {
+        return ModifyPolyline(interp, canvas, ppolyPtr, objc, objv);
+    }
+    if ((ppolyPtr->ringPtr != NULL) && (objc > 0)) {
+        double *points;
+        int numPoints;
+
+        if (GetPolyCoords(interp, canvas, objc, objv, &points, 
+                &numPoints) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        FreePolyAtoms(ppolyPtr);
+        SetPolyPoints(ppolyPtr, points, numPoints);
+        ckfree((char *) points);
+        ConfigureArrows(canvas, ppolyPtr);
+        ComputePpolyBbox(canvas, ppolyPtr);
+        return TCL_OK;
+    }
     closed = (ppolyPtr->type == kPpolyTypePolyline) ? 0 : 1;
-    if (CoordsForPolygonline(interp, canvas, closed, objc, objv, 
-            &(ppolyPtr->atomPtr), &len) != TCL_OK) {
+    if (CoordsForPolygonline(interp, canvas, closed, ppolyPtr->precision,
+            objc, objv, &(ppolyPtr->atomPtr), &len) != TCL_OK) {
         return TCL_ERROR;
     }
     ppolyPtr->maxNumSegments = len;
@@ -276,9 +389,15 @@ ComputePpolyBbox(Tk_PathCanvas canvas, PpolyItem *ppolyPtr)
     Tk_PathStyle style;
     Tk_PathState state = itemExPtr->header.state;
 
+    if (TkPathCanvasDeferItemBbox(canvas, itemPtr)) {
+	return;
+    }
     if (state == TK_PATHSTATE_NULL) {
 	state = TkPathCanvasState(canvas);
     }
+    ppolyPtr->numDropped = 0;
+    ClearDecimated(ppolyPtr);
+    FreeSimplifiedAtoms(&ppolyPtr->simplifiedPtr);
     if ((ppolyPtr->atomPtr == NULL) || (state == TK_PATHSTATE_HIDDEN)) {
         itemExPtr->header.x1 = itemExPtr->header.x2 =
         itemExPtr->header.y1 = itemExPtr->header.y2 = -1;
@@ -384,6 +503,23 @@ ConfigurePpoly(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
 	stylePtr->mask |= mask;
     }
     stylePtr->strokeOpacity = MAX(0.0, MIN(1.0, stylePtr->strokeOpacity));
+    ppolyPtr->capacity = MAX(0, ppolyPtr->capacity);
+    ppolyPtr->simplify = MAX(0.0, ppolyPtr->simplify);
+
+    /*
+     * Store the coordinates again if -precision or -capacity was changed.
+     */
+    if (!error 
+	    && (mask & (PPOLY_OPTION_INDEX_PRECISION|PPOLY_OPTION_INDEX_CAPACITY))
+	    && ((ppolyPtr->atomPtr != NULL) || (ppolyPtr->ringPtr != NULL))) {
+	double *points;
+	int numPoints;
+
+	points = GetPolyPoints(ppolyPtr->atomPtr, &numPoints);
+	FreePolyAtoms(ppolyPtr);
+	SetPolyPoints(ppolyPtr, points, numPoints);
+	ckfree((char *) points);
+    }
 
 #if 0	    // From old code. Needed?
     state = itemPtr->state;
@@ -421,10 +557,9 @@ DeletePpoly(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display)
     if (itemExPtr->styleInst != NULL) {
 	TkPathFreeStyle(itemExPtr->styleInst);
     }
-    if (ppolyPtr->atomPtr != NULL) {
-        TkPathFreeAtoms(ppolyPtr->atomPtr);
-        ppolyPtr->atomPtr = NULL;
-    }
+    FreePolyAtoms(ppolyPtr);
+    ClearDecimated(ppolyPtr);
+    FreeSimplifiedAtoms(&ppolyPtr->simplifiedPtr);
     TkPathFreeArrow(&ppolyPtr->startarrow);
     TkPathFreeArrow(&ppolyPtr->endarrow);
     optionTable = (ppolyPtr->type == kPpolyTypePolyline) ? optionTablePolyline : optionTablePpolygon;
@@ -438,13 +573,28 @@ DisplayPpoly(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display, Drawa
     PpolyItem *ppolyPtr = (PpolyItem *) itemPtr;
     TMatrix m = GetCanvasTMatrix(canvas);
     Tk_PathStyle style;
+    PathAtom *atomPtr = ppolyPtr->atomPtr;
     
     /* === EB - 23-apr-2010: register coordinate offsets */
     TkPathSetCoordOffsets(m.tx, m.ty);
     /* === */
     
+    if (atomPtr == NULL) {
+        /* All points of a ring buffer may have been dropped. */
+        return;
+    }
     style = TkPathCanvasInheritStyle(itemPtr, 0);
-    TkPathDrawPath(Tk_PathCanvasTkwin(canvas), drawable, ppolyPtr->atomPtr, &style,
+    if (ppolyPtr->decimate) {
+        TMatrix device = m;
+        
+        MMulTMatrix(style.matrixPtr, &device);
+        atomPtr = GetDecimatedAtoms(ppolyPtr, &device);
+    } else if (ppolyPtr->simplify > 0.0) {
+        atomPtr = GetSimplifiedAtoms(atomPtr, ppolyPtr->simplify,
+                style.matrixPtr, &ppolyPtr->simplifiedPtr, 
+                &ppolyPtr->simplifiedZoom);
+    }
+    TkPathDrawPath(Tk_PathCanvasTkwin(canvas), drawable, atomPtr, &style,
             &m, &itemPtr->bbox);
     /*
      * Display arrowheads, if they are wanted.
@@ -471,7 +621,7 @@ PpolyToPoint(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *pointPtr)
 
     flags = (ppolyPtr->type == kPpolyTypePolyline) ? kPathMergeStyleNotFill : 0;
     style = TkPathCanvasInheritStyle(itemPtr, flags);
-    dist = GenericPathToPoint(canvas, itemPtr, &style, ppolyPtr->atomPtr, 
+    dist = GenericPathToPoint(canvas, itemPtr, &style, HitAtoms(canvas, ppolyPtr, &style), 
             ppolyPtr->maxNumSegments, pointPtr);
     TkPathCanvasFreeInheritedStyle(&style);
     return dist;
@@ -488,7 +638,7 @@ PpolyToArea(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *areaPtr)
     flags = (ppolyPtr->type == kPpolyTypePolyline) ? kPathMergeStyleNotFill : 0;
     style = TkPathCanvasInheritStyle(itemPtr, flags);    
     area = GenericPathToArea(canvas, itemPtr, &style, 
-            ppolyPtr->atomPtr, ppolyPtr->maxNumSegments, areaPtr);
+            HitAtoms(canvas, ppolyPtr, &style), ppolyPtr->maxNumSegments, areaPtr);
     TkPathCanvasFreeInheritedStyle(&style);            
     return area;
 }
@@ -505,6 +655,8 @@ ScalePpoly(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double originX, double or
 {
     PpolyItem *ppolyPtr = (PpolyItem *) itemPtr;
 
+    ClearDecimated(ppolyPtr);
+    FreeSimplifiedAtoms(&ppolyPtr->simplifiedPtr);
     ScalePathAtoms(ppolyPtr->atomPtr, originX, originY, scaleX, scaleY);
     ScalePathRect(&itemPtr->bbox, originX, originY, scaleX, scaleY);
     ScalePathRect(&itemPtr->totalBbox, originX, originY, scaleX, scaleY);
@@ -519,6 +671,8 @@ TranslatePpoly(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double deltaX, double
 {
     PpolyItem *ppolyPtr = (PpolyItem *) itemPtr;
 
+    ClearDecimated(ppolyPtr);
+    FreeSimplifiedAtoms(&ppolyPtr->simplifiedPtr);
     TranslatePathAtoms(ppolyPtr->atomPtr, deltaX, deltaY);
     TranslatePathRect(&itemPtr->bbox, deltaX, deltaY);
     TranslatePathRect(&itemPtr->totalBbox, deltaX, deltaY);
@@ -549,12 +703,15 @@ CoordsForPolygonline(
     Tcl_Interp *interp, 
     Tk_PathCanvas canvas, 
     int closed,				/* Polyline (0) or polygon (1) */
+    int precision,			/* kPpolyPrecisionDouble or 
+					 * kPpolyPrecisionFloat */
     int objc, 
     Tcl_Obj *CONST objv[],
     PathAtom **atomPtrPtr,
     int *lenPtr)
 {
     PathAtom *atomPtr = *atomPtrPtr;
+    double *points;
 
     if (objc == 0) {
         Tcl_Obj *obj = Tcl_NewListObj(0, (Tcl_Obj **) NULL);
@@ -573,6 +730,18 @@ CoordsForPolygonline(
                     Tcl_ListObjAppendElement(interp, obj, Tcl_NewDoubleObj(line->y));
                     break;
                 }
+                case PATH_ATOM_FLINE: {
+                    FloatLineAtom *fline = (FloatLineAtom *) atomPtr;
+                    float *pts = fline->points;
+                    int i;
+                    for (i = 0; i < fline->numPoints; i++, pts += 2) {
+                        Tcl_ListObjAppendElement(interp, obj, 
+                                Tcl_NewDoubleObj(fline->x0 + pts[0]));
+                        Tcl_ListObjAppendElement(interp, obj, 
+                                Tcl_NewDoubleObj(fline->y0 + pts[1]));
+                    }
+                    break;
+                }
                 case PATH_ATOM_Z: {
                 
                     break;
@@ -586,7 +755,59 @@ CoordsForPolygonline(
         Tcl_SetObjResult(interp, obj);
         return TCL_OK;
     }
-    if (objc == 1) {
+    if (GetPolyCoords(interp, canvas, objc, objv, &points, &objc) != TCL_OK) {
+        return TCL_ERROR;
+    }
+
+    /*
+     * Free any old stuff.
+     */
+    if (atomPtr != NULL) {
+        TkPathFreeAtoms(atomPtr);
+    }
+    *atomPtrPtr = MakePolyAtoms(points, objc, closed, precision);
+    ckfree((char *) points);
+    *lenPtr = objc + 2;
+    return TCL_OK;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetPolyCoords --
+ *
+ *		Gets the coordinates given to 'coords' or 'create' for 
+ *		polyline and polygon items, either as numbers, a list of 
+ *		numbers or packed binary data.
+ *
+ * Results:
+ *		Standard tcl result. On success an array of x and y 
+ *		coordinates, which must be freed by the caller, is stored
+ *		in pointsPtr and the number of points, at least 2, in
+ *		numPointsPtr.
+ *
+ * Side effects:
+ *		Memory allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+GetPolyCoords(
+    Tcl_Interp *interp, 
+    Tk_PathCanvas canvas, 
+    int objc, 
+    Tcl_Obj *CONST objv[],
+    double **pointsPtr,
+    int *numPointsPtr)
+{
+    double *points;
+    int i;
+
+    if (CoordsFromBinary(interp, objc, objv, &points, &objc) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if ((points == NULL) && (objc == 1)) {
         if (Tcl_ListObjGetElements(interp, objv[0], &objc,
             (Tcl_Obj ***) &objv) != TCL_OK) {
             return TCL_ERROR;
@@ -596,51 +817,599 @@ CoordsForPolygonline(
         char buf[64 + TCL_INTEGER_SPACE];
         sprintf(buf, "wrong # coordinates: expected an even number, got %d", objc);
         Tcl_SetResult(interp, buf, TCL_VOLATILE);
-        return TCL_ERROR;
+        goto error;
     } else if (objc < 4) {
         char buf[64 + TCL_INTEGER_SPACE];
         sprintf(buf, "wrong # coordinates: expected at least 4, got %d", objc);
         Tcl_SetResult(interp, buf, TCL_VOLATILE);
-        return TCL_ERROR;
+        goto error;
+    }
+    if (points == NULL) {
+        points = (double *) ckalloc((unsigned) (objc * sizeof(double)));
+        for (i = 0; i < objc; i++) {
+            if (Tk_PathCanvasGetCoordFromObj(interp, canvas, objv[i], 
+                    &points[i]) != TCL_OK) {
+                goto error;
+            }
+        }
+    }
+    *pointsPtr = points;
+    *numPointsPtr = objc/2;
+    return TCL_OK;
+
+error:
+    if (points != NULL) {
+        ckfree((char *) points);
+    }
+    return TCL_ERROR;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * MakePolyAtoms --
+ *
+ *		Makes the atoms for a polyline or polygon from an array
+ *		of x and y coordinates. With float precision the first
+ *		and last points are kept as doubles, and the ones in
+ *		between are stored in a FloatLineAtom relative to the
+ *		first point. Arrows can therefore still adjust the end
+ *		points in place.
+ *
+ * Results:
+ *		The first atom of the list.
+ *
+ * Side effects:
+ *		Memory allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static PathAtom *
+MakePolyAtoms(
+    double *points,
+    int numPoints,			/* At least 2. */
+    int closed,
+    int precision)
+{
+    PathAtom *firstAtomPtr, *atomPtr;
+    int i;
+
+    if (precision == kPpolyPrecisionFloat) {
+        firstAtomPtr = atomPtr = NewMoveToAtom(points[0], points[1]);
+        if (numPoints > 2) {
+            FloatLineAtom *flinePtr;
+            float *pts;
+
+            atomPtr->nextPtr = NewFloatLineAtom(points[0], points[1], 
+                    numPoints - 2);
+            atomPtr = atomPtr->nextPtr;
+            flinePtr = (FloatLineAtom *) atomPtr;
+            for (i = 1, pts = flinePtr->points; i < numPoints-1; i++, pts += 2) {
+                pts[0] = (float) (points[2*i] - points[0]);
+                pts[1] = (float) (points[2*i+1] - points[1]);
+            }
+        }
+        i = numPoints - 1;
+        atomPtr->nextPtr = NewLineToAtom(points[2*i], points[2*i+1]);
+        atomPtr = atomPtr->nextPtr;
+        if (closed) {
+            atomPtr->nextPtr = NewCloseAtom(points[0], points[1]);
+        }
     } else {
-        int 	i;
-        double	x, y;
-        double	firstX = 0.0, firstY = 0.0;
-        PathAtom *firstAtomPtr = NULL;
-    
+        PathAtomBuffer atoms;
+        LineToAtom *linePtr;
+        CloseAtom *closePtr;
+
         /*
-        * Free any old stuff.
-        */
-        if (atomPtr != NULL) {
-            TkPathFreeAtoms(atomPtr);
-            atomPtr = NULL;
+         * MoveToAtom and LineToAtom have the same layout so all points
+         * are filled in through a LineToAtom pointer.
+         */
+        TkPathAtomBufferInit(&atoms, numPoints + 1);
+        for (i = 0; i < numPoints; i++) {
+            linePtr = (LineToAtom *) TkPathAtomBufferAlloc(&atoms,
+                    (i == 0) ? PATH_ATOM_M : PATH_ATOM_L);
+            linePtr->x = points[2*i];
+            linePtr->y = points[2*i+1];
+        }
+        if (closed) {
+            closePtr = (CloseAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_Z);
+            closePtr->x = points[0];
+            closePtr->y = points[1];
         }
-        for (i = 0; i < objc; i += 2) {
-            if (Tk_PathCanvasGetCoordFromObj(interp, canvas, objv[i], &x) != TCL_OK) {
-                /* @@@ error recovery? */
+        firstAtomPtr = TkPathAtomBufferFinish(&atoms);
+    }
+    return firstAtomPtr;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetPolyPoints --
+ *
+ *		Collects the points of a polyline or polygon atom list
+ *		into an array of x and y coordinates.
+ *
+ * Results:
+ *		The array which must be freed by the caller. The number
+ *		of points is stored in numPointsPtr.
+ *
+ * Side effects:
+ *		Memory allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static double *
+GetPolyPoints(PathAtom *atomPtr, int *numPointsPtr)
+{
+    PathAtom *walkPtr;
+    double *points, *p;
+    int i, numPoints = 0;
+
+    for (walkPtr = atomPtr; walkPtr != NULL; walkPtr = walkPtr->nextPtr) {
+        if ((walkPtr->type == PATH_ATOM_M) || (walkPtr->type == PATH_ATOM_L)) {
+            numPoints++;
+        } else if (walkPtr->type == PATH_ATOM_FLINE) {
+            numPoints += ((FloatLineAtom *) walkPtr)->numPoints;
+        }
+    }
+    p = points = (double *) ckalloc((unsigned) (2 * numPoints * sizeof(double)));
+    for (walkPtr = atomPtr; walkPtr != NULL; walkPtr = walkPtr->nextPtr) {
+        if ((walkPtr->type == PATH_ATOM_M) || (walkPtr->type == PATH_ATOM_L)) {
+            LineToAtom *line = (LineToAtom *) walkPtr;
+            *p++ = line->x;
+            *p++ = line->y;
+        } else if (walkPtr->type == PATH_ATOM_FLINE) {
+            FloatLineAtom *fline = (FloatLineAtom *) walkPtr;
+            for (i = 0; i < fline->numPoints; i++) {
+                *p++ = fline->x0 + fline->points[2*i];
+                *p++ = fline->y0 + fline->points[2*i+1];
+            }
+        }
+    }
+    *numPointsPtr = numPoints;
+    return points;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * SetPolyPoints --
+ *
+ *		Stores the points of a polyline or polygon as atoms, in
+ *		a ring buffer if the item has a -capacity. A ring buffer
+ *		only keeps the newest points that fit.
+ *
+ * Results:
+ *		None.
+ *
+ * Side effects:
+ *		Memory allocated. Any old atoms must have been freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+SetPolyPoints(
+    PpolyItem *ppolyPtr,
+    double *points,
+    int numPoints)
+{
+    int i;
+
+    ppolyPtr->atomPtr = NULL;
+    if (ppolyPtr->capacity > 0) {
+        ppolyPtr->ringPtr = (LineToAtom *) ckalloc((unsigned) 
+                (ppolyPtr->capacity * sizeof(LineToAtom)));
+        ppolyPtr->ringFirst = 0;
+        ppolyPtr->ringCount = 0;
+        for (i = MAX(0, numPoints - ppolyPtr->capacity); i < numPoints; i++) {
+            RingPush(ppolyPtr, points[2*i], points[2*i+1]);
+        }
+        numPoints = ppolyPtr->ringCount;
+    } else if (numPoints > 0) {
+        ppolyPtr->atomPtr = MakePolyAtoms(points, numPoints,
+                (ppolyPtr->type == kPpolyTypePolyline) ? 0 : 1, 
+                ppolyPtr->precision);
+    }
+    ppolyPtr->maxNumSegments = numPoints + 2;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * FreePolyAtoms --
+ *
+ *		Frees the atoms of a polyline or polygon, which may be
+ *		kept in a ring buffer.
+ *
+ * Results:
+ *		None.
+ *
+ * Side effects:
+ *		Memory freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+FreePolyAtoms(PpolyItem *ppolyPtr)
+{
+    if (ppolyPtr->ringPtr != NULL) {
+        ckfree((char *) ppolyPtr->ringPtr);
+        ppolyPtr->ringPtr = NULL;
+        ppolyPtr->ringCount = 0;
+    } else if (ppolyPtr->atomPtr != NULL) {
+        TkPathFreeAtoms(ppolyPtr->atomPtr);
+    }
+    ppolyPtr->atomPtr = NULL;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * RingPush --
+ *
+ *		Adds a point after the newest one of a ring buffer which
+ *		must not be full. The atoms are linked in place so this
+ *		takes constant time.
+ *
+ * Results:
+ *		None.
+ *
+ * Side effects:
+ *		The ring buffer is changed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+RingPush(
+    PpolyItem *ppolyPtr,
+    double x, double y)
+{
+    LineToAtom *ringPtr = ppolyPtr->ringPtr;
+    LineToAtom *linePtr;
+    int capacity = ppolyPtr->capacity;
+    int i;
+
+    i = (ppolyPtr->ringFirst + ppolyPtr->ringCount) % capacity;
+    linePtr = ringPtr + i;
+    linePtr->x = x;
+    linePtr->y = y;
+    linePtr->pathAtom.flags = 0;
+    linePtr->pathAtom.nextPtr = NULL;
+    if (ppolyPtr->ringCount == 0) {
+        linePtr->pathAtom.type = PATH_ATOM_M;
+        ppolyPtr->atomPtr = (PathAtom *) linePtr;
+    } else {
+        linePtr->pathAtom.type = PATH_ATOM_L;
+        ringPtr[(i + capacity - 1) % capacity].pathAtom.nextPtr = 
+                (PathAtom *) linePtr;
+    }
+    ppolyPtr->ringCount++;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * RingDrop --
+ *
+ *		Drops the oldest numPoints points of a ring buffer.
+ *
+ * Results:
+ *		None.
+ *
+ * Side effects:
+ *		The ring buffer is changed. The dropped points and the new
+ *		first point are included in the damaged rect.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+RingDrop(
+    PpolyItem *ppolyPtr,
+    int numPoints,
+    PathRect *damagePtr)
+{
+    LineToAtom *linePtr;
+    int i;
+
+    numPoints = MIN(numPoints, ppolyPtr->ringCount);
+    if (numPoints <= 0) {
+        return;
+    }
+    for (i = 0; i < numPoints; i++) {
+        linePtr = ppolyPtr->ringPtr + ppolyPtr->ringFirst;
+        IncludePointInRect(damagePtr, linePtr->x, linePtr->y);
+        ppolyPtr->ringFirst = (ppolyPtr->ringFirst + 1) % ppolyPtr->capacity;
+    }
+    ppolyPtr->ringCount -= numPoints;
+    ppolyPtr->numDropped += numPoints;
+    if (ppolyPtr->ringCount == 0) {
+        ppolyPtr->ringFirst = 0;
+        ppolyPtr->atomPtr = NULL;
+    } else {
+        linePtr = ppolyPtr->ringPtr + ppolyPtr->ringFirst;
+        linePtr->pathAtom.type = PATH_ATOM_M;
+        IncludePointInRect(damagePtr, linePtr->x, linePtr->y);
+        ppolyPtr->atomPtr = (PathAtom *) linePtr;
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ModifyPolyline --
+ *
+ *		Processes the options to "coords" that change the points
+ *		of a polyline with a ring buffer:
+ *
+ *		    -append coordList	adds points after the newest one,
+ *					dropping the oldest ones if full
+ *		    -drop numPoints	drops the oldest points
+ *
+ *		Each point takes constant time. Unless the item has arrows
+ *		or is filled, only the area of the changed segments is
+ *		redrawn and the bbox is grown. It is computed again once
+ *		as many points were dropped as there are left, to not
+ *		keep growing when the points move along, as in a strip 
+ *		chart.
+ *
+ * Results:
+ *		Standard tcl result.
+ *
+ * Side effects:
+ *		The points may be changed and parts of the canvas redrawn.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ModifyPolyline(
+    Tcl_Interp *interp, 
+    Tk_PathCanvas canvas, 
+    PpolyItem *ppolyPtr, 
+    int objc, 
+    Tcl_Obj *CONST objv[])
+{
+    Tk_PathItem *itemPtr = &ppolyPtr->headerEx.header;
+    static CONST char *modifiers[] = {
+        "-append", "-drop", (char *) NULL
+    };
+    enum {
+        POLY_COORDS_APPEND, POLY_COORDS_DROP
+    };
+    Tk_PathState state = itemPtr->state;
+    Tk_PathStyle style;
+    Tk_PathItem damageHeader;
+    PathRect damage, total;
+    LineToAtom *lastPtr;
+    Tcl_Obj **coordsv;
+    int i, j, index, num, coordsc;
+    int partial;		/* Only the damaged area is redrawn. */
+    double x, y;
+
+    if (ppolyPtr->ringPtr == NULL) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(
+                "points can only be appended to a polyline with a -capacity",
+                -1));
+        return TCL_ERROR;
+    }
+    if (objc % 2) {
+        Tcl_WrongNumArgs(interp, 0, objv,
+                "pathName coords id ?-drop numPoints? ?-append coordList?");
+        return TCL_ERROR;
+    }
+    
+    /* Check all arguments before anything is changed. */
+    for (i = 0; i < objc; i += 2) {
+        if (Tcl_GetIndexFromObj(interp, objv[i], modifiers, "option", 0,
+                &index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (index == POLY_COORDS_DROP) {
+            if (Tcl_GetIntFromObj(interp, objv[i+1], &num) != TCL_OK) {
                 return TCL_ERROR;
             }
-            if (Tk_PathCanvasGetCoordFromObj(interp, canvas, objv[i+1], &y) != TCL_OK) {
+            if (num < 0) {
+                Tcl_SetObjResult(interp, Tcl_NewStringObj(
+                        "number of points can't be negative", -1));
                 return TCL_ERROR;
             }
-            if (i == 0) {
-                firstX = x;
-                firstY = y;
-                atomPtr = NewMoveToAtom(x, y);
-                firstAtomPtr = atomPtr;
-            } else {
-                atomPtr->nextPtr = NewLineToAtom(x, y);
-                atomPtr = atomPtr->nextPtr;
+            continue;
+        }
+        if (Tcl_ListObjGetElements(interp, objv[i+1], &coordsc, 
+                &coordsv) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (coordsc & 1) {
+            char buf[64 + TCL_INTEGER_SPACE];
+            sprintf(buf, "wrong # coordinates: expected an even number, got %d",
+                    coordsc);
+            Tcl_SetResult(interp, buf, TCL_VOLATILE);
+            return TCL_ERROR;
+        }
+        for (j = 0; j < coordsc; j++) {
+            if (Tk_PathCanvasGetCoordFromObj(interp, canvas, coordsv[j], 
+                    &x) != TCL_OK) {
+                return TCL_ERROR;
             }
         }
-        if (closed) {
-            atomPtr->nextPtr = NewCloseAtom(firstX, firstY);
+    }
+
+    if (state == TK_PATHSTATE_NULL) {
+	state = TkPathCanvasState(canvas);
+    }
+    style = TkPathCanvasInheritStyle(itemPtr, 0);
+    partial = (state != TK_PATHSTATE_HIDDEN) && (ppolyPtr->atomPtr != NULL)
+            && !ppolyPtr->startarrow.arrowEnabled 
+            && !ppolyPtr->endarrow.arrowEnabled && (style.fill == NULL);
+    if (!partial) {
+        Tk_PathCanvasEventuallyRedraw(canvas, itemPtr->x1, itemPtr->y1,
+                itemPtr->x2, itemPtr->y2);
+        
+        /* An end arrow has moved the newest point back; restore it. */
+        if ((ppolyPtr->endarrow.arrowPointsPtr != NULL) 
+                && (ppolyPtr->ringCount > 0)) {
+            lastPtr = ppolyPtr->ringPtr + (ppolyPtr->ringFirst 
+                    + ppolyPtr->ringCount - 1) % ppolyPtr->capacity;
+            TkPathPreconfigureArrow((PathPoint *) &lastPtr->x, 
+                    &ppolyPtr->endarrow);
+        }
+    }
+    
+    damage = NewEmptyPathRect();
+    for (i = 0; i < objc; i += 2) {
+        Tcl_GetIndexFromObj(NULL, objv[i], modifiers, "option", 0, &index);
+        if (index == POLY_COORDS_DROP) {
+            Tcl_GetIntFromObj(NULL, objv[i+1], &num);
+            RingDrop(ppolyPtr, num, &damage);
+            continue;
+        }
+        Tcl_ListObjGetElements(NULL, objv[i+1], &coordsc, &coordsv);
+        if ((ppolyPtr->ringCount > 0) && (coordsc > 0)) {
+            lastPtr = ppolyPtr->ringPtr + (ppolyPtr->ringFirst 
+                    + ppolyPtr->ringCount - 1) % ppolyPtr->capacity;
+            IncludePointInRect(&damage, lastPtr->x, lastPtr->y);
+        }
+        for (j = 0; j < coordsc; j += 2) {
+            Tk_PathCanvasGetCoordFromObj(NULL, canvas, coordsv[j], &x);
+            Tk_PathCanvasGetCoordFromObj(NULL, canvas, coordsv[j+1], &y);
+            if (ppolyPtr->ringCount == ppolyPtr->capacity) {
+                RingDrop(ppolyPtr, 1, &damage);
+            }
+            RingPush(ppolyPtr, x, y);
+            IncludePointInRect(&damage, x, y);
+            IncludePointInRect(&itemPtr->bbox, x, y);
+        }
+    }
+    ppolyPtr->maxNumSegments = ppolyPtr->ringCount + 2;
+    ClearDecimated(ppolyPtr);
+    FreeSimplifiedAtoms(&ppolyPtr->simplifiedPtr);
+    
+    if (!partial) {
+        ConfigureArrows(canvas, ppolyPtr);
+        ComputePpolyBbox(canvas, ppolyPtr);
+        Tk_PathCanvasEventuallyRedraw(canvas, itemPtr->x1, itemPtr->y1,
+                itemPtr->x2, itemPtr->y2);
+    } else if (!IsPathRectEmpty(&damage)) {
+        total = GetGenericPathTotalBboxFromBare(NULL, &style, &damage);
+        if ((style.joinStyle == JoinMiter) && (style.strokeWidth > 1.0)) {
+            double miter = 0.5 * style.miterLimit * style.strokeWidth;
+            
+            total.x1 -= miter;
+            total.y1 -= miter;
+            total.x2 += miter;
+            total.y2 += miter;
+        }
+        if ((ppolyPtr->atomPtr == NULL) 
+                || (ppolyPtr->numDropped > ppolyPtr->ringCount)) {
+            ComputePpolyBbox(canvas, ppolyPtr);
+        } else {
+            IncludePointInRect(&itemPtr->totalBbox, total.x1, total.y1);
+            IncludePointInRect(&itemPtr->totalBbox, total.x2, total.y2);
+            SetGenericPathHeaderBbox(itemPtr, style.matrixPtr, 
+                    &itemPtr->totalBbox);
         }
-        *atomPtrPtr = firstAtomPtr;
-        *lenPtr = i/2 + 2;
+        SetGenericPathHeaderBbox(&damageHeader, style.matrixPtr, &total);
+        Tk_PathCanvasEventuallyRedraw(canvas, damageHeader.x1, 
+                damageHeader.y1, damageHeader.x2, damageHeader.y2);
     }
+    TkPathCanvasFreeInheritedStyle(&style);
     return TCL_OK;
 }
 
-/*----------------------------------------------------------------------*/
+/*
+ *--------------------------------------------------------------
+ *
+ * GetDecimatedAtoms --
+ *
+ *		Gets the atoms of a polyline decimated to at most four 
+ *		points per device pixel column, see DecimatePoints. They 
+ *		are cached and made again only when the points or the
+ *		zoom changed. Scrolling by whole pixels keeps them.
+ *
+ * Results:
+ *		The decimated atoms, owned by the item.
+ *
+ * Side effects:
+ *		Memory allocated.
+ *
+ *--------------------------------------------------------------
+ */
 
+static PathAtom *
+GetDecimatedAtoms(
+    PpolyItem *ppolyPtr,
+    TMatrix *mPtr)		/* From item to device coordinates. */
+{
+    TMatrix *cachePtr = &ppolyPtr->decimatedMatrix;
+    double *points, *decimated;
+    int numPoints, numDecimated;
+
+    if ((ppolyPtr->decimatedPtr != NULL) 
+            && (mPtr->a == cachePtr->a) && (mPtr->b == cachePtr->b)
+            && (mPtr->c == cachePtr->c) && (mPtr->d == cachePtr->d)
+            && (mPtr->tx - floor(mPtr->tx) == cachePtr->tx - floor(cachePtr->tx))) {
+        return ppolyPtr->decimatedPtr;
+    }
+    ClearDecimated(ppolyPtr);
+    points = GetPolyPoints(ppolyPtr->atomPtr, &numPoints);
+    decimated = (double *) ckalloc((unsigned) (2 * numPoints * sizeof(double)));
+    numDecimated = DecimatePoints(points, numPoints, mPtr, decimated);
+    ppolyPtr->decimatedPtr = MakePolyAtoms(decimated, numDecimated, 0,
+            kPpolyPrecisionDouble);
+    ppolyPtr->decimatedMatrix = *mPtr;
+    ckfree((char *) decimated);
+    ckfree((char *) points);
+    return ppolyPtr->decimatedPtr;
+}
+
+static void
+ClearDecimated(PpolyItem *ppolyPtr)
+{
+    if (ppolyPtr->decimatedPtr != NULL) {
+        TkPathFreeAtoms(ppolyPtr->decimatedPtr);
+        ppolyPtr->decimatedPtr = NULL;
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * HitAtoms --
+ *
+ *		Gets the atoms used by the point and area functions. With
+ *		-decimate or -simplify they are the ones drawn, so that
+ *		what is hit is what is seen.
+ *
+ * Results:
+ *		The atoms, owned by the item.
+ *
+ * Side effects:
+ *		May make the decimated or simplified atoms.
+ *
+ *--------------------------------------------------------------
+ */
+
+static PathAtom *
+HitAtoms(Tk_PathCanvas canvas, PpolyItem *ppolyPtr, Tk_PathStyle *stylePtr)
+{
+    if (ppolyPtr->decimate && (ppolyPtr->atomPtr != NULL)) {
+        TMatrix device = GetCanvasTMatrix(canvas);
+        
+        MMulTMatrix(stylePtr->matrixPtr, &device);
+        return GetDecimatedAtoms(ppolyPtr, &device);
+    }
+    if ((ppolyPtr->simplify > 0.0) && (ppolyPtr->atomPtr != NULL)) {
+        return GetSimplifiedAtoms(ppolyPtr->atomPtr, ppolyPtr->simplify,
+                stylePtr->matrixPtr, &ppolyPtr->simplifiedPtr, 
+                &ppolyPtr->simplifiedZoom);
+    }
+    return ppolyPtr->atomPtr;
+}
+
+/*----------------------------------------------------------------------*/
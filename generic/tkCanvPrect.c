@@ -14,27 +14,46 @@
 #include "tkCanvPathUtil.h"
 #include "tkPathStyle.h"
 
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 /*
- * The structure below defines the record for each path item.
+ * The structure below holds what is specific to prect items. It is shared
+ * by the regular items and the lean ones that have no style options of
+ * their own. The rectangle itself is kept in the header bbox.
  */
 
-typedef struct PrectItem  {
-    Tk_PathItemEx headerEx; /* Generic stuff that's the same for all
-                             * path types.  MUST BE FIRST IN STRUCTURE. */
+typedef struct PrectShape {
     double rx;		    /* Radius of corners. */
     double ry;
     int maxNumSegments;	    /* Max number of straight segments (for subpath)
                              * needed for Area and Point functions. */
+} PrectShape;
+
+/*
+ * The structures below define the record for each prect and lprect item.
+ */
+
+typedef struct PrectItem  {
+    Tk_PathItemEx headerEx; /* Generic stuff that's the same for all
+                             * path types.  MUST BE FIRST IN STRUCTURE. */
+    PrectShape shape;
 } PrectItem;
 
+typedef struct LeanPrectItem  {
+    Tk_PathItemLean headerLean;
+			    /* Generic stuff that's the same for all
+                             * lean types.  MUST BE FIRST IN STRUCTURE. */
+    PrectShape shape;
+} LeanPrectItem;
+
+#define GetPrectShape(itemPtr)					\
+    (TkPathItemIsLean(itemPtr)					\
+	? &((LeanPrectItem *) (itemPtr))->shape			\
+	: &((PrectItem *) (itemPtr))->shape)
+
 /*
  * Prototypes for procedures defined in this file:
  */
 
-static void	ComputePrectBbox(Tk_PathCanvas canvas, PrectItem *prectPtr);
+static void	ComputePrectBbox(Tk_PathCanvas canvas, Tk_PathItem *itemPtr);
 static int	ConfigurePrect(Tcl_Interp *interp, Tk_PathCanvas canvas, 
                         Tk_PathItem *itemPtr, int objc,
                         Tcl_Obj *CONST objv[], int flags);
@@ -61,7 +80,7 @@ static void	ScalePrect(Tk_PathCanvas canvas,
                         double scaleX, double scaleY);
 static void	TranslatePrect(Tk_PathCanvas canvas,
                         Tk_PathItem *itemPtr, double deltaX, double deltaY);
-static PathAtom * MakePathAtoms(PrectItem *prectPtr);
+static PathAtom * MakePathAtoms(Tk_PathItem *itemPtr);
 
 
 enum {
@@ -77,12 +96,12 @@ PATH_OPTION_STRING_TABLES_STATE
 
 #define PATH_OPTION_SPEC_RX(typeName)		    \
     {TK_OPTION_DOUBLE, "-rx", NULL, NULL,	    \
-        "0.0", -1, Tk_Offset(typeName, rx),	    \
+        "0.0", -1, Tk_Offset(typeName, shape.rx),    \
 	0, 0, PRECT_OPTION_INDEX_RX}
 
 #define PATH_OPTION_SPEC_RY(typeName)		    \
     {TK_OPTION_DOUBLE, "-ry", NULL, NULL,	    \
-        "0.0", -1, Tk_Offset(typeName, ry),	    \
+        "0.0", -1, Tk_Offset(typeName, shape.ry),    \
 	0, 0, PRECT_OPTION_INDEX_RY}
 
 static Tk_OptionSpec optionSpecs[] = {
@@ -96,7 +115,16 @@ static Tk_OptionSpec optionSpecs[] = {
     PATH_OPTION_SPEC_END
 };
 
+static Tk_OptionSpec optionSpecsLean[] = {
+    PATH_OPTION_SPEC_CORE(Tk_PathItemLean),
+    PATH_OPTION_SPEC_PARENT,
+    PATH_OPTION_SPEC_RX(LeanPrectItem),
+    PATH_OPTION_SPEC_RY(LeanPrectItem),
+    PATH_OPTION_SPEC_END
+};
+
 static Tk_OptionTable optionTable = NULL;
+static Tk_OptionTable optionTableLean = NULL;
 
 /*
  * The structures below defines the 'prect' item type by means
@@ -126,14 +154,38 @@ Tk_PathItemType tkPrectType = {
     (Tk_PathItemDCharsProc *) NULL,	/* dTextProc */
     (Tk_PathItemType *) NULL,		/* nextPtr */
 };
+
+Tk_PathItemType tkLeanPrectType = {
+    "lprect",				/* name */
+    sizeof(LeanPrectItem),		/* itemSize */
+    CreatePrect,			/* createProc */
+    optionSpecsLean,			/* optionSpecs */
+    ConfigurePrect,			/* configureProc */
+    PrectCoords,			/* coordProc */
+    DeletePrect,			/* deleteProc */
+    DisplayPrect,			/* displayProc */
+    TK_PATH_ITEMTYPE_LEAN,		/* flags */
+    PrectBbox,				/* bboxProc */
+    PrectToPoint,			/* pointProc */
+    PrectToArea,			/* areaProc */
+    PrectToPostscript,			/* postscriptProc */
+    ScalePrect,				/* scaleProc */
+    TranslatePrect,			/* translateProc */
+    (Tk_PathItemIndexProc *) NULL,	/* indexProc */
+    (Tk_PathItemCursorProc *) NULL,	/* icursorProc */
+    (Tk_PathItemSelectionProc *) NULL,	/* selectionProc */
+    (Tk_PathItemInsertProc *) NULL,	/* insertProc */
+    (Tk_PathItemDCharsProc *) NULL,	/* dTextProc */
+    (Tk_PathItemType *) NULL,		/* nextPtr */
+};
                         
 
 static int		
 CreatePrect(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
         int objc, Tcl_Obj *CONST objv[])
 {
-    PrectItem *prectPtr = (PrectItem *) itemPtr;
-    Tk_PathItemEx *itemExPtr = &prectPtr->headerEx;
+    PrectShape *prectPtr = GetPrectShape(itemPtr);
+    Tk_PathItemEx *itemExPtr = (Tk_PathItemEx *) itemPtr;
     int	i;
 
     if (objc == 0) {
@@ -143,9 +195,11 @@ CreatePrect(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
     /*
      * Carry out initialization that is needed to set defaults and to
      * allow proper cleanup after errors during the the remainder of
-     * this procedure.
+     * this procedure. Lean items have no style record.
      */
-    TkPathInitStyle(&itemExPtr->style);
+    if (!TkPathItemIsLean(itemPtr)) {
+	TkPathInitStyle(&itemExPtr->style);
+    }
     itemExPtr->canvas = canvas;
     itemExPtr->styleObj = NULL;
     itemExPtr->styleInst = NULL;
@@ -153,11 +207,18 @@ CreatePrect(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
     itemPtr->totalBbox = NewEmptyPathRect();
     prectPtr->maxNumSegments = 100;		/* Crude overestimate. */
     
-    if (optionTable == NULL) {
-	optionTable = Tk_CreateOptionTable(interp, optionSpecs);
-    } 
-    itemPtr->optionTable = optionTable;
-    if (Tk_InitOptions(interp, (char *) prectPtr, optionTable, 
+    if (TkPathItemIsLean(itemPtr)) {
+	if (optionTableLean == NULL) {
+	    optionTableLean = Tk_CreateOptionTable(interp, optionSpecsLean);
+	}
+	itemPtr->optionTable = optionTableLean;
+    } else {
+	if (optionTable == NULL) {
+	    optionTable = Tk_CreateOptionTable(interp, optionSpecs);
+	} 
+	itemPtr->optionTable = optionTable;
+    }
+    if (Tk_InitOptions(interp, (char *) itemPtr, itemPtr->optionTable, 
 	    Tk_PathCanvasTkwin(canvas)) != TCL_OK) {
         goto error;
     }
@@ -189,35 +250,35 @@ static int
 PrectCoords(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr, 
         int objc, Tcl_Obj *CONST objv[])
 {
-    PrectItem *prectPtr = (PrectItem *) itemPtr;
     int result;
 
     result = CoordsForRectangularItems(interp, canvas, &itemPtr->bbox, objc, objv);
     if ((result == TCL_OK) && ((objc == 1) || (objc == 4))) {
-	ComputePrectBbox(canvas, prectPtr);
+	ComputePrectBbox(canvas, itemPtr);
     }
     return result;
 }
 
 void
-ComputePrectBbox(Tk_PathCanvas canvas, PrectItem *prectPtr)
+ComputePrectBbox(Tk_PathCanvas canvas, Tk_PathItem *itemPtr)
 {
-    Tk_PathItemEx *itemExPtr = &prectPtr->headerEx;
-    Tk_PathItem *itemPtr = &itemExPtr->header;
     Tk_PathStyle style;
-    Tk_PathState state = itemExPtr->header.state;
+    Tk_PathState state = itemPtr->state;
 
+    if (TkPathCanvasDeferItemBbox(canvas, itemPtr)) {
+	return;
+    }
     if(state == TK_PATHSTATE_NULL) {
 	state = TkPathCanvasState(canvas);
     }
     if (state == TK_PATHSTATE_HIDDEN) {
-        itemExPtr->header.x1 = itemExPtr->header.x2 =
-        itemExPtr->header.y1 = itemExPtr->header.y2 = -1;
+        itemPtr->x1 = itemPtr->x2 =
+        itemPtr->y1 = itemPtr->y2 = -1;
         return;
     }
     style = TkPathCanvasInheritStyle(itemPtr, kPathMergeStyleNotFill);
     itemPtr->totalBbox = GetGenericPathTotalBboxFromBare(NULL, &style, &itemPtr->bbox);
-    SetGenericPathHeaderBbox(&itemExPtr->header, style.matrixPtr, &itemPtr->totalBbox);
+    SetGenericPathHeaderBbox(itemPtr, style.matrixPtr, &itemPtr->totalBbox);
     TkPathCanvasFreeInheritedStyle(&style);
 }
 
@@ -225,8 +286,8 @@ static int
 ConfigurePrect(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr, 
         int objc, Tcl_Obj *CONST objv[], int flags)
 {
-    PrectItem *prectPtr = (PrectItem *) itemPtr;
-    Tk_PathItemEx *itemExPtr = &prectPtr->headerEx;
+    PrectShape *prectPtr = GetPrectShape(itemPtr);
+    Tk_PathItemEx *itemExPtr = (Tk_PathItemEx *) itemPtr;
     Tk_PathStyle *stylePtr = &itemExPtr->style;
     Tk_Window tkwin;
     //Tk_PathState state;
@@ -237,7 +298,7 @@ ConfigurePrect(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
     tkwin = Tk_PathCanvasTkwin(canvas);
     for (error = 0; error <= 1; error++) {
 	if (!error) {
-	    if (Tk_SetOptions(interp, (char *) prectPtr, optionTable, 
+	    if (Tk_SetOptions(interp, (char *) itemPtr, itemPtr->optionTable, 
 		    objc, objv, tkwin, &savedOptions, &mask) != TCL_OK) {
 		continue;
 	    }
@@ -257,10 +318,14 @@ ConfigurePrect(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
     }
     if (!error) {
 	Tk_FreeSavedOptions(&savedOptions);
-	stylePtr->mask |= mask;
     }
-    stylePtr->strokeOpacity = MAX(0.0, MIN(1.0, stylePtr->strokeOpacity));
-    stylePtr->fillOpacity   = MAX(0.0, MIN(1.0, stylePtr->fillOpacity));
+    if (!TkPathItemIsLean(itemPtr)) {
+	if (!error) {
+	    stylePtr->mask |= mask;
+	}
+	stylePtr->strokeOpacity = MAX(0.0, MIN(1.0, stylePtr->strokeOpacity));
+	stylePtr->fillOpacity   = MAX(0.0, MIN(1.0, stylePtr->fillOpacity));
+    }
     prectPtr->rx = MAX(0.0, prectPtr->rx);
     prectPtr->ry = MAX(0.0, prectPtr->ry);
 
@@ -281,15 +346,15 @@ ConfigurePrect(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
 	Tcl_DecrRefCount(errorResult);
 	return TCL_ERROR;
     } else {
-	ComputePrectBbox(canvas, prectPtr);
+	ComputePrectBbox(canvas, itemPtr);
 	return TCL_OK;
     }
 }
 
 static PathAtom *
-MakePathAtoms(PrectItem *prectPtr)
+MakePathAtoms(Tk_PathItem *itemPtr)
 {
-    Tk_PathItem *itemPtr = (Tk_PathItem *) prectPtr;
+    PrectShape *prectPtr = GetPrectShape(itemPtr);
     PathAtom *atomPtr;
     double points[4];
     
@@ -304,24 +369,22 @@ MakePathAtoms(PrectItem *prectPtr)
 static void		
 DeletePrect(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display)
 {
-    PrectItem *prectPtr = (PrectItem *) itemPtr;
-    Tk_PathItemEx *itemExPtr = &prectPtr->headerEx;
+    Tk_PathItemEx *itemExPtr = (Tk_PathItemEx *) itemPtr;
     Tk_PathStyle *stylePtr = &itemExPtr->style;
 
-    if (stylePtr->fill != NULL) {
+    if (!TkPathItemIsLean(itemPtr) && (stylePtr->fill != NULL)) {
 	TkPathFreePathColor(stylePtr->fill);
     }
     if (itemExPtr->styleInst != NULL) {
 	TkPathFreeStyle(itemExPtr->styleInst);
     }
-    Tk_FreeConfigOptions((char *) itemPtr, optionTable, Tk_PathCanvasTkwin(canvas));
+    Tk_FreeConfigOptions((char *) itemPtr, itemPtr->optionTable, Tk_PathCanvasTkwin(canvas));
 }
 
 static void		
 DisplayPrect(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display, Drawable drawable,
         int x, int y, int width, int height)
 {
-    PrectItem *prectPtr = (PrectItem *) itemPtr;
     TMatrix m = GetCanvasTMatrix(canvas);
     PathAtom *atomPtr;            
     Tk_PathStyle style;
@@ -331,7 +394,7 @@ DisplayPrect(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display, Drawa
     /* === */
     
     style = TkPathCanvasInheritStyle(itemPtr, 0);
-    atomPtr = MakePathAtoms(prectPtr);
+    atomPtr = MakePathAtoms(itemPtr);
     TkPathDrawPath(Tk_PathCanvasTkwin(canvas), drawable, atomPtr, 
 	    &style, &m, &itemPtr->bbox);
     TkPathFreeAtoms(atomPtr);
@@ -341,14 +404,13 @@ DisplayPrect(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display, Drawa
 static void	
 PrectBbox(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, int mask)
 {
-    PrectItem *prectPtr = (PrectItem *) itemPtr;
-    ComputePrectBbox(canvas, prectPtr);
+    ComputePrectBbox(canvas, itemPtr);
 }
 
 static double	
 PrectToPoint(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *pointPtr)
 {
-    PrectItem *prectPtr = (PrectItem *) itemPtr;
+    PrectShape *prectPtr = GetPrectShape(itemPtr);
     Tk_PathStyle style;
     TMatrix *mPtr;
     PathRect *rectPtr = &itemPtr->bbox;
@@ -386,7 +448,7 @@ PrectToPoint(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *pointPtr)
     if (rectiLinear) {
         dist = PathRectToPoint(bareRect, width, filled, pointPtr);
     } else {
-	PathAtom *atomPtr = MakePathAtoms(prectPtr);
+	PathAtom *atomPtr = MakePathAtoms(itemPtr);
         dist = GenericPathToPoint(canvas, itemPtr, &style, atomPtr, 
             prectPtr->maxNumSegments, pointPtr);
 	TkPathFreeAtoms(atomPtr);
@@ -398,9 +460,8 @@ PrectToPoint(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *pointPtr)
 static int		
 PrectToArea(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *areaPtr)
 {
-    PrectItem *prectPtr = (PrectItem *) itemPtr;
-    Tk_PathItemEx *itemExPtr = &prectPtr->headerEx;
-    Tk_PathStyle style = itemExPtr->style;  /* NB: We *copy* the style for temp usage. */
+    PrectShape *prectPtr = GetPrectShape(itemPtr);
+    Tk_PathStyle style;
     TMatrix *mPtr;
     PathRect *rectPtr = &(itemPtr->bbox);
     double bareRect[4];
@@ -437,7 +498,7 @@ PrectToArea(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *areaPtr)
     if (rectiLinear) {
         area = PathRectToArea(bareRect, width, filled, areaPtr);
     } else {
-	PathAtom *atomPtr = MakePathAtoms(prectPtr);
+	PathAtom *atomPtr = MakePathAtoms(itemPtr);
         area = GenericPathToArea(canvas, itemPtr, &style, 
                 atomPtr, prectPtr->maxNumSegments, areaPtr);
 	TkPathFreeAtoms(atomPtr);
@@ -14,9 +14,6 @@
 #include "tkCanvPathUtil.h"
 #include "tkPathStyle.h"
 
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 /*
  * The structure below defines the record for each path item.
  */
@@ -338,6 +335,9 @@ ComputePtextBbox(Tk_PathCanvas canvas, PtextItem *ptextPtr)
     double bheight;
     PathRect bbox, r;
 
+    if (TkPathCanvasDeferItemBbox(canvas, itemPtr)) {
+	return;
+    }
     if(state == TK_PATHSTATE_NULL) {
 	state = TkPathCanvasState(canvas);
     }
@@ -0,0 +1,499 @@
+/*
+ * tkCanvUse.c --
+ *
+ *	This file implements the use canvas item modelled after its
+ *	SVG counterpart. See http://www.w3.org/TR/SVG11/.
+ *	A use item draws the geometry of a path item without having a
+ *	copy of its own. It only stores its position, a transform and
+ *	its style, which makes it cheap to have many instances of the
+ *	same symbol.
+ *
+ * $Id$
+ */
+
+#include "tkIntPath.h"
+#include "tkpCanvas.h"
+#include "tkCanvPathUtil.h"
+#include "tkPathStyle.h"
+
+/*
+ * The structure below defines the record for each use item.
+ */
+
+typedef struct UseItem  {
+    Tk_PathItemEx headerEx; /* Generic stuff that's the same for all
+                             * path types.  MUST BE FIRST IN STRUCTURE. */
+    TMatrix instance;	    /* Places the referenced geometry. The tx and
+			     * ty members are the item coords. */
+    Tcl_Obj *hrefObj;	    /* The tagOrId of the referenced item. */
+    int refId;		    /* Id of the referenced item, or -1. */
+} UseItem;
+
+enum {
+    USE_OPTION_INDEX_HREF = (1L << (PATH_STYLE_OPTION_INDEX_END + 1))
+};
+
+/*
+ * Prototypes for procedures defined in this file:
+ */
+
+static void	ComputeUseBbox(Tk_PathCanvas canvas, UseItem *usePtr);
+static int	ConfigureUse(Tcl_Interp *interp, Tk_PathCanvas canvas,
+                        Tk_PathItem *itemPtr, int objc,
+                        Tcl_Obj *CONST objv[], int flags);
+static int	CreateUse(Tcl_Interp *interp,
+                        Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
+                        int objc, Tcl_Obj *CONST objv[]);
+static void	DeleteUse(Tk_PathCanvas canvas,
+                        Tk_PathItem *itemPtr, Display *display);
+static void	DisplayUse(Tk_PathCanvas canvas,
+                        Tk_PathItem *itemPtr, Display *display, Drawable drawable,
+                        int x, int y, int width, int height);
+static void	UseBbox(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, int mask);
+static int	UseCoords(Tcl_Interp *interp,
+                        Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
+                        int objc, Tcl_Obj *CONST objv[]);
+static int	UseToArea(Tk_PathCanvas canvas,
+                        Tk_PathItem *itemPtr, double *rectPtr);
+static double	UseToPoint(Tk_PathCanvas canvas,
+                        Tk_PathItem *itemPtr, double *coordPtr);
+static int	UseToPostscript(Tcl_Interp *interp,
+                        Tk_PathCanvas canvas, Tk_PathItem *itemPtr, int prepass);
+static void	ScaleUse(Tk_PathCanvas canvas,
+                        Tk_PathItem *itemPtr, double originX, double originY,
+                        double scaleX, double scaleY);
+static void	TranslateUse(Tk_PathCanvas canvas,
+                        Tk_PathItem *itemPtr, double deltaX, double deltaY);
+static PathAtom * GetUseGeometry(Tk_PathCanvas canvas, UseItem *usePtr,
+			int *maxNumSegmentsPtr, PathRect *bboxPtr);
+static Tk_PathStyle UseInheritStyle(UseItem *usePtr, long flags);
+
+
+PATH_STYLE_CUSTOM_OPTION_RECORDS
+PATH_CUSTOM_OPTION_TAGS
+PATH_OPTION_STRING_TABLES_FILL
+PATH_OPTION_STRING_TABLES_STROKE
+PATH_OPTION_STRING_TABLES_STATE
+
+#define PATH_OPTION_SPEC_HREF					\
+    {TK_OPTION_STRING, "-href", NULL, NULL,			\
+        NULL, Tk_Offset(UseItem, hrefObj), -1,			\
+	TK_OPTION_NULL_OK, 0, USE_OPTION_INDEX_HREF}
+
+static Tk_OptionSpec optionSpecs[] = {
+    PATH_OPTION_SPEC_CORE(Tk_PathItemEx),
+    PATH_OPTION_SPEC_PARENT,
+    PATH_OPTION_SPEC_STYLE_FILL(Tk_PathItemEx, ""),
+    PATH_OPTION_SPEC_STYLE_MATRIX(Tk_PathItemEx),
+    PATH_OPTION_SPEC_STYLE_STROKE(Tk_PathItemEx, "black"),
+    PATH_OPTION_SPEC_HREF,
+    PATH_OPTION_SPEC_END
+};
+
+static Tk_OptionTable optionTable = NULL;
+
+/*
+ * The structures below defines the 'use' item type by means
+ * of procedures that can be invoked by generic item code.
+ */
+
+Tk_PathItemType tkUseType = {
+    "use",				/* name */
+    sizeof(UseItem),			/* itemSize */
+    CreateUse,				/* createProc */
+    optionSpecs,			/* optionSpecs */
+    ConfigureUse,			/* configureProc */
+    UseCoords,				/* coordProc */
+    DeleteUse,				/* deleteProc */
+    DisplayUse,				/* displayProc */
+    0,					/* flags */
+    UseBbox,				/* bboxProc */
+    UseToPoint,				/* pointProc */
+    UseToArea,				/* areaProc */
+    UseToPostscript,			/* postscriptProc */
+    ScaleUse,				/* scaleProc */
+    TranslateUse,			/* translateProc */
+    (Tk_PathItemIndexProc *) NULL,	/* indexProc */
+    (Tk_PathItemCursorProc *) NULL,	/* icursorProc */
+    (Tk_PathItemSelectionProc *) NULL,	/* selectionProc */
+    (Tk_PathItemInsertProc *) NULL,	/* insertProc */
+    (Tk_PathItemDCharsProc *) NULL,	/* dTextProc */
+    (Tk_PathItemType *) NULL,		/* nextPtr */
+};
+
+static int
+CreateUse(Tcl_Interp *interp, Tk_PathCanvas canvas, struct Tk_PathItem *itemPtr,
+        int objc, Tcl_Obj *CONST objv[])
+{
+    UseItem *usePtr = (UseItem *) itemPtr;
+    Tk_PathItemEx *itemExPtr = &usePtr->headerEx;
+    TMatrix unitMatrix = kPathUnitTMatrix;
+    int	i;
+
+    if (objc == 0) {
+        Tcl_Panic("canvas did not pass any coords\n");
+    }
+
+    /*
+     * Carry out initialization that is needed to set defaults and to
+     * allow proper cleanup after errors during the the remainder of
+     * this procedure.
+     */
+    TkPathInitStyle(&itemExPtr->style);
+    itemExPtr->canvas = canvas;
+    itemExPtr->styleObj = NULL;
+    itemExPtr->styleInst = NULL;
+    usePtr->instance = unitMatrix;
+    usePtr->hrefObj = NULL;
+    usePtr->refId = -1;
+    itemPtr->bbox = NewEmptyPathRect();
+    itemPtr->totalBbox = NewEmptyPathRect();
+
+    if (optionTable == NULL) {
+	optionTable = Tk_CreateOptionTable(interp, optionSpecs);
+    }
+    itemPtr->optionTable = optionTable;
+    if (Tk_InitOptions(interp, (char *) usePtr, optionTable,
+	    Tk_PathCanvasTkwin(canvas)) != TCL_OK) {
+        goto error;
+    }
+
+    for (i = 1; i < objc; i++) {
+        char *arg = Tcl_GetString(objv[i]);
+        if ((arg[0] == '-') && (arg[1] >= 'a') && (arg[1] <= 'z')) {
+            break;
+        }
+    }
+    if (CoordsForPointItems(interp, canvas, &usePtr->instance.tx, i, objv) != TCL_OK) {
+        goto error;
+    }
+    if (ConfigureUse(interp, canvas, itemPtr, objc-i, objv+i, 0) == TCL_OK) {
+        return TCL_OK;
+    }
+
+    error:
+    /*
+     * NB: We must unlink the item here since the TkPathCanvasItemExConfigure()
+     *     link it to the root by default.
+     */
+    TkPathCanvasItemDetach(itemPtr);
+    DeleteUse(canvas, itemPtr, Tk_Display(Tk_PathCanvasTkwin(canvas)));
+    return TCL_ERROR;
+}
+
+static int
+UseCoords(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
+        int objc, Tcl_Obj *CONST objv[])
+{
+    UseItem *usePtr = (UseItem *) itemPtr;
+    int result;
+
+    /* NB: tx and ty follow each other in the TMatrix record. */
+    result = CoordsForPointItems(interp, canvas, &usePtr->instance.tx, objc, objv);
+    if ((result == TCL_OK) && ((objc == 1) || (objc == 2))) {
+        ComputeUseBbox(canvas, usePtr);
+    }
+    return result;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetUseGeometry --
+ *
+ *	Looks up the geometry of the item that a use item refers to.
+ *	This is done each time since the referenced item may have been
+ *	changed or deleted.
+ *
+ * Results:
+ *	The path atoms or NULL if nothing to draw.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static PathAtom *
+GetUseGeometry(Tk_PathCanvas canvas, UseItem *usePtr,
+        int *maxNumSegmentsPtr, PathRect *bboxPtr)
+{
+    Tk_PathItem *refPtr;
+
+    if (usePtr->refId < 0) {
+        return NULL;
+    }
+    refPtr = TkPathCanvasItemFromId(canvas, usePtr->refId);
+    if (refPtr == NULL) {
+        return NULL;
+    }
+    return TkPathCanvasPathGeometry(refPtr, maxNumSegmentsPtr, bboxPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * UseInheritStyle --
+ *
+ *	Same as TkPathCanvasInheritStyle but with the items instance
+ *	transform put in front of the matrix.
+ *
+ * Results:
+ *	The style which must be freed with TkPathCanvasFreeInheritedStyle.
+ *
+ * Side effects:
+ *	Memory allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static Tk_PathStyle
+UseInheritStyle(UseItem *usePtr, long flags)
+{
+    Tk_PathStyle style;
+    TMatrix matrix = kPathUnitTMatrix;
+
+    style = TkPathCanvasInheritStyle((Tk_PathItem *) usePtr, flags);
+    if (style.matrixPtr != NULL) {
+        matrix = *style.matrixPtr;
+    } else {
+        style.matrixPtr = (TMatrix *) ckalloc(sizeof(TMatrix));
+    }
+    MMulTMatrix(&usePtr->instance, &matrix);
+    *style.matrixPtr = matrix;
+    return style;
+}
+
+static void
+ComputeUseBbox(Tk_PathCanvas canvas, UseItem *usePtr)
+{
+    Tk_PathItem *itemPtr = (Tk_PathItem *) usePtr;
+    Tk_PathStyle style;
+    Tk_PathState state = itemPtr->state;
+    PathAtom *atomPtr;
+    int maxNumSegments;
+
+    if (TkPathCanvasDeferItemBbox(canvas, itemPtr)) {
+	return;
+    }
+    if (state == TK_PATHSTATE_NULL) {
+	state = TkPathCanvasState(canvas);
+    }
+    atomPtr = GetUseGeometry(canvas, usePtr, &maxNumSegments, &itemPtr->bbox);
+    if ((atomPtr == NULL) || (state == TK_PATHSTATE_HIDDEN)) {
+        itemPtr->x1 = itemPtr->x2 =
+        itemPtr->y1 = itemPtr->y2 = -1;
+        return;
+    }
+    style = UseInheritStyle(usePtr, kPathMergeStyleNotFill);
+    itemPtr->totalBbox = GetGenericPathTotalBboxFromBare(atomPtr,
+            &style, &itemPtr->bbox);
+    SetGenericPathHeaderBbox(itemPtr, style.matrixPtr, &itemPtr->totalBbox);
+    TkPathCanvasFreeInheritedStyle(&style);
+}
+
+static int
+ConfigureUse(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr,
+        int objc, Tcl_Obj *CONST objv[], int flags)
+{
+    UseItem *usePtr = (UseItem *) itemPtr;
+    Tk_PathItemEx *itemExPtr = &usePtr->headerEx;
+    Tk_PathStyle *stylePtr = &itemExPtr->style;
+    Tk_Window tkwin;
+    Tk_SavedOptions savedOptions;
+    Tcl_Obj *errorResult = NULL;
+    int mask, error;
+
+    tkwin = Tk_PathCanvasTkwin(canvas);
+    for (error = 0; error <= 1; error++) {
+	if (!error) {
+	    if (Tk_SetOptions(interp, (char *) usePtr, optionTable,
+		    objc, objv, tkwin, &savedOptions, &mask) != TCL_OK) {
+		continue;
+	    }
+	} else {
+	    errorResult = Tcl_GetObjResult(interp);
+	    Tcl_IncrRefCount(errorResult);
+	    Tk_RestoreSavedOptions(&savedOptions);
+	}
+	if (TkPathCanvasItemExConfigure(interp, canvas, itemExPtr, mask) != TCL_OK) {
+	    continue;
+	}
+	if (mask & USE_OPTION_INDEX_HREF) {
+	    Tk_PathItem *refPtr = NULL;
+	    int refId;
+
+	    if (usePtr->hrefObj != NULL) {
+		if (TkPathCanvasFindItem(interp, canvas, usePtr->hrefObj,
+			&refPtr) != TCL_OK) {
+		    continue;
+		}
+		if (refPtr->typePtr != &tkPathType) {
+		    Tcl_AppendStringsToObj(Tcl_GetObjResult(interp),
+			    "tag \"", Tcl_GetString(usePtr->hrefObj),
+			    "\" is not a path item", NULL);
+		    continue;
+		}
+	    }
+	    refId = (refPtr != NULL) ? refPtr->id : -1;
+	    if (refId != usePtr->refId) {
+		if (usePtr->refId >= 0) {
+		    TkPathCanvasRemoveUseRef(canvas, usePtr->refId, itemPtr);
+		}
+		if (refId >= 0) {
+		    TkPathCanvasAddUseRef(canvas, refId, itemPtr);
+		}
+		usePtr->refId = refId;
+	    }
+	}
+
+	/*
+	 * If we reach this on the first pass we are OK and continue below.
+	 */
+	break;
+    }
+    if (!error) {
+	Tk_FreeSavedOptions(&savedOptions);
+	stylePtr->mask |= mask;
+    }
+    stylePtr->strokeOpacity = MAX(0.0, MIN(1.0, stylePtr->strokeOpacity));
+    stylePtr->fillOpacity   = MAX(0.0, MIN(1.0, stylePtr->fillOpacity));
+
+    if (error) {
+	Tcl_SetObjResult(interp, errorResult);
+	Tcl_DecrRefCount(errorResult);
+	return TCL_ERROR;
+    } else {
+	ComputeUseBbox(canvas, usePtr);
+	return TCL_OK;
+    }
+}
+
+static void
+DeleteUse(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display)
+{
+    UseItem *usePtr = (UseItem *) itemPtr;
+    Tk_PathItemEx *itemExPtr = &usePtr->headerEx;
+    Tk_PathStyle *stylePtr = &itemExPtr->style;
+
+    if (usePtr->refId >= 0) {
+	TkPathCanvasRemoveUseRef(canvas, usePtr->refId, itemPtr);
+    }
+    if (stylePtr->fill != NULL) {
+	TkPathFreePathColor(stylePtr->fill);
+    }
+    if (itemExPtr->styleInst != NULL) {
+	TkPathFreeStyle(itemExPtr->styleInst);
+    }
+    Tk_FreeConfigOptions((char *) itemPtr, optionTable, Tk_PathCanvasTkwin(canvas));
+}
+
+static void
+DisplayUse(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, Display *display, Drawable drawable,
+        int x, int y, int width, int height)
+{
+    UseItem *usePtr = (UseItem *) itemPtr;
+    TMatrix m = GetCanvasTMatrix(canvas);
+    Tk_PathStyle style;
+    PathAtom *atomPtr;
+    PathRect bbox;
+    int maxNumSegments;
+
+    /* === EB - 23-apr-2010: register coordinate offsets */
+    TkPathSetCoordOffsets(m.tx, m.ty);
+    /* === */
+
+    atomPtr = GetUseGeometry(canvas, usePtr, &maxNumSegments, &bbox);
+    if (atomPtr == NULL) {
+        return;
+    }
+    style = UseInheritStyle(usePtr, 0);
+    TkPathDrawPath(Tk_PathCanvasTkwin(canvas), drawable, atomPtr, &style,
+            &m, &bbox);
+    TkPathCanvasFreeInheritedStyle(&style);
+}
+
+static void
+UseBbox(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, int mask)
+{
+    UseItem *usePtr = (UseItem *) itemPtr;
+    ComputeUseBbox(canvas, usePtr);
+}
+
+static double
+UseToPoint(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *pointPtr)
+{
+    UseItem *usePtr = (UseItem *) itemPtr;
+    Tk_PathStyle style;
+    PathAtom *atomPtr;
+    PathRect bbox;
+    int maxNumSegments;
+    double dist;
+
+    atomPtr = GetUseGeometry(canvas, usePtr, &maxNumSegments, &bbox);
+    if (atomPtr == NULL) {
+        return 1.0e36;
+    }
+    style = UseInheritStyle(usePtr, 0);
+    dist = GenericPathToPoint(canvas, itemPtr, &style, atomPtr,
+            maxNumSegments, pointPtr);
+    TkPathCanvasFreeInheritedStyle(&style);
+    return dist;
+}
+
+static int
+UseToArea(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double *areaPtr)
+{
+    UseItem *usePtr = (UseItem *) itemPtr;
+    Tk_PathStyle style;
+    PathAtom *atomPtr;
+    PathRect bbox;
+    int maxNumSegments;
+    int area;
+
+    atomPtr = GetUseGeometry(canvas, usePtr, &maxNumSegments, &bbox);
+    if (atomPtr == NULL) {
+        return -1;
+    }
+    style = UseInheritStyle(usePtr, 0);
+    area = GenericPathToArea(canvas, itemPtr, &style,
+            atomPtr, maxNumSegments, areaPtr);
+    TkPathCanvasFreeInheritedStyle(&style);
+    return area;
+}
+
+static int
+UseToPostscript(Tcl_Interp *interp, Tk_PathCanvas canvas, Tk_PathItem *itemPtr, int prepass)
+{
+    return TCL_ERROR;
+}
+
+static void
+ScaleUse(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double originX, double originY,
+        double scaleX, double scaleY)
+{
+    UseItem *usePtr = (UseItem *) itemPtr;
+    TMatrix *mPtr = &usePtr->instance;
+
+    /* The shared geometry is left alone; we scale the instance instead. */
+    mPtr->a *= scaleX;
+    mPtr->c *= scaleX;
+    mPtr->b *= scaleY;
+    mPtr->d *= scaleY;
+    mPtr->tx = originX + scaleX*(mPtr->tx - originX);
+    mPtr->ty = originY + scaleY*(mPtr->ty - originY);
+    ComputeUseBbox(canvas, usePtr);
+}
+
+static void
+TranslateUse(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, double deltaX, double deltaY)
+{
+    UseItem *usePtr = (UseItem *) itemPtr;
+
+    usePtr->instance.tx += deltaX;
+    usePtr->instance.ty += deltaY;
+    ComputeUseBbox(canvas, usePtr);
+}
+
+/*----------------------------------------------------------------------*/
+
@@ -115,7 +115,23 @@ enum {
     PATH_STYLE_FLAG_DELETE
 };
 
-extern int gAntiAlias;
+/*
+ * Settings linked to the ::tkp::antialias, ::tkp::premultiplyalpha,
+ * ::tkp::depixelize and ::tkp::simd variables. There is one set for
+ * each thread; interpreters of the same thread share it.
+ */
+
+typedef struct TkPathSettings {
+    int antiAlias;
+    int surfaceCopyPremultiplyAlpha;
+    int depixelize;
+    int simd;
+} TkPathSettings;
+
+#define gAntiAlias			(TkPathGetSettings()->antiAlias)
+#define gSurfaceCopyPremultiplyAlpha	(TkPathGetSettings()->surfaceCopyPremultiplyAlpha)
+#define gDepixelize			(TkPathGetSettings()->depixelize)
+#define gSimd				(TkPathGetSettings()->simd)
 
 enum {
     kPathTextAnchorStart		= 0L,
@@ -268,6 +284,21 @@ typedef struct RectAtom {
     double height;
 } RectAtom;
 
+/*
+ * A FloatLineAtom is equivalent to numPoints LineToAtoms in a row. To save
+ * memory the points are stored as floats relative to the origin x0, y0,
+ * which keeps the precision high also far away from the canvas origin.
+ */
+
+typedef struct FloatLineAtom {
+    PathAtom pathAtom;
+    double x0;
+    double y0;
+    int numPoints;
+    float points[2];		/* x and y of each point. Actually
+				 * 2*numPoints long. */
+} FloatLineAtom;
+
 /*
  * Flags for 'TkPathStyleMergeStyles'.
  */
@@ -305,13 +336,17 @@ void		TkPathClosePath(TkPathContext ctx);
 void		TkPathImage(TkPathContext ctx, Tk_Image image, Tk_PhotoHandle photo, 
                     double x, double y, double width, double height, double fillOpacity,
                     XColor *tintColor, double tintAmount, int interpolation, PathRect *srcRegion);
+void		TkPathImageChanged(Tk_PhotoHandle photo);
 int			TkPathTextConfig(Tcl_Interp *interp, Tk_PathTextStyle *textStylePtr, char *utf8, void **customPtr);
 void		TkPathTextDraw(TkPathContext ctx, Tk_PathStyle *style, 
                     Tk_PathTextStyle *textStylePtr, double x, double y, int fillOverStroke, char *utf8, void *custom);
 void		TkPathTextFree(Tk_PathTextStyle *textStylePtr, void *custom);
 PathRect	TkPathTextMeasureBbox(Tk_PathTextStyle *textStylePtr, char *utf8, void *custom);
 void    	TkPathSurfaceErase(TkPathContext ctx, double x, double y, double width, double height);
-void		TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo);
+void		TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo,
+			    int x, int y, int width, int height);
+int		TkPathSurfaceToPng(Tcl_Interp *interp, TkPathContext ctx, Tcl_Channel chan,
+			    int x, int y, int width, int height);
 
 /*
  * General path drawing using linked list of path atoms.
@@ -360,16 +395,14 @@ void 		PathApplyTMatrix(TMatrix *m, double *x, double *y);
 void 		PathApplyTMatrixToPoint(TMatrix *m, double in[2], double out[2]);
 void		PathInverseTMatrix(TMatrix *m, TMatrix *mi);
 void		MMulTMatrix(TMatrix *m1, TMatrix *m2);
-void		PathCopyBitsARGB(unsigned char *from, unsigned char *to, 
-                    int width, int height, int bytesPerRow);
-void		PathCopyBitsBGRA(unsigned char *from, unsigned char *to, 
-                    int width, int height, int bytesPerRow);
 void		PathCopyBitsPremultipliedAlphaRGBA(unsigned char *from, unsigned char *to, 
                     int width, int height, int bytesPerRow);
 void		PathCopyBitsPremultipliedAlphaARGB(unsigned char *from, unsigned char *to, 
                     int width, int height, int bytesPerRow);
 void		PathCopyBitsPremultipliedAlphaBGRA(unsigned char *from, unsigned char *to, 
                     int width, int height, int bytesPerRow);
+void		PathCopyPhotoBitsPremultipliedBGRA(Tk_PhotoImageBlock *blockPtr,
+                    unsigned char *to);
 
 int		ObjectIsEmpty(Tcl_Obj *objPtr);
 int		PathGetTMatrix(Tcl_Interp* interp, CONST char *list, TMatrix *matrixPtr);
@@ -400,6 +433,8 @@ MODULE_SCOPE int    TkPathGenericCmdDispatcher(
 			void (*freeProc)(Tcl_Interp *interp, char *recordPtr));
 void		    PathStyleInit(Tcl_Interp* interp);
 void		    PathGradientInit(Tcl_Interp* interp);
+MODULE_SCOPE Tcl_HashTable * TkPathGradientTable(void);
+MODULE_SCOPE TkPathSettings * TkPathGetSettings(void);
 MODULE_SCOPE void   TkPathStyleMergeStyles(Tk_PathStyle *srcStyle, Tk_PathStyle *dstStyle, 
 			long flags);
 MODULE_SCOPE int    TkPathStyleMergeStyleStatic(Tcl_Interp* interp, Tcl_Obj *styleObj, 
@@ -12,11 +12,13 @@
 
 #include "tkIntPath.h"
 
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 static const char kPathSyntaxError[] = "syntax error in path definition";
 
+static void	FreePackedBlocks(PathAtom *atomPtr);
+static int	ParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, 
+		    PathAtom *lastAtomPtr, double lastStartX, double lastStartY,
+		    PathAtom **atomPtrPtr, int *lenPtr);
+
 
 int 	
 PixelAlignObjCmd(ClientData clientData, Tcl_Interp* interp,
@@ -26,56 +28,206 @@ PixelAlignObjCmd(ClientData clientData, Tcl_Interp* interp,
     return TCL_OK;
 }
 
+/*
+ * Paths are first split into a flat array of tokens, each being either
+ * an instruction or a number, which are then parsed into path atoms.
+ * Raw SVG path data, "M10,10L20,20", is scanned directly from the string
+ * which avoids creating a Tcl_Obj for each token.
+ */
+
+typedef struct PathToken {
+    char instr;			/* The instruction, or '\0' for a number. */
+    double value;		/* The number if not an instruction. */
+} PathToken;
+
+typedef struct PathTokenBuffer {
+    PathToken *tokens;
+    int used;
+    int size;
+} PathTokenBuffer;
+
+static PathToken *
+PathTokenBufferAlloc(PathTokenBuffer *bufPtr)
+{
+    if (bufPtr->used == bufPtr->size) {
+        bufPtr->size = (bufPtr->size == 0) ? 64 : 2*bufPtr->size;
+        bufPtr->tokens = (PathToken *) ckrealloc((char *) bufPtr->tokens,
+                (unsigned) (bufPtr->size * sizeof(PathToken)));
+    }
+    return bufPtr->tokens + bufPtr->used++;
+}
+
+static int
+IsPathInstruction(int c)
+{
+    switch (c) {
+        case 'M': case 'm': case 'L': case 'l':
+        case 'H': case 'h': case 'V': case 'v':
+        case 'A': case 'a': case 'Q': case 'q':
+        case 'T': case 't': case 'C': case 'c':
+        case 'S': case 's': case 'Z': case 'z':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 /*
  *--------------------------------------------------------------
  *
- * GetPathInstruction --
+ * ScanPathString --
  *
- *		Gets the path instruction at position index of objv.
- *		If unrecognized instruction returns PATH_NEXT_ERROR.
+ *		Splits SVG path data into tokens. Numbers may be separated
+ *		by white space, commas, or nothing at all when unambiguous,
+ *		as in "M10-5.5.5" or in the arc flags "a1 1 0 0110 10".
  *
  * Results:
- *		A PATH_NEXT_* result.
+ *		1 if the complete string was scanned, else 0 and the caller
+ *		should try to treat it as a Tcl list instead.
  *
  * Side effects:
- *		None.
+ *		Tokens added to bufPtr.
  *
  *--------------------------------------------------------------
  */
 
 static int
-GetPathInstruction(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int index, char *c) 
+ScanPathString(CONST char *str, PathTokenBuffer *bufPtr)
 {
-    int len;
-    int result;
-    char *str;
-    
-    *c = '\0';
-    str = Tcl_GetStringFromObj(objv[index], &len);
-    if (isalpha(str[0])) {
-        if (len != 1) {
-            Tcl_SetObjResult(interp, Tcl_NewStringObj(kPathSyntaxError, -1));
-            result = PATH_NEXT_ERROR;
+    CONST char *p = str;
+    CONST char *q;
+    char *end;
+    char instr = '\0';
+    int argIndex = 0;
+    PathToken *tokenPtr;
+
+    while (1) {
+        while (isspace(UCHAR(*p)) || (*p == ',')) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (isalpha(UCHAR(*p))) {
+            if (!IsPathInstruction(*p)) {
+                return 0;
+            }
+            tokenPtr = PathTokenBufferAlloc(bufPtr);
+            tokenPtr->instr = instr = *p++;
+            argIndex = 0;
+            continue;
+        }
+        tokenPtr = PathTokenBufferAlloc(bufPtr);
+        tokenPtr->instr = '\0';
+        if (((instr == 'A') || (instr == 'a'))
+                && ((argIndex % 7 == 3) || (argIndex % 7 == 4))
+                && ((*p == '0') || (*p == '1'))) {
+            /* Arc flags are single digits that need no separator. */
+            tokenPtr->value = (*p++ == '1');
         } else {
-            switch (str[0]) {
-                case 'M': case 'm': case 'L': case 'l':
-                case 'H': case 'h': case 'V': case 'v':
-                case 'A': case 'a': case 'Q': case 'q':
-                case 'T': case 't': case 'C': case 'c':
-                case 'S': case 's': case 'Z': case 'z':
-                    result = PATH_NEXT_INSTRUCTION;
-                    *c = str[0];
-                    break;
-                default:
-                    Tcl_SetObjResult(interp, Tcl_NewStringObj(kPathSyntaxError, -1));
-                    result = PATH_NEXT_ERROR;
-                    break;
+            if (!isdigit(UCHAR(*p)) && (*p != '.') && (*p != '-') && (*p != '+')) {
+                return 0;
+            }
+            tokenPtr->value = strtod(p, &end);
+            if (end == p) {
+                return 0;
+            }
+            /* Reject hex and such that strtod accepts but SVG does not. */
+            for (q = p; q < end; q++) {
+                if (!isdigit(UCHAR(*q)) && (strchr(".eE+-", *q) == NULL)) {
+                    return 0;
+                }
             }
+            p = end;
         }
-    } else {
-        result = PATH_NEXT_OTHER;
+        argIndex++;
     }
-    return result;
+    return 1;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TokenizePathList --
+ *
+ *		Splits a Tcl list into tokens. This is used for pure lists
+ *		and for anything ScanPathString does not understand.
+ *
+ * Results:
+ *		A standard Tcl result.
+ *
+ * Side effects:
+ *		Tokens added to bufPtr.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+TokenizePathList(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathTokenBuffer *bufPtr)
+{
+    Tcl_Obj **objv;
+    PathToken *tokenPtr;
+    char *str;
+    char instr = '\0';
+    int i, len, objc, boolean;
+    int argIndex = 0;
+
+    if (Tcl_ListObjGetElements(interp, listObjPtr, &objc, &objv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (objc < 3) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(
+                "path specification too short", -1));
+        return TCL_ERROR;
+    }
+    for (i = 0; i < objc; i++) {
+        tokenPtr = PathTokenBufferAlloc(bufPtr);
+        str = Tcl_GetStringFromObj(objv[i], &len);
+        if (isalpha(UCHAR(str[0]))) {
+            if ((len != 1) || !IsPathInstruction(str[0])) {
+                Tcl_SetObjResult(interp, Tcl_NewStringObj(kPathSyntaxError, -1));
+                return TCL_ERROR;
+            }
+            tokenPtr->instr = instr = str[0];
+            argIndex = 0;
+            continue;
+        }
+        tokenPtr->instr = '\0';
+        if (((instr == 'A') || (instr == 'a'))
+                && ((argIndex % 7 == 3) || (argIndex % 7 == 4))) {
+            if (Tcl_GetBooleanFromObj(interp, objv[i], &boolean) != TCL_OK) {
+                return TCL_ERROR;
+            }
+            tokenPtr->value = boolean;
+        } else if (Tcl_GetDoubleFromObj(interp, objv[i], &tokenPtr->value) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        argIndex++;
+    }
+    return TCL_OK;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetPathInstruction --
+ *
+ *		Gets the path instruction at position index of tokens.
+ *
+ * Results:
+ *		A PATH_NEXT_* result.
+ *
+ * Side effects:
+ *		None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+GetPathInstruction(Tcl_Interp *interp, PathToken *tokens, int index, char *c) 
+{
+    *c = tokens[index].instr;
+    return (*c != '\0') ? PATH_NEXT_INSTRUCTION : PATH_NEXT_OTHER;
 }
 
 /*
@@ -84,7 +236,7 @@ GetPathInstruction(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int index, char *c
  * GetPathDouble, GetPathBoolean, GetPathPoint, GetPathTwoPoints,
  * GetPathThreePoints, GetPathArcParameters --
  *
- *		Gets a certain number of numbers from objv.
+ *		Gets a certain number of numbers from tokens.
  *		Increments indexPtr by the number of numbers extracted
  *		if succesful, else it is unchanged.
  *
@@ -98,43 +250,46 @@ GetPathInstruction(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int index, char *c
  */
 
 static int
-GetPathDouble(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *indexPtr, double *zPtr) 
+GetPathNumber(Tcl_Interp *interp, PathToken *tokens, int len, int *indexPtr, 
+        CONST char *what, double *zPtr) 
 {
-    int result;
+    char instr[2];
 
     if (*indexPtr > len - 1) {
         Tcl_SetObjResult(interp, Tcl_NewStringObj(kPathSyntaxError, -1));
-        result = TCL_ERROR;
-    } else {
-        result = Tcl_GetDoubleFromObj(interp, objv[*indexPtr], zPtr);
-        if (result == TCL_OK) {
-            (*indexPtr)++;
-        }
+        return TCL_ERROR;
     }
-    return result;
+    if (tokens[*indexPtr].instr != '\0') {
+        instr[0] = tokens[*indexPtr].instr;
+        instr[1] = '\0';
+        Tcl_ResetResult(interp);
+        Tcl_AppendResult(interp, "expected ", what, " but got \"", instr, "\"", NULL);
+        return TCL_ERROR;
+    }
+    *zPtr = tokens[(*indexPtr)++].value;
+    return TCL_OK;
 }
 
 static int
-GetPathBoolean(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *indexPtr, char *boolPtr) 
+GetPathDouble(Tcl_Interp *interp, PathToken *tokens, int len, int *indexPtr, double *zPtr) 
 {
-    int result;
-    int boolean;
+    return GetPathNumber(interp, tokens, len, indexPtr, "floating-point number", zPtr);
+}
 
-    if (*indexPtr > len - 1) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(kPathSyntaxError, -1));
-        result = TCL_ERROR;
-    } else {
-        result = Tcl_GetBooleanFromObj(interp, objv[*indexPtr], &boolean);
-        if (result == TCL_OK) {
-            (*indexPtr)++;
-            *boolPtr = boolean;
-        }
+static int
+GetPathBoolean(Tcl_Interp *interp, PathToken *tokens, int len, int *indexPtr, char *boolPtr) 
+{
+    double z;
+
+    if (GetPathNumber(interp, tokens, len, indexPtr, "boolean value", &z) != TCL_OK) {
+        return TCL_ERROR;
     }
-    return result;
+    *boolPtr = (z != 0.0);
+    return TCL_OK;
 }
 
 static int
-GetPathPoint(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *indexPtr, 
+GetPathPoint(Tcl_Interp *interp, PathToken *tokens, int len, int *indexPtr, 
         double *xPtr, double *yPtr)
 {
     int result = TCL_OK;
@@ -143,10 +298,10 @@ GetPathPoint(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *indexPtr,
     if (*indexPtr > len - 2) {
         Tcl_SetObjResult(interp, Tcl_NewStringObj(kPathSyntaxError, -1));
         result = TCL_ERROR;
-    } else if (Tcl_GetDoubleFromObj(interp, objv[(*indexPtr)++], xPtr) != TCL_OK) {
+    } else if (GetPathDouble(interp, tokens, len, indexPtr, xPtr) != TCL_OK) {
         *indexPtr = indIn;
         result = TCL_ERROR;
-    } else if (Tcl_GetDoubleFromObj(interp, objv[(*indexPtr)++], yPtr) != TCL_OK) {
+    } else if (GetPathDouble(interp, tokens, len, indexPtr, yPtr) != TCL_OK) {
         *indexPtr = indIn;
         result = TCL_ERROR;
     }
@@ -154,15 +309,15 @@ GetPathPoint(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *indexPtr,
 }
 
 static int
-GetPathTwoPoints(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *indexPtr, 
+GetPathTwoPoints(Tcl_Interp *interp, PathToken *tokens, int len, int *indexPtr, 
         double *x1Ptr, double *y1Ptr, double *x2Ptr, double *y2Ptr)
 {
     int result;
     int indIn = *indexPtr;
 
-    result = GetPathPoint(interp, objv, len, indexPtr, x1Ptr, y1Ptr);
+    result = GetPathPoint(interp, tokens, len, indexPtr, x1Ptr, y1Ptr);
     if (result == TCL_OK) {
-        if (GetPathPoint(interp, objv, len, indexPtr, x2Ptr, y2Ptr) != TCL_OK) {
+        if (GetPathPoint(interp, tokens, len, indexPtr, x2Ptr, y2Ptr) != TCL_OK) {
             *indexPtr = indIn;
             result = TCL_ERROR;
         }
@@ -171,19 +326,19 @@ GetPathTwoPoints(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *indexP
 }
 
 static int
-GetPathThreePoints(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *indexPtr, 
+GetPathThreePoints(Tcl_Interp *interp, PathToken *tokens, int len, int *indexPtr, 
         double *x1Ptr, double *y1Ptr, double *x2Ptr, double *y2Ptr,
         double *x3Ptr, double *y3Ptr)
 {
     int result;
     int indIn = *indexPtr;
 
-    result = GetPathPoint(interp, objv, len, indexPtr, x1Ptr, y1Ptr);
+    result = GetPathPoint(interp, tokens, len, indexPtr, x1Ptr, y1Ptr);
     if (result == TCL_OK) {
-        if (GetPathPoint(interp, objv, len, indexPtr, x2Ptr, y2Ptr) != TCL_OK) {
+        if (GetPathPoint(interp, tokens, len, indexPtr, x2Ptr, y2Ptr) != TCL_OK) {
             *indexPtr = indIn;
             result = TCL_ERROR;
-        } else if (GetPathPoint(interp, objv, len, indexPtr, x3Ptr, y3Ptr) != TCL_OK) {
+        } else if (GetPathPoint(interp, tokens, len, indexPtr, x3Ptr, y3Ptr) != TCL_OK) {
             *indexPtr = indIn;
             result = TCL_ERROR;
         }
@@ -192,7 +347,7 @@ GetPathThreePoints(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *inde
 }
 
 static int
-GetPathArcParameters(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *indexPtr,
+GetPathArcParameters(Tcl_Interp *interp, PathToken *tokens, int len, int *indexPtr,
         double *radXPtr, double *radYPtr, double *anglePtr, 
         char *largeArcFlagPtr, char *sweepFlagPtr, 
         double *xPtr, double *yPtr)
@@ -200,18 +355,18 @@ GetPathArcParameters(Tcl_Interp *interp, Tcl_Obj *CONST objv[], int len, int *in
     int result;
     int indIn = *indexPtr;
 
-    result = GetPathPoint(interp, objv, len, indexPtr, radXPtr, radYPtr);
+    result = GetPathPoint(interp, tokens, len, indexPtr, radXPtr, radYPtr);
     if (result == TCL_OK) {
-        if (GetPathDouble(interp, objv, len, indexPtr, anglePtr) != TCL_OK) {
+        if (GetPathDouble(interp, tokens, len, indexPtr, anglePtr) != TCL_OK) {
             *indexPtr = indIn;
             result = TCL_ERROR;
-        } else if (GetPathBoolean(interp, objv, len, indexPtr, largeArcFlagPtr) != TCL_OK) {
+        } else if (GetPathBoolean(interp, tokens, len, indexPtr, largeArcFlagPtr) != TCL_OK) {
             *indexPtr = indIn;
             result = TCL_ERROR;
-        } else if (GetPathBoolean(interp, objv, len, indexPtr, sweepFlagPtr) != TCL_OK) {
+        } else if (GetPathBoolean(interp, tokens, len, indexPtr, sweepFlagPtr) != TCL_OK) {
             *indexPtr = indIn;
             result = TCL_ERROR;
-        } else if (GetPathPoint(interp, objv, len, indexPtr, xPtr, yPtr) != TCL_OK) {
+        } else if (GetPathPoint(interp, tokens, len, indexPtr, xPtr, yPtr) != TCL_OK) {
             *indexPtr = indIn;
             result = TCL_ERROR;
         } 
@@ -245,6 +400,7 @@ NewMoveToAtom(double x, double y)
 
     moveToAtomPtr = (MoveToAtom *) ckalloc((unsigned) (sizeof(MoveToAtom)));
     atomPtr = (PathAtom *) moveToAtomPtr;
+    atomPtr->flags = 0;
     atomPtr->type = PATH_ATOM_M;
     atomPtr->nextPtr = NULL;
     moveToAtomPtr->x = x;
@@ -260,6 +416,7 @@ NewLineToAtom(double x, double y)
 
     lineToAtomPtr = (LineToAtom *) ckalloc((unsigned) (sizeof(LineToAtom)));
     atomPtr = (PathAtom *) lineToAtomPtr;
+    atomPtr->flags = 0;
     atomPtr->type = PATH_ATOM_L;
     atomPtr->nextPtr = NULL;
     lineToAtomPtr->x = x;
@@ -276,6 +433,7 @@ NewArcAtom(double radX, double radY,
 
     arcAtomPtr = (ArcAtom *) ckalloc((unsigned) (sizeof(ArcAtom)));
     atomPtr = (PathAtom *) arcAtomPtr;
+    atomPtr->flags = 0;
     atomPtr->type = PATH_ATOM_A;
     atomPtr->nextPtr = NULL;    
     arcAtomPtr->radX = radX;
@@ -296,6 +454,7 @@ NewQuadBezierAtom(double ctrlX, double ctrlY, double anchorX, double anchorY)
 
     quadBezierAtomPtr = (QuadBezierAtom *) ckalloc((unsigned) (sizeof(QuadBezierAtom)));
     atomPtr = (PathAtom *) quadBezierAtomPtr;
+    atomPtr->flags = 0;
     atomPtr->type = PATH_ATOM_Q;
     atomPtr->nextPtr = NULL;
     quadBezierAtomPtr->ctrlX = ctrlX;
@@ -314,6 +473,7 @@ NewCurveToAtom(double ctrlX1, double ctrlY1, double ctrlX2, double ctrlY2,
 
     curveToAtomPtr = (CurveToAtom *) ckalloc((unsigned) (sizeof(CurveToAtom)));
     atomPtr = (PathAtom *) curveToAtomPtr;
+    atomPtr->flags = 0;
     atomPtr->type = PATH_ATOM_C;
     atomPtr->nextPtr = NULL;
     curveToAtomPtr->ctrlX1 = ctrlX1;
@@ -333,6 +493,7 @@ NewRectAtom(double pointsPtr[])
 
     rectAtomPtr = (RectAtom *) ckalloc((unsigned) (sizeof(RectAtom)));
     atomPtr = (PathAtom *) rectAtomPtr;    
+    atomPtr->flags = 0;
     atomPtr->nextPtr = NULL;
     atomPtr->type = PATH_ATOM_RECT;
     rectAtomPtr->x = pointsPtr[0];
@@ -350,6 +511,7 @@ NewCloseAtom(double x, double y)
 
     closeAtomPtr = (CloseAtom *) ckalloc((unsigned) (sizeof(CloseAtom)));
     atomPtr = (PathAtom *) closeAtomPtr;
+    atomPtr->flags = 0;
     atomPtr->type = PATH_ATOM_Z;
     atomPtr->nextPtr = NULL;
     closeAtomPtr->x = x;
@@ -357,13 +519,183 @@ NewCloseAtom(double x, double y)
     return atomPtr;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * NewFloatLineAtom --
+ *
+ *		Creates a FloatLineAtom with room for numPoints points
+ *		relative to x0, y0. The points must be filled in by the
+ *		caller.
+ *
+ * Results:
+ *		A PathAtom pointer.
+ *
+ * Side effects:
+ *		Memory allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+PathAtom *
+NewFloatLineAtom(double x0, double y0, int numPoints)
+{
+    PathAtom *atomPtr;
+    FloatLineAtom *flineAtomPtr;
+
+    flineAtomPtr = (FloatLineAtom *) ckalloc((unsigned) (sizeof(FloatLineAtom)
+	    + 2 * (numPoints - 1) * sizeof(float)));
+    atomPtr = (PathAtom *) flineAtomPtr;
+    atomPtr->flags = 0;
+    atomPtr->type = PATH_ATOM_FLINE;
+    atomPtr->nextPtr = NULL;
+    flineAtomPtr->x0 = x0;
+    flineAtomPtr->y0 = y0;
+    flineAtomPtr->numPoints = numPoints;
+    return atomPtr;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * PathAtomSize --
+ *
+ *		Returns the size of the record used for atoms of the
+ *		given type.
+ *
+ * Results:
+ *		Number of bytes.
+ *
+ * Side effects:
+ *		None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+PathAtomSize(PathAtomType type)
+{
+    switch (type) {
+        case PATH_ATOM_M: return sizeof(MoveToAtom);
+        case PATH_ATOM_L: return sizeof(LineToAtom);
+        case PATH_ATOM_A: return sizeof(ArcAtom);
+        case PATH_ATOM_Q: return sizeof(QuadBezierAtom);
+        case PATH_ATOM_C: return sizeof(CurveToAtom);
+        case PATH_ATOM_Z: return sizeof(CloseAtom);
+        case PATH_ATOM_ELLIPSE: return sizeof(EllipseAtom);
+        case PATH_ATOM_RECT: return sizeof(RectAtom);
+        case PATH_ATOM_FLINE: return sizeof(FloatLineAtom);
+    }
+    return sizeof(PathAtom);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkPathAtomBufferInit, TkPathAtomBufferAlloc, TkPathAtomBufferFinish,
+ * TkPathAtomBufferFree --
+ *
+ *		Build a list of path atoms that are stored back to back in a
+ *		single block of memory. This saves an allocation per segment
+ *		and keeps the atoms of long paths together in memory.
+ *		numAtoms is only a hint of the expected number of atoms.
+ *		Atoms returned by TkPathAtomBufferAlloc are only valid until
+ *		the next call since the block may move when it grows; the
+ *		nextPtr fields are set up by TkPathAtomBufferFinish.
+ *
+ * Results:
+ *		TkPathAtomBufferAlloc returns a zeroed atom of the given type.
+ *		TkPathAtomBufferFinish returns the first atom of the list,
+ *		or NULL if the buffer is empty.
+ *
+ * Side effects:
+ *		Memory allocated. After TkPathAtomBufferFinish the block is
+ *		owned by the list and must be freed with TkPathFreeAtoms.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+TkPathAtomBufferInit(PathAtomBuffer *bufPtr, int numAtoms)
+{
+    bufPtr->bytes = NULL;
+    bufPtr->used = 0;
+    bufPtr->size = (numAtoms > 0) ? numAtoms * sizeof(LineToAtom) : 0;
+}
+
+PathAtom *
+TkPathAtomBufferAlloc(PathAtomBuffer *bufPtr, PathAtomType type)
+{
+    PathAtom *atomPtr;
+    int size = PathAtomSize(type);
+
+    if (bufPtr->used + size > bufPtr->size) {
+        bufPtr->size = 2 * bufPtr->size;
+        if (bufPtr->size < bufPtr->used + size) {
+            bufPtr->size = bufPtr->used + 8 * sizeof(CurveToAtom);
+        }
+        if (bufPtr->bytes != NULL) {
+            bufPtr->bytes = ckrealloc(bufPtr->bytes, (unsigned) bufPtr->size);
+        }
+    }
+    if (bufPtr->bytes == NULL) {
+        bufPtr->bytes = ckalloc((unsigned) bufPtr->size);
+    }
+    atomPtr = (PathAtom *) (bufPtr->bytes + bufPtr->used);
+    bufPtr->used += size;
+    memset(atomPtr, 0, (size_t) size);
+    atomPtr->type = type;
+    return atomPtr;
+}
+
+PathAtom *
+TkPathAtomBufferFinish(PathAtomBuffer *bufPtr)
+{
+    PathAtom *atomPtr;
+    int offset;
+
+    if (bufPtr->used == 0) {
+        TkPathAtomBufferFree(bufPtr);
+        return NULL;
+    }
+    if (bufPtr->used < bufPtr->size - bufPtr->size/4) {
+        bufPtr->bytes = ckrealloc(bufPtr->bytes, (unsigned) bufPtr->used);
+    }
+    offset = 0;
+    while (1) {
+        atomPtr = (PathAtom *) (bufPtr->bytes + offset);
+        offset += PathAtomSize(atomPtr->type);
+        if (offset >= bufPtr->used) {
+            atomPtr->nextPtr = NULL;
+            break;
+        }
+        atomPtr->nextPtr = (PathAtom *) (bufPtr->bytes + offset);
+    }
+    atomPtr = (PathAtom *) bufPtr->bytes;
+    atomPtr->flags |= PATH_ATOM_PACKED;
+    bufPtr->bytes = NULL;
+    bufPtr->used = bufPtr->size = 0;
+    return atomPtr;
+}
+
+void
+TkPathAtomBufferFree(PathAtomBuffer *bufPtr)
+{
+    if (bufPtr->bytes != NULL) {
+        ckfree(bufPtr->bytes);
+    }
+    bufPtr->bytes = NULL;
+    bufPtr->used = bufPtr->size = 0;
+}
+
 /*
  *--------------------------------------------------------------
  *
  * TkPathParseToAtoms
  *
- *		Takes a tcl list of values which defines the path item and
- *		parses them into a linked list of path atoms.
+ *		Takes a tcl list of values, or a string with SVG path data,
+ *		which defines the path item and parses them into a linked
+ *		list of path atoms.
  *
  * Results:
  *		A standard Tcl result.
@@ -376,6 +708,43 @@ NewCloseAtom(double x, double y)
 
 int
 TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPtr, int *lenPtr)
+{
+    return ParseToAtoms(interp, listObjPtr, NULL, 0.0, 0.0, atomPtrPtr, lenPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkPathParseToAtomsAppend
+ *
+ *		Same as TkPathParseToAtoms but the path continues an
+ *		existing path whose last atom is lastAtomPtr and whose
+ *		current subpath starts at startX, startY. The path need
+ *		not start with M. Nothing is done to the existing atoms;
+ *		see TkPathFreeAtoms on how to link the lists.
+ *
+ * Results:
+ *		A standard Tcl result.
+ *
+ * Side effects:
+ *		None
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkPathParseToAtomsAppend(Tcl_Interp *interp, Tcl_Obj *listObjPtr, 
+        PathAtom *lastAtomPtr, double startX, double startY,
+        PathAtom **atomPtrPtr, int *lenPtr)
+{
+    return ParseToAtoms(interp, listObjPtr, lastAtomPtr, startX, startY,
+            atomPtrPtr, lenPtr);
+}
+
+static int
+ParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, 
+        PathAtom *lastAtomPtr, double lastStartX, double lastStartY,
+        PathAtom **atomPtrPtr, int *lenPtr)
 {
     char 	currentInstr;		/* current instruction (M, l, c, etc.) */
     char 	lastInstr;			/* previous instruction */
@@ -388,9 +757,15 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
     double 	startX, startY;		/* the current moveto point */
     double 	ctrlX, ctrlY;		/* last control point, for s, S, t, T */
     double 	x, y;
-    Tcl_Obj **objv;
-    PathAtom *atomPtr = NULL;
-    PathAtom *currentAtomPtr = NULL;
+    PathToken *tokens;
+    PathTokenBuffer tokenBuf;
+    PathAtomBuffer atoms;
+    MoveToAtom *movePtr;
+    LineToAtom *linePtr;
+    ArcAtom *arcPtr;
+    QuadBezierAtom *quadPtr;
+    CurveToAtom *curvePtr;
+    CloseAtom *closePtr;
     
     *atomPtrPtr = NULL;
     currentX = 0.0;
@@ -401,33 +776,70 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
     ctrlY = 0.0;
     lastInstr = 'M';	/* If first instruction is missing it defaults to M ? */
     relative = 0;
-        
-    if (Tcl_ListObjGetElements(interp, listObjPtr, lenPtr, &objv) != TCL_OK) {
-        return TCL_ERROR;
+    if (lastAtomPtr != NULL) {
+        TkPathAtomEndPoint(lastAtomPtr, &currentX, &currentY);
+        startX = lastStartX;
+        startY = lastStartY;
+        lastInstr = 'L';
+        if (lastAtomPtr->type == PATH_ATOM_C) {
+            lastInstr = 'C';
+            ctrlX = ((CurveToAtom *) lastAtomPtr)->ctrlX2;
+            ctrlY = ((CurveToAtom *) lastAtomPtr)->ctrlY2;
+        } else if (lastAtomPtr->type == PATH_ATOM_Q) {
+            lastInstr = 'Q';
+            ctrlX = ((QuadBezierAtom *) lastAtomPtr)->ctrlX;
+            ctrlY = ((QuadBezierAtom *) lastAtomPtr)->ctrlY;
+        }
+    }
+    tokenBuf.tokens = NULL;
+    tokenBuf.used = tokenBuf.size = 0;
+    atoms.bytes = NULL;
+
+    /*
+     * Scan the string directly unless we have a pure list which would
+     * need to generate its string first. Anything the scanner can't
+     * handle, braces for instance, goes the slow list way.
+     */
+    if ((listObjPtr->bytes == NULL) 
+            || !ScanPathString(Tcl_GetString(listObjPtr), &tokenBuf)) {
+        tokenBuf.used = 0;
+        if (TokenizePathList(interp, listObjPtr, &tokenBuf) != TCL_OK) {
+            goto error;
+        }
     }
-    len = *lenPtr;
+    tokens = tokenBuf.tokens;
+    len = *lenPtr = tokenBuf.used;
     
     /* First some error checking. Necessary??? */
-    if (len < 3) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(
-                "path specification too short", -1));
-        return TCL_ERROR;
-    }
-    if ((GetPathInstruction(interp, objv, 0, &currentInstr) != PATH_NEXT_INSTRUCTION) || 
-            (toupper(currentInstr) != 'M')) {
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(
-                "path must start with M or m", -1));
-        return TCL_ERROR;
-    }
-    currentInd = 1;
-    if (GetPathPoint(interp, objv, len, &currentInd, &x, &y) != TCL_OK) {
-        return TCL_ERROR;
+    if (lastAtomPtr != NULL) {
+        if (len == 0) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(
+                    "path specification too short", -1));
+            goto error;
+        }
+    } else {
+        if (len < 3) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(
+                    "path specification too short", -1));
+            goto error;
+        }
+        if ((GetPathInstruction(interp, tokens, 0, &currentInstr) != PATH_NEXT_INSTRUCTION) || 
+                (toupper(currentInstr) != 'M')) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj(
+                    "path must start with M or m", -1));
+            goto error;
+        }
+        currentInd = 1;
+        if (GetPathPoint(interp, tokens, len, &currentInd, &x, &y) != TCL_OK) {
+            goto error;
+        }
     }
     currentInd = 0;
+    TkPathAtomBufferInit(&atoms, len/3 + 1);
      
     while (currentInd < len) {
 
-        next = GetPathInstruction(interp, objv, currentInd, &currentInstr);
+        next = GetPathInstruction(interp, tokens, currentInd, &currentInstr);
         if (next == PATH_NEXT_ERROR) {
             goto error;
         } else if (next == PATH_NEXT_INSTRUCTION) {
@@ -450,20 +862,16 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
         switch (currentInstr) {
         
             case 'M': case 'm': {
-                if (GetPathPoint(interp, objv, len, &index, &x, &y) != TCL_OK) {
+                if (GetPathPoint(interp, tokens, len, &index, &x, &y) != TCL_OK) {
                     goto error;
                 }
                 if (relative) {
                     x += currentX;
                     y += currentY;
                 }    
-                atomPtr = NewMoveToAtom(x, y);
-                if (currentAtomPtr == NULL) {
-                    *atomPtrPtr = atomPtr;
-                } else {
-                    currentAtomPtr->nextPtr = atomPtr;
-                }
-                currentAtomPtr = atomPtr;
+                movePtr = (MoveToAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_M);
+                movePtr->x = x;
+                movePtr->y = y;
                 currentX = x;
                 currentY = y;
                 startX = x;
@@ -476,14 +884,14 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
                     Tcl_SetObjResult(interp, Tcl_NewStringObj(kPathSyntaxError, -1));
                     goto error;
                 }
-                if (GetPathPoint(interp, objv, len, &index, &x, &y) == TCL_OK) {
+                if (GetPathPoint(interp, tokens, len, &index, &x, &y) == TCL_OK) {
                     if (relative) {
                         x += currentX;
                         y += currentY;
                     }    
-                    atomPtr = NewLineToAtom(x, y);
-                    currentAtomPtr->nextPtr = atomPtr;
-                    currentAtomPtr = atomPtr;
+                    linePtr = (LineToAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_L);
+                    linePtr->x = x;
+                    linePtr->y = y;
                     currentX = x;
                     currentY = y;
                 } else {
@@ -496,16 +904,21 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
                 double radX, radY, angle;
                 char largeArcFlag, sweepFlag;
                 
-                if (GetPathArcParameters(interp, objv, len, &index,
+                if (GetPathArcParameters(interp, tokens, len, &index,
                         &radX, &radY, &angle, &largeArcFlag, &sweepFlag,
                         &x, &y) == TCL_OK) {
                     if (relative) {
                         x += currentX;
                         y += currentY;
                     }    
-                    atomPtr = NewArcAtom(radX, radY, angle, largeArcFlag, sweepFlag, x, y);
-                    currentAtomPtr->nextPtr = atomPtr;
-                    currentAtomPtr = atomPtr;
+                    arcPtr = (ArcAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_A);
+                    arcPtr->radX = radX;
+                    arcPtr->radY = radY;
+                    arcPtr->angle = angle;
+                    arcPtr->largeArcFlag = largeArcFlag;
+                    arcPtr->sweepFlag = sweepFlag;
+                    arcPtr->x = x;
+                    arcPtr->y = y;
                     currentX = x;
                     currentY = y;
                 } else {
@@ -521,7 +934,7 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
                     Tcl_SetObjResult(interp, Tcl_NewStringObj(kPathSyntaxError, -1));
                     goto error;
                 }
-                if (GetPathThreePoints(interp, objv, len, &index, &x1, &y1, &x2, &y2, &x, &y) == TCL_OK) {
+                if (GetPathThreePoints(interp, tokens, len, &index, &x1, &y1, &x2, &y2, &x, &y) == TCL_OK) {
                     if (relative) {
                         x1 += currentX;
                         y1 += currentY;
@@ -530,9 +943,13 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
                         x  += currentX;
                         y  += currentY;
                     }    
-                    atomPtr = NewCurveToAtom(x1, y1, x2, y2, x, y);
-                    currentAtomPtr->nextPtr = atomPtr;
-                    currentAtomPtr = atomPtr;
+                    curvePtr = (CurveToAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_C);
+                    curvePtr->ctrlX1 = x1;
+                    curvePtr->ctrlY1 = y1;
+                    curvePtr->ctrlX2 = x2;
+                    curvePtr->ctrlY2 = y2;
+                    curvePtr->anchorX = x;
+                    curvePtr->anchorY = y;
                     ctrlX = x2; 	/* Keep track of the last control point. */
                     ctrlY = y2;
                     currentX = x;
@@ -560,16 +977,20 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
                     Tcl_SetObjResult(interp, Tcl_NewStringObj(kPathSyntaxError, -1));
                     goto error;
                 }
-                if (GetPathTwoPoints(interp, objv, len, &index, &x2, &y2, &x, &y) == TCL_OK) {
+                if (GetPathTwoPoints(interp, tokens, len, &index, &x2, &y2, &x, &y) == TCL_OK) {
                     if (relative) {
                         x2 += currentX;
                         y2 += currentY;
                         x  += currentX;
                         y  += currentY;
                     }    
-                    atomPtr = NewCurveToAtom(x1, y1, x2, y2, x, y);
-                    currentAtomPtr->nextPtr = atomPtr;
-                    currentAtomPtr = atomPtr;
+                    curvePtr = (CurveToAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_C);
+                    curvePtr->ctrlX1 = x1;
+                    curvePtr->ctrlY1 = y1;
+                    curvePtr->ctrlX2 = x2;
+                    curvePtr->ctrlY2 = y2;
+                    curvePtr->anchorX = x;
+                    curvePtr->anchorY = y;
                     ctrlX = x2; 	/* Keep track of the last control point. */
                     ctrlY = y2;
                     currentX = x;
@@ -583,16 +1004,18 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
             case 'Q': case 'q': {
                 double x1, y1;	/* The control point. */
                 
-                if (GetPathTwoPoints(interp, objv, len, &index, &x1, &y1, &x, &y) == TCL_OK) {
+                if (GetPathTwoPoints(interp, tokens, len, &index, &x1, &y1, &x, &y) == TCL_OK) {
                     if (relative) {
                         x1 += currentX;
                         y1 += currentY;
                         x  += currentX;
                         y  += currentY;
                     }    
-                    atomPtr = NewQuadBezierAtom(x1, y1, x, y);
-                    currentAtomPtr->nextPtr = atomPtr;
-                    currentAtomPtr = atomPtr;
+                    quadPtr = (QuadBezierAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_Q);
+                    quadPtr->ctrlX = x1;
+                    quadPtr->ctrlY = y1;
+                    quadPtr->anchorX = x;
+                    quadPtr->anchorY = y;
                     ctrlX = x1; 	/* Keep track of the last control point. */
                     ctrlY = y1;
                     currentX = x;
@@ -615,14 +1038,16 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
                     x1 = currentX;
                     y1 = currentY;
                 }
-                if (GetPathPoint(interp, objv, len, &index, &x, &y) == TCL_OK) {
+                if (GetPathPoint(interp, tokens, len, &index, &x, &y) == TCL_OK) {
                     if (relative) {
                         x  += currentX;
                         y  += currentY;
                     }    
-                    atomPtr = NewQuadBezierAtom(x1, y1, x, y);
-                    currentAtomPtr->nextPtr = atomPtr;
-                    currentAtomPtr = atomPtr;
+                    quadPtr = (QuadBezierAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_Q);
+                    quadPtr->ctrlX = x1;
+                    quadPtr->ctrlY = y1;
+                    quadPtr->anchorX = x;
+                    quadPtr->anchorY = y;
                     ctrlX = x1; 	/* Keep track of the last control point. */
                     ctrlY = y1;
                     currentX = x;
@@ -635,11 +1060,11 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
             
             case 'H': {
                 while ((index < len) && 
-                        (GetPathDouble(interp, objv, len, &index, &x) == TCL_OK))
+                        (GetPathDouble(interp, tokens, len, &index, &x) == TCL_OK))
                     ;
-                atomPtr = NewLineToAtom(x, currentY);
-                currentAtomPtr->nextPtr = atomPtr;
-                currentAtomPtr = atomPtr;
+                linePtr = (LineToAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_L);
+                linePtr->x = x;
+                linePtr->y = currentY;
                 currentX = x;
                 break;
             }
@@ -649,23 +1074,23 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
                 
                 x = currentX;
                 while ((index < len) &&
-                        (GetPathDouble(interp, objv, len, &index, &z) == TCL_OK)) {
+                        (GetPathDouble(interp, tokens, len, &index, &z) == TCL_OK)) {
                     x += z;
                 }
-                atomPtr = NewLineToAtom(x, currentY);
-                currentAtomPtr->nextPtr = atomPtr;
-                currentAtomPtr = atomPtr;
+                linePtr = (LineToAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_L);
+                linePtr->x = x;
+                linePtr->y = currentY;
                 currentX = x;
                 break;
             }
             
             case 'V': {
                 while ((index < len) && 
-                        (GetPathDouble(interp, objv, len, &index, &y) == TCL_OK))
+                        (GetPathDouble(interp, tokens, len, &index, &y) == TCL_OK))
                     ;
-                atomPtr = NewLineToAtom(currentX, y);
-                currentAtomPtr->nextPtr = atomPtr;
-                currentAtomPtr = atomPtr;
+                linePtr = (LineToAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_L);
+                linePtr->x = currentX;
+                linePtr->y = y;
                 currentY = y;
                 break;
             }
@@ -675,20 +1100,20 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
                 
                 y = currentY;
                 while ((index < len) &&
-                        (GetPathDouble(interp, objv, len, &index, &z) == TCL_OK)) {
+                        (GetPathDouble(interp, tokens, len, &index, &z) == TCL_OK)) {
                     y += z;
                 }
-                atomPtr = NewLineToAtom(currentX, y);
-                currentAtomPtr->nextPtr = atomPtr;
-                currentAtomPtr = atomPtr;
+                linePtr = (LineToAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_L);
+                linePtr->x = currentX;
+                linePtr->y = y;
                 currentY = y;
                 break;
             }
             
             case 'Z': case 'z': {
-                atomPtr = NewCloseAtom(startX, startY);
-                currentAtomPtr->nextPtr = atomPtr;
-                currentAtomPtr = atomPtr;
+                closePtr = (CloseAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_Z);
+                closePtr->x = startX;
+                closePtr->y = startY;
                 currentX = startX;
                 currentY = startY;
                 break;
@@ -704,6 +1129,9 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
         lastInstr = currentInstr;
     }
     
+    *atomPtrPtr = TkPathAtomBufferFinish(&atoms);
+    ckfree((char *) tokenBuf.tokens);
+    
     /* When we parse coordinates there may be some junk result
      * left in the interpreter to be cleared out. */
     Tcl_ResetResult(interp);
@@ -711,7 +1139,10 @@ TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPt
     
 error:
 
-    TkPathFreeAtoms(*atomPtrPtr);
+    TkPathAtomBufferFree(&atoms);
+    if (tokenBuf.tokens != NULL) {
+        ckfree((char *) tokenBuf.tokens);
+    }
     *atomPtrPtr = NULL;
     return TCL_ERROR;
 }
@@ -722,6 +1153,9 @@ error:
  * TkPathFreeAtoms
  *
  *		Frees up all memory allocated for the path atoms.
+ *		A list made by TkPathParseToAtomsAppend may be linked to
+ *		the last atom of a packed list if the first atom of that
+ *		list gets its PATH_ATOM_CHAINED flag set.
  *
  * Results:
  *		None.
@@ -737,6 +1171,15 @@ TkPathFreeAtoms(PathAtom *pathAtomPtr)
 {
     PathAtom *tmpAtomPtr;
 
+    if ((pathAtomPtr != NULL) && (pathAtomPtr->flags & PATH_ATOM_PACKED)) {
+        if (!(pathAtomPtr->flags & PATH_ATOM_CHAINED)) {
+            /* The rest of the list is a single block. */
+            ckfree((char *) pathAtomPtr);
+        } else {
+            FreePackedBlocks(pathAtomPtr);
+        }
+        return;
+    }
     while (pathAtomPtr != NULL) {
         tmpAtomPtr = pathAtomPtr;
         pathAtomPtr = tmpAtomPtr->nextPtr;
@@ -744,6 +1187,329 @@ TkPathFreeAtoms(PathAtom *pathAtomPtr)
     }
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * FreePackedBlocks
+ *
+ *		Frees all blocks of packed atoms that start in the list.
+ *		Atoms of a block that started before the list are skipped.
+ *
+ * Results:
+ *		None.
+ *
+ * Side effects:
+ *		None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+FreePackedBlocks(PathAtom *atomPtr)
+{
+    PathAtom *blockPtr = NULL;
+    PathAtom *nextPtr;
+
+    while (atomPtr != NULL) {
+        nextPtr = atomPtr->nextPtr;
+        if (atomPtr->flags & PATH_ATOM_PACKED) {
+            /* All atoms of the previous block have been passed. */
+            if (blockPtr != NULL) {
+                ckfree((char *) blockPtr);
+            }
+            blockPtr = atomPtr;
+        }
+        atomPtr = nextPtr;
+    }
+    if (blockPtr != NULL) {
+        ckfree((char *) blockPtr);
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkPathTruncateAtoms
+ *
+ *		Keeps the first numAtoms atoms of a list and frees the rest.
+ *		Memory of a packed block that is cut in two is kept until
+ *		the whole list is freed.
+ *
+ * Results:
+ *		The last atom kept.
+ *
+ * Side effects:
+ *		Memory freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+PathAtom *
+TkPathTruncateAtoms(PathAtom *atomPtr, int numAtoms)
+{
+    PathAtom *lastPtr = atomPtr;
+    PathAtom *tailPtr;
+    int packed = (atomPtr->flags & PATH_ATOM_PACKED);
+
+    while ((--numAtoms > 0) && (lastPtr->nextPtr != NULL)) {
+        lastPtr = lastPtr->nextPtr;
+    }
+    tailPtr = lastPtr->nextPtr;
+    lastPtr->nextPtr = NULL;
+    if (packed) {
+        FreePackedBlocks(tailPtr);
+    } else {
+        TkPathFreeAtoms(tailPtr);
+    }
+    return lastPtr;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkPathAtomEndPoint
+ *
+ *		Gets the current point after the atom has been drawn.
+ *
+ * Results:
+ *		None.
+ *
+ * Side effects:
+ *		None.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+TkPathAtomEndPoint(PathAtom *atomPtr, double *xPtr, double *yPtr)
+{
+    switch (atomPtr->type) {
+        case PATH_ATOM_M: {
+            *xPtr = ((MoveToAtom *) atomPtr)->x;
+            *yPtr = ((MoveToAtom *) atomPtr)->y;
+            break;
+        }
+        case PATH_ATOM_L: {
+            *xPtr = ((LineToAtom *) atomPtr)->x;
+            *yPtr = ((LineToAtom *) atomPtr)->y;
+            break;
+        }
+        case PATH_ATOM_A: {
+            *xPtr = ((ArcAtom *) atomPtr)->x;
+            *yPtr = ((ArcAtom *) atomPtr)->y;
+            break;
+        }
+        case PATH_ATOM_Q: {
+            *xPtr = ((QuadBezierAtom *) atomPtr)->anchorX;
+            *yPtr = ((QuadBezierAtom *) atomPtr)->anchorY;
+            break;
+        }
+        case PATH_ATOM_C: {
+            *xPtr = ((CurveToAtom *) atomPtr)->anchorX;
+            *yPtr = ((CurveToAtom *) atomPtr)->anchorY;
+            break;
+        }
+        case PATH_ATOM_Z: {
+            *xPtr = ((CloseAtom *) atomPtr)->x;
+            *yPtr = ((CloseAtom *) atomPtr)->y;
+            break;
+        }
+        case PATH_ATOM_FLINE: {
+            FloatLineAtom *fline = (FloatLineAtom *) atomPtr;
+            float *pts = fline->points + 2*(fline->numPoints - 1);
+
+            *xPtr = fline->x0 + pts[0];
+            *yPtr = fline->y0 + pts[1];
+            break;
+        }
+        default: {
+            /* The ellipse and rect atoms are never part of a path. */
+            *xPtr = *yPtr = 0.0;
+        }
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * SimplifyRun
+ *
+ *		Douglas-Peucker simplification of a polyline. Marks the
+ *		points that must be kept so that no point that is dropped
+ *		lies further than tolerance from the simplified line.
+ *		The end points are always kept.
+ *
+ * Results:
+ *		None.
+ *
+ * Side effects:
+ *		The keep array is filled in.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+SimplifyRun(double *points, int numPoints, double tolerance, char *keep)
+{
+    int *stack;
+    int top = 0;
+    int i, j, k, maxk;
+    double dx, dy, len2, t, ex, ey, d2, maxd2;
+    double tol2 = tolerance*tolerance;
+
+    memset(keep, 0, (size_t) numPoints);
+    keep[0] = keep[numPoints-1] = 1;
+    if (numPoints < 3) {
+        return;
+    }
+    stack = (int *) ckalloc((unsigned) (2*numPoints*sizeof(int)));
+    stack[top++] = 0;
+    stack[top++] = numPoints-1;
+    while (top > 0) {
+        j = stack[--top];
+        i = stack[--top];
+        if (j - i < 2) {
+            continue;
+        }
+        dx = points[2*j] - points[2*i];
+        dy = points[2*j+1] - points[2*i+1];
+        len2 = dx*dx + dy*dy;
+        maxd2 = -1.0;
+        maxk = i;
+        for (k = i+1; k < j; k++) {
+            ex = points[2*k] - points[2*i];
+            ey = points[2*k+1] - points[2*i+1];
+            
+            /* Distance to the segment, not the infinite line. */
+            if (len2 > 0.0) {
+                t = (ex*dx + ey*dy)/len2;
+                if (t > 1.0) {
+                    t = 1.0;
+                } else if (t < 0.0) {
+                    t = 0.0;
+                }
+                ex -= t*dx;
+                ey -= t*dy;
+            }
+            d2 = ex*ex + ey*ey;
+            if (d2 > maxd2) {
+                maxd2 = d2;
+                maxk = k;
+            }
+        }
+        if (maxd2 > tol2) {
+            keep[maxk] = 1;
+            stack[top++] = i;
+            stack[top++] = maxk;
+            stack[top++] = maxk;
+            stack[top++] = j;
+        }
+    }
+    ckfree((char *) stack);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkPathSimplifyAtoms
+ *
+ *		Makes a copy of a list of atoms where each run of straight
+ *		line segments is simplified so that it deviates at most
+ *		tolerance from the original. All other atoms are copied
+ *		as they are, and float precision lines are turned into
+ *		ordinary line atoms.
+ *
+ * Results:
+ *		A new packed list of atoms, or NULL if atomPtr is NULL.
+ *
+ * Side effects:
+ *		Memory allocated. Free the list with TkPathFreeAtoms.
+ *
+ *--------------------------------------------------------------
+ */
+
+PathAtom *
+TkPathSimplifyAtoms(PathAtom *atomPtr, double tolerance)
+{
+    PathAtomBuffer atoms;
+    PathAtom *dstPtr;
+    LineToAtom *lineAtomPtr;
+    double *run = NULL;
+    char *keep = NULL;
+    int runLen = 0, runSize = 0;
+    int numAtoms = 0;
+    int i, size;
+    double currentX = 0.0, currentY = 0.0;
+    PathAtom *srcPtr;
+
+    for (srcPtr = atomPtr; srcPtr != NULL; srcPtr = srcPtr->nextPtr) {
+        numAtoms++;
+    }
+    TkPathAtomBufferInit(&atoms, numAtoms);
+    for (srcPtr = atomPtr; ; srcPtr = srcPtr->nextPtr) {
+        if ((srcPtr != NULL) && ((srcPtr->type == PATH_ATOM_L) 
+                || (srcPtr->type == PATH_ATOM_FLINE))) {
+            int n = (srcPtr->type == PATH_ATOM_L) ? 1 :
+                    ((FloatLineAtom *) srcPtr)->numPoints;
+            
+            if (runLen + n + 1 > runSize) {
+                runSize = 2*(runLen + n + 1);
+                run = (double *) ckrealloc((char *) run, 
+                        (unsigned) (2*runSize*sizeof(double)));
+            }
+            if (runLen == 0) {
+                /* The run starts at the current point. */
+                run[0] = currentX;
+                run[1] = currentY;
+                runLen = 1;
+            }
+            if (srcPtr->type == PATH_ATOM_L) {
+                run[2*runLen] = ((LineToAtom *) srcPtr)->x;
+                run[2*runLen+1] = ((LineToAtom *) srcPtr)->y;
+                runLen++;
+            } else {
+                FloatLineAtom *fline = (FloatLineAtom *) srcPtr;
+
+                for (i = 0; i < n; i++, runLen++) {
+                    run[2*runLen] = fline->x0 + fline->points[2*i];
+                    run[2*runLen+1] = fline->y0 + fline->points[2*i+1];
+                }
+            }
+            TkPathAtomEndPoint(srcPtr, &currentX, &currentY);
+            continue;
+        }
+        if (runLen > 1) {
+            keep = ckrealloc(keep, (unsigned) runSize);
+            SimplifyRun(run, runLen, tolerance, keep);
+            for (i = 1; i < runLen; i++) {
+                if (keep[i]) {
+                    lineAtomPtr = (LineToAtom *) 
+                            TkPathAtomBufferAlloc(&atoms, PATH_ATOM_L);
+                    lineAtomPtr->x = run[2*i];
+                    lineAtomPtr->y = run[2*i+1];
+                }
+            }
+        }
+        runLen = 0;
+        if (srcPtr == NULL) {
+            break;
+        }
+        size = PathAtomSize(srcPtr->type);
+        dstPtr = TkPathAtomBufferAlloc(&atoms, srcPtr->type);
+        memcpy((char *) dstPtr + sizeof(PathAtom), 
+                (char *) srcPtr + sizeof(PathAtom), 
+                (size_t) (size - sizeof(PathAtom)));
+        TkPathAtomEndPoint(srcPtr, &currentX, &currentY);
+    }
+    if (run != NULL) {
+        ckfree((char *) run);
+    }
+    if (keep != NULL) {
+        ckfree(keep);
+    }
+    return TkPathAtomBufferFinish(&atoms);
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -788,6 +1554,18 @@ TkPathNormalize(Tcl_Interp *interp, PathAtom *atomPtr, Tcl_Obj **listObjPtrPtr)
                 Tcl_ListObjAppendElement(interp, normObjPtr, Tcl_NewDoubleObj(line->y));
                 break;
             }
+            case PATH_ATOM_FLINE: {
+                FloatLineAtom *fline = (FloatLineAtom *) atomPtr;
+                float *pts = fline->points;
+                int i;
+                
+                for (i = 0; i < fline->numPoints; i++, pts += 2) {
+                    Tcl_ListObjAppendElement(interp, normObjPtr, Tcl_NewStringObj("L", -1));
+                    Tcl_ListObjAppendElement(interp, normObjPtr, Tcl_NewDoubleObj(fline->x0 + pts[0]));
+                    Tcl_ListObjAppendElement(interp, normObjPtr, Tcl_NewDoubleObj(fline->y0 + pts[1]));
+                }
+                break;
+            }
             case PATH_ATOM_A: {
                 ArcAtom *arc = (ArcAtom *) atomPtr;
                 
@@ -876,6 +1654,15 @@ TkPathMakePath(
                 TkPathLineTo(context, line->x, line->y);
                 break;
             }
+            case PATH_ATOM_FLINE: {
+                FloatLineAtom *fline = (FloatLineAtom *) atomPtr;
+                float *pts = fline->points;
+                int i;
+                for (i = 0; i < fline->numPoints; i++, pts += 2) {
+                    TkPathLineTo(context, fline->x0 + pts[0], fline->y0 + pts[1]);
+                }
+                break;
+            }
             case PATH_ATOM_A: {
                 ArcAtom *arc = (ArcAtom *) atomPtr;
                 TkPathArcTo(context, arc->radX, arc->radY, arc->angle, 
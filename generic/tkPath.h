@@ -38,7 +38,9 @@ typedef enum {
     PATH_ATOM_ELLIPSE = '1',	/* These are not a standard atoms
                                  * since they are more complex (molecule).
                                  * Not all features supported for these! */
-    PATH_ATOM_RECT = '2'
+    PATH_ATOM_RECT = '2',
+    PATH_ATOM_FLINE = '3'	/* A run of line-to's with the points stored
+                                 * as floats relative to a double origin. */
 } PathAtomType;
 
 enum {
@@ -74,9 +76,39 @@ typedef struct TMatrix {
  
 typedef struct PathAtom {
     PathAtomType type;		/* Type of PathAtom. */
+    int flags;			/* PATH_ATOM_PACKED etc. */
     struct PathAtom *nextPtr;	/* Next PathAtom along the path. */
 } PathAtom;
 
+/*
+ * Flag bits for PathAtom:
+ *
+ * PATH_ATOM_PACKED -		Set on the first atom of a list built with
+ *				a PathAtomBuffer. This atom and all atoms
+ *				following it up to the next packed atom live
+ *				in a single block of memory which is freed
+ *				at once by TkPathFreeAtoms.
+ * PATH_ATOM_CHAINED -		Set on the first atom of a packed list when
+ *				further packed lists have been appended to
+ *				it, see TkPathParseToAtomsAppend.
+ */
+
+#define PATH_ATOM_PACKED	1
+#define PATH_ATOM_CHAINED	2
+
+/*
+ * A PathAtomBuffer collects atoms back to back in one growing block of
+ * memory instead of allocating each atom separately. The atoms are linked
+ * up when the buffer is finished, so the result is an ordinary atom list
+ * that can be walked using the nextPtr fields.
+ */
+
+typedef struct PathAtomBuffer {
+    char *bytes;		/* Storage for the atoms, or NULL. */
+    int used;			/* Number of bytes used. */
+    int size;			/* Number of bytes allocated. */
+} PathAtomBuffer;
+
 typedef void (TkPathGradientChangedProc)(ClientData clientData, int flags);
 typedef void (TkPathStyleChangedProc)(ClientData clientData, int flags);
 
@@ -282,13 +314,25 @@ PathAtom *  NewCurveToAtom(double ctrlX1, double ctrlY1, double ctrlX2, double c
 		double anchorX, double anchorY);
 PathAtom *  NewRectAtom(double pointsPtr[]);
 PathAtom *  NewCloseAtom(double x, double y);
+PathAtom *  NewFloatLineAtom(double x0, double y0, int numPoints);
+
+void	    TkPathAtomBufferInit(PathAtomBuffer *bufPtr, int numAtoms);
+PathAtom *  TkPathAtomBufferAlloc(PathAtomBuffer *bufPtr, PathAtomType type);
+PathAtom *  TkPathAtomBufferFinish(PathAtomBuffer *bufPtr);
+void	    TkPathAtomBufferFree(PathAtomBuffer *bufPtr);
 
 /*
  * Functions that process lists and atoms.
  */
  
 int	TkPathParseToAtoms(Tcl_Interp *interp, Tcl_Obj *listObjPtr, PathAtom **atomPtrPtr, int *lenPtr);
+int	TkPathParseToAtomsAppend(Tcl_Interp *interp, Tcl_Obj *listObjPtr, 
+		PathAtom *lastAtomPtr, double startX, double startY,
+		PathAtom **atomPtrPtr, int *lenPtr);
 void	TkPathFreeAtoms(PathAtom *pathAtomPtr);
+PathAtom *  TkPathTruncateAtoms(PathAtom *atomPtr, int numAtoms);
+void	TkPathAtomEndPoint(PathAtom *atomPtr, double *xPtr, double *yPtr);
+PathAtom *  TkPathSimplifyAtoms(PathAtom *atomPtr, double tolerance);
 int	TkPathNormalize(Tcl_Interp *interp, PathAtom *atomPtr, Tcl_Obj **listObjPtrPtr);
 int	TkPathMakePath(Drawable drawable, PathAtom *atomPtr, Tk_PathStyle *stylePtr);
 
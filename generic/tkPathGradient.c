@@ -16,16 +16,23 @@
 
 /*
  * Hash table to keep track of gradient fills.
- * This is used for globally defined gradients.
+ * This is used for globally defined gradients. It is shared by all
+ * interps of a thread but each thread has its own.
  */    
 
-Tcl_HashTable 	*gGradientHashPtr = NULL;
+typedef struct ThreadSpecificData {
+    Tcl_HashTable gradientTable;
+    Tk_OptionTable linearOptionTable;
+    Tk_OptionTable radialOptionTable;
+    int gradientNameUid;
+    int initialized;
+} ThreadSpecificData;
 
-static Tk_OptionTable 	linearOptionTable = NULL;
-static Tk_OptionTable 	radialOptionTable = NULL;
-static int 		gGradientNameUid = 0;
+static Tcl_ThreadDataKey dataKey;
 static char *		kGradientNameBase = "tkp::gradient";
 
+#define gGradientHashPtr (&GetThreadData()->gradientTable)
+
 static int 	GradientObjCmd(ClientData clientData, Tcl_Interp* interp,
 			int objc, Tcl_Obj* CONST objv[]);
 
@@ -500,44 +507,60 @@ PathGradientPaint(TkPathContext ctx, PathRect *bbox,
     }
 }
 
+static ThreadSpecificData *
+GetThreadData(void)
+{
+    return (ThreadSpecificData *) 
+	    Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData));
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPathGradientTable --
+ *
+ *	Returns the table of globally defined gradients of this thread.
+ *
+ * Results:
+ *	Pointer to the hash table.
+ *
+ * Side effects:
+ *	None
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_HashTable *
+TkPathGradientTable(void)
+{
+    return gGradientHashPtr;
+}
+
 void
 PathGradientInit(Tcl_Interp* interp) 
 {
-    /* 
-     fixme roger: 04/07/2008
+    ThreadSpecificData *tsdPtr = GetThreadData();
 
-     Don't recreate the Gradient Tables for
-     slave interps -- otherwise will void
-     existing gradients in the main interp...
-
-     THERE IS NO FREE FOR THESE HASH TABLES...
-    */
+    /* 
+     * Don't recreate the gradient table for slave interps,
+     * otherwise will void existing gradients in the main interp.
+     * Interps in other threads get their own table and option tables
+     * since neither may be touched from more than one thread.
+     */
     
-    if (NULL == gGradientHashPtr) {
-	gGradientHashPtr = (Tcl_HashTable *) ckalloc( sizeof(Tcl_HashTable) );
-	Tcl_InitHashTable(gGradientHashPtr, TCL_STRING_KEYS);
-    }
+    if (!tsdPtr->initialized) {
+	Tcl_InitHashTable(&tsdPtr->gradientTable, TCL_STRING_KEYS);
 
-    /*
-     * The option table must only be made once and not for each instance.
-     */
+	/*
+	 * The option table must only be made once and not for each instance.
+	 */
 
-    if (NULL == linearOptionTable) {
-	linearOptionTable = Tk_CreateOptionTable(interp, 
+	tsdPtr->linearOptionTable = Tk_CreateOptionTable(interp, 
 		linGradientStyleOptionSpecs);
-    }
-    if (NULL == radialOptionTable ) {
-	radialOptionTable = Tk_CreateOptionTable(interp, 
+	tsdPtr->radialOptionTable = Tk_CreateOptionTable(interp, 
 		radGradientStyleOptionSpecs);
+	tsdPtr->initialized = 1;
     }
-    
-    /* 
-       fixme roger 04/07 ... above,
-       
-       Tables have to be restructured to be accessed via clientData
-       for each interp... that will close this issue.
-     */
-     
     Tcl_CreateObjCommand(interp, "::tkp::gradient",
             GradientObjCmd, (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
 }
@@ -661,9 +684,9 @@ PathGradientCreate(Tcl_Interp *interp, Tk_Window tkwin, int objc, Tcl_Obj * CONS
      * been created, the cached pointer will be returned.
      */
     if (type == kPathGradientTypeLinear) {
-	gradientPtr->optionTable = linearOptionTable; 
+	gradientPtr->optionTable = GetThreadData()->linearOptionTable; 
     } else {
-	gradientPtr->optionTable = radialOptionTable; 
+	gradientPtr->optionTable = GetThreadData()->radialOptionTable; 
     }
     gradientPtr->type = type;
     gradientPtr->name = Tk_GetUid(tokenName);
@@ -840,7 +863,7 @@ GradientObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CON
 		Tcl_WrongNumArgs(interp, 2, objv, "type ?option value...?");
 		return TCL_ERROR;
 	    }
-            sprintf(str, "%s%d", kGradientNameBase, gGradientNameUid++);
+            sprintf(str, "%s%d", kGradientNameBase, GetThreadData()->gradientNameUid++);
 	    result = PathGradientCreate(interp, tkwin, objc-2, objv+2, gGradientHashPtr, str);
             break;
         }
@@ -20,13 +20,27 @@
 #include "tkIntPath.h"
 #include "tkPathStyle.h"
 
-extern Tcl_HashTable 	*gGradientHashPtr;
+/*
+ * The globally defined styles are shared by all interps of a thread
+ * but each thread has its own.
+ */
+
+typedef struct ThreadSpecificData {
+    Tcl_HashTable styleTable;
+    Tk_OptionTable optionTable;
+    int styleNameUid;
+    int initialized;
+} ThreadSpecificData;
 
-static Tcl_HashTable 	*gStyleHashPtr;
-static Tk_OptionTable 	styleOptionTable;
-static int 		gStyleNameUid = 0;
+static Tcl_ThreadDataKey dataKey;
 static char 		*kStyleNameBase = "tkp::style";
 
+#define GetThreadData() ((ThreadSpecificData *) \
+	Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData)))
+#define gStyleHashPtr (&GetThreadData()->styleTable)
+#define gGradientHashPtr TkPathGradientTable()
+#define styleOptionTable (GetThreadData()->optionTable)
+
 /*
  * Declarationd for functions local to this file.
  */
@@ -416,13 +430,20 @@ static Tk_OptionSpec styleOptionSpecs[] = {
 void
 PathStyleInit(Tcl_Interp *interp) 
 {
-    gStyleHashPtr = (Tcl_HashTable *) ckalloc( sizeof(Tcl_HashTable) );
-    Tcl_InitHashTable(gStyleHashPtr, TCL_STRING_KEYS);
-    
+    ThreadSpecificData *tsdPtr = GetThreadData();
+
     /*
-     * The option table must only be made once and not for each instance.
+     * Slave interps share the styles of their thread.
      */
-    styleOptionTable = Tk_CreateOptionTable(interp, styleOptionSpecs);
+    if (!tsdPtr->initialized) {
+	Tcl_InitHashTable(&tsdPtr->styleTable, TCL_STRING_KEYS);
+    
+	/*
+	 * The option table must only be made once and not for each instance.
+	 */
+	tsdPtr->optionTable = Tk_CreateOptionTable(interp, styleOptionSpecs);
+	tsdPtr->initialized = 1;
+    }
 
     Tcl_CreateObjCommand(interp, "tkp::style",
             StyleObjCmd, (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
@@ -776,7 +797,7 @@ StyleObjCmd(
 		Tcl_WrongNumArgs(interp, 1, objv, "?option value...?");
 		return TCL_ERROR;
 	    }
-            sprintf(str, "%s%d", kStyleNameBase, gStyleNameUid++);
+            sprintf(str, "%s%d", kStyleNameBase, GetThreadData()->styleNameUid++);
 	    result = PathStyleCreate(interp, tkwin, objc-2, objv+2, 
 		    gStyleHashPtr, gGradientHashPtr, str);
             break;
@@ -12,14 +12,60 @@
 #include "tkIntPath.h"
 #include "tkPathStyle.h"
 
+/*
+ * The surfaces and the option tables used to draw in them are kept
+ * for each interpreter so that surfaces can be used from several
+ * threads at once.
+ */
+
+typedef struct PathSurfaceState {
+    Tcl_HashTable surfaceTable;	/* Surfaces by name. */
+    int uid;
+    int recordingUid;
+    Tk_OptionTable optionTables[9];
+			/* Indexed by kPathSurfaceItem*. */
+} PathSurfaceState;
+
 typedef struct PathSurface {
+    PathSurfaceState *statePtr;
     TkPathContext ctx;
     char *token;
     int width;
     int height;
+    Tcl_HashTable *optionCachePtr;
+			/* Parsed options shared by the primitives of
+			 * a 'draw' command list or a recording, or NULL. */
+    struct PathRecording *recordingPtr;
+			/* The recording being made, or NULL. */
+    struct SurfOptionRecord *lastOptPtr;
+			/* Options of the last primitive parsed into
+			 * the option cache. */
+    struct SurfOptionRecord *replayOptPtr;
+			/* Options of the primitive being replayed. */
 } PathSurface;
 
-static Tcl_HashTable 	*surfaceHashPtr = NULL;
+/*
+ * A recording keeps the primitives drawn to a surface together with
+ * their parsed options so that they can be drawn again, to any surface
+ * of the interp and with any transform, without parsing them again.
+ */
+
+typedef struct SurfRecordedOp {
+    int objc;			/* The words of the primitive, the type first. */
+    Tcl_Obj **objv;		/* Has two more slots at the start that are
+				 * filled in when replayed. */
+    struct SurfOptionRecord *optPtr;
+} SurfRecordedOp;
+
+typedef struct PathRecording {
+    PathSurfaceState *statePtr;
+    Tcl_Interp *interp;
+    char *token;
+    Tcl_HashTable optionCache;	/* Owns the parsed options of the ops. */
+    SurfRecordedOp *ops;
+    int numOps;
+    int maxOps;
+} PathRecording;
 
 static int 	StaticSurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
 static int 	NamesSurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
@@ -27,9 +73,15 @@ static int 	NewSurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc
 static int 	SurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
 static int 	SurfaceCopyObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[]);
 static int 	SurfaceDestroyObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr);
+static int 	SurfaceDrawObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[]);
 static void	SurfaceDeletedProc(ClientData clientData);
 static int 	SurfaceCreateObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[]);
 static int 	SurfaceEraseObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[]);
+static int 	SurfaceWriteObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[]);
+static int 	SurfaceRecordObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[]);
+static int 	RecordingObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[]);
+static void	RecordingDeletedProc(ClientData clientData);
+static void	FreeRecording(PathRecording *recPtr);
 
 static int	SurfaceCreateEllipse(Tcl_Interp* interp, PathSurface *surfacePtr, int type, int objc, Tcl_Obj* CONST objv[]);
 static int	SurfaceCreatePath(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[]);
@@ -38,20 +90,40 @@ static int	SurfaceCreatePline(Tcl_Interp* interp, PathSurface *surfacePtr, int o
 static int	SurfaceCreatePpoly(Tcl_Interp* interp, PathSurface *surfacePtr, int type, int objc, Tcl_Obj* CONST objv[]);
 static int	SurfaceCreatePrect(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[]);
 static int	SurfaceCreatePtext(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[]);
-static void	SurfaceInitOptions(Tcl_Interp* interp);
+static void	SurfaceInitOptions(Tcl_Interp* interp, PathSurfaceState *statePtr);
 
-static int	uid = 0;
 static char	*kSurfaceNameBase = "tkp::surface";
+static char	*kRecordingNameBase = "tkp::recording";
+static char	*kSurfaceAssocKey = "tkpath::surface";
+
+/*
+ * The surface commands are deleted before this is called.
+ */
+
+static void
+SurfaceStateDeleteProc(ClientData clientData, Tcl_Interp *interp)
+{
+    PathSurfaceState *statePtr = (PathSurfaceState *) clientData;
+    
+    Tcl_DeleteHashTable(&statePtr->surfaceTable);
+    ckfree((char *) statePtr);
+}
 
 int
 SurfaceInit(Tcl_Interp *interp)
 {
-    surfaceHashPtr = (Tcl_HashTable *) ckalloc( sizeof(Tcl_HashTable) );
-    Tcl_InitHashTable(surfaceHashPtr, TCL_STRING_KEYS);
+    PathSurfaceState *statePtr;
+    
+    statePtr = (PathSurfaceState *) ckalloc(sizeof(PathSurfaceState));
+    Tcl_InitHashTable(&statePtr->surfaceTable, TCL_STRING_KEYS);
+    statePtr->uid = 0;
+    statePtr->recordingUid = 0;
+    Tcl_SetAssocData(interp, kSurfaceAssocKey, SurfaceStateDeleteProc, 
+            (ClientData) statePtr);
 
     Tcl_CreateObjCommand(interp, "::tkp::surface",
-            StaticSurfaceObjCmd, (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
-    SurfaceInitOptions(interp);
+            StaticSurfaceObjCmd, (ClientData) statePtr, (Tcl_CmdDeleteProc *) NULL);
+    SurfaceInitOptions(interp, statePtr);
     return TCL_OK;
 }
 
@@ -94,6 +166,7 @@ StaticSurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj
 static int 	
 NamesSurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 {
+    PathSurfaceState *statePtr = (PathSurfaceState *) clientData;
     char	    *name;
     Tcl_HashEntry   *hPtr;
     Tcl_Obj	    *listObj;
@@ -104,9 +177,9 @@ NamesSurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj*
         return TCL_ERROR;
     }
     listObj = Tcl_NewListObj(0, NULL);
-    hPtr = Tcl_FirstHashEntry(surfaceHashPtr, &search);
+    hPtr = Tcl_FirstHashEntry(&statePtr->surfaceTable, &search);
     while (hPtr != NULL) {
-        name = (char *) Tcl_GetHashKey(surfaceHashPtr, hPtr);
+        name = (char *) Tcl_GetHashKey(&statePtr->surfaceTable, hPtr);
         Tcl_ListObjAppendElement(interp, listObj, Tcl_NewStringObj(name, -1));
         hPtr = Tcl_NextHashEntry(&search);
     }
@@ -117,6 +190,7 @@ NamesSurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj*
 static int 
 NewSurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
 {
+    PathSurfaceState *statePtr = (PathSurfaceState *) clientData;
     TkPathContext   ctx;
     PathSurface	    *surfacePtr;
     Tcl_HashEntry   *hPtr;
@@ -142,16 +216,21 @@ NewSurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* C
         return TCL_ERROR;
     }
 
-    sprintf(str, "%s%d", kSurfaceNameBase, uid++);
+    sprintf(str, "%s%d", kSurfaceNameBase, statePtr->uid++);
     surfacePtr = (PathSurface *) ckalloc( sizeof(PathSurface) );
     surfacePtr->token = (char *) ckalloc( (unsigned int)strlen(str) + 1 );
     strcpy(surfacePtr->token, str);
+    surfacePtr->statePtr = statePtr;
     surfacePtr->ctx = ctx;
     surfacePtr->width = width;
     surfacePtr->height = height;
+    surfacePtr->optionCachePtr = NULL;
+    surfacePtr->recordingPtr = NULL;
+    surfacePtr->lastOptPtr = NULL;
+    surfacePtr->replayOptPtr = NULL;
     Tcl_CreateObjCommand(interp, str, SurfaceObjCmd, (ClientData) surfacePtr, SurfaceDeletedProc);
 
-    hPtr = Tcl_CreateHashEntry(surfaceHashPtr, str, &isNew);
+    hPtr = Tcl_CreateHashEntry(&statePtr->surfaceTable, str, &isNew);
     Tcl_SetHashValue(hPtr, surfacePtr);
     Tcl_SetObjResult(interp, Tcl_NewStringObj(str, -1));
     return result;
@@ -159,7 +238,8 @@ NewSurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* C
 
 static CONST char *surfaceCmds[] = {
     "copy", 	"create", 	"destroy", 
-    "erase", 	"height", 	"width",
+    "draw",	"erase", 	"height", 	
+    "record",	"width",	"write",
     (char *) NULL
 };
 
@@ -167,9 +247,12 @@ enum {
     kPathSurfaceCmdCopy		= 0L,
     kPathSurfaceCmdCreate,
     kPathSurfaceCmdDestroy,
+    kPathSurfaceCmdDraw,
     kPathSurfaceCmdErase,
     kPathSurfaceCmdHeight,
-    kPathSurfaceCmdWidth
+    kPathSurfaceCmdRecord,
+    kPathSurfaceCmdWidth,
+    kPathSurfaceCmdWrite
 };
 
 static int 
@@ -200,6 +283,10 @@ SurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONS
             result = SurfaceDestroyObjCmd(interp, surfacePtr);
             break;
         }
+        case kPathSurfaceCmdDraw: {
+            result = SurfaceDrawObjCmd(interp, surfacePtr, objc, objv);
+            break;
+        }
         case kPathSurfaceCmdErase: {
             result = SurfaceEraseObjCmd(interp, surfacePtr, objc, objv);
             break;
@@ -214,17 +301,57 @@ SurfaceObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONS
                     (index == kPathSurfaceCmdHeight) ? surfacePtr->height : surfacePtr->width));
             break;
         }
+        case kPathSurfaceCmdRecord: {
+            result = SurfaceRecordObjCmd(interp, surfacePtr, objc, objv);
+            break;
+        }
+        case kPathSurfaceCmdWrite: {
+            result = SurfaceWriteObjCmd(interp, surfacePtr, objc, objv);
+            break;
+        }
     }    
     return result;
 }
 
+/*
+ * Parses a {x1 y1 x2 y2} region and clips it to the surface. 
+ * An empty region gets x2 <= x1 or y2 <= y1.
+ */
+
+static int
+GetSurfaceRegion(Tcl_Interp* interp, PathSurface *surfacePtr, Tcl_Obj *regionObj, int r[4])
+{
+    Tcl_Obj **rectv;
+    int i, rectc;
+
+    if (Tcl_ListObjGetElements(interp, regionObj, &rectc, &rectv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (rectc != 4) {
+        Tcl_AppendResult(interp, "region \"", Tcl_GetString(regionObj), 
+                "\" is inconsistent", (char *) NULL);
+        return TCL_ERROR;
+    }
+    for (i = 0; i < 4; i++) {
+        if (Tcl_GetIntFromObj(interp, rectv[i], &r[i]) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+    r[0] = MAX(0, r[0]);
+    r[1] = MAX(0, r[1]);
+    r[2] = MIN(surfacePtr->width, r[2]);
+    r[3] = MIN(surfacePtr->height, r[3]);
+    return TCL_OK;
+}
+
 static int 
 SurfaceCopyObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[])
 {
     Tk_PhotoHandle photo;
+    int r[4];
     
-    if (objc != 3) {
-        Tcl_WrongNumArgs(interp, 2, objv, "image");
+    if ((objc != 3) && ((objc != 5) || strcmp(Tcl_GetString(objv[3]), "-region"))) {
+        Tcl_WrongNumArgs(interp, 2, objv, "image ?-region {x1 y1 x2 y2}?");
         return TCL_ERROR;
     }
     photo = Tk_FindPhoto( interp, Tcl_GetString(objv[2]) );
@@ -232,11 +359,77 @@ SurfaceCopyObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj
         Tcl_SetObjResult(interp, Tcl_NewStringObj("didn't find that image", -1));
         return TCL_ERROR;
     }
-    TkPathSurfaceToPhoto(interp, surfacePtr->ctx, photo);
+    r[0] = r[1] = 0;
+    r[2] = surfacePtr->width;
+    r[3] = surfacePtr->height;
+    if ((objc == 5) && (GetSurfaceRegion(interp, surfacePtr, objv[4], r) != TCL_OK)) {
+        return TCL_ERROR;
+    }
+    if ((r[2] > r[0]) && (r[3] > r[1])) {
+        TkPathSurfaceToPhoto(interp, surfacePtr->ctx, photo, 
+                r[0], r[1], r[2] - r[0], r[3] - r[1]);
+    }
     Tcl_SetObjResult(interp, objv[2]);
     return TCL_OK;
 }
 
+static CONST char *surfaceWriteFormats[] = {
+    "png", (char *) NULL
+};
+
+static CONST char *surfaceWriteOptions[] = {
+    "-channel", "-region", (char *) NULL
+};
+
+enum {
+    kPathSurfaceWriteChannel	= 0L,
+    kPathSurfaceWriteRegion
+};
+
+static int 
+SurfaceWriteObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[])
+{
+    Tcl_Channel chan = NULL;
+    int i, index, mode, r[4];
+    
+    if ((objc < 3) || (objc % 2 == 0)) {
+        Tcl_WrongNumArgs(interp, 2, objv, "png ?-channel channelId? ?-region {x1 y1 x2 y2}?");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[2], surfaceWriteFormats, "format", 0,
+            &index) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    r[0] = r[1] = 0;
+    r[2] = surfacePtr->width;
+    r[3] = surfacePtr->height;
+    for (i = 3; i < objc; i += 2) {
+        if (Tcl_GetIndexFromObj(interp, objv[i], surfaceWriteOptions, "option", 0,
+                &index) != TCL_OK) {
+            return TCL_ERROR;
+        }
+        if (index == kPathSurfaceWriteChannel) {
+            chan = Tcl_GetChannel(interp, Tcl_GetString(objv[i+1]), &mode);
+            if (chan == NULL) {
+                return TCL_ERROR;
+            }
+            if (!(mode & TCL_WRITABLE)) {
+                Tcl_AppendResult(interp, "channel \"", Tcl_GetString(objv[i+1]),
+                        "\" wasn't opened for writing", (char *) NULL);
+                return TCL_ERROR;
+            }
+        } else if (GetSurfaceRegion(interp, surfacePtr, objv[i+1], r) != TCL_OK) {
+            return TCL_ERROR;
+        }
+    }
+    if ((r[2] <= r[0]) || (r[3] <= r[1])) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("region is empty", -1));
+        return TCL_ERROR;
+    }
+    return TkPathSurfaceToPng(interp, surfacePtr->ctx, chan, 
+            r[0], r[1], r[2] - r[0], r[3] - r[1]);
+}
+
 static int 
 SurfaceDestroyObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr)
 {
@@ -250,10 +443,13 @@ SurfaceDeletedProc(ClientData clientData)
     PathSurface *surfacePtr = (PathSurface *) clientData;
     Tcl_HashEntry *hPtr;
 
-    hPtr = Tcl_FindHashEntry(surfaceHashPtr, surfacePtr->token);
+    hPtr = Tcl_FindHashEntry(&surfacePtr->statePtr->surfaceTable, surfacePtr->token);
     if (hPtr != NULL) {
         Tcl_DeleteHashEntry(hPtr);
     }
+    if (surfacePtr->recordingPtr != NULL) {
+        FreeRecording(surfacePtr->recordingPtr);
+    }
     TkPathFree(surfacePtr->ctx);
     ckfree(surfacePtr->token);
     ckfree((char *)surfacePtr);
@@ -294,6 +490,7 @@ SurfaceCreateObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_O
             &index) != TCL_OK) {
         return TCL_ERROR;
     }
+    surfacePtr->lastOptPtr = NULL;
 
     switch (index) {
         case kPathSurfaceItemCircle:
@@ -327,18 +524,31 @@ SurfaceCreateObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_O
             break;
         }
     }
+    if ((result == TCL_OK) && (surfacePtr->recordingPtr != NULL)) {
+        PathRecording *recPtr = surfacePtr->recordingPtr;
+        SurfRecordedOp *opPtr;
+        int i;
+        
+        if (recPtr->numOps == recPtr->maxOps) {
+            recPtr->maxOps = (recPtr->maxOps == 0) ? 16 : 2*recPtr->maxOps;
+            recPtr->ops = (SurfRecordedOp *) ckrealloc((char *) recPtr->ops, 
+                    recPtr->maxOps*sizeof(SurfRecordedOp));
+        }
+        opPtr = recPtr->ops + recPtr->numOps++;
+        opPtr->objc = objc - 2;
+        opPtr->objv = (Tcl_Obj **) ckalloc(objc*sizeof(Tcl_Obj *));
+        opPtr->objv[0] = opPtr->objv[1] = NULL;
+        for (i = 2; i < objc; i++) {
+            opPtr->objv[i] = objv[i];
+            Tcl_IncrRefCount(objv[i]);
+        }
+        opPtr->optPtr = surfacePtr->lastOptPtr;
+    }
     return result;
 }
 
-static Tk_OptionTable 	gOptionTableCircle;
-static Tk_OptionTable 	gOptionTableEllipse;
-static Tk_OptionTable 	gOptionTablePath;
-static Tk_OptionTable 	gOptionTablePimage;
-static Tk_OptionTable 	gOptionTablePline;
-static Tk_OptionTable 	gOptionTablePolyline;
-static Tk_OptionTable 	gOptionTablePpolygon;
-static Tk_OptionTable 	gOptionTablePrect;
-static Tk_OptionTable 	gOptionTablePtext;
+#define SurfaceOptionTable(surfacePtr, type) \
+    ((surfacePtr)->statePtr->optionTables[type])
 
 PATH_STYLE_CUSTOM_OPTION_RECORDS
 
@@ -422,8 +632,6 @@ GetTwoPointsCoords(Tcl_Interp *interp, double *pointsPtr, int objc, Tcl_Obj *CON
 static int
 MakePolyAtoms(Tcl_Interp *interp, int closed, int objc, Tcl_Obj *CONST objv[], PathAtom **atomPtrPtr)
 {
-    PathAtom *atomPtr = NULL;
-
     if (objc == 1) {
         if (Tcl_ListObjGetElements(interp, objv[0], &objc,
             (Tcl_Obj ***) &objv) != TCL_OK) {
@@ -440,28 +648,33 @@ MakePolyAtoms(Tcl_Interp *interp, int closed, int objc, Tcl_Obj *CONST objv[], P
         int 	i;
         double	x, y;
         double	firstX = 0.0, firstY = 0.0;
-        PathAtom *firstAtomPtr = NULL;
+        PathAtomBuffer atoms;
+        LineToAtom *linePtr;
+        CloseAtom *closePtr;
 
+        TkPathAtomBufferInit(&atoms, objc/2 + 1);
         for (i = 0; i < objc; i += 2) {
             if ((Tcl_GetDoubleFromObj(interp, objv[i], &x) != TCL_OK)
                     || (Tcl_GetDoubleFromObj(interp, objv[i+1], &y) != TCL_OK)) {
-                TkPathFreeAtoms(atomPtr);
+                TkPathAtomBufferFree(&atoms);
                 return TCL_ERROR;
             }
+            /* MoveToAtom has the same layout as LineToAtom. */
+            linePtr = (LineToAtom *) TkPathAtomBufferAlloc(&atoms,
+                    (i == 0) ? PATH_ATOM_M : PATH_ATOM_L);
+            linePtr->x = x;
+            linePtr->y = y;
             if (i == 0) {
                 firstX = x;
                 firstY = y;
-                atomPtr = NewMoveToAtom(x, y);
-                firstAtomPtr = atomPtr;
-            } else {
-                atomPtr->nextPtr = NewLineToAtom(x, y);
-                atomPtr = atomPtr->nextPtr;
             }
         }
         if (closed) {
-            atomPtr->nextPtr = NewCloseAtom(firstX, firstY);
+            closePtr = (CloseAtom *) TkPathAtomBufferAlloc(&atoms, PATH_ATOM_Z);
+            closePtr->x = firstX;
+            closePtr->y = firstY;
         }
-        *atomPtrPtr = firstAtomPtr;
+        *atomPtrPtr = TkPathAtomBufferFinish(&atoms);
     }
     return TCL_OK;
 }
@@ -479,20 +692,127 @@ GetFirstOptionIndex(int objc, Tcl_Obj* CONST objv[])
     return i;
 }
 
+/*
+ * While a 'draw' command list is drawn the parsed option records are
+ * kept in the surface's option cache, keyed by the option table and the
+ * option words. Primitives with identical options then share a record
+ * which is freed when the list is done.
+ */
+
+typedef struct SurfOptionRecord {
+    Tk_OptionTable table;
+    char *recordPtr;
+    int styleOffset;		/* Offset of Tk_PathStyle in record, or -1. */
+} SurfOptionRecord;
+
+/*
+ * The option cache may outlive a gradient used as fill, so let go of it
+ * when it is deleted, just like the styles do.
+ */
+
+static void
+SurfaceGradientProc(ClientData clientData, int flags)
+{
+    Tk_PathStyle *stylePtr = (Tk_PathStyle *) clientData;
+    
+    if (flags & PATH_GRADIENT_FLAG_DELETE) {
+        TkPathFreePathColor(stylePtr->fill);
+        stylePtr->fill = NULL;
+    }
+}
+
+/*
+ * Parses the options into the record and resolves any fill of the style
+ * in it. Free with SurfaceFreeOptions also on error.
+ */
+
 static int
-SurfaceParseOptions(Tcl_Interp *interp, char *recordPtr, 
-        Tk_OptionTable table, int objc, Tcl_Obj* CONST objv[])
+SurfaceParseOptions(Tcl_Interp *interp, PathSurface *surfacePtr, 
+        char *recordPtr, int size, Tk_OptionTable table, Tk_PathStyle *stylePtr,
+        int objc, Tcl_Obj* CONST objv[])
 {
     Tk_Window tkwin = Tk_MainWindow(interp);    
+    Tcl_HashEntry *hPtr = NULL;
+    SurfOptionRecord *optPtr = NULL;
+    Tcl_DString ds;
+    char str[64];
+    int i, isNew;
+    
+    if (surfacePtr->replayOptPtr != NULL) {
+        memcpy(recordPtr, surfacePtr->replayOptPtr->recordPtr, size);
+        return TCL_OK;
+    }
+    if (surfacePtr->optionCachePtr != NULL) {
+        Tcl_DStringInit(&ds);
+        sprintf(str, "%p", (void *) table);
+        Tcl_DStringAppend(&ds, str, -1);
+        for (i = 0; i < objc; i++) {
+            Tcl_DStringAppendElement(&ds, Tcl_GetString(objv[i]));
+        }
+        hPtr = Tcl_CreateHashEntry(surfacePtr->optionCachePtr, Tcl_DStringValue(&ds), &isNew);
+        Tcl_DStringFree(&ds);
+        if (!isNew) {
+            optPtr = (SurfOptionRecord *) Tcl_GetHashValue(hPtr);
+            memcpy(recordPtr, optPtr->recordPtr, size);
+            surfacePtr->lastOptPtr = optPtr;
+            return TCL_OK;
+        }
+        optPtr = (SurfOptionRecord *) ckalloc(sizeof(SurfOptionRecord));
+        optPtr->table = table;
+        optPtr->recordPtr = ckalloc(size);
+        optPtr->styleOffset = (stylePtr != NULL) ? (int) ((char *) stylePtr - recordPtr) : -1;
+    }
     if (Tk_InitOptions(interp, recordPtr, table, tkwin) != TCL_OK) {
-        return TCL_ERROR;
+        goto error;
     }
     if (Tk_SetOptions(interp, recordPtr, table, 	
             objc, objv, tkwin, NULL, NULL) != TCL_OK) {
         Tk_FreeConfigOptions(recordPtr, table, tkwin);
-        return TCL_ERROR;
+        goto error;
+    }
+    if ((stylePtr != NULL) && (stylePtr->fillObj != NULL)) {
+        if (optPtr != NULL) {
+            stylePtr->fill = TkPathGetPathColor(interp, tkwin, stylePtr->fillObj, 
+                    TkPathGradientTable(), SurfaceGradientProc, 
+                    (ClientData) (optPtr->recordPtr + optPtr->styleOffset));
+        } else {
+            stylePtr->fill = TkPathGetPathColorStatic(interp, tkwin, stylePtr->fillObj);
+        }
+	if (stylePtr->fill == NULL) {
+            if (hPtr != NULL) {
+                Tk_FreeConfigOptions(recordPtr, table, tkwin);
+            }
+	    goto error;
+	}
+    }
+    if (hPtr != NULL) {
+        memcpy(optPtr->recordPtr, recordPtr, size);
+        Tcl_SetHashValue(hPtr, optPtr);
+        surfacePtr->lastOptPtr = optPtr;
     }
     return TCL_OK;
+    
+error:
+    if (hPtr != NULL) {
+        Tcl_DeleteHashEntry(hPtr);
+        ckfree(optPtr->recordPtr);
+        ckfree((char *) optPtr);
+    }
+    return TCL_ERROR;
+}
+
+static void
+SurfaceFreeOptions(Tcl_Interp *interp, PathSurface *surfacePtr, 
+        char *recordPtr, Tk_OptionTable table, Tk_PathStyle *stylePtr)
+{
+    /* The option cache owns the record. */
+    if (surfacePtr->optionCachePtr != NULL) {
+        return;
+    }
+    if (stylePtr != NULL) {
+        TkPathDeleteStyle(stylePtr);
+    }
+    Tk_FreeConfigOptions(recordPtr, table, Tk_MainWindow(interp));
 }
 
 typedef struct SurfEllipseItem {
@@ -543,19 +863,12 @@ SurfaceCreateEllipse(Tcl_Interp* interp, PathSurface *surfacePtr, int type, int
     if (GetPointCoords(interp, center, i-3, objv+3) != TCL_OK) {
         goto bail;
     }
-    if (SurfaceParseOptions(interp, (char *)&ellipse, 
-            (type == kPathSurfaceItemCircle) ? gOptionTableCircle : gOptionTableEllipse, 
-            objc-i, objv+i) != TCL_OK) {
+    if (SurfaceParseOptions(interp, surfacePtr, (char *)&ellipse, sizeof(ellipse),
+            SurfaceOptionTable(surfacePtr, type), 
+            style, objc-i, objv+i) != TCL_OK) {
         result = TCL_ERROR;
         goto bail;
     }
-    if (style->fillObj != NULL) {
-	style->fill = TkPathGetPathColorStatic(interp, Tk_MainWindow(interp), style->fillObj);
-	if (style->fill == NULL) {
-	    result = TCL_ERROR;
-	    goto bail;	
-	}
-    }
     
     /*
      * NB: We *copy* the style for temp usage.
@@ -587,10 +900,9 @@ SurfaceCreateEllipse(Tcl_Interp* interp, PathSurface *surfacePtr, int type, int
     TkPathRestoreState(context);
 
 bail:
-    TkPathDeleteStyle(&ellipse.style);
-    Tk_FreeConfigOptions((char *)&ellipse, 
-	    (type == kPathSurfaceItemCircle) ? gOptionTableCircle : gOptionTableEllipse,
-	    Tk_MainWindow(interp));
+    SurfaceFreeOptions(interp, surfacePtr, (char *)&ellipse, 
+	    SurfaceOptionTable(surfacePtr, type),
+	    style);
     return result;
 }
 
@@ -619,17 +931,11 @@ SurfaceCreatePath(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj
     if (TkPathParseToAtoms(interp, objv[3], &atomPtr, &len) != TCL_OK) {
         return TCL_ERROR;
     }
-    if (SurfaceParseOptions(interp, (char *)&item, gOptionTablePath, objc-4, objv+4) != TCL_OK) {
+    if (SurfaceParseOptions(interp, surfacePtr, (char *)&item, sizeof(item), 
+            SurfaceOptionTable(surfacePtr, kPathSurfaceItemPath), style, objc-4, objv+4) != TCL_OK) {
         result = TCL_ERROR;
         goto bail;
     }
-    if (style->fillObj != NULL) {
-	style->fill = TkPathGetPathColorStatic(interp, Tk_MainWindow(interp), style->fillObj);
-	if (style->fill == NULL) {
-	    result = TCL_ERROR;
-	    goto bail;	
-	}
-    }
     mergedStyle = item.style;
     if (TkPathStyleMergeStyleStatic(interp, item.styleObj, &mergedStyle, 0) != TCL_OK) {
         result = TCL_ERROR;
@@ -645,10 +951,9 @@ SurfaceCreatePath(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj
     TkPathPaintPath(context, atomPtr, &mergedStyle, &bbox);
     
 bail:
-    TkPathDeleteStyle(style);
     TkPathFreeAtoms(atomPtr);
     TkPathRestoreState(context);
-    Tk_FreeConfigOptions((char *)&item, gOptionTablePath, Tk_MainWindow(interp));
+    SurfaceFreeOptions(interp, surfacePtr, (char *)&item, SurfaceOptionTable(surfacePtr, kPathSurfaceItemPath), style);
     return result;
 }
 
@@ -694,7 +999,8 @@ SurfaceCreatePimage(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_O
     if (GetPointCoords(interp, point, i-3, objv+3) != TCL_OK) {
         return TCL_ERROR;
     }
-    if (SurfaceParseOptions(interp, (char *)&item, gOptionTablePimage, objc-i, objv+i) != TCL_OK) {
+    if (SurfaceParseOptions(interp, surfacePtr, (char *)&item, sizeof(item), 
+            SurfaceOptionTable(surfacePtr, kPathSurfaceItemPimage), NULL, objc-i, objv+i) != TCL_OK) {
         return TCL_ERROR;
     }    
     style.matrixPtr = item.matrixPtr;
@@ -714,12 +1020,15 @@ SurfaceCreatePimage(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_O
         TkPathPushTMatrix(context, style.matrixPtr);
         TkPathImage(context, image, photo, point[0], point[1], item.width, item.height, style.fillOpacity,
                 NULL, 0.0, 99, NULL);
+        
+        /* We get no notice when the photo changes so don't keep it cached. */
+        TkPathImageChanged(photo);
         Tk_FreeImage(image);
         TkPathRestoreState(context);
     }
 
 bail:
-    Tk_FreeConfigOptions((char *)&item, gOptionTablePimage, Tk_MainWindow(interp));
+    SurfaceFreeOptions(interp, surfacePtr, (char *)&item, SurfaceOptionTable(surfacePtr, kPathSurfaceItemPimage), NULL);
     return result;
 }
 
@@ -748,7 +1057,8 @@ SurfaceCreatePline(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Ob
     if (GetTwoPointsCoords(interp, points, i-3, objv+3) != TCL_OK) {
         return TCL_ERROR;
     }
-    if (SurfaceParseOptions(interp, (char *)&item, gOptionTablePline, objc-i, objv+i) != TCL_OK) {
+    if (SurfaceParseOptions(interp, surfacePtr, (char *)&item, sizeof(item), 
+            SurfaceOptionTable(surfacePtr, kPathSurfaceItemPline), &item.style, objc-i, objv+i) != TCL_OK) {
         return TCL_ERROR;
     }
     mergedStyle = item.style;
@@ -768,10 +1078,9 @@ SurfaceCreatePline(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Ob
     TkPathPaintPath(context, atomPtr, &mergedStyle, &bbox);
     
 bail:
-    TkPathDeleteStyle(&item.style);
     TkPathFreeAtoms(atomPtr);
     TkPathRestoreState(context);
-    Tk_FreeConfigOptions((char *)&item, gOptionTablePline, Tk_MainWindow(interp));
+    SurfaceFreeOptions(interp, surfacePtr, (char *)&item, SurfaceOptionTable(surfacePtr, kPathSurfaceItemPline), &item.style);
     return result;
 }
 
@@ -809,19 +1118,12 @@ SurfaceCreatePpoly(Tcl_Interp* interp, PathSurface *surfacePtr, int type, int ob
             i-3, objv+3, &atomPtr) != TCL_OK) {
         return TCL_ERROR;
     }
-    if (SurfaceParseOptions(interp, (char *)&item, 
-            (type == kPathSurfaceItemPolyline) ? gOptionTablePolyline : gOptionTablePpolygon, 
-            objc-i, objv+i) != TCL_OK) {
+    if (SurfaceParseOptions(interp, surfacePtr, (char *)&item, sizeof(item),
+            SurfaceOptionTable(surfacePtr, type), 
+            style, objc-i, objv+i) != TCL_OK) {
         result = TCL_ERROR;
         goto bail;
     }
-    if (style->fillObj != NULL) {
-	style->fill = TkPathGetPathColorStatic(interp, Tk_MainWindow(interp), style->fillObj);
-	if (style->fill == NULL) {
-	    result = TCL_ERROR;
-	    goto bail;	
-	}
-    }
     mergedStyle = item.style;
     if (TkPathStyleMergeStyleStatic(interp, item.styleObj, &mergedStyle, 0) != TCL_OK) {
         result = TCL_ERROR;
@@ -837,12 +1139,11 @@ SurfaceCreatePpoly(Tcl_Interp* interp, PathSurface *surfacePtr, int type, int ob
     TkPathPaintPath(context, atomPtr, &mergedStyle, &bbox);
     
 bail:
-    TkPathDeleteStyle(style);
     TkPathFreeAtoms(atomPtr);
     TkPathRestoreState(context);
-    Tk_FreeConfigOptions((char *)&item, 
-	    (type == kPathSurfaceItemPolyline) ? gOptionTablePolyline : gOptionTablePpolygon, 
-	    Tk_MainWindow(interp));
+    SurfaceFreeOptions(interp, surfacePtr, (char *)&item, 
+	    SurfaceOptionTable(surfacePtr, type), 
+	    style);
     return result;
 }
 
@@ -881,17 +1182,11 @@ SurfaceCreatePrect(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Ob
     if (GetTwoPointsCoords(interp, points, i-3, objv+3) != TCL_OK) {
         return TCL_ERROR;
     }
-    if (SurfaceParseOptions(interp, (char *)&prect, gOptionTablePrect, objc-i, objv+i) != TCL_OK) {
+    if (SurfaceParseOptions(interp, surfacePtr, (char *)&prect, sizeof(prect), 
+            SurfaceOptionTable(surfacePtr, kPathSurfaceItemPrect), style, objc-i, objv+i) != TCL_OK) {
         result = TCL_ERROR;
         goto bail;
     }
-    if (style->fillObj != NULL) {
-	style->fill = TkPathGetPathColorStatic(interp, Tk_MainWindow(interp), style->fillObj);
-	if (style->fill == NULL) {
-	    result = TCL_ERROR;
-	    goto bail;	
-	}
-    }
     mergedStyle = prect.style;
     if (TkPathStyleMergeStyleStatic(interp, prect.styleObj, &mergedStyle, 0) != TCL_OK) {
         result = TCL_ERROR;
@@ -910,10 +1205,9 @@ SurfaceCreatePrect(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Ob
     TkPathPaintPath(context, atomPtr, &mergedStyle, &bbox);
     
 bail:
-    TkPathDeleteStyle(&prect.style);
     TkPathFreeAtoms(atomPtr);
     TkPathRestoreState(context);
-    Tk_FreeConfigOptions((char *)&prect, gOptionTablePrect, Tk_MainWindow(interp));
+    SurfaceFreeOptions(interp, surfacePtr, (char *)&prect, SurfaceOptionTable(surfacePtr, kPathSurfaceItemPrect), style);
     return result;
 }
 
@@ -972,17 +1266,11 @@ SurfaceCreatePtext(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Ob
     if (GetPointCoords(interp, point, i-3, objv+3) != TCL_OK) {
         return TCL_ERROR;
     }
-    if (SurfaceParseOptions(interp, (char *)&item, gOptionTablePtext, objc-i, objv+i) != TCL_OK) {
+    if (SurfaceParseOptions(interp, surfacePtr, (char *)&item, sizeof(item), 
+            SurfaceOptionTable(surfacePtr, kPathSurfaceItemPtext), style, objc-i, objv+i) != TCL_OK) {
         result = TCL_ERROR;
         goto bail;
     }
-    if (style->fillObj != NULL) {
-	style->fill = TkPathGetPathColorStatic(interp, Tk_MainWindow(interp), style->fillObj);
-	if (style->fill == NULL) {
-	    result = TCL_ERROR;
-	    goto bail;	
-	}
-    }
     if (TkPathTextConfig(interp, &item.textStyle, item.utf8, &custom) != TCL_OK) {
         result = TCL_ERROR;
         goto bail;
@@ -1009,24 +1297,328 @@ SurfaceCreatePtext(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Ob
     TkPathTextFree(&item.textStyle, custom);
     
 bail:
-    TkPathDeleteStyle(style);
     TkPathRestoreState(context);
-    Tk_FreeConfigOptions((char *)&item, gOptionTablePtext, Tk_MainWindow(interp));
+    SurfaceFreeOptions(interp, surfacePtr, (char *)&item, SurfaceOptionTable(surfacePtr, kPathSurfaceItemPtext), style);
+    return result;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * SurfaceDrawObjCmd --
+ *
+ *	Draws a list of primitives, each given as the arguments to
+ *	'create', in one go. The parsed options are shared by all
+ *	primitives with identical options.
+ *
+ * Results:
+ *	A standard Tcl result. Drawing stops at the first primitive
+ *	that fails.
+ *
+ * Side effects:
+ *	Draws into the surface.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+FreeOptionCache(Tcl_HashTable *cachePtr, Tk_Window tkwin)
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    SurfOptionRecord *optPtr;
+
+    hPtr = Tcl_FirstHashEntry(cachePtr, &search);
+    while (hPtr != NULL) {
+        optPtr = (SurfOptionRecord *) Tcl_GetHashValue(hPtr);
+        if (optPtr->styleOffset >= 0) {
+            TkPathDeleteStyle((Tk_PathStyle *) (optPtr->recordPtr + optPtr->styleOffset));
+        }
+        Tk_FreeConfigOptions(optPtr->recordPtr, optPtr->table, tkwin);
+        ckfree(optPtr->recordPtr);
+        ckfree((char *) optPtr);
+        hPtr = Tcl_NextHashEntry(&search);
+    }
+    Tcl_DeleteHashTable(cachePtr);
+}
+
+static int 
+SurfaceDrawObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[])
+{
+    Tcl_HashTable cache;
+    Tcl_Obj **cmdv, **wordv, **argv = NULL;
+    char msg[64];
+    int i, cmdc, wordc, argc = 0;
+    int result = TCL_OK;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "commandList");
+        return TCL_ERROR;
+    }
+    if (Tcl_ListObjGetElements(interp, objv[2], &cmdc, &cmdv) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    
+    /* A recording keeps its own cache. */
+    if (surfacePtr->recordingPtr == NULL) {
+        Tcl_InitHashTable(&cache, TCL_STRING_KEYS);
+        surfacePtr->optionCachePtr = &cache;
+    }
+    
+    for (i = 0; i < cmdc; i++) {
+        if (Tcl_ListObjGetElements(interp, cmdv[i], &wordc, &wordv) != TCL_OK) {
+            result = TCL_ERROR;
+            break;
+        }
+        
+        /* Pass it on as if it were '$surface create ...'. */
+        if (wordc + 2 > argc) {
+            argc = 2*(wordc + 2);
+            argv = (Tcl_Obj **) ckrealloc((char *) argv, argc*sizeof(Tcl_Obj *));
+        }
+        argv[0] = objv[0];
+        argv[1] = objv[1];
+        memcpy(argv + 2, wordv, wordc*sizeof(Tcl_Obj *));
+        result = SurfaceCreateObjCmd(interp, surfacePtr, wordc + 2, argv);
+        if (result != TCL_OK) {
+            break;
+        }
+    }
+    if (result != TCL_OK) {
+        sprintf(msg, "\n    (drawing primitive %d)", i);
+        Tcl_AddErrorInfo(interp, msg);
+    } else {
+        Tcl_ResetResult(interp);
+    }
+    
+    if (surfacePtr->recordingPtr == NULL) {
+        surfacePtr->optionCachePtr = NULL;
+        FreeOptionCache(&cache, Tk_MainWindow(interp));
+    }
+    if (argv != NULL) {
+        ckfree((char *) argv);
+    }
+    return result;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * SurfaceRecordObjCmd --
+ *
+ *	Implements '$surface record begin|end'. Between the two all
+ *	primitives drawn with 'create' or 'draw' are also recorded.
+ *
+ * Results:
+ *	A standard Tcl result. 'end' returns the token of the recording
+ *	which is a new command.
+ *
+ * Side effects:
+ *	Keeps the parsed options of the primitives alive until the
+ *	recording is destroyed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static CONST char *surfaceRecordCmds[] = {
+    "begin", "end", (char *) NULL
+};
+
+enum {
+    kPathSurfaceRecordBegin	= 0L,
+    kPathSurfaceRecordEnd
+};
+
+static int 
+SurfaceRecordObjCmd(Tcl_Interp* interp, PathSurface *surfacePtr, int objc, Tcl_Obj* CONST objv[])
+{
+    PathSurfaceState *statePtr = surfacePtr->statePtr;
+    PathRecording *recPtr = surfacePtr->recordingPtr;
+    char str[255];
+    int index;
+
+    if (objc != 3) {
+        Tcl_WrongNumArgs(interp, 2, objv, "begin|end");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[2], surfaceRecordCmds, "command", 0,
+            &index) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (index == kPathSurfaceRecordBegin) {
+        if (recPtr != NULL) {
+            Tcl_SetObjResult(interp, Tcl_NewStringObj("surface is already recording", -1));
+            return TCL_ERROR;
+        }
+        recPtr = (PathRecording *) ckalloc(sizeof(PathRecording));
+        recPtr->statePtr = statePtr;
+        recPtr->interp = interp;
+        recPtr->token = NULL;
+        Tcl_InitHashTable(&recPtr->optionCache, TCL_STRING_KEYS);
+        recPtr->ops = NULL;
+        recPtr->numOps = 0;
+        recPtr->maxOps = 0;
+        surfacePtr->recordingPtr = recPtr;
+        surfacePtr->optionCachePtr = &recPtr->optionCache;
+        return TCL_OK;
+    }
+    if (recPtr == NULL) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj("surface is not recording", -1));
+        return TCL_ERROR;
+    }
+    surfacePtr->recordingPtr = NULL;
+    surfacePtr->optionCachePtr = NULL;
+    sprintf(str, "%s%d", kRecordingNameBase, statePtr->recordingUid++);
+    recPtr->token = (char *) ckalloc((unsigned int) strlen(str) + 1);
+    strcpy(recPtr->token, str);
+    Tcl_CreateObjCommand(interp, str, RecordingObjCmd, (ClientData) recPtr, 
+            RecordingDeletedProc);
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(str, -1));
+    return TCL_OK;
+}
+
+static void
+FreeRecording(PathRecording *recPtr)
+{
+    SurfRecordedOp *opPtr;
+    int i;
+    
+    for (opPtr = recPtr->ops; opPtr < recPtr->ops + recPtr->numOps; opPtr++) {
+        for (i = 2; i < opPtr->objc + 2; i++) {
+            Tcl_DecrRefCount(opPtr->objv[i]);
+        }
+        ckfree((char *) opPtr->objv);
+    }
+    if (recPtr->ops != NULL) {
+        ckfree((char *) recPtr->ops);
+    }
+    FreeOptionCache(&recPtr->optionCache, Tk_MainWindow(recPtr->interp));
+    if (recPtr->token != NULL) {
+        ckfree(recPtr->token);
+    }
+    ckfree((char *) recPtr);
+}
+
+static void
+RecordingDeletedProc(ClientData clientData)
+{
+    FreeRecording((PathRecording *) clientData);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * RecordingObjCmd --
+ *
+ *	Implements the recording token commands 'destroy' and
+ *	'replay surface ?matrix?'. Replaying draws the recorded
+ *	primitives to the surface, in the coordinate system given by
+ *	the matrix, with the options parsed when they were recorded.
+ *	Named styles and gradients are looked up when replayed.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	Draws into the surface.
+ *
+ *--------------------------------------------------------------
+ */
+
+static CONST char *recordingCmds[] = {
+    "destroy", "replay", (char *) NULL
+};
+
+enum {
+    kPathRecordingCmdDestroy	= 0L,
+    kPathRecordingCmdReplay
+};
+
+static int 
+RecordingObjCmd(ClientData clientData, Tcl_Interp* interp, int objc, Tcl_Obj* CONST objv[])
+{
+    PathRecording *recPtr = (PathRecording *) clientData;
+    PathSurface *surfacePtr;
+    SurfRecordedOp *opPtr;
+    Tcl_HashEntry *hPtr;
+    TMatrix matrix;
+    char msg[64];
+    int index;
+    int result = TCL_OK;
+
+    if (objc < 2) {
+        Tcl_WrongNumArgs(interp, 1, objv, "command ?arg arg...?");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], recordingCmds, "command", 0,
+            &index) != TCL_OK) {
+        return TCL_ERROR;
+    }
+    if (index == kPathRecordingCmdDestroy) {
+        if (objc != 2) {
+            Tcl_WrongNumArgs(interp, 2, objv, NULL);
+            return TCL_ERROR;
+        }
+        Tcl_DeleteCommand(interp, recPtr->token);
+        return TCL_OK;
+    }
+    if ((objc != 3) && (objc != 4)) {
+        Tcl_WrongNumArgs(interp, 2, objv, "surface ?matrix?");
+        return TCL_ERROR;
+    }
+    hPtr = Tcl_FindHashEntry(&recPtr->statePtr->surfaceTable, Tcl_GetString(objv[2]));
+    if (hPtr == NULL) {
+        Tcl_AppendResult(interp, "surface \"", Tcl_GetString(objv[2]), 
+                "\" doesn't exist", (char *) NULL);
+        return TCL_ERROR;
+    }
+    surfacePtr = (PathSurface *) Tcl_GetHashValue(hPtr);
+    if (surfacePtr->recordingPtr != NULL) {
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(
+                "can't replay to a surface that is recording", -1));
+        return TCL_ERROR;
+    }
+    if ((objc == 4) && (PathGetTMatrix(interp, Tcl_GetString(objv[3]), &matrix) != TCL_OK)) {
+        return TCL_ERROR;
+    }
+    
+    TkPathSaveState(surfacePtr->ctx);
+    if (objc == 4) {
+        TkPathPushTMatrix(surfacePtr->ctx, &matrix);
+    }
+    surfacePtr->optionCachePtr = &recPtr->optionCache;
+    for (opPtr = recPtr->ops; opPtr < recPtr->ops + recPtr->numOps; opPtr++) {
+        opPtr->objv[0] = objv[2];
+        opPtr->objv[1] = objv[1];
+        surfacePtr->replayOptPtr = opPtr->optPtr;
+        result = SurfaceCreateObjCmd(interp, surfacePtr, opPtr->objc + 2, opPtr->objv);
+        if (result != TCL_OK) {
+            sprintf(msg, "\n    (replaying primitive %d)", (int) (opPtr - recPtr->ops));
+            Tcl_AddErrorInfo(interp, msg);
+            break;
+        }
+    }
+    surfacePtr->replayOptPtr = NULL;
+    surfacePtr->optionCachePtr = NULL;
+    TkPathRestoreState(surfacePtr->ctx);
+    if (result == TCL_OK) {
+        Tcl_ResetResult(interp);
+    }
     return result;
 }
 
 static void
-SurfaceInitOptions(Tcl_Interp* interp)
+SurfaceInitOptions(Tcl_Interp* interp, PathSurfaceState *statePtr)
 {
-    gOptionTableCircle = Tk_CreateOptionTable(interp, circleOptionSpecs);
-    gOptionTableEllipse = Tk_CreateOptionTable(interp, ellipseOptionSpecs);
-    gOptionTablePath = Tk_CreateOptionTable(interp, pathOptionSpecs);
-    gOptionTablePimage = Tk_CreateOptionTable(interp, pimageOptionSpecs);
-    gOptionTablePline = Tk_CreateOptionTable(interp, plineOptionSpecs);
-    gOptionTablePolyline = Tk_CreateOptionTable(interp, polylineOptionSpecs);
-    gOptionTablePpolygon = Tk_CreateOptionTable(interp, ppolygonOptionSpecs);
-    gOptionTablePrect = Tk_CreateOptionTable(interp, prectOptionSpecs);
-    gOptionTablePtext = Tk_CreateOptionTable(interp, ptextOptionSpecs);
+    statePtr->optionTables[kPathSurfaceItemCircle] = Tk_CreateOptionTable(interp, circleOptionSpecs);
+    statePtr->optionTables[kPathSurfaceItemEllipse] = Tk_CreateOptionTable(interp, ellipseOptionSpecs);
+    statePtr->optionTables[kPathSurfaceItemPath] = Tk_CreateOptionTable(interp, pathOptionSpecs);
+    statePtr->optionTables[kPathSurfaceItemPimage] = Tk_CreateOptionTable(interp, pimageOptionSpecs);
+    statePtr->optionTables[kPathSurfaceItemPline] = Tk_CreateOptionTable(interp, plineOptionSpecs);
+    statePtr->optionTables[kPathSurfaceItemPolyline] = Tk_CreateOptionTable(interp, polylineOptionSpecs);
+    statePtr->optionTables[kPathSurfaceItemPpolygon] = Tk_CreateOptionTable(interp, ppolygonOptionSpecs);
+    statePtr->optionTables[kPathSurfaceItemPrect] = Tk_CreateOptionTable(interp, prectOptionSpecs);
+    statePtr->optionTables[kPathSurfaceItemPtext] = Tk_CreateOptionTable(interp, ptextOptionSpecs);
 }
 
 static int 
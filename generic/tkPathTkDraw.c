@@ -18,8 +18,6 @@
 
 #define _PATH_N_BUFFER_POINTS 		2000
 
-extern int gAntiAlias;
-
 extern void	CurveSegments(double control[], int includeFirst, int numSteps, register double *coordPtr);
 
 /*
@@ -293,6 +291,12 @@ TkPathImage(TkPathContext ctx, Tk_Image image, Tk_PhotoHandle photo,
     Tk_RedrawImage(image, 0, 0, iwidth, iheight, context->drawable, (int)x, (int)y);
 }
 
+void
+TkPathImageChanged(Tk_PhotoHandle photo)
+{
+    /* Nothing is cached. */
+}
+
 void TkPathClosePath(TkPathContext ctx)
 {
     TkPathContext_ *context = (TkPathContext_ *) ctx;
@@ -347,12 +351,22 @@ TkPathSurfaceErase(TkPathContext ctx, double x, double y, double width, double h
 }
 
 void
-TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo)
+TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo,
+        int x, int y, int width, int height)
 {
     TkPathContext_ *context = (TkPathContext_ *) ctx;
 
 }
 
+int
+TkPathSurfaceToPng(Tcl_Interp *interp, TkPathContext ctx, Tcl_Channel chan,
+        int x, int y, int width, int height)
+{
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+            "writing png is not supported on this platform", -1));
+    return TCL_ERROR;
+}
+
 void TkPathClipToPath(TkPathContext ctx, int fillRule)
 {
     /* empty */
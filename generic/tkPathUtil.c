@@ -295,12 +295,278 @@ TkPathFreePathColor(TkPathColor *colorPtr)
     }
 }
 
+/*
+ * The pixel copying functions below work row by row. The rows are done
+ * by SSSE3 or AVX2 kernels, four or eight pixels at a time, when the
+ * compiler and the CPU support them, and the remaining pixels of each
+ * row by the scalar code. The kernels give exactly the same result as
+ * the scalar code. The ::tkp::simd variable turns them off.
+ *
+ * Each function is given by a permutation perm which tells for each
+ * byte of a destination pixel which byte of the source pixel it comes
+ * from. The alpha is the last byte of the destination pixel.
+ */
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) \
+	&& ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)) \
+	|| defined(__clang__))
+#   define PATH_HAVE_SIMD 1
+#   include <immintrin.h>
+#endif
+
+enum {
+    PATH_SIMD_NONE,
+    PATH_SIMD_SSSE3,
+    PATH_SIMD_AVX2
+};
+
+typedef void (PathRowProc)(unsigned char *src, unsigned char *dst, 
+	int n, CONST unsigned char *perm);
+
+static CONST unsigned char permARGB[4] = {1, 2, 3, 0};
+static CONST unsigned char permBGRA[4] = {2, 1, 0, 3};
+static CONST unsigned char permRGBA[4] = {0, 1, 2, 3};
+
+static void
+RowUnpremultiply(unsigned char *src, unsigned char *dst, int n, 
+	CONST unsigned char *perm)
+{
+    unsigned char alpha;
+    int j;
+
+    for (j = 0; j < n; j++, src += 4, dst += 4) {
+        alpha = src[perm[3]];
+        if (alpha == 0xFF || alpha == 0x00) {
+            dst[0] = src[perm[0]];
+            dst[1] = src[perm[1]];
+            dst[2] = src[perm[2]];
+        } else {
+            /* dst = 255*src/alpha */
+            dst[0] = (src[perm[0]]*255)/alpha;
+            dst[1] = (src[perm[1]]*255)/alpha;
+            dst[2] = (src[perm[2]]*255)/alpha;
+        }
+        dst[3] = alpha;
+    }
+}
+
+static void
+RowPremultiply(unsigned char *src, unsigned char *dst, int n, 
+	CONST unsigned char *perm)
+{
+    unsigned int alpha;
+    int j;
+
+    for (j = 0; j < n; j++, src += 4, dst += 4) {
+        alpha = src[perm[3]];
+        if (alpha == 0xFF) {
+            dst[0] = src[perm[0]];
+            dst[1] = src[perm[1]];
+            dst[2] = src[perm[2]];
+        } else {
+            dst[0] = alpha*src[perm[0]]/255;
+            dst[1] = alpha*src[perm[1]]/255;
+            dst[2] = alpha*src[perm[2]]/255;
+        }
+        dst[3] = alpha;
+    }
+}
+
+#ifdef PATH_HAVE_SIMD
+
+/*
+ * The AVX2 kernels are the SSSE3 ones on twice the width. All the
+ * instructions used work within each 128 bit lane, so the lanes are
+ * just two SSSE3 registers side by side.
+ */
+
+static int
+SimdLevel(void)
+{
+    static int level = -1;
+
+    if (level < 0) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            level = PATH_SIMD_AVX2;
+        } else if (__builtin_cpu_supports("ssse3")) {
+            level = PATH_SIMD_SSSE3;
+        } else {
+            level = PATH_SIMD_NONE;
+        }
+    }
+    return level;
+}
+
+#define PERM_MASK(p, o) \
+    (char) ((o)+(p)[0]), (char) ((o)+(p)[1]), (char) ((o)+(p)[2]), (char) ((o)+(p)[3])
+
+/*
+ * Unpremultiply in single precision floats. c*255 is exact, the division
+ * is correctly rounded and can't round up to the next integer since that
+ * is at least 1/alpha away, so truncating gives the integer result.
+ * The low byte is kept, as when the scalar code stores a value > 255.
+ */
+
+__attribute__((target("ssse3"))) static void
+RowUnpremultiplySSSE3(unsigned char *src, unsigned char *dst, int n, 
+	CONST unsigned char *perm)
+{
+    __m128i mask = _mm_setr_epi8(PERM_MASK(perm, 0), PERM_MASK(perm, 4),
+	    PERM_MASK(perm, 8), PERM_MASK(perm, 12));
+    __m128i zero = _mm_setzero_si128();
+    __m128i ff = _mm_set1_epi32(0xFF);
+    __m128i alphaLane = _mm_setr_epi32(0, 0, 0, -1);
+    __m128 f255 = _mm_set1_ps(255.0f);
+    __m128i p[4], a, q, keep, w0, w1;
+    int j, k;
+
+    for (j = 0; j+4 <= n; j += 4) {
+        __m128i px = _mm_shuffle_epi8(
+		_mm_loadu_si128((__m128i *) (src + 4*j)), mask);
+        
+        w0 = _mm_unpacklo_epi8(px, zero);
+        w1 = _mm_unpackhi_epi8(px, zero);
+        p[0] = _mm_unpacklo_epi16(w0, zero);
+        p[1] = _mm_unpackhi_epi16(w0, zero);
+        p[2] = _mm_unpacklo_epi16(w1, zero);
+        p[3] = _mm_unpackhi_epi16(w1, zero);
+        for (k = 0; k < 4; k++) {
+            a = _mm_shuffle_epi32(p[k], 0xFF);
+            q = _mm_cvttps_epi32(_mm_div_ps(
+		    _mm_mul_ps(_mm_cvtepi32_ps(p[k]), f255), _mm_cvtepi32_ps(a)));
+            q = _mm_and_si128(q, ff);
+            keep = _mm_or_si128(alphaLane, _mm_or_si128(
+		    _mm_cmpeq_epi32(a, zero), _mm_cmpeq_epi32(a, ff)));
+            p[k] = _mm_or_si128(_mm_and_si128(keep, p[k]), 
+		    _mm_andnot_si128(keep, q));
+        }
+        w0 = _mm_packs_epi32(p[0], p[1]);
+        w1 = _mm_packs_epi32(p[2], p[3]);
+        _mm_storeu_si128((__m128i *) (dst + 4*j), _mm_packus_epi16(w0, w1));
+    }
+    RowUnpremultiply(src + 4*j, dst + 4*j, n-j, perm);
+}
+
+__attribute__((target("avx2"))) static void
+RowUnpremultiplyAVX2(unsigned char *src, unsigned char *dst, int n, 
+	CONST unsigned char *perm)
+{
+    __m256i mask = _mm256_setr_epi8(PERM_MASK(perm, 0), PERM_MASK(perm, 4),
+	    PERM_MASK(perm, 8), PERM_MASK(perm, 12), PERM_MASK(perm, 0),
+	    PERM_MASK(perm, 4), PERM_MASK(perm, 8), PERM_MASK(perm, 12));
+    __m256i zero = _mm256_setzero_si256();
+    __m256i ff = _mm256_set1_epi32(0xFF);
+    __m256i alphaLane = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+    __m256 f255 = _mm256_set1_ps(255.0f);
+    __m256i p[4], a, q, keep, w0, w1;
+    int j, k;
+
+    for (j = 0; j+8 <= n; j += 8) {
+        __m256i px = _mm256_shuffle_epi8(
+		_mm256_loadu_si256((__m256i *) (src + 4*j)), mask);
+        
+        w0 = _mm256_unpacklo_epi8(px, zero);
+        w1 = _mm256_unpackhi_epi8(px, zero);
+        p[0] = _mm256_unpacklo_epi16(w0, zero);
+        p[1] = _mm256_unpackhi_epi16(w0, zero);
+        p[2] = _mm256_unpacklo_epi16(w1, zero);
+        p[3] = _mm256_unpackhi_epi16(w1, zero);
+        for (k = 0; k < 4; k++) {
+            a = _mm256_shuffle_epi32(p[k], 0xFF);
+            q = _mm256_cvttps_epi32(_mm256_div_ps(
+		    _mm256_mul_ps(_mm256_cvtepi32_ps(p[k]), f255), 
+		    _mm256_cvtepi32_ps(a)));
+            q = _mm256_and_si256(q, ff);
+            keep = _mm256_or_si256(alphaLane, _mm256_or_si256(
+		    _mm256_cmpeq_epi32(a, zero), _mm256_cmpeq_epi32(a, ff)));
+            p[k] = _mm256_or_si256(_mm256_and_si256(keep, p[k]), 
+		    _mm256_andnot_si256(keep, q));
+        }
+        w0 = _mm256_packs_epi32(p[0], p[1]);
+        w1 = _mm256_packs_epi32(p[2], p[3]);
+        _mm256_storeu_si256((__m256i *) (dst + 4*j), _mm256_packus_epi16(w0, w1));
+    }
+    RowUnpremultiply(src + 4*j, dst + 4*j, n-j, perm);
+}
+
+/*
+ * Premultiply in 16 bit integers: x = alpha*c fits, and x/255 rounded
+ * down is (x + 1 + (x >> 8)) >> 8 for all x up to 255*255.
+ */
+
+__attribute__((target("ssse3"))) static void
+RowPremultiplySSSE3(unsigned char *src, unsigned char *dst, int n, 
+	CONST unsigned char *perm)
+{
+    __m128i mask = _mm_setr_epi8(PERM_MASK(perm, 0), PERM_MASK(perm, 4),
+	    PERM_MASK(perm, 8), PERM_MASK(perm, 12));
+    __m128i zero = _mm_setzero_si128();
+    __m128i one = _mm_set1_epi16(1);
+    __m128i alphaLane = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+    __m128i w[2], a, x;
+    int j, k;
+
+    for (j = 0; j+4 <= n; j += 4) {
+        __m128i px = _mm_shuffle_epi8(
+		_mm_loadu_si128((__m128i *) (src + 4*j)), mask);
+        
+        w[0] = _mm_unpacklo_epi8(px, zero);
+        w[1] = _mm_unpackhi_epi8(px, zero);
+        for (k = 0; k < 2; k++) {
+            a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(w[k], 0xFF), 0xFF);
+            x = _mm_mullo_epi16(w[k], a);
+            x = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, one), 
+		    _mm_srli_epi16(x, 8)), 8);
+            w[k] = _mm_or_si128(_mm_and_si128(alphaLane, w[k]), 
+		    _mm_andnot_si128(alphaLane, x));
+        }
+        _mm_storeu_si128((__m128i *) (dst + 4*j), _mm_packus_epi16(w[0], w[1]));
+    }
+    RowPremultiply(src + 4*j, dst + 4*j, n-j, perm);
+}
+
+__attribute__((target("avx2"))) static void
+RowPremultiplyAVX2(unsigned char *src, unsigned char *dst, int n, 
+	CONST unsigned char *perm)
+{
+    __m256i mask = _mm256_setr_epi8(PERM_MASK(perm, 0), PERM_MASK(perm, 4),
+	    PERM_MASK(perm, 8), PERM_MASK(perm, 12), PERM_MASK(perm, 0),
+	    PERM_MASK(perm, 4), PERM_MASK(perm, 8), PERM_MASK(perm, 12));
+    __m256i zero = _mm256_setzero_si256();
+    __m256i one = _mm256_set1_epi16(1);
+    __m256i alphaLane = _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1,
+	    0, 0, 0, -1, 0, 0, 0, -1);
+    __m256i w[2], a, x;
+    int j, k;
+
+    for (j = 0; j+8 <= n; j += 8) {
+        __m256i px = _mm256_shuffle_epi8(
+		_mm256_loadu_si256((__m256i *) (src + 4*j)), mask);
+        
+        w[0] = _mm256_unpacklo_epi8(px, zero);
+        w[1] = _mm256_unpackhi_epi8(px, zero);
+        for (k = 0; k < 2; k++) {
+            a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(w[k], 0xFF), 0xFF);
+            x = _mm256_mullo_epi16(w[k], a);
+            x = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, one), 
+		    _mm256_srli_epi16(x, 8)), 8);
+            w[k] = _mm256_or_si256(_mm256_and_si256(alphaLane, w[k]), 
+		    _mm256_andnot_si256(alphaLane, x));
+        }
+        _mm256_storeu_si256((__m256i *) (dst + 4*j), _mm256_packus_epi16(w[0], w[1]));
+    }
+    RowPremultiply(src + 4*j, dst + 4*j, n-j, perm);
+}
+
+#endif /* PATH_HAVE_SIMD */
+
 /*
  *--------------------------------------------------------------
  *
- * PathCopyBitsARGB, PathCopyBitsBGRA --
+ * CopyRows --
  *
- *	Copies bitmap data from these formats to RGBA.
+ *	Runs a row function, or its fastest kernel, over all rows.
  *
  * Results:
  *	None.
@@ -311,47 +577,27 @@ TkPathFreePathColor(TkPathColor *colorPtr)
  *--------------------------------------------------------------
  */
 
-void
-PathCopyBitsARGB(unsigned char *from, unsigned char *to, 
-        int width, int height, int bytesPerRow)
+static void
+CopyRows(unsigned char *from, unsigned char *to, int width, int height, 
+	int bytesPerRow, CONST unsigned char *perm, PathRowProc *rowProc)
 {
-    unsigned char *src, *dst;
-    int i, j;
-
-    /* Copy XRGB to RGBX in one shot, alphas in a loop. */
-    memcpy(to, from+1, height*bytesPerRow-1);
-    
-    for (i = 0; i < height; i++) {
-        src = from + i*bytesPerRow;
-        dst = to + i*bytesPerRow;
-        /* @@@ Keep ARGB format in photo? */
-        for (j = 0; j < width; j++, src += 4, dst += 4) {
-            *(dst+3) = *src;
+    int i;
+
+#ifdef PATH_HAVE_SIMD
+    if (gSimd && (width >= 4)) {
+        int level = SimdLevel();
+
+        if (rowProc == RowUnpremultiply) {
+            rowProc = (level == PATH_SIMD_AVX2) ? RowUnpremultiplyAVX2 :
+		    (level == PATH_SIMD_SSSE3) ? RowUnpremultiplySSSE3 : rowProc;
+        } else if (rowProc == RowPremultiply) {
+            rowProc = (level == PATH_SIMD_AVX2) ? RowPremultiplyAVX2 :
+		    (level == PATH_SIMD_SSSE3) ? RowPremultiplySSSE3 : rowProc;
         }
     }
-}
-
-void
-PathCopyBitsBGRA(unsigned char *from, unsigned char *to, 
-        int width, int height, int bytesPerRow)
-{
-    unsigned char *src, *dst;
-    int i, j;
-    
-    /* Copy BGRA -> RGBA */
+#endif
     for (i = 0; i < height; i++) {
-        src = from + i*bytesPerRow;
-        dst = to + i*bytesPerRow;
-        for (j = 0; j < width; j++, src += 4) {
-            /* RED */
-            *dst++ = *(src+2);
-            /* GREEN */
-            *dst++ = *(src+1);
-            /* BLUE */
-            *dst++ = *src;
-            /* ALPHA */
-            *dst++ = *(src+3);
-        }
+        (*rowProc)(from + i*bytesPerRow, to + i*bytesPerRow, width, perm);
     }
 }
 
@@ -377,100 +623,53 @@ void
 PathCopyBitsPremultipliedAlphaRGBA(unsigned char *from, unsigned char *to, 
         int width, int height, int bytesPerRow)
 {
-    unsigned char *src, *dst, alpha;
-    int i, j;
-
-    /* Copy src RGBA with premulitplied alpha to "plain" RGBA. */
-    for (i = 0; i < height; i++) {
-        src = from + i*bytesPerRow;
-        dst = to + i*bytesPerRow;
-        for (j = 0; j < width; j++) {
-            alpha = *(src+3);
-            if (alpha == 0xFF || alpha == 0x00) {
-                memcpy(dst, src, 4);
-                src += 4;
-                dst += 4;
-            } else {
-                /* dst = 255*src/alpha */
-                *dst++ = (*src++*255)/alpha;
-                *dst++ = (*src++*255)/alpha;
-                *dst++ = (*src++*255)/alpha;
-                *dst++ = alpha;
-                src++;
-            }
-        }
-    }
+    CopyRows(from, to, width, height, bytesPerRow, permRGBA, RowUnpremultiply);
 }
 
-// UNTESTED!
 void
 PathCopyBitsPremultipliedAlphaARGB(unsigned char *from, unsigned char *to, 
         int width, int height, int bytesPerRow)
 {
-    unsigned char *src, *dst, alpha;
-    int i, j;
-
-    /* Copy src ARGB with premulitplied alpha to "plain" RGBA. */
-    for (i = 0; i < height; i++) {
-        src = from + i*bytesPerRow;
-        dst = to + i*bytesPerRow;
-        for (j = 0; j < width; j++) {
-            alpha = *src;
-            if (alpha == 0xFF || alpha == 0x00) {
-                memcpy(dst, src+1, 3);
-                *(dst+3) = alpha;
-                src += 4;
-                dst += 4;
-            } else {
-                /* dst = 255*src/alpha */
-                *(dst+3) = alpha;
-                src++;
-                *dst = ((*src << 8) - *src)/alpha;
-                dst++, src++;
-                *dst = ((*src << 8) - *src)/alpha;
-                dst++, src++;
-                *dst = ((*src << 8) - *src)/alpha;
-                dst++, dst++, src++;
-            }
-        }
-    }
+    CopyRows(from, to, width, height, bytesPerRow, permARGB, RowUnpremultiply);
 }
 
 void
 PathCopyBitsPremultipliedAlphaBGRA(unsigned char *from, unsigned char *to, 
         int width, int height, int bytesPerRow)
 {
-    unsigned char *src, *dst, alpha;
-    int i, j;
+    CopyRows(from, to, width, height, bytesPerRow, permBGRA, RowUnpremultiply);
+}
 
-    /* Copy src BGRA with premulitplied alpha to "plain" RGBA. */
-    for (i = 0; i < height; i++) {
-        src = from + i*bytesPerRow;
-        dst = to + i*bytesPerRow;
-        for (j = 0; j < width; j++, src += 4) {
-            alpha = *(src+3);
-            if (alpha == 0xFF || alpha == 0x00) {
-                /* RED */
-                *dst++ = *(src+2);
-                /* GREEN */
-                *dst++ = *(src+1);
-                /* BLUE */
-                *dst++ = *src;
-                /* ALPHA */
-                *dst++ = *(src+3);
-            } else {
-                /* dst = 255*src/alpha */
-                /* RED */
-                *dst++ = (*(src+2)*255)/alpha;
-                /* GREEN */
-                *dst++ = (*(src+1)*255)/alpha;
-                /* BLUE */
-                *dst++ = (*(src+0)*255)/alpha;
-                /* ALPHA */
-                *dst++ = alpha;
-            }
-        }
-    }
+/*
+ *--------------------------------------------------------------
+ *
+ * PathCopyPhotoBitsPremultipliedBGRA --
+ *
+ *	Copies the pixels of a photo to a bitmap in BGRA format with
+ *	the alpha premultiplied, as used by cairo on little endian
+ *	machines. The bitmap has the pitch of the photo.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+PathCopyPhotoBitsPremultipliedBGRA(Tk_PhotoImageBlock *blockPtr, 
+	unsigned char *to)
+{
+    unsigned char perm[4];
+
+    perm[0] = blockPtr->offset[2];
+    perm[1] = blockPtr->offset[1];
+    perm[2] = blockPtr->offset[0];
+    perm[3] = blockPtr->offset[3];
+    CopyRows(blockPtr->pixelPtr, to, blockPtr->width, blockPtr->height, 
+	    blockPtr->pitch, perm, RowPremultiply);
 }
 
 /* from mozilla */
@@ -68,6 +68,14 @@ typedef struct Tk_PathTags {
 				 * *tagPtr. */
 } Tk_PathTags;
 
+/*
+ * True if the tag array is the one allocated along with the Tk_PathTags
+ * record itself, and must not be freed separately.
+ */
+
+#define TK_PATHTAGS_INLINE(tagsPtr) \
+	((tagsPtr)->tagPtr == (Tk_Uid *) ((tagsPtr) + 1))
+
 typedef struct PathRect {
     double x1;
     double y1;
@@ -17,6 +17,7 @@
 #include "tkInt.h"
 #include "tkIntPath.h"
 #include "tkpCanvas.h"
+#include "tkCanvPathUtil.h"
 
 /*
  * The structure below defines the record for each line item.
@@ -61,6 +62,12 @@ typedef struct LineItem  {
     Tk_PathSmoothMethod *smooth;/* Non-zero means draw line smoothed (i.e.
 				 * with Bezier splines). */
     int splineSteps;		/* Number of steps in each spline segment. */
+    int decimate;		/* Non-zero means draw at most four points
+				 * per pixel column, see DecimatePoints. */
+    double *decimatedPtr;	/* Cached decimated points, or NULL. They
+				 * stay valid when scrolling since the canvas
+				 * origin is always a whole pixel. */
+    int numDecimated;		/* Number of points in decimatedPtr. */
 } LineItem;
 
 /*
@@ -226,6 +233,9 @@ static Tk_OptionSpec optionSpecs[] = {
     {TK_OPTION_PIXELS, "-dashoffset", NULL, NULL,
 	"0", -1, Tk_Offset(LineItem, outline.offset),
 	0, 0, 0},
+    {TK_OPTION_BOOLEAN, "-decimate", NULL, NULL,
+	"0", -1, Tk_Offset(LineItem, decimate),
+	0, 0, 0},
     {TK_OPTION_CUSTOM, "-disableddash", NULL, NULL,
 	NULL, -1, Tk_Offset(LineItem, outline.disabledDashPtr),
 	TK_OPTION_NULL_OK, &dashCO, 0},
@@ -358,6 +368,9 @@ CreateLine(
     linePtr->firstArrowPtr = NULL;
     linePtr->lastArrowPtr = NULL;
     linePtr->smooth = NULL;
+    linePtr->decimate = 0;
+    linePtr->decimatedPtr = NULL;
+    linePtr->numDecimated = 0;
     linePtr->splineSteps = 12;
 
     if (optionTable == NULL) {
@@ -677,6 +690,9 @@ DeleteLine(
     if (linePtr->coordPtr != NULL) {
 	ckfree((char *) linePtr->coordPtr);
     }
+    if (linePtr->decimatedPtr != NULL) {
+	ckfree((char *) linePtr->decimatedPtr);
+    }
     if (linePtr->arrowGC != None) {
 	Tk_FreeGC(display, linePtr->arrowGC);
     }
@@ -721,6 +737,16 @@ ComputeLineBbox(
 	state = TkPathCanvasState(canvas);
     }
 
+    /*
+     * This is called whenever the points have changed, so any decimated
+     * points must be made again.
+     */
+
+    if (linePtr->decimatedPtr != NULL) {
+	ckfree((char *) linePtr->decimatedPtr);
+	linePtr->decimatedPtr = NULL;
+    }
+
     if (!(linePtr->numPoints) || (state==TK_PATHSTATE_HIDDEN)) {
 	linePtr->header.x1 = -1;
 	linePtr->header.x2 = -1;
@@ -902,6 +928,7 @@ DisplayLine(
     XPoint staticPoints[MAX_STATIC_POINTS*3];
     XPoint *pointPtr;
     double linewidth;
+    double *coordPtr = linePtr->coordPtr;
     int numPoints;
     Tk_PathState state = itemPtr->state;
 
@@ -932,6 +959,23 @@ DisplayLine(
     if ((linePtr->smooth) && (linePtr->numPoints > 2)) {
 	numPoints = linePtr->smooth->coordProc(canvas, NULL,
 		linePtr->numPoints, linePtr->splineSteps, NULL, NULL);
+    } else if (linePtr->decimate) {
+
+	/*
+	 * Points are rounded to the nearest pixel when drawn, so the
+	 * columns start half a pixel to the left.
+	 */
+
+	if (linePtr->decimatedPtr == NULL) {
+	    TMatrix m = {1.0, 0.0, 0.0, 1.0, 0.5, 0.0};
+
+	    linePtr->decimatedPtr = (double *) ckalloc((unsigned)
+		    (2 * linePtr->numPoints * sizeof(double)));
+	    linePtr->numDecimated = DecimatePoints(linePtr->coordPtr,
+		    linePtr->numPoints, &m, linePtr->decimatedPtr);
+	}
+	coordPtr = linePtr->decimatedPtr;
+	numPoints = linePtr->numDecimated;
     } else {
 	numPoints = linePtr->numPoints;
     }
@@ -947,7 +991,7 @@ DisplayLine(
 		linePtr->numPoints, linePtr->splineSteps, pointPtr, NULL);
     } else {
 	numPoints = TkPathCanvTranslatePath((TkPathCanvas*)canvas, numPoints,
-		linePtr->coordPtr, 0, pointPtr);
+		coordPtr, 0, pointPtr);
     }
 
     /*
@@ -440,9 +440,12 @@ TkPathCanvasInheritStyle(Tk_PathItem *itemPtr, long flags)
     /*
      * Merge the parents style with the actual items style.
      * The order of these two merges decides which take precedence.
+     * Lean items have no style record of their own.
      */
     itemExPtr = (Tk_PathItemEx *) itemPtr;
-    TkPathStyleMergeStyles(&itemExPtr->style, &style, flags);
+    if (!TkPathItemIsLean(itemPtr)) {
+	TkPathStyleMergeStyles(&itemExPtr->style, &style, flags);
+    }
     if (itemExPtr->styleInst != NULL) {
 	TkPathStyleMergeStyles(itemExPtr->styleInst->masterPtr, &style, flags);
     }    
@@ -616,10 +619,16 @@ TkPathAllocTagsFromObj(
 	return NULL;
     }
     len = MAX(objc, TK_PATHTAG_SPACE);
-    tagsPtr = (Tk_PathTags *) ckalloc(sizeof(Tk_PathTags));
+    
+    /*
+     * The initial tag array is allocated in the same block, directly
+     * after the record, see TK_PATHTAGS_INLINE.
+     */
+    tagsPtr = (Tk_PathTags *) ckalloc((unsigned) 
+	    (sizeof(Tk_PathTags) + len * sizeof(Tk_Uid)));
     tagsPtr->tagSpace = len;
     tagsPtr->numTags = objc;
-    tagsPtr->tagPtr = (Tk_Uid *) ckalloc((unsigned) (len * sizeof(Tk_Uid)));
+    tagsPtr->tagPtr = (Tk_Uid *) (tagsPtr + 1);
     for (i = 0; i < objc; i++) {
 	tagsPtr->tagPtr[i] = Tk_GetUid(Tcl_GetStringFromObj(objv[i], NULL));
     }
@@ -629,7 +638,7 @@ TkPathAllocTagsFromObj(
 static void
 TkPathFreeTags(Tk_PathTags *tagsPtr)
 {
-    if (tagsPtr->tagPtr != NULL) {
+    if ((tagsPtr->tagPtr != NULL) && !TK_PATHTAGS_INLINE(tagsPtr)) {
 	ckfree((char *) tagsPtr->tagPtr);
     }    
 }
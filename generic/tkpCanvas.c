@@ -22,6 +22,7 @@
 #define TK_PATH_NO_DOUBLE_BUFFERING
 #endif
 
+#include <float.h>
 #include "default.h"
 #include "tkInt.h"
 #include "tkIntPath.h"
@@ -32,9 +33,6 @@
 #endif
 #endif /* TK_PATH_NO_DOUBLE_BUFFERING */
 
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 /*
  * See tkpCanvas.h for key data structures used to implement canvases.
  */
@@ -94,8 +92,39 @@ typedef struct TagSearch {
     unsigned int rewritebufferAllocated;
 				/* Available space for rewrites. */
     TagSearchExpr *expr;	/* Compiled tag expression. */
+    struct TagIndexHit *hits;	/* Items found in the tag index for single
+				 * tag searches, sorted in display order. */
+    int numHits;		/* Number of entries used in hits. */
+    int hitSpace;		/* Number of entries allocated for hits. */
+    int hitIndex;		/* Next entry in hits to return. */
 } TagSearch;
 
+/*
+ * A snapshot of the tag index is kept as item ids rather than pointers
+ * so that items may be deleted while the search is in progress.
+ */
+
+typedef struct TagIndexHit {
+    int displayOrder;
+    int id;
+} TagIndexHit;
+
+/*
+ * Data the canvas keeps per item without exposing it in Tk_PathItem,
+ * whose layout is fixed for item types compiled against tkp.h. It is
+ * stored just in front of each item record.
+ */
+
+typedef union ItemPrivate {
+    int displayOrder;		/* Position in the display list, used to
+				 * sort tag index lookups. Only valid if
+				 * it is nonnegative for the root item. */
+    double align;		/* Keeps the item record aligned. */
+} ItemPrivate;
+
+#define ItemDisplayOrder(itemPtr) \
+	(((ItemPrivate *) (itemPtr))[-1].displayOrder)
+
 /*
  * Values for the TagSearch type field.
  */
@@ -107,6 +136,33 @@ typedef struct TagSearch {
 #define SEARCH_TYPE_EXPR	4	/* Compound search */
 #define SEARCH_TYPE_ROOT	5	/* Looking for the root item */
 
+/*
+ * Compiled tag expressions are cached as the internal representation of
+ * the Tcl_Obj holding the expression so that scripts using the same
+ * expression over and over again don't need to parse it each time.
+ */
+
+typedef struct TagExprRep {
+    Tk_Uid uid;			/* The uid of the whole expression. */
+    int length;			/* Number of uids in compiled expression. */
+    Tk_Uid uids[1];		/* Compiled expression, actual size
+				 * depends on length. */
+} TagExprRep;
+
+#define TAG_EXPR_REP_SIZE(n) \
+    ((unsigned) (sizeof(TagExprRep) + ((n) - 1) * sizeof(Tk_Uid)))
+
+static void		TagExprFreeIntRep(Tcl_Obj *objPtr);
+static void		TagExprDupIntRep(Tcl_Obj *srcPtr, Tcl_Obj *dupPtr);
+
+static Tcl_ObjType tagExprObjType = {
+    "tkptagexpr",		/* name */
+    TagExprFreeIntRep,		/* freeIntRepProc */
+    TagExprDupIntRep,		/* dupIntRepProc */
+    NULL,			/* updateStringProc */
+    NULL			/* setFromAnyProc */
+};
+
 #endif /* USE_OLD_TAG_SEARCH */
 
 #define PATH_DEF_STATE "normal"
@@ -296,15 +352,43 @@ static int		ConfigureCanvas(Tcl_Interp *interp,
 			    Tcl_Obj *CONST *argv, int flags);
 static void		DestroyCanvas(char *memPtr);
 static void		DisplayCanvas(ClientData clientData);
-static void		DoItem(Tcl_Interp *interp,
+static void		DoItem(Tcl_Interp *interp, TkPathCanvas *canvasPtr,
 			    Tk_PathItem *itemPtr, Tk_Uid tag);
 static void		EventuallyRedrawItem(Tk_PathCanvas canvas,
 			    Tk_PathItem *itemPtr);
+static void		DeferRedrawItem(TkPathCanvas *canvasPtr,
+			    Tk_PathItem *itemPtr, Tk_PathItem **lastParentPtr);
+static void		RegisterItemDamage(TkPathCanvas *canvasPtr,
+			    Tk_PathItem *itemPtr);
+static void		UpdateUseItems(TkPathCanvas *canvasPtr);
+static void		UseRefsChanged(TkPathCanvas *canvasPtr,
+			    Tk_PathItem *itemPtr);
+static void		UseRefsFree(TkPathCanvas *canvasPtr);
+static void		UpdateItemBboxes(TkPathCanvas *canvasPtr);
+static int		PaintOptionsOnly(int objc, Tcl_Obj *CONST objv[]);
 
 static Tcl_Obj *	UnshareObj(Tcl_Obj *objPtr);
+static int		ItemConfigure(Tcl_Interp *interp,
+			    TkPathCanvas *canvasPtr, Tk_PathItem *itemPtr,
+			    int objc, Tcl_Obj *CONST objv[]);
+static int		ItemHasTag(Tk_PathItem *itemPtr, Tk_Uid uid);
+static void		TagIndexAdd(TkPathCanvas *canvasPtr,
+			    Tk_PathItem *itemPtr, Tk_Uid uid);
+static void		TagIndexRemove(TkPathCanvas *canvasPtr,
+			    Tk_PathItem *itemPtr, Tk_Uid uid);
+static void		TagIndexAddItem(TkPathCanvas *canvasPtr,
+			    Tk_PathItem *itemPtr);
+static void		TagIndexRemoveItem(TkPathCanvas *canvasPtr,
+			    Tk_PathItem *itemPtr);
+static void		TagIndexFree(TkPathCanvas *canvasPtr);
+static void		CanvasUpdateDisplayOrder(TkPathCanvas *canvasPtr);
 static Tk_PathItem *	ItemIteratorSubNext(Tk_PathItem *itemPtr, Tk_PathItem *groupPtr);
 static void		ItemAddToParent(Tk_PathItem *parentPtr, Tk_PathItem *itemPtr);
 static void		ItemDelete(TkPathCanvas *canvasPtr, Tk_PathItem *itemPtr);
+static Tk_PathItem *	ItemRecordAlloc(TkPathCanvas *canvasPtr, int size);
+static void		ItemRecordFree(TkPathCanvas *canvasPtr,
+			    Tk_PathItem *itemPtr);
+static void		ItemPoolsTrim(TkPathCanvas *canvasPtr, int all);
 static int		ItemCreate(Tcl_Interp *interp, TkPathCanvas *canvasPtr, 
 				Tk_PathItemType *typePtr, int isRoot, Tk_PathItem **itemPtrPtr, 
 				int objc, Tcl_Obj *CONST objv[]);
@@ -325,6 +409,11 @@ static int		FindItems(Tcl_Interp *interp, TkPathCanvas *canvasPtr,
 #endif /* USE_OLD_TAG_SEARCH */
 static int		FindArea(Tcl_Interp *interp, TkPathCanvas *canvasPtr,
 			    Tcl_Obj *CONST *argv, Tk_Uid uid, int enclosed);
+static int		FindPolygon(Tcl_Interp *interp, TkPathCanvas *canvasPtr,
+			    Tcl_Obj *polyObj, Tk_Uid uid, int enclosed);
+static int		FindClosestMany(Tcl_Interp *interp,
+			    TkPathCanvas *canvasPtr, Tcl_Obj *pointsObj,
+			    Tcl_Obj *haloObj, Tk_Uid uid);
 static double		GridAlign(double coord, double spacing);
 static CONST char**	TkGetStringsFromObjs(int argc, Tcl_Obj *CONST *objv);
 static void		InitCanvas(void);
@@ -353,6 +442,7 @@ static int		TagSearchEvalExpr(TagSearchExpr *expr,
 			    Tk_PathItem *itemPtr);
 static Tk_PathItem *	TagSearchFirst(TagSearch *searchPtr);
 static Tk_PathItem *	TagSearchNext(TagSearch *searchPtr);
+static void		TagExprSetIntRep(Tcl_Obj *objPtr, TagSearchExpr *expr);
 #endif /* USE_OLD_TAG_SEARCH */
 
 /*
@@ -532,6 +622,10 @@ Tk_PathCanvasObjCmd(
 #endif
 
     Tcl_InitHashTable(&canvasPtr->idTable, TCL_ONE_WORD_KEYS);
+    Tcl_InitHashTable(&canvasPtr->tagIndexTable, TCL_ONE_WORD_KEYS);
+    canvasPtr->itemPools = NULL;
+    Tcl_InitHashTable(&canvasPtr->useTable, TCL_ONE_WORD_KEYS);
+    canvasPtr->changedRefsPtr = NULL;
     Tcl_InitHashTable(&canvasPtr->styleTable, TCL_STRING_KEYS);
     Tcl_InitHashTable(&canvasPtr->gradientTable, TCL_STRING_KEYS);
 
@@ -564,6 +658,7 @@ Tk_PathCanvasObjCmd(
     ItemCreate(interp, canvasPtr, &tkGroupType, 1, &rootItemPtr, 0, NULL);
     rootItemPtr->pathTagsPtr = TkPathAllocTagsFromObj(NULL, 
 	    Tcl_NewStringObj("root", -1));
+    TagIndexAddItem(canvasPtr, rootItemPtr);
     canvasPtr->rootItemPtr = rootItemPtr;
 
     Tcl_SetResult(interp, Tk_PathName(canvasPtr->tkwin), TCL_STATIC);
@@ -658,6 +753,17 @@ CanvasWidgetCmd(
     }
     Tcl_Preserve((ClientData) canvasPtr);
 
+    /*
+     * Only the commands that change many items at once leave item bboxes
+     * out of date; everything else may look at them.
+     */
+
+    if ((canvasPtr->flags & ITEM_BBOX_DIRTY) && (index != CANV_ITEMCGET)
+	    && (index != CANV_ITEMCONFIGURE) && (index != CANV_MOVE)
+	    && (index != CANV_SCALE)) {
+	UpdateItemBboxes(canvasPtr);
+    }
+
     result = TCL_OK;
     switch ((enum options) index) {
     case CANV_ADDTAG: {
@@ -1054,14 +1160,31 @@ CanvasWidgetCmd(
 	}
 	FIRST_CANVAS_ITEM_MATCHING(objv[2], &searchPtr, goto done);
 	if (itemPtr != NULL) {
-	    if (objc != 3) {
+	    /*
+	     * Coordinates modified with an option like '-append' are
+	     * changed in place by the item, which registers the damaged
+	     * area itself, often much smaller than its bounding box.
+	     */
+	    int incremental = (objc > 3)
+		    && TkPathCanvasIsCoordsModifier(objv[3]);
+
+	    if ((objc != 3) && !incremental) {
 		EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
 	    }
 	    if (itemPtr->typePtr->coordProc != NULL) {
 		result = (*itemPtr->typePtr->coordProc)(interp,
 			(Tk_PathCanvas) canvasPtr, itemPtr, objc-3, objv+3);
 	    }
-	    if (objc != 3) {
+	    if (incremental) {
+		SetAncestorsDirtyBbox(itemPtr);
+		if (itemPtr->redraw_flags & ITEM_REFERENCED) {
+		    UseRefsChanged(canvasPtr, itemPtr);
+		}
+		if (!(canvasPtr->flags & REDRAW_PENDING)) {
+		    Tcl_DoWhenIdle(DisplayCanvas, (ClientData) canvasPtr);
+		    canvasPtr->flags |= REDRAW_PENDING;
+		}
+	    } else if (objc != 3) {
 		EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
 	    }
 	}
@@ -1234,6 +1357,7 @@ CanvasWidgetCmd(
 		ItemDelete(canvasPtr, itemPtr);
 	    }
 	}
+	ItemPoolsTrim(canvasPtr, 0);
 	break;
     }
     case CANV_DEPTH: {
@@ -1300,6 +1424,7 @@ CanvasWidgetCmd(
 			ptagsPtr->numTags--;
 		    }
 		}
+		TagIndexRemove(canvasPtr, itemPtr, tag);
 	    }
 	}
 	break;
@@ -1525,11 +1650,19 @@ CanvasWidgetCmd(
 	break;
     }
     case CANV_ITEMCONFIGURE: {
+	Tk_PathItem *lastParentPtr = NULL;
+
 	if (objc < 3) {
 	    Tcl_WrongNumArgs(interp, 2, objv, "tagOrId ?option value ...?");
 	    result = TCL_ERROR;
 	    goto done;
 	}
+	if (objc > 4) {
+	    canvasPtr->flags |= DEFER_ITEM_BBOX;
+	    if (PaintOptionsOnly(objc-3, objv+3)) {
+		canvasPtr->flags |= KEEP_ITEM_BBOX;
+	    }
+	}
 	FOR_EVERY_CANVAS_ITEM_MATCHING(objv[2], &searchPtr, goto done) {
 	    if (objc <= 4) {
 		resultObjPtr = Tk_GetOptionInfo(canvasPtr->interp, (char *) itemPtr, 
@@ -1542,11 +1675,10 @@ CanvasWidgetCmd(
 		    Tcl_SetObjResult(interp, resultObjPtr);
 		}
 	    } else {
-		EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
-		result = (*itemPtr->typePtr->configProc)(interp,
-			(Tk_PathCanvas) canvasPtr, itemPtr, objc-3, objv+3,
-			TK_CONFIG_ARGV_ONLY);
-		EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
+		RegisterItemDamage(canvasPtr, itemPtr);
+		result = ItemConfigure(interp, canvasPtr, itemPtr,
+			objc-3, objv+3);
+		DeferRedrawItem(canvasPtr, itemPtr, &lastParentPtr);
 		canvasPtr->flags |= REPICK_NEEDED;
 	    }
 	    if ((result != TCL_OK) || (objc < 5)) {
@@ -1609,6 +1741,7 @@ CanvasWidgetCmd(
     }
     case CANV_MOVE: {
 	double xAmount, yAmount;
+	Tk_PathItem *lastParentPtr = NULL;
 
 	if (objc != 5) {
 	    Tcl_WrongNumArgs(interp, 2, objv, "tagOrId xAmount yAmount");
@@ -1622,11 +1755,12 @@ CanvasWidgetCmd(
 	    goto done;
 	}
 
+	canvasPtr->flags |= DEFER_ITEM_BBOX;
 	FOR_EVERY_CANVAS_ITEM_MATCHING(objv[2], &searchPtr, goto done) {
-	    EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
+	    RegisterItemDamage(canvasPtr, itemPtr);
 	    (void) (*itemPtr->typePtr->translateProc)((Tk_PathCanvas) canvasPtr,
 		    itemPtr,  xAmount, yAmount);
-	    EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
+	    DeferRedrawItem(canvasPtr, itemPtr, &lastParentPtr);
 	    canvasPtr->flags |= REPICK_NEEDED;
 	}
 	break;
@@ -1738,6 +1872,7 @@ CanvasWidgetCmd(
     }
     case CANV_SCALE: {
 	double xOrigin, yOrigin, xScale, yScale;
+	Tk_PathItem *lastParentPtr = NULL;
 
 	if (objc != 7) {
 	    Tcl_WrongNumArgs(interp, 2, objv, "tagOrId xOrigin yOrigin xScale yScale");
@@ -1758,11 +1893,12 @@ CanvasWidgetCmd(
 	    result = TCL_ERROR;
 	    goto done;
 	}
+	canvasPtr->flags |= DEFER_ITEM_BBOX;
 	FOR_EVERY_CANVAS_ITEM_MATCHING(objv[2], &searchPtr, goto done) {
-	    EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
+	    RegisterItemDamage(canvasPtr, itemPtr);
 	    (void) (*itemPtr->typePtr->scaleProc)((Tk_PathCanvas) canvasPtr,
 		    itemPtr, xOrigin, yOrigin, xScale, yScale);
-	    EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
+	    DeferRedrawItem(canvasPtr, itemPtr, &lastParentPtr);
 	    canvasPtr->flags |= REPICK_NEEDED;
 	}
 	break;
@@ -2051,6 +2187,13 @@ CanvasWidgetCmd(
 #ifndef USE_OLD_TAG_SEARCH
     TagSearchDestroy(searchPtr);
 #endif /* not USE_OLD_TAG_SEARCH */
+    canvasPtr->flags &= ~(DEFER_ITEM_BBOX|KEEP_ITEM_BBOX);
+    if (canvasPtr->flags & USE_UPDATE_NEEDED) {
+	if (canvasPtr->flags & ITEM_BBOX_DIRTY) {
+	    UpdateItemBboxes(canvasPtr);
+	}
+	UpdateUseItems(canvasPtr);
+    }
     Tcl_Release((ClientData) canvasPtr);
     return result;
 }
@@ -2097,9 +2240,12 @@ DestroyCanvas(
         prevItemPtr = TkPathCanvasItemIteratorPrev(itemPtr);
 	(*itemPtr->typePtr->deleteProc)((Tk_PathCanvas) canvasPtr, itemPtr,
 		canvasPtr->display);
-	ckfree((char *) itemPtr);
+	if (itemPtr == canvasPtr->rootItemPtr) {
+	    ckfree((char *) itemPtr - sizeof(ItemPrivate));
+	}
         itemPtr = prevItemPtr;
     }
+    ItemPoolsTrim(canvasPtr, 1);
 
     /*
      * Free up all the stuff that requires special handling, then let
@@ -2107,6 +2253,8 @@ DestroyCanvas(
      */
 
     Tcl_DeleteHashTable(&canvasPtr->idTable);
+    TagIndexFree(canvasPtr);
+    UseRefsFree(canvasPtr);
     
     // @@@ TODO: tkwin = NULL!
     PathStylesFree(canvasPtr->tkwin, &canvasPtr->styleTable);
@@ -2399,7 +2547,7 @@ DisplayCanvas(
 {
     TkPathCanvas *canvasPtr = (TkPathCanvas *) clientData;
     Tk_Window tkwin = canvasPtr->tkwin;
-    Tk_PathItem *itemPtr;
+    Tk_PathItem *itemPtr, *parentPtr;
     Pixmap pixmap;
     int screenX1, screenX2, screenY1, screenY2, width, height;
     int flags;
@@ -2410,6 +2558,9 @@ DisplayCanvas(
     if (!Tk_IsMapped(tkwin)) {
 	goto done;
     }
+    if (canvasPtr->flags & ITEM_BBOX_DIRTY) {
+	UpdateItemBboxes(canvasPtr);
+    }
 
     /*
      * Choose a new current item if that is needed (this could cause event
@@ -2430,15 +2581,21 @@ DisplayCanvas(
     /*
      * Scan through the item list, registering the bounding box for all items
      * that didn't do that for the final coordinates yet. This can be
-     * determined by the FORCE_REDRAW flag.
+     * determined by the FORCE_REDRAW flag. Siblings are visited in a row,
+     * so the ancestors only need to be marked when the parent changes.
      */
 
+    parentPtr = NULL;
     for (itemPtr = canvasPtr->rootItemPtr; itemPtr != NULL;
 	    itemPtr = TkPathCanvasItemIteratorNext(itemPtr)) {
 	if (itemPtr->redraw_flags & FORCE_REDRAW) {
 	    itemPtr->redraw_flags &= ~FORCE_REDRAW;
-	    EventuallyRedrawItem((Tk_PathCanvas)canvasPtr, itemPtr);
+	    RegisterItemDamage(canvasPtr, itemPtr);
 	    itemPtr->redraw_flags &= ~FORCE_REDRAW;
+	    if (itemPtr->parentPtr != parentPtr) {
+		parentPtr = itemPtr->parentPtr;
+		SetAncestorsDirtyBbox(itemPtr);
+	    }
 	}
     }
     
@@ -2831,6 +2988,42 @@ EventuallyRedrawItem(
     Tk_PathItem *itemPtr)		/* Item to be redrawn. */
 {
     TkPathCanvas *canvasPtr = (TkPathCanvas *) canvas;
+
+    RegisterItemDamage(canvasPtr, itemPtr);
+    SetAncestorsDirtyBbox(itemPtr);
+    if (itemPtr->redraw_flags & ITEM_REFERENCED) {
+	UseRefsChanged(canvasPtr, itemPtr);
+    }
+    if (!(canvasPtr->flags & REDRAW_PENDING)) {
+	Tcl_DoWhenIdle(DisplayCanvas, (ClientData) canvasPtr);
+	canvasPtr->flags |= REDRAW_PENDING;
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * RegisterItemDamage --
+ *
+ *	Adds the current bounding box of an item to the area of the
+ *	canvas that needs redrawing, unless that was already done for
+ *	the item since the last redisplay.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The redraw area may grow and the item gets its FORCE_REDRAW
+ *	flag set.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+RegisterItemDamage(
+    TkPathCanvas *canvasPtr,		/* Information about widget. */
+    Tk_PathItem *itemPtr)		/* Item whose area is damaged. */
+{
     if ((itemPtr->x1 >= itemPtr->x2) || (itemPtr->y1 >= itemPtr->y2) ||
  	    (itemPtr->x2 < canvasPtr->xOrigin) ||
 	    (itemPtr->y2 < canvasPtr->yOrigin) ||
@@ -2863,7 +3056,49 @@ EventuallyRedrawItem(
 	}
 	itemPtr->redraw_flags |= FORCE_REDRAW;
     }
-    SetAncestorsDirtyBbox(itemPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * DeferRedrawItem --
+ *
+ *	Used by the commands that may touch many items at once
+ *	(itemconfigure, move, scale) after an item has been changed.
+ *	Instead of registering the new bounding box right away the item
+ *	is only flagged with FORCE_REDRAW; DisplayCanvas picks up the
+ *	final bounding box once, however many times the item changed.
+ *	Ancestor groups are marked dirty only when the parent differs
+ *	from the one of the previous item, since matching items are
+ *	mostly siblings, and not at all if only paint options were set.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A redisplay is scheduled and *lastParentPtr is updated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+DeferRedrawItem(
+    TkPathCanvas *canvasPtr,		/* Information about widget. */
+    Tk_PathItem *itemPtr,		/* Item that was changed. */
+    Tk_PathItem **lastParentPtr)	/* Parent of the previously changed
+					 * item, or NULL. */
+{
+    itemPtr->redraw_flags |= FORCE_REDRAW;
+    if (canvasPtr->flags & KEEP_ITEM_BBOX) {
+	/* Nothing moved, so the ancestors keep their bbox. */
+    } else if ((*lastParentPtr == NULL)
+	    || (itemPtr->parentPtr != *lastParentPtr)) {
+	*lastParentPtr = itemPtr->parentPtr;
+	SetAncestorsDirtyBbox(itemPtr);
+    }
+    if (itemPtr->redraw_flags & ITEM_REFERENCED) {
+	UseRefsChanged(canvasPtr, itemPtr);
+    }
     if (!(canvasPtr->flags & REDRAW_PENDING)) {
 	Tcl_DoWhenIdle(DisplayCanvas, (ClientData) canvasPtr);
 	canvasPtr->flags |= REDRAW_PENDING;
@@ -2871,197 +3106,554 @@ EventuallyRedrawItem(
 }
 
 /*
- *----------------------------------------------------------------------
+ *--------------------------------------------------------------
  *
- * GroupItemConfigured --
+ * TkPathCanvasDeferItemBbox --
  *
- *	Schedules all children of a group for redisplay in a recursive way.
+ *	Called by items first thing when they are about to compute
+ *	their bbox. While itemconfigure, move or scale runs the work is
+ *	put off until the bbox is needed, so an item changed many times
+ *	computes it once. If only paint options were configured the
+ *	bbox stays as it is.
  *
  * Results:
- *	None.
+ *	1 if the item shall not compute its bbox now, else 0.
  *
  * Side effects:
- *	A number of items scheduled for redisplay.
+ *	The item may get its BBOX_DIRTY flag set.
  *
- *----------------------------------------------------------------------
+ *--------------------------------------------------------------
  */
 
-void
-GroupItemConfigured(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, int mask)
+int
+TkPathCanvasDeferItemBbox(
+    Tk_PathCanvas canvas,		/* Canvas that contains item. */
+    Tk_PathItem *itemPtr)		/* Item whose bbox is wanted. */
 {
-    Tk_PathItem *walkPtr;
-    
-    for (walkPtr = itemPtr->firstChildPtr; walkPtr != NULL; walkPtr = walkPtr->nextPtr) {
-	EventuallyRedrawItem(canvas, walkPtr);
-	if (walkPtr->typePtr->bboxProc != NULL) {
-	    (*walkPtr->typePtr->bboxProc)(canvas, walkPtr, mask);
-	    /*
-	     * Only if the item responds to the bboxProc we need to redraw it.
-	     */
-	    EventuallyRedrawItem(canvas, walkPtr);
-	}
-	if (walkPtr->typePtr == &tkGroupType) {
-	    /*
-	     * Call ourself recursively for each group.
-	     * @@@ An alternative would be to have this call in the group's
-	     *     own bbox proc.
-	     */
-	    GroupItemConfigured(canvas, walkPtr, mask);
-	}
+    TkPathCanvas *canvasPtr = (TkPathCanvas *) canvas;
+
+    if (!(canvasPtr->flags & DEFER_ITEM_BBOX)) {
+	return 0;
     }
+    if (!(canvasPtr->flags & KEEP_ITEM_BBOX)) {
+	itemPtr->redraw_flags |= BBOX_DIRTY;
+	canvasPtr->flags |= ITEM_BBOX_DIRTY;
+    }
+    return 1;
 }
 
 /*
  *--------------------------------------------------------------
  *
- * Tk_CreatePathItemType --
+ * UpdateItemBboxes --
  *
- *	This function may be invoked to add a new kind of canvas element to
- *	the core item types supported by Tk.
+ *	Computes the bbox of all items that had it deferred by
+ *	TkPathCanvasDeferItemBbox. Must be called before anything
+ *	looks at item bboxes: display, picking and all widget commands
+ *	but the ones that defer.
  *
  * Results:
  *	None.
  *
  * Side effects:
- *	From now on, the new item type will be useable in canvas widgets
- *	(e.g. typePtr->name can be used as the item type in "create" widget
- *	commands). If there was already a type with the same name as in
- *	typePtr, it is replaced with the new type.
+ *	Items get a new bbox and their ancestors are marked dirty.
  *
  *--------------------------------------------------------------
  */
 
-void
-Tk_CreatePathItemType(
-    Tk_PathItemType *typePtr)	/* Information about item type; storage must
-				 * be statically allocated (must live
-				 * forever). */
+static void
+UpdateItemBboxes(
+    TkPathCanvas *canvasPtr)		/* Information about widget. */
 {
-    Tk_PathItemType *typePtr2, *prevPtr;
-
-    if (typeList == NULL) {
-	InitCanvas();
-    }
-
-    /*
-     * If there's already an item type with the given name, remove it.
-     */
+    Tk_PathItem *itemPtr, *parentPtr = NULL;
 
-    Tcl_MutexLock(&typeListMutex);
-    for (typePtr2 = typeList, prevPtr = NULL; typePtr2 != NULL;
-	    prevPtr = typePtr2, typePtr2 = typePtr2->nextPtr) {
-	if (strcmp(typePtr2->name, typePtr->name) == 0) {
-	    if (prevPtr == NULL) {
-		typeList = typePtr2->nextPtr;
-	    } else {
-		prevPtr->nextPtr = typePtr2->nextPtr;
+    canvasPtr->flags &= ~ITEM_BBOX_DIRTY;
+    for (itemPtr = canvasPtr->rootItemPtr; itemPtr != NULL;
+	    itemPtr = TkPathCanvasItemIteratorNext(itemPtr)) {
+	if (itemPtr->redraw_flags & BBOX_DIRTY) {
+	    itemPtr->redraw_flags &= ~BBOX_DIRTY;
+	    (*itemPtr->typePtr->bboxProc)((Tk_PathCanvas) canvasPtr,
+		    itemPtr, 0);
+	    if (itemPtr->parentPtr != parentPtr) {
+		parentPtr = itemPtr->parentPtr;
+		SetAncestorsDirtyBbox(itemPtr);
 	    }
-	    break;
 	}
     }
-    typePtr->nextPtr = typeList;
-    typeList = typePtr;
-    Tcl_MutexUnlock(&typeListMutex);
 }
 
 /*
- *----------------------------------------------------------------------
+ *--------------------------------------------------------------
  *
- * Tk_PathGetItemTypes --
+ * PaintOptionsOnly --
  *
- *	This function returns a pointer to the list of all item types. Note
- *	that this is inherently thread-unsafe, but since item types are only
- *	ever registered very rarely this is unlikely to be a problem in
- *	practice.
+ *	Tells whether an itemconfigure option list only sets options
+ *	that change how items are painted but never their geometry.
+ *	Abbreviated option names are not recognized, which is safe.
  *
  * Results:
- *	The return value is a pointer to the first in the list of item types
- *	currently supported by canvases.
+ *	1 if all options are paint options, else 0.
  *
  * Side effects:
  *	None.
  *
- *----------------------------------------------------------------------
+ *--------------------------------------------------------------
  */
 
-Tk_PathItemType *
-Tk_PathGetItemTypes(void)
+static int
+PaintOptionsOnly(
+    int objc,			/* Number of option value pairs * 2. */
+    Tcl_Obj *CONST objv[])	/* Option value pairs. */
 {
-    if (typeList == NULL) {
-	InitCanvas();
+    static CONST char *paintOptions[] = {
+	"-fill",	    "-fillopacity",	"-fillrule",
+	"-strokedasharray", "-strokeopacity",	"-tintamount",
+	"-tintcolor",	    "-interpolation",	NULL
+    };
+    CONST char **namePtr;
+    CONST char *option;
+    int i;
+
+    if (objc & 1) {
+	return 0;
     }
-    return typeList;
+    for (i = 0; i < objc; i += 2) {
+	option = Tcl_GetString(objv[i]);
+	for (namePtr = paintOptions; *namePtr != NULL; namePtr++) {
+	    if (strcmp(option, *namePtr) == 0) {
+		break;
+	    }
+	}
+	if (*namePtr == NULL) {
+	    return 0;
+	}
+    }
+    return 1;
 }
 
 /*
- *----------------------------------------------------------------------
+ * The use items referring to one item. The records are kept in the
+ * useTable of the canvas with the id of the referenced item as key,
+ * since the id stays unique even after the item is deleted.
+ */
+
+typedef struct UseRefs {
+    int refId;			/* Id of the referenced item. */
+    int numUses;		/* Number of use items in usePtrs. */
+    int maxUses;		/* Room in usePtrs. */
+    Tk_PathItem **usePtrs;	/* The use items, in no particular order. */
+    int changed;		/* 1 if on the changedRefsPtr list. */
+    struct UseRefs *nextChangedPtr;
+				/* Next on the changedRefsPtr list. */
+} UseRefs;
+
+/*
+ *--------------------------------------------------------------
  *
- * TkPathCanvasSetParent --
+ * TkPathCanvasAddUseRef, TkPathCanvasRemoveUseRef --
  *
- *	Appends an item as the last sibling to a parent item.
- *	May unlink any existing linkage.
+ *	Called by use items when they start or stop drawing the
+ *	geometry of the item with id refId, so that only they are
+ *	updated when that item changes.
  *
  * Results:
- *	Standard tcl result.
+ *	None.
  *
  * Side effects:
- *	Links in item in display list.
+ *	The list of use items of refId changes. The referenced item
+ *	gets its ITEM_REFERENCED flag set.
  *
- *----------------------------------------------------------------------
+ *--------------------------------------------------------------
  */
 
 void
-TkPathCanvasSetParent(Tk_PathItem *parentPtr, Tk_PathItem *itemPtr)
+TkPathCanvasAddUseRef(
+    Tk_PathCanvas canvas,		/* Information about widget. */
+    int refId,				/* Id of the referenced item. */
+    Tk_PathItem *useItemPtr)		/* The use item. */
 {
-
-    /*
-     * Unlink any present parent, then link in again.
-     */
-    if (itemPtr->parentPtr != NULL) {
-	TkPathCanvasItemDetach(itemPtr);
+    TkPathCanvas *canvasPtr = (TkPathCanvas *) canvas;
+    Tcl_HashEntry *entryPtr;
+    Tk_PathItem *refPtr;
+    UseRefs *refsPtr;
+    int isNew;
+
+    refPtr = TkPathCanvasItemFromId(canvas, refId);
+    if (refPtr != NULL) {
+	refPtr->redraw_flags |= ITEM_REFERENCED;
+    }
+    entryPtr = Tcl_CreateHashEntry(&canvasPtr->useTable,
+	    (char *) INT2PTR(refId), &isNew);
+    if (isNew) {
+	refsPtr = (UseRefs *) ckalloc(sizeof(UseRefs));
+	refsPtr->refId = refId;
+	refsPtr->numUses = 0;
+	refsPtr->maxUses = 4;
+	refsPtr->usePtrs = (Tk_PathItem **)
+		ckalloc(refsPtr->maxUses * sizeof(Tk_PathItem *));
+	refsPtr->changed = 0;
+	refsPtr->nextChangedPtr = NULL;
+	Tcl_SetHashValue(entryPtr, refsPtr);
+    } else {
+	refsPtr = (UseRefs *) Tcl_GetHashValue(entryPtr);
     }
-    ItemAddToParent(parentPtr, itemPtr);
-    
-    /* 
-     * We may have configured -parent with a tag but need to return an id. 
-     */
-    itemPtr->parentObj = UnshareObj(itemPtr->parentObj);
-    Tcl_SetIntObj(itemPtr->parentObj, parentPtr->id);
+    if (refsPtr->numUses == refsPtr->maxUses) {
+	refsPtr->maxUses *= 2;
+	refsPtr->usePtrs = (Tk_PathItem **) ckrealloc((char *) refsPtr->usePtrs,
+		refsPtr->maxUses * sizeof(Tk_PathItem *));
+    }
+    refsPtr->usePtrs[refsPtr->numUses++] = useItemPtr;
 }
 
 void
-CanvasSetParentToRoot(Tk_PathItem *itemPtr)
+TkPathCanvasRemoveUseRef(
+    Tk_PathCanvas canvas,		/* Information about widget. */
+    int refId,				/* Id of the referenced item. */
+    Tk_PathItem *useItemPtr)		/* The use item. */
 {
-    Tk_PathItemEx *itemExPtr = (Tk_PathItemEx *)itemPtr;
-    Tk_PathCanvas canvas = itemExPtr->canvas;
     TkPathCanvas *canvasPtr = (TkPathCanvas *) canvas;
-    TkPathCanvasSetParent(canvasPtr->rootItemPtr, itemPtr);
+    Tcl_HashEntry *entryPtr;
+    UseRefs *refsPtr;
+    int i;
+
+    entryPtr = Tcl_FindHashEntry(&canvasPtr->useTable, (char *) INT2PTR(refId));
+    if (entryPtr == NULL) {
+	return;
+    }
+    refsPtr = (UseRefs *) Tcl_GetHashValue(entryPtr);
+    for (i = 0; i < refsPtr->numUses; i++) {
+	if (refsPtr->usePtrs[i] == useItemPtr) {
+	    refsPtr->usePtrs[i] = refsPtr->usePtrs[--refsPtr->numUses];
+	    break;
+	}
+    }
+
+    /*
+     * A record on the changed list is freed by UpdateUseItems.
+     */
+    if ((refsPtr->numUses == 0) && !refsPtr->changed) {
+	Tcl_DeleteHashEntry(entryPtr);
+	ckfree((char *) refsPtr->usePtrs);
+	ckfree((char *) refsPtr);
+    }
 }
 
 /*
- *----------------------------------------------------------------------
+ *--------------------------------------------------------------
  *
- * TkPathCanvasFindGroup --
+ * UseRefsChanged --
  *
- *	Searches for the first group item described by the tagOrId parentObj.
+ *	Called when an item that has been referenced by use items is
+ *	changed or deleted. Puts its use items up for an update at the
+ *	end of the widget command.
  *
  * Results:
- *	Standard tcl result. parentPtrPtr filled in on success.
+ *	None.
  *
  * Side effects:
- *	Leaves any error result in interp.
+ *	The use record of the item may go on the changed list.
  *
- *----------------------------------------------------------------------
+ *--------------------------------------------------------------
  */
 
-int
-TkPathCanvasFindGroup(Tcl_Interp *interp, Tk_PathCanvas canvas, 
-	Tcl_Obj *parentObj, Tk_PathItem **parentPtrPtr)
+static void
+UseRefsChanged(
+    TkPathCanvas *canvasPtr,		/* Information about widget. */
+    Tk_PathItem *itemPtr)		/* Referenced item that changed. */
 {
-    TkPathCanvas *canvasPtr = (TkPathCanvas *) canvas;
-    Tk_PathItem *parentPtr;
-    int result = TCL_OK;
-    TagSearch *searchPtr = NULL;/* Allocated by first TagSearchScan, freed by
+    Tcl_HashEntry *entryPtr;
+    UseRefs *refsPtr;
+
+    entryPtr = Tcl_FindHashEntry(&canvasPtr->useTable,
+	    (char *) INT2PTR(itemPtr->id));
+    if (entryPtr == NULL) {
+	return;
+    }
+    refsPtr = (UseRefs *) Tcl_GetHashValue(entryPtr);
+    if (!refsPtr->changed) {
+	refsPtr->changed = 1;
+	refsPtr->nextChangedPtr = canvasPtr->changedRefsPtr;
+	canvasPtr->changedRefsPtr = refsPtr;
+	canvasPtr->flags |= USE_UPDATE_NEEDED;
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * UpdateUseItems --
+ *
+ *	Called at the end of a widget command that changed or deleted
+ *	an item that use items refer to. Since the use items draw the
+ *	geometry of another item their bbox may have changed as well.
+ *	Only the use items of the changed items are updated.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Use items get a new bbox and are scheduled for redisplay.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+UpdateUseItems(
+    TkPathCanvas *canvasPtr)		/* Information about widget. */
+{
+    Tk_PathItem *itemPtr;
+    Tcl_HashEntry *entryPtr;
+    UseRefs *refsPtr;
+    int i;
+
+    canvasPtr->flags &= ~USE_UPDATE_NEEDED;
+    while (canvasPtr->changedRefsPtr != NULL) {
+	refsPtr = canvasPtr->changedRefsPtr;
+	canvasPtr->changedRefsPtr = refsPtr->nextChangedPtr;
+	refsPtr->changed = 0;
+	for (i = 0; i < refsPtr->numUses; i++) {
+	    itemPtr = refsPtr->usePtrs[i];
+	    EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
+	    (*itemPtr->typePtr->bboxProc)((Tk_PathCanvas) canvasPtr, itemPtr, 0);
+	    EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
+	}
+	if (refsPtr->numUses == 0) {
+	    entryPtr = Tcl_FindHashEntry(&canvasPtr->useTable,
+		    (char *) INT2PTR(refsPtr->refId));
+	    Tcl_DeleteHashEntry(entryPtr);
+	    ckfree((char *) refsPtr->usePtrs);
+	    ckfree((char *) refsPtr);
+	}
+    }
+    canvasPtr->flags |= REPICK_NEEDED;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * UseRefsFree --
+ *
+ *	Frees the use records of a canvas that is being destroyed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+UseRefsFree(
+    TkPathCanvas *canvasPtr)		/* Information about widget. */
+{
+    Tcl_HashEntry *entryPtr;
+    Tcl_HashSearch search;
+    UseRefs *refsPtr;
+
+    for (entryPtr = Tcl_FirstHashEntry(&canvasPtr->useTable, &search);
+	    entryPtr != NULL; entryPtr = Tcl_NextHashEntry(&search)) {
+	refsPtr = (UseRefs *) Tcl_GetHashValue(entryPtr);
+	ckfree((char *) refsPtr->usePtrs);
+	ckfree((char *) refsPtr);
+    }
+    Tcl_DeleteHashTable(&canvasPtr->useTable);
+    canvasPtr->changedRefsPtr = NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GroupItemConfigured --
+ *
+ *	Schedules all children of a group for redisplay in a recursive way.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A number of items scheduled for redisplay.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+GroupItemConfigured(Tk_PathCanvas canvas, Tk_PathItem *itemPtr, int mask)
+{
+    Tk_PathItem *walkPtr;
+    
+    for (walkPtr = itemPtr->firstChildPtr; walkPtr != NULL; walkPtr = walkPtr->nextPtr) {
+	EventuallyRedrawItem(canvas, walkPtr);
+	if (walkPtr->typePtr->bboxProc != NULL) {
+	    (*walkPtr->typePtr->bboxProc)(canvas, walkPtr, mask);
+	    /*
+	     * Only if the item responds to the bboxProc we need to redraw it.
+	     */
+	    EventuallyRedrawItem(canvas, walkPtr);
+	}
+	if (walkPtr->typePtr == &tkGroupType) {
+	    /*
+	     * Call ourself recursively for each group.
+	     * @@@ An alternative would be to have this call in the group's
+	     *     own bbox proc.
+	     */
+	    GroupItemConfigured(canvas, walkPtr, mask);
+	}
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * Tk_CreatePathItemType --
+ *
+ *	This function may be invoked to add a new kind of canvas element to
+ *	the core item types supported by Tk.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	From now on, the new item type will be useable in canvas widgets
+ *	(e.g. typePtr->name can be used as the item type in "create" widget
+ *	commands). If there was already a type with the same name as in
+ *	typePtr, it is replaced with the new type.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+Tk_CreatePathItemType(
+    Tk_PathItemType *typePtr)	/* Information about item type; storage must
+				 * be statically allocated (must live
+				 * forever). */
+{
+    Tk_PathItemType *typePtr2, *prevPtr;
+
+    if (typeList == NULL) {
+	InitCanvas();
+    }
+
+    /*
+     * If there's already an item type with the given name, remove it.
+     */
+
+    Tcl_MutexLock(&typeListMutex);
+    for (typePtr2 = typeList, prevPtr = NULL; typePtr2 != NULL;
+	    prevPtr = typePtr2, typePtr2 = typePtr2->nextPtr) {
+	if (strcmp(typePtr2->name, typePtr->name) == 0) {
+	    if (prevPtr == NULL) {
+		typeList = typePtr2->nextPtr;
+	    } else {
+		prevPtr->nextPtr = typePtr2->nextPtr;
+	    }
+	    break;
+	}
+    }
+    typePtr->nextPtr = typeList;
+    typeList = typePtr;
+    Tcl_MutexUnlock(&typeListMutex);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tk_PathGetItemTypes --
+ *
+ *	This function returns a pointer to the list of all item types. Note
+ *	that this is inherently thread-unsafe, but since item types are only
+ *	ever registered very rarely this is unlikely to be a problem in
+ *	practice.
+ *
+ * Results:
+ *	The return value is a pointer to the first in the list of item types
+ *	currently supported by canvases.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tk_PathItemType *
+Tk_PathGetItemTypes(void)
+{
+    if (typeList == NULL) {
+	InitCanvas();
+    }
+    return typeList;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPathCanvasSetParent --
+ *
+ *	Appends an item as the last sibling to a parent item.
+ *	May unlink any existing linkage.
+ *
+ * Results:
+ *	Standard tcl result.
+ *
+ * Side effects:
+ *	Links in item in display list.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkPathCanvasSetParent(Tk_PathItem *parentPtr, Tk_PathItem *itemPtr)
+{
+
+    /*
+     * Unlink any present parent, then link in again.
+     */
+    if (itemPtr->parentPtr != NULL) {
+	TkPathCanvasItemDetach(itemPtr);
+    }
+    ItemAddToParent(parentPtr, itemPtr);
+    
+    /* 
+     * We may have configured -parent with a tag but need to return an id. 
+     */
+    itemPtr->parentObj = UnshareObj(itemPtr->parentObj);
+    Tcl_SetIntObj(itemPtr->parentObj, parentPtr->id);
+}
+
+void
+CanvasSetParentToRoot(Tk_PathItem *itemPtr)
+{
+    Tk_PathItemEx *itemExPtr = (Tk_PathItemEx *)itemPtr;
+    Tk_PathCanvas canvas = itemExPtr->canvas;
+    TkPathCanvas *canvasPtr = (TkPathCanvas *) canvas;
+    TkPathCanvasSetParent(canvasPtr->rootItemPtr, itemPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPathCanvasFindGroup --
+ *
+ *	Searches for the first group item described by the tagOrId parentObj.
+ *
+ * Results:
+ *	Standard tcl result. parentPtrPtr filled in on success.
+ *
+ * Side effects:
+ *	Leaves any error result in interp.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkPathCanvasFindGroup(Tcl_Interp *interp, Tk_PathCanvas canvas, 
+	Tcl_Obj *parentObj, Tk_PathItem **parentPtrPtr)
+{
+    TkPathCanvas *canvasPtr = (TkPathCanvas *) canvas;
+    Tk_PathItem *parentPtr;
+    int result = TCL_OK;
+    TagSearch *searchPtr = NULL;/* Allocated by first TagSearchScan, freed by
 				 * TagSearchDestroy */
 
     if (parentObj != NULL) {
@@ -3084,7 +3676,108 @@ TkPathCanvasFindGroup(Tcl_Interp *interp, Tk_PathCanvas canvas,
 	}
 	TagSearchDestroy(searchPtr);
     }
-    return result;
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPathCanvasFindItem --
+ *
+ *	Searches for the first item described by the tagOrId tagObj.
+ *
+ * Results:
+ *	Standard tcl result. itemPtrPtr filled in on success.
+ *
+ * Side effects:
+ *	Leaves any error result in interp.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkPathCanvasFindItem(Tcl_Interp *interp, Tk_PathCanvas canvas, 
+	Tcl_Obj *tagObj, Tk_PathItem **itemPtrPtr)
+{
+    TkPathCanvas *canvasPtr = (TkPathCanvas *) canvas;
+    Tk_PathItem *itemPtr;
+    int result = TCL_OK;
+    TagSearch *searchPtr = NULL;
+
+    if (TagSearchScan(canvasPtr, tagObj, &searchPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    itemPtr = TagSearchFirst(searchPtr);
+    if (itemPtr == NULL) {
+	Tcl_AppendStringsToObj(Tcl_GetObjResult(interp), 
+		"tag \"", Tcl_GetString(tagObj),
+		"\" doesn't match any items", NULL);
+	result = TCL_ERROR;
+    } else {
+	*itemPtrPtr = itemPtr;
+    }
+    TagSearchDestroy(searchPtr);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPathCanvasIsCoordsModifier --
+ *
+ *	Tells if the first argument to the coords command of an item
+ *	is an option, such as '-append', rather than a coordinate. Any
+ *	negative number starts with a digit or a point after the minus.
+ *	Objects without a string representation, such as lists of
+ *	numbers, are never options and are not turned into strings.
+ *
+ * Results:
+ *	1 if it is an option, else 0.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkPathCanvasIsCoordsModifier(Tcl_Obj *objPtr)
+{
+    char *arg = objPtr->bytes;
+
+    if (arg == NULL) {
+	return 0;
+    }
+    return (arg[0] == '-') && (arg[1] >= 'a') && (arg[1] <= 'z');
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPathCanvasItemFromId --
+ *
+ *	Looks up an item from its id.
+ *
+ * Results:
+ *	The item or NULL if there is no item with that id.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tk_PathItem *
+TkPathCanvasItemFromId(Tk_PathCanvas canvas, int id)
+{
+    TkPathCanvas *canvasPtr = (TkPathCanvas *) canvas;
+    Tcl_HashEntry *entryPtr;
+
+    entryPtr = Tcl_FindHashEntry(&canvasPtr->idTable, (char *) INT2PTR(id));
+    if (entryPtr == NULL) {
+	return NULL;
+    }
+    return (Tk_PathItem *) Tcl_GetHashValue(entryPtr);
 }
 
 void	    
@@ -3236,15 +3929,19 @@ InitCanvas(void)
 
     tkWindowType.nextPtr = &tkPathType;
     tkPathType.nextPtr = &tkPrectType;
-    tkPrectType.nextPtr = &tkPlineType;
+    tkPrectType.nextPtr = &tkLeanPrectType;
+    tkLeanPrectType.nextPtr = &tkPlineType;
     tkPlineType.nextPtr = &tkPolylineType;
     tkPolylineType.nextPtr = &tkPpolygonType;
     tkPpolygonType.nextPtr = &tkCircleType;
     tkCircleType.nextPtr = &tkEllipseType;
-    tkEllipseType.nextPtr = &tkPimageType;
+    tkEllipseType.nextPtr = &tkLeanCircleType;
+    tkLeanCircleType.nextPtr = &tkLeanEllipseType;
+    tkLeanEllipseType.nextPtr = &tkPimageType;
     tkPimageType.nextPtr = &tkPtextType;
     tkPtextType.nextPtr = &tkGroupType;
-    tkGroupType.nextPtr = NULL;
+    tkGroupType.nextPtr = &tkUseType;
+    tkUseType.nextPtr = NULL;
    
     Tcl_MutexUnlock(&typeListMutex);
 }
@@ -3278,7 +3975,17 @@ ItemCreate(Tcl_Interp *interp, TkPathCanvas *canvasPtr,
     int isNew = 0;
     int result;
 
-    itemPtr = (Tk_PathItem *) ckalloc((unsigned) typePtr->itemSize);
+    /*
+     * The root item lives as long as the canvas and is kept out of the
+     * pools so these can be released when all other items are deleted.
+     */
+    if (isRoot) {
+	itemPtr = (Tk_PathItem *) (ckalloc((unsigned)
+		(sizeof(ItemPrivate) + typePtr->itemSize))
+		+ sizeof(ItemPrivate));
+    } else {
+	itemPtr = ItemRecordAlloc(canvasPtr, typePtr->itemSize);
+    }
     if (isRoot) {
 	itemPtr->id = 0;
     } else {
@@ -3288,6 +3995,7 @@ ItemCreate(Tcl_Interp *interp, TkPathCanvas *canvasPtr,
     itemPtr->typePtr = typePtr;
     itemPtr->state = TK_PATHSTATE_NULL;
     itemPtr->redraw_flags = 0;
+    ItemDisplayOrder(itemPtr) = 0;
     itemPtr->optionTable = NULL;
     itemPtr->pathTagsPtr = NULL;
     itemPtr->nextPtr = NULL;
@@ -3307,12 +4015,17 @@ ItemCreate(Tcl_Interp *interp, TkPathCanvas *canvasPtr,
     result = (*typePtr->createProc)(interp, (Tk_PathCanvas) canvasPtr,
 	    itemPtr, objc, objv);
     if (result != TCL_OK) {
-	ckfree((char *) itemPtr);
+	if (isRoot) {
+	    ckfree((char *) itemPtr - sizeof(ItemPrivate));
+	} else {
+	    ItemRecordFree(canvasPtr, itemPtr);
+	}
 	return TCL_ERROR;
     }
     entryPtr = Tcl_CreateHashEntry(&canvasPtr->idTable,
 	    (char *) INT2PTR(itemPtr->id), &isNew);
     Tcl_SetHashValue(entryPtr, itemPtr);
+    TagIndexAddItem(canvasPtr, itemPtr);
 
     /*
      * If item's createProc didn't put it in the display list we do.
@@ -3500,6 +4213,9 @@ TkPathCanvasItemDetach(Tk_PathItem *itemPtr)
 static void		
 ItemAddToParent(Tk_PathItem *parentPtr, Tk_PathItem *itemPtr)
 {
+    Tk_PathItem *rootPtr;
+    int atEnd = 1;
+
     itemPtr->nextPtr = NULL;
     itemPtr->prevPtr = parentPtr->lastChildPtr;
     if (parentPtr->lastChildPtr != NULL) {
@@ -3509,78 +4225,475 @@ ItemAddToParent(Tk_PathItem *parentPtr, Tk_PathItem *itemPtr)
     }
     parentPtr->lastChildPtr = itemPtr;
     itemPtr->parentPtr = parentPtr;
+
+    /*
+     * Keep the display order numbers valid if the item was appended
+     * at the very end of the display list, which is by far the most
+     * common case. Else invalidate them all via the root item.
+     */
+    for (rootPtr = parentPtr; rootPtr->parentPtr != NULL;
+	    rootPtr = rootPtr->parentPtr) {
+	if (rootPtr->nextPtr != NULL) {
+	    atEnd = 0;
+	}
+    }
+    if (ItemDisplayOrder(rootPtr) >= 0) {
+	if (atEnd && (itemPtr->firstChildPtr == NULL)) {
+	    ItemDisplayOrder(itemPtr) =
+		    ItemDisplayOrder(TkPathCanvasItemIteratorPrev(itemPtr)) + 1;
+	} else {
+	    ItemDisplayOrder(rootPtr) = -1;
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ItemDelete --
+ *
+ *	Recursively frees all resources associated with an Item and its
+ *	descendants and removes it from display list.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Items are removed from their parent and freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ItemDelete(TkPathCanvas *canvasPtr, Tk_PathItem *itemPtr)
+{
+    Tcl_HashEntry *entryPtr;
+    
+    /*
+     * Remove any children by recursively calling us.
+     * NB: This is very tricky code! Children updates
+     *     the itemPtr->firstChildPtr here via calls
+     *     to TkPathCanvasItemDetach.
+     */
+    while (itemPtr->firstChildPtr != NULL) {
+	ItemDelete(canvasPtr, itemPtr->firstChildPtr);
+    }
+
+    EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
+    if (canvasPtr->bindingTable != NULL) {
+	Tk_DeleteAllBindings(canvasPtr->bindingTable,
+			     (ClientData) itemPtr);
+    }
+    
+    /*
+     * The item type deleteProc is responsible for calling 
+     * Tk_FreeConfigOptions which will implicitly also clean up
+     * the Tk_PathTags via its custom free proc.
+     */
+    TagIndexRemoveItem(canvasPtr, itemPtr);
+    (*itemPtr->typePtr->deleteProc)((Tk_PathCanvas) canvasPtr, itemPtr,
+				    canvasPtr->display);
+
+    entryPtr = Tcl_FindHashEntry(&canvasPtr->idTable,
+				 (char *) INT2PTR(itemPtr->id));
+    Tcl_DeleteHashEntry(entryPtr);
+    TkPathCanvasItemDetach(itemPtr);
+    
+    if (itemPtr == canvasPtr->currentItemPtr) {
+	canvasPtr->currentItemPtr = NULL;
+	canvasPtr->flags |= REPICK_NEEDED;
+    }
+    if (itemPtr == canvasPtr->newCurrentPtr) {
+	canvasPtr->newCurrentPtr = NULL;
+	canvasPtr->flags |= REPICK_NEEDED;
+    }
+    if (itemPtr == canvasPtr->textInfo.focusItemPtr) {
+	canvasPtr->textInfo.focusItemPtr = NULL;
+    }
+    if (itemPtr == canvasPtr->textInfo.selItemPtr) {
+	canvasPtr->textInfo.selItemPtr = NULL;
+    }
+    if ((itemPtr == canvasPtr->hotPtr)
+	    || (itemPtr == canvasPtr->hotPrevPtr)) {
+	canvasPtr->hotPtr = NULL;
+    }
+    ItemRecordFree(canvasPtr, itemPtr);
+}
+
+/*
+ * Item records are carved out of larger slabs instead of being allocated
+ * one by one. There is one pool per (rounded) record size. Freed records
+ * go on a free list and are reused; the slabs themselves are only given
+ * back when no record of the pool is in use anymore, typically after
+ * "delete all", or when the canvas is destroyed.
+ */
+
+#define ITEM_SLAB_MIN		16
+#define ITEM_SLAB_MAX		1024
+
+typedef struct ItemSlab {
+    struct ItemSlab *nextPtr;	/* Next slab of the same pool. */
+    double align;		/* Keeps the records that follow aligned. */
+} ItemSlab;
+
+typedef struct ItemPool {
+    int size;			/* Size of each record in the pool. */
+    int numLive;		/* Number of records handed out. */
+    int slabRecords;		/* Number of records in the last slab. */
+    ItemSlab *slabPtr;		/* List of slabs, last allocated first. */
+    char *nextPtr;		/* Next never used record in the first
+				 * slab... */
+    char *endPtr;		/* ...and the end of that slab. */
+    void *freePtr;		/* List of freed records, linked through
+				 * their first word. */
+    struct ItemPool *nextPoolPtr;
+} ItemPool;
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ItemRecordAlloc, ItemRecordFree --
+ *
+ *	Get and release storage for an item record of the given size
+ *	from the pools of the canvas.
+ *
+ * Results:
+ *	ItemRecordAlloc returns uninitialized storage for the record.
+ *
+ * Side effects:
+ *	A new slab may be allocated. Released records are kept for
+ *	reuse until ItemPoolsTrim is called.
+ *
+ *--------------------------------------------------------------
+ */
+
+static ItemPool *
+ItemPoolFind(TkPathCanvas *canvasPtr, int size)
+{
+    ItemPool *poolPtr;
+
+    size = (size + sizeof(double) - 1) & ~(int)(sizeof(double) - 1);
+    for (poolPtr = canvasPtr->itemPools; poolPtr != NULL;
+	    poolPtr = poolPtr->nextPoolPtr) {
+	if (poolPtr->size == size) {
+	    return poolPtr;
+	}
+    }
+    poolPtr = (ItemPool *) ckalloc(sizeof(ItemPool));
+    memset(poolPtr, 0, sizeof(ItemPool));
+    poolPtr->size = size;
+    poolPtr->nextPoolPtr = canvasPtr->itemPools;
+    canvasPtr->itemPools = poolPtr;
+    return poolPtr;
+}
+
+static Tk_PathItem *
+ItemRecordAlloc(TkPathCanvas *canvasPtr, int size)
+{
+    ItemPool *poolPtr = ItemPoolFind(canvasPtr, sizeof(ItemPrivate) + size);
+    ItemSlab *slabPtr;
+    char *recordPtr;
+
+    if (poolPtr->freePtr != NULL) {
+	recordPtr = (char *) poolPtr->freePtr;
+	poolPtr->freePtr = *((void **) recordPtr);
+    } else {
+	if (poolPtr->nextPtr == poolPtr->endPtr) {
+	    if (poolPtr->slabRecords < ITEM_SLAB_MIN) {
+		poolPtr->slabRecords = ITEM_SLAB_MIN;
+	    } else if (poolPtr->slabRecords < ITEM_SLAB_MAX) {
+		poolPtr->slabRecords *= 2;
+	    }
+	    slabPtr = (ItemSlab *) ckalloc((unsigned)
+		    (sizeof(ItemSlab) + poolPtr->slabRecords * poolPtr->size));
+	    slabPtr->nextPtr = poolPtr->slabPtr;
+	    poolPtr->slabPtr = slabPtr;
+	    poolPtr->nextPtr = (char *) (slabPtr + 1);
+	    poolPtr->endPtr = poolPtr->nextPtr
+		    + poolPtr->slabRecords * poolPtr->size;
+	}
+	recordPtr = poolPtr->nextPtr;
+	poolPtr->nextPtr += poolPtr->size;
+    }
+    poolPtr->numLive++;
+    return (Tk_PathItem *) (recordPtr + sizeof(ItemPrivate));
+}
+
+static void
+ItemRecordFree(TkPathCanvas *canvasPtr, Tk_PathItem *itemPtr)
+{
+    ItemPool *poolPtr = ItemPoolFind(canvasPtr,
+	    sizeof(ItemPrivate) + itemPtr->typePtr->itemSize);
+    char *recordPtr = (char *) itemPtr - sizeof(ItemPrivate);
+
+    *((void **) recordPtr) = poolPtr->freePtr;
+    poolPtr->freePtr = (void *) recordPtr;
+    poolPtr->numLive--;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ItemPoolsTrim --
+ *
+ *	Releases the slabs of all pools that have no records in use.
+ *	If all is set every pool is released regardless; this is only
+ *	done when the canvas is destroyed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+ItemPoolsTrim(TkPathCanvas *canvasPtr, int all)
+{
+    ItemPool *poolPtr, **prevPtrPtr;
+    ItemSlab *slabPtr;
+
+    prevPtrPtr = &canvasPtr->itemPools;
+    while ((poolPtr = *prevPtrPtr) != NULL) {
+	if (!all && (poolPtr->numLive > 0)) {
+	    prevPtrPtr = &poolPtr->nextPoolPtr;
+	    continue;
+	}
+	while (poolPtr->slabPtr != NULL) {
+	    slabPtr = poolPtr->slabPtr;
+	    poolPtr->slabPtr = slabPtr->nextPtr;
+	    ckfree((char *) slabPtr);
+	}
+	*prevPtrPtr = poolPtr->nextPoolPtr;
+	ckfree((char *) poolPtr);
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ItemConfigure --
+ *
+ *	Calls the items configProc and keeps the tag index in sync
+ *	if the -tags option was changed.
+ *
+ * Results:
+ *	Standard Tcl result from configProc.
+ *
+ * Side effects:
+ *	Item reconfigured, tag index updated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ItemConfigure(
+    Tcl_Interp *interp,
+    TkPathCanvas *canvasPtr,
+    Tk_PathItem *itemPtr,
+    int objc,
+    Tcl_Obj *CONST objv[])
+{
+    Tk_Uid staticUids[TK_PATHTAG_SPACE];
+    Tk_Uid *oldUids = staticUids;
+    Tk_PathTags *oldTagsPtr = itemPtr->pathTagsPtr;
+    int i, numOld = 0, result;
+
+    /*
+     * The old Tk_PathTags record is freed when options are set,
+     * so we need a copy of its tags.
+     */
+
+    if (oldTagsPtr != NULL) {
+	numOld = oldTagsPtr->numTags;
+	if (numOld > TK_PATHTAG_SPACE) {
+	    oldUids = (Tk_Uid *) ckalloc((unsigned) (numOld * sizeof(Tk_Uid)));
+	}
+	memcpy((void *) oldUids, oldTagsPtr->tagPtr, numOld * sizeof(Tk_Uid));
+    }
+    result = (*itemPtr->typePtr->configProc)(interp,
+	    (Tk_PathCanvas) canvasPtr, itemPtr, objc, objv,
+	    TK_CONFIG_ARGV_ONLY);
+    if (itemPtr->pathTagsPtr != oldTagsPtr) {
+	for (i = 0; i < numOld; i++) {
+	    if (!ItemHasTag(itemPtr, oldUids[i])) {
+		TagIndexRemove(canvasPtr, itemPtr, oldUids[i]);
+	    }
+	}
+	TagIndexAddItem(canvasPtr, itemPtr);
+    }
+    if (oldUids != staticUids) {
+	ckfree((char *) oldUids);
+    }
+    return result;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ItemHasTag --
+ *
+ *	Checks if item has a specific tag.
+ *
+ * Results:
+ *	1 if the tag was found, 0 else.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ItemHasTag(Tk_PathItem *itemPtr, Tk_Uid uid)
+{
+    Tk_PathTags *ptagsPtr = itemPtr->pathTagsPtr;
+    int i;
+    
+    if (ptagsPtr != NULL) {
+	for (i = 0; i < ptagsPtr->numTags; i++) {
+	    if (ptagsPtr->tagPtr[i] == uid) {
+		return 1;
+	    }
+	}
+    }
+    return 0;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TagIndexAdd, TagIndexRemove, TagIndexAddItem, TagIndexRemoveItem --
+ *
+ *	Maintains the tag index which maps each tag Uid to a hash table
+ *	of all items having that tag. This makes single tag searches
+ *	independent of the total number of items in the canvas.
+ *	It must be updated everywhere the tags of an item change.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Tag index updated, memory allocated or freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+TagIndexAdd(TkPathCanvas *canvasPtr, Tk_PathItem *itemPtr, Tk_Uid uid)
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashTable *tablePtr;
+    int isNew;
+
+    hPtr = Tcl_CreateHashEntry(&canvasPtr->tagIndexTable, (char *) uid, 
+	    &isNew);
+    if (isNew) {
+	tablePtr = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
+	Tcl_InitHashTable(tablePtr, TCL_ONE_WORD_KEYS);
+	Tcl_SetHashValue(hPtr, tablePtr);
+    } else {
+	tablePtr = (Tcl_HashTable *) Tcl_GetHashValue(hPtr);
+    }
+    Tcl_CreateHashEntry(tablePtr, (char *) itemPtr, &isNew);
+}
+
+static void
+TagIndexRemove(TkPathCanvas *canvasPtr, Tk_PathItem *itemPtr, Tk_Uid uid)
+{
+    Tcl_HashEntry *hPtr, *itemHPtr;
+    Tcl_HashTable *tablePtr;
+
+    hPtr = Tcl_FindHashEntry(&canvasPtr->tagIndexTable, (char *) uid);
+    if (hPtr == NULL) {
+	return;
+    }
+    tablePtr = (Tcl_HashTable *) Tcl_GetHashValue(hPtr);
+    itemHPtr = Tcl_FindHashEntry(tablePtr, (char *) itemPtr);
+    if (itemHPtr != NULL) {
+	Tcl_DeleteHashEntry(itemHPtr);
+    }
+    if (tablePtr->numEntries == 0) {
+	Tcl_DeleteHashTable(tablePtr);
+	ckfree((char *) tablePtr);
+	Tcl_DeleteHashEntry(hPtr);
+    }
+}
+
+static void
+TagIndexAddItem(TkPathCanvas *canvasPtr, Tk_PathItem *itemPtr)
+{
+    Tk_PathTags *ptagsPtr = itemPtr->pathTagsPtr;
+    int i;
+    
+    if (ptagsPtr != NULL) {
+	for (i = 0; i < ptagsPtr->numTags; i++) {
+	    TagIndexAdd(canvasPtr, itemPtr, ptagsPtr->tagPtr[i]);
+	}
+    }
+}
+
+static void
+TagIndexRemoveItem(TkPathCanvas *canvasPtr, Tk_PathItem *itemPtr)
+{
+    Tk_PathTags *ptagsPtr = itemPtr->pathTagsPtr;
+    int i;
+    
+    if (ptagsPtr != NULL) {
+	for (i = 0; i < ptagsPtr->numTags; i++) {
+	    TagIndexRemove(canvasPtr, itemPtr, ptagsPtr->tagPtr[i]);
+	}
+    }
+}
+
+static void
+TagIndexFree(TkPathCanvas *canvasPtr)
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    Tcl_HashTable *tablePtr;
+
+    for (hPtr = Tcl_FirstHashEntry(&canvasPtr->tagIndexTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	tablePtr = (Tcl_HashTable *) Tcl_GetHashValue(hPtr);
+	Tcl_DeleteHashTable(tablePtr);
+	ckfree((char *) tablePtr);
+    }
+    Tcl_DeleteHashTable(&canvasPtr->tagIndexTable);
 }
 
 /*
- *----------------------------------------------------------------------
+ *--------------------------------------------------------------
  *
- * ItemDelete --
+ * CanvasUpdateDisplayOrder --
  *
- *	Recursively frees all resources associated with an Item and its
- *	descendants and removes it from display list.
+ *	Renumbers the displayOrder of all items if they have been
+ *	invalidated by restacking or reparenting items.
  *
  * Results:
  *	None.
  *
  * Side effects:
- *	Items are removed from their parent and freed.
+ *	displayOrder updated for all items.
  *
- *----------------------------------------------------------------------
+ *--------------------------------------------------------------
  */
 
 static void
-ItemDelete(TkPathCanvas *canvasPtr, Tk_PathItem *itemPtr)
+CanvasUpdateDisplayOrder(TkPathCanvas *canvasPtr)
 {
-    Tcl_HashEntry *entryPtr;
-    
-    /*
-     * Remove any children by recursively calling us.
-     * NB: This is very tricky code! Children updates
-     *     the itemPtr->firstChildPtr here via calls
-     *     to TkPathCanvasItemDetach.
-     */
-    while (itemPtr->firstChildPtr != NULL) {
-	ItemDelete(canvasPtr, itemPtr->firstChildPtr);
-    }
-
-    EventuallyRedrawItem((Tk_PathCanvas) canvasPtr, itemPtr);
-    if (canvasPtr->bindingTable != NULL) {
-	Tk_DeleteAllBindings(canvasPtr->bindingTable,
-			     (ClientData) itemPtr);
-    }
-    
-    /*
-     * The item type deleteProc is responsible for calling 
-     * Tk_FreeConfigOptions which will implicitly also clean up
-     * the Tk_PathTags via its custom free proc.
-     */
-    (*itemPtr->typePtr->deleteProc)((Tk_PathCanvas) canvasPtr, itemPtr,
-				    canvasPtr->display);
+    Tk_PathItem *itemPtr;
+    int order = 0;
 
-    entryPtr = Tcl_FindHashEntry(&canvasPtr->idTable,
-				 (char *) INT2PTR(itemPtr->id));
-    Tcl_DeleteHashEntry(entryPtr);
-    TkPathCanvasItemDetach(itemPtr);
-    
-    if (itemPtr == canvasPtr->currentItemPtr) {
-	canvasPtr->currentItemPtr = NULL;
-	canvasPtr->flags |= REPICK_NEEDED;
-    }
-    if (itemPtr == canvasPtr->newCurrentPtr) {
-	canvasPtr->newCurrentPtr = NULL;
-	canvasPtr->flags |= REPICK_NEEDED;
-    }
-    if (itemPtr == canvasPtr->textInfo.focusItemPtr) {
-	canvasPtr->textInfo.focusItemPtr = NULL;
-    }
-    if (itemPtr == canvasPtr->textInfo.selItemPtr) {
-	canvasPtr->textInfo.selItemPtr = NULL;
+    if (ItemDisplayOrder(canvasPtr->rootItemPtr) >= 0) {
+	return;
     }
-    if ((itemPtr == canvasPtr->hotPtr)
-	    || (itemPtr == canvasPtr->hotPrevPtr)) {
-	canvasPtr->hotPtr = NULL;
+    for (itemPtr = canvasPtr->rootItemPtr; itemPtr != NULL;
+	    itemPtr = TkPathCanvasItemIteratorNext(itemPtr)) {
+	ItemDisplayOrder(itemPtr) = order++;
     }
-    ckfree((char *) itemPtr);
 }
 
 static void
@@ -3921,6 +5034,68 @@ TagSearchExprDestroy(
     }
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * TagExprSetIntRep, TagExprFreeIntRep, TagExprDupIntRep --
+ *
+ *	Manage the compiled tag expression internal representation
+ *	of Tcl_Obj, see tagExprObjType.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory allocated or freed, objects internal rep changed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+TagExprSetIntRep(
+    Tcl_Obj *objPtr,		/* Object holding the tag expression. */
+    TagSearchExpr *expr)	/* Successfully compiled expression. */
+{
+    TagExprRep *repPtr;
+
+    repPtr = (TagExprRep *) ckalloc(TAG_EXPR_REP_SIZE(expr->length));
+    repPtr->uid = expr->uid;
+    repPtr->length = expr->length;
+    memcpy((void *) repPtr->uids, expr->uids, expr->length * sizeof(Tk_Uid));
+
+    /*
+     * The string rep must be kept since we don't have an
+     * updateStringProc.
+     */
+
+    Tcl_GetString(objPtr);
+    if ((objPtr->typePtr != NULL) && 
+	    (objPtr->typePtr->freeIntRepProc != NULL)) {
+	objPtr->typePtr->freeIntRepProc(objPtr);
+    }
+    objPtr->internalRep.otherValuePtr = (VOID *) repPtr;
+    objPtr->typePtr = &tagExprObjType;
+}
+
+static void
+TagExprFreeIntRep(Tcl_Obj *objPtr)
+{
+    ckfree((char *) objPtr->internalRep.otherValuePtr);
+    objPtr->typePtr = NULL;
+}
+
+static void
+TagExprDupIntRep(Tcl_Obj *srcPtr, Tcl_Obj *dupPtr)
+{
+    TagExprRep *srcRepPtr = (TagExprRep *) srcPtr->internalRep.otherValuePtr;
+    TagExprRep *repPtr;
+
+    repPtr = (TagExprRep *) ckalloc(TAG_EXPR_REP_SIZE(srcRepPtr->length));
+    memcpy((void *) repPtr, srcRepPtr, TAG_EXPR_REP_SIZE(srcRepPtr->length));
+    dupPtr->internalRep.otherValuePtr = (VOID *) repPtr;
+    dupPtr->typePtr = &tagExprObjType;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -3967,6 +5142,8 @@ TagSearchScan(
 
 	*searchPtrPtr = searchPtr = (TagSearch *) ckalloc(sizeof(TagSearch));
 	searchPtr->expr = NULL;
+	searchPtr->hits = NULL;
+	searchPtr->hitSpace = 0;
 
 	/*
 	 * Allocate buffer for rewritten tags (after de-escaping).
@@ -4003,6 +5180,34 @@ TagSearchScan(
     searchPtr->canvasPtr = canvasPtr;
     searchPtr->searchOver = 0;
     searchPtr->type = SEARCH_TYPE_EMPTY;
+    searchPtr->numHits = 0;
+    searchPtr->hitIndex = 0;
+
+    /*
+     * Reuse any compiled tag expression cached in the object.
+     */
+
+    if (tagObj->typePtr == &tagExprObjType) {
+	TagExprRep *repPtr = (TagExprRep *) tagObj->internalRep.otherValuePtr;
+	TagSearchExpr *expr = searchPtr->expr;
+
+	if (expr->allocated < repPtr->length) {
+	    if (expr->uids) {
+		ckfree((char *) expr->uids);
+	    }
+	    expr->allocated = repPtr->length;
+	    expr->uids = (Tk_Uid *)
+		    ckalloc((unsigned) (expr->allocated * sizeof(Tk_Uid)));
+	}
+	memcpy((void *) expr->uids, repPtr->uids,
+		repPtr->length * sizeof(Tk_Uid));
+	expr->uid = repPtr->uid;
+	expr->length = expr->index = repPtr->length;
+	searchPtr->string = tag;
+	searchPtr->stringIndex = 0;
+	searchPtr->type = SEARCH_TYPE_EXPR;
+	return TCL_OK;
+    }
 
     /*
      * Find the first matching item in one of several ways. If the tag is a
@@ -4080,6 +5285,7 @@ TagSearchScan(
 	    return TCL_ERROR;
 	}
 	searchPtr->expr->length = searchPtr->expr->index;
+	TagExprSetIntRep(tagObj, searchPtr->expr);
     } else if (searchPtr->expr->uid == GetStaticUids()->allUid) {
 	/*
 	 * All items match.
@@ -4121,6 +5327,9 @@ TagSearchDestroy(
 {
     if (searchPtr) {
 	TagSearchExprDestroy(searchPtr->expr);
+	if (searchPtr->hits != NULL) {
+	    ckfree((char *)searchPtr->hits);
+	}
 	ckfree((char *)searchPtr->rewritebuffer);
 	ckfree((char *)searchPtr);
     }
@@ -4536,6 +5745,55 @@ TagSearchEvalExpr(
     return result;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * CompareTagIndexHits, TagSearchNextHit --
+ *
+ *	Helpers for single tag searches using the tag index.
+ *	TagSearchNextHit returns the next item from the snapshot that
+ *	still exists and still has the tag.
+ *
+ * Results:
+ *	The next matching item or NULL.
+ *
+ * Side effects:
+ *	Advances the search.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+CompareTagIndexHits(CONST void *p1, CONST void *p2)
+{
+    return ((TagIndexHit *) p1)->displayOrder 
+	    - ((TagIndexHit *) p2)->displayOrder;
+}
+
+static Tk_PathItem *
+TagSearchNextHit(
+    TagSearch *searchPtr)	/* Record describing search in progress. */
+{
+    Tcl_HashEntry *entryPtr;
+    Tk_PathItem *itemPtr;
+
+    while (!searchPtr->searchOver
+	    && (searchPtr->hitIndex < searchPtr->numHits)) {
+	entryPtr = Tcl_FindHashEntry(&searchPtr->canvasPtr->idTable,
+		(char *) INT2PTR(searchPtr->hits[searchPtr->hitIndex++].id));
+	if (entryPtr == NULL) {
+	    continue;
+	}
+	itemPtr = (Tk_PathItem *) Tcl_GetHashValue(entryPtr);
+	if (ItemHasTag(itemPtr, searchPtr->expr->uid)) {
+	    searchPtr->currentPtr = itemPtr;
+	    return itemPtr;
+	}
+    }
+    searchPtr->searchOver = 1;
+    return NULL;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -4562,9 +5820,6 @@ TagSearchFirst(
     TagSearch *searchPtr)	/* Record describing tag search */
 {
     Tk_PathItem *itemPtr, *lastPtr;
-    Tk_Uid uid, *tagPtr;
-    Tk_PathTags *ptagsPtr;
-    int count;
 
     /*
      * Short circuit impossible searches for null tags.
@@ -4625,24 +5880,48 @@ TagSearchFirst(
 
     if (searchPtr->type == SEARCH_TYPE_TAG) {
 	/*
-	 * Optimized single-tag search
+	 * Optimized single-tag search using the tag index. Take a snapshot
+	 * of the matching items and sort it in display order.
 	 */
 
-	uid = searchPtr->expr->uid;
-	for (lastPtr = NULL, itemPtr = searchPtr->canvasPtr->rootItemPtr;
-		itemPtr != NULL; lastPtr = itemPtr, itemPtr = TkPathCanvasItemIteratorNext(itemPtr)) {
-	    ptagsPtr = itemPtr->pathTagsPtr;
-	    if (ptagsPtr != NULL) {
-		for (tagPtr = ptagsPtr->tagPtr, count = ptagsPtr->numTags;
-		     count > 0; tagPtr++, count--) {
-		    if (*tagPtr == uid) {
-			searchPtr->lastPtr = lastPtr;
-			searchPtr->currentPtr = itemPtr;
-			return itemPtr;
-		    }
-		}
-	    }
+	TkPathCanvas *canvasPtr = searchPtr->canvasPtr;
+	Tcl_HashEntry *hPtr;
+	Tcl_HashTable *tablePtr;
+	Tcl_HashSearch search;
+	TagIndexHit *hitPtr;
+
+	hPtr = Tcl_FindHashEntry(&canvasPtr->tagIndexTable,
+		(char *) searchPtr->expr->uid);
+	if (hPtr == NULL) {
+	    searchPtr->searchOver = 1;
+	    return NULL;
 	}
+	tablePtr = (Tcl_HashTable *) Tcl_GetHashValue(hPtr);
+	if (tablePtr->numEntries > searchPtr->hitSpace) {
+	    if (searchPtr->hits != NULL) {
+		ckfree((char *) searchPtr->hits);
+	    }
+	    searchPtr->hitSpace = tablePtr->numEntries;
+	    searchPtr->hits = (TagIndexHit *) ckalloc((unsigned)
+		    (searchPtr->hitSpace * sizeof(TagIndexHit)));
+	}
+	if (tablePtr->numEntries > 1) {
+	    CanvasUpdateDisplayOrder(canvasPtr);
+	}
+	hitPtr = searchPtr->hits;
+	for (hPtr = Tcl_FirstHashEntry(tablePtr, &search); hPtr != NULL;
+		hPtr = Tcl_NextHashEntry(&search), hitPtr++) {
+	    itemPtr = (Tk_PathItem *) Tcl_GetHashKey(tablePtr, hPtr);
+	    hitPtr->id = itemPtr->id;
+	    hitPtr->displayOrder = ItemDisplayOrder(itemPtr);
+	}
+	searchPtr->numHits = tablePtr->numEntries;
+	searchPtr->hitIndex = 0;
+	if (searchPtr->numHits > 1) {
+	    qsort((void *) searchPtr->hits, (size_t) searchPtr->numHits,
+		    sizeof(TagIndexHit), CompareTagIndexHits);
+	}
+	return TagSearchNextHit(searchPtr);
     } else {
 
 	/*
@@ -4690,9 +5969,10 @@ TagSearchNext(
     TagSearch *searchPtr)	/* Record describing search in progress. */
 {
     Tk_PathItem *itemPtr, *lastPtr;
-    Tk_PathTags *ptagsPtr;
-    Tk_Uid uid, *tagPtr;
-    int count;
+
+    if (searchPtr->type == SEARCH_TYPE_TAG) {
+	return TagSearchNextHit(searchPtr);
+    }
 
     /*
      * Find next item in list (this may not actually be a suitable one to
@@ -4731,30 +6011,6 @@ TagSearchNext(
 	return itemPtr;
     }
 
-    if (searchPtr->type == SEARCH_TYPE_TAG) {
-	/*
-	 * Optimized single-tag search
-	 */
-
-	uid = searchPtr->expr->uid;
-	for (; itemPtr != NULL; lastPtr = itemPtr, itemPtr = TkPathCanvasItemIteratorNext(itemPtr)) {
-	    ptagsPtr = itemPtr->pathTagsPtr;
-	    if (ptagsPtr != NULL) {
-		for (tagPtr = ptagsPtr->tagPtr, count = ptagsPtr->numTags;
-		     count > 0; tagPtr++, count--) {
-		    if (*tagPtr == uid) {
-			searchPtr->lastPtr = lastPtr;
-			searchPtr->currentPtr = itemPtr;
-			return itemPtr;
-		    }
-		}
-	    }
-	}
-	searchPtr->lastPtr = lastPtr;
-	searchPtr->searchOver = 1;
-	return NULL;
-    }
-
     /*
      * Else.... evaluate tag expression
      */
@@ -4796,6 +6052,7 @@ static void
 DoItem(
     Tcl_Interp *interp,		/* Interpreter in which to (possibly) record
 				 * item id. */
+    TkPathCanvas *canvasPtr,	/* Canvas containing item. */
     Tk_PathItem *itemPtr,	/* Item to (possibly) modify. */
     Tk_Uid tag)			/* Tag to add to those already present for
 				 * item, or NULL. */
@@ -4848,7 +6105,9 @@ DoItem(
 		    ckalloc((unsigned) (ptagsPtr->tagSpace * sizeof(Tk_Uid)));
 	    memcpy((void *) newTagPtr, ptagsPtr->tagPtr,
 		    ptagsPtr->numTags * sizeof(Tk_Uid));
-	    ckfree((char *) ptagsPtr->tagPtr);
+	    if (!TK_PATHTAGS_INLINE(ptagsPtr)) {
+		ckfree((char *) ptagsPtr->tagPtr);
+	    }
 	    ptagsPtr->tagPtr = newTagPtr;
 	}
 	
@@ -4862,6 +6121,7 @@ DoItem(
 
     *tagPtr = tag;
     ptagsPtr->numTags++;
+    TagIndexAdd(canvasPtr, itemPtr, tag);
 }
 
 /*
@@ -4915,12 +6175,14 @@ FindItems(
     Tk_Uid uid;
     int index, result;
     static CONST char *optionStrings[] = {
-	"above", "all", "below", "closest",
-	"enclosed", "overlapping", "withtag", NULL
+	"above", "all", "below", "closest", "closestmany",
+	"enclosed", "insidepolygon", "overlapping", "overlappingpolygon",
+	"withtag", NULL
     };
     enum options {
-	CANV_ABOVE, CANV_ALL, CANV_BELOW, CANV_CLOSEST,
-	CANV_ENCLOSED, CANV_OVERLAPPING, CANV_WITHTAG
+	CANV_ABOVE, CANV_ALL, CANV_BELOW, CANV_CLOSEST, CANV_CLOSESTMANY,
+	CANV_ENCLOSED, CANV_INSIDEPOLYGON, CANV_OVERLAPPING,
+	CANV_OVERLAPPINGPOLYGON, CANV_WITHTAG
     };
 
     if (newTag != NULL) {
@@ -4947,7 +6209,7 @@ FindItems(
 
 	/* We constrain this to siblings. */
 	if ((lastPtr != NULL) && (lastPtr->nextPtr != NULL)) {
-	    DoItem(interp, lastPtr->nextPtr, uid);
+	    DoItem(interp, canvasPtr, lastPtr->nextPtr, uid);
 	}
 	break;
     }
@@ -4958,7 +6220,7 @@ FindItems(
 	}
 	for (itemPtr = canvasPtr->rootItemPtr; itemPtr != NULL;
 		itemPtr = TkPathCanvasItemIteratorNext(itemPtr)) {
-	    DoItem(interp, itemPtr, uid);
+	    DoItem(interp, canvasPtr, itemPtr, uid);
 	}
 	break;
 
@@ -4973,7 +6235,7 @@ FindItems(
 	
 	    /* We constrain this to siblings. */
 	    if (itemPtr->prevPtr != NULL) {
-		DoItem(interp, itemPtr->prevPtr, uid);
+		DoItem(interp, canvasPtr, itemPtr->prevPtr, uid);
 	    }
 	}
 	break;
@@ -5067,7 +6329,7 @@ FindItems(
 		    itemPtr = canvasPtr->rootItemPtr;
 		}
 		if (itemPtr == startPtr) {
-		    DoItem(interp, closestPtr, uid);
+		    DoItem(interp, canvasPtr, closestPtr, uid);
 		    return TCL_OK;
 		}
 		if (itemPtr->state == TK_PATHSTATE_HIDDEN ||
@@ -5092,26 +6354,130 @@ FindItems(
 	}
 	break;
     }
+    case CANV_CLOSESTMANY:
+	if ((objc < first+2) || (objc > first+3)) {
+	    Tcl_WrongNumArgs(interp, first+1, objv, "coordList ?halo?");
+	    return TCL_ERROR;
+	}
+	return FindClosestMany(interp, canvasPtr, objv[first+1],
+		(objc > first+2) ? objv[first+2] : NULL, uid);
     case CANV_ENCLOSED:
 	if (objc != first+5) {
 	    Tcl_WrongNumArgs(interp, first+1, objv, "x1 y1 x2 y2");
 	    return TCL_ERROR;
 	}
 	return FindArea(interp, canvasPtr, objv+first+1, uid, 1);
+    case CANV_INSIDEPOLYGON:
+	if (objc != first+2) {
+	    Tcl_WrongNumArgs(interp, first+1, objv, "coordList");
+	    return TCL_ERROR;
+	}
+	return FindPolygon(interp, canvasPtr, objv[first+1], uid, 1);
     case CANV_OVERLAPPING:
 	if (objc != first+5) {
 	    Tcl_WrongNumArgs(interp, first+1, objv, "x1 y1 x2 y2");
 	    return TCL_ERROR;
 	}
 	return FindArea(interp, canvasPtr, objv+first+1, uid, 0);
+    case CANV_OVERLAPPINGPOLYGON:
+	if (objc != first+2) {
+	    Tcl_WrongNumArgs(interp, first+1, objv, "coordList");
+	    return TCL_ERROR;
+	}
+	return FindPolygon(interp, canvasPtr, objv[first+1], uid, 0);
     case CANV_WITHTAG:
 	if (objc != first+2) {
 	    Tcl_WrongNumArgs(interp, first+1, objv, "tagOrId");
 	    return TCL_ERROR;
 	}
-	FOR_EVERY_CANVAS_ITEM_MATCHING(objv[first+1], searchPtrPtr,
-		return TCL_ERROR) {
-	    DoItem(interp, itemPtr, uid);
+	FOR_EVERY_CANVAS_ITEM_MATCHING(objv[first+1], searchPtrPtr,
+		return TCL_ERROR) {
+	    DoItem(interp, canvasPtr, itemPtr, uid);
+	}
+    }
+    return TCL_OK;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * FindArea --
+ *
+ *	This function implements area searches for the "find" and "addtag"
+ *	options.
+ *
+ * Results:
+ *	A standard Tcl return value. If newTag is NULL, then a list of ids
+ *	from all the items overlapping or enclosed by the rectangle given by
+ *	objc is returned in the interp's result. If newTag is NULL, then the
+ *	normal the interp's result is an empty string. If an error occurs,
+ *	then the interp's result will hold an error message.
+ *
+ * Side effects:
+ *	If uid is non-NULL, then all the items overlapping or enclosed by the
+ *	area in objv have that tag added to their lists of tags.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+FindArea(
+    Tcl_Interp *interp,		/* Interpreter for error reporting and result
+				 * storing. */
+    TkPathCanvas *canvasPtr,	/* Canvas whose items are to be searched. */
+    Tcl_Obj *CONST *objv,	/* Array of four arguments that give the
+				 * coordinates of the rectangular area to
+				 * search. */
+    Tk_Uid uid,			/* If non-NULL, gives new tag to set on all
+				 * found items; if NULL, then ids of found
+				 * items are returned in the interp's
+				 * result. */
+    int enclosed)		/* 0 means overlapping or enclosed items are
+				 * OK, 1 means only enclosed items are OK. */
+{
+    double rect[4], tmp;
+    int x1, y1, x2, y2;
+    Tk_PathItem *itemPtr;
+
+    if ((Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr, objv[0],
+		&rect[0]) != TCL_OK)
+	    || (Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr, objv[1],
+		&rect[1]) != TCL_OK)
+	    || (Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr, objv[2],
+		&rect[2]) != TCL_OK)
+	    || (Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr, objv[3],
+		&rect[3]) != TCL_OK)) {
+	return TCL_ERROR;
+    }
+    if (rect[0] > rect[2]) {
+	tmp = rect[0]; rect[0] = rect[2]; rect[2] = tmp;
+    }
+    if (rect[1] > rect[3]) {
+	tmp = rect[1]; rect[1] = rect[3]; rect[3] = tmp;
+    }
+
+    /*
+     * Use an integer bounding box for a quick test, to avoid calling
+     * item-specific code except for items that are close.
+     */
+
+    x1 = (int) (rect[0]-1.0);
+    y1 = (int) (rect[1]-1.0);
+    x2 = (int) (rect[2]+1.0);
+    y2 = (int) (rect[3]+1.0);
+    for (itemPtr = canvasPtr->rootItemPtr; itemPtr != NULL;
+	    itemPtr = TkPathCanvasItemIteratorNext(itemPtr)) {
+	if (itemPtr->state == TK_PATHSTATE_HIDDEN || (itemPtr->state == TK_PATHSTATE_NULL &&
+		canvasPtr->canvas_state == TK_PATHSTATE_HIDDEN)) {
+	    continue;
+	}
+	if ((itemPtr->x1 >= x2) || (itemPtr->x2 <= x1)
+		|| (itemPtr->y1 >= y2) || (itemPtr->y2 <= y1)) {
+	    continue;
+	}
+	if ((*itemPtr->typePtr->areaProc)((Tk_PathCanvas) canvasPtr, itemPtr, rect)
+		>= enclosed) {
+	    DoItem(interp, canvasPtr, itemPtr, uid);
 	}
     }
     return TCL_OK;
@@ -5120,33 +6486,138 @@ FindItems(
 /*
  *--------------------------------------------------------------
  *
- * FindArea --
+ * PolygonToRect --
  *
- *	This function implements area searches for the "find" and "addtag"
- *	options.
+ *	Classifies a rectangle with respect to a closed polygon.
  *
  * Results:
- *	A standard Tcl return value. If newTag is NULL, then a list of ids
- *	from all the items overlapping or enclosed by the rectangle given by
- *	objc is returned in the interp's result. If newTag is NULL, then the
- *	normal the interp's result is an empty string. If an error occurs,
- *	then the interp's result will hold an error message.
+ *	1 if the rectangle is entirely inside the polygon, -1 if it
+ *	is entirely outside, and 0 if any polygon edge crosses it.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+PolygonToRect(
+    double *polyPtr,		/* Closed polygon; the first point is
+				 * duplicated in the last. */
+    int numPoints,		/* Number of points including the
+				 * duplicate. */
+    double *rectPtr)		/* x1 y1 x2 y2 of rectangle. */
+{
+    double center[2];
+    int i;
+
+    for (i = 0; i < numPoints-1; i++) {
+	if (TkLineToArea(polyPtr+2*i, polyPtr+2*i+2, rectPtr) >= 0) {
+	    return 0;
+	}
+    }
+    center[0] = (rectPtr[0] + rectPtr[2])/2.0;
+    center[1] = (rectPtr[1] + rectPtr[3])/2.0;
+    return (TkPolygonToPoint(polyPtr, numPoints, center) == 0.0) ? 1 : -1;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ItemPolygonSearch --
+ *
+ *	Recursive helper for FindPolygon. The rectangle is split in
+ *	quadrants until each part is either free of the item (tested
+ *	using the items areaProc), entirely inside or entirely outside
+ *	the polygon, or a pixel in size. This gives an answer accurate
+ *	to a pixel along the polygon edges for any item type, without
+ *	the need for item specific polygon code.
+ *
+ * Results:
+ *	If enclosed is 0, returns 1 if some part of the item inside
+ *	rectPtr overlaps the polygon. If enclosed is 1, returns 1 if
+ *	some part of the item inside rectPtr lies outside the polygon.
+ *	Otherwise 0 is returned.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ItemPolygonSearch(
+    TkPathCanvas *canvasPtr,
+    Tk_PathItem *itemPtr,
+    double *polyPtr,
+    int numPoints,
+    double *rectPtr,
+    int enclosed)
+{
+    double sub[4], midX, midY;
+    int i, where;
+
+    if ((*itemPtr->typePtr->areaProc)((Tk_PathCanvas) canvasPtr, itemPtr,
+	    rectPtr) < 0) {
+	return 0;
+    }
+    where = PolygonToRect(polyPtr, numPoints, rectPtr);
+    if (where != 0) {
+	return enclosed ? (where < 0) : (where > 0);
+    }
+    if ((rectPtr[2] - rectPtr[0] <= 1.0) && (rectPtr[3] - rectPtr[1] <= 1.0)) {
+
+	/*
+	 * The item touches the polygon edge. This counts as overlapping
+	 * but not as enclosed.
+	 */
+
+	return 1;
+    }
+    midX = (rectPtr[0] + rectPtr[2])/2.0;
+    midY = (rectPtr[1] + rectPtr[3])/2.0;
+    for (i = 0; i < 4; i++) {
+	sub[0] = (i & 1) ? midX : rectPtr[0];
+	sub[2] = (i & 1) ? rectPtr[2] : midX;
+	sub[1] = (i & 2) ? midY : rectPtr[1];
+	sub[3] = (i & 2) ? rectPtr[3] : midY;
+	if (ItemPolygonSearch(canvasPtr, itemPtr, polyPtr, numPoints, sub,
+		enclosed)) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * FindPolygon --
+ *
+ *	This function implements polygon (lasso) searches for the "find"
+ *	and "addtag" options. Items are first checked using their bbox
+ *	against the bbox of the polygon and then against the polygon
+ *	itself. Only items whose bbox straddles a polygon edge need a
+ *	closer look by ItemPolygonSearch.
+ *
+ * Results:
+ *	A standard Tcl return value. If uid is NULL, then a list of ids
+ *	from all the items overlapping or enclosed by the polygon is
+ *	returned in the interp's result.
  *
  * Side effects:
  *	If uid is non-NULL, then all the items overlapping or enclosed by the
- *	area in objv have that tag added to their lists of tags.
+ *	polygon have that tag added to their lists of tags.
  *
  *--------------------------------------------------------------
  */
 
 static int
-FindArea(
+FindPolygon(
     Tcl_Interp *interp,		/* Interpreter for error reporting and result
 				 * storing. */
     TkPathCanvas *canvasPtr,	/* Canvas whose items are to be searched. */
-    Tcl_Obj *CONST *objv,	/* Array of four arguments that give the
-				 * coordinates of the rectangular area to
-				 * search. */
+    Tcl_Obj *polyObj,		/* Flat list of polygon coordinates. */
     Tk_Uid uid,			/* If non-NULL, gives new tag to set on all
 				 * found items; if NULL, then ids of found
 				 * items are returned in the interp's
@@ -5154,36 +6625,52 @@ FindArea(
     int enclosed)		/* 0 means overlapping or enclosed items are
 				 * OK, 1 means only enclosed items are OK. */
 {
-    double rect[4], tmp;
-    int x1, y1, x2, y2;
+    Tcl_Obj **objv;
     Tk_PathItem *itemPtr;
+    double *polyPtr, rect[4];
+    int objc, numPoints, i, where, found;
+    int x1, y1, x2, y2;
 
-    if ((Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr, objv[0],
-		&rect[0]) != TCL_OK)
-	    || (Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr, objv[1],
-		&rect[1]) != TCL_OK)
-	    || (Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr, objv[2],
-		&rect[2]) != TCL_OK)
-	    || (Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr, objv[3],
-		&rect[3]) != TCL_OK)) {
+    if (Tcl_ListObjGetElements(interp, polyObj, &objc, &objv) != TCL_OK) {
 	return TCL_ERROR;
     }
-    if (rect[0] > rect[2]) {
-	tmp = rect[0]; rect[0] = rect[2]; rect[2] = tmp;
-    }
-    if (rect[1] > rect[3]) {
-	tmp = rect[1]; rect[1] = rect[3]; rect[3] = tmp;
+    if ((objc & 1) || (objc < 6)) {
+	Tcl_AppendResult(interp, "polygon must have an even number of ",
+		"coordinates and at least three points", NULL);
+	return TCL_ERROR;
     }
 
     /*
-     * Use an integer bounding box for a quick test, to avoid calling
-     * item-specific code except for items that are close.
+     * Make room for closing the polygon.
      */
 
+    polyPtr = (double *) ckalloc((unsigned) ((objc+2) * sizeof(double)));
+    for (i = 0; i < objc; i++) {
+	if (Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr,
+		objv[i], polyPtr+i) != TCL_OK) {
+	    ckfree((char *) polyPtr);
+	    return TCL_ERROR;
+	}
+    }
+    numPoints = objc/2;
+    if ((polyPtr[0] != polyPtr[objc-2]) || (polyPtr[1] != polyPtr[objc-1])) {
+	polyPtr[objc] = polyPtr[0];
+	polyPtr[objc+1] = polyPtr[1];
+	numPoints++;
+    }
+    rect[0] = rect[2] = polyPtr[0];
+    rect[1] = rect[3] = polyPtr[1];
+    for (i = 1; i < numPoints; i++) {
+	rect[0] = MIN(rect[0], polyPtr[2*i]);
+	rect[2] = MAX(rect[2], polyPtr[2*i]);
+	rect[1] = MIN(rect[1], polyPtr[2*i+1]);
+	rect[3] = MAX(rect[3], polyPtr[2*i+1]);
+    }
     x1 = (int) (rect[0]-1.0);
     y1 = (int) (rect[1]-1.0);
     x2 = (int) (rect[2]+1.0);
     y2 = (int) (rect[3]+1.0);
+
     for (itemPtr = canvasPtr->rootItemPtr; itemPtr != NULL;
 	    itemPtr = TkPathCanvasItemIteratorNext(itemPtr)) {
 	if (itemPtr->state == TK_PATHSTATE_HIDDEN || (itemPtr->state == TK_PATHSTATE_NULL &&
@@ -5194,14 +6681,438 @@ FindArea(
 		|| (itemPtr->y1 >= y2) || (itemPtr->y2 <= y1)) {
 	    continue;
 	}
-	if ((*itemPtr->typePtr->areaProc)((Tk_PathCanvas) canvasPtr, itemPtr, rect)
-		>= enclosed) {
-	    DoItem(interp, itemPtr, uid);
+	if (enclosed && ((itemPtr->x1 < x1) || (itemPtr->x2 > x2)
+		|| (itemPtr->y1 < y1) || (itemPtr->y2 > y2))) {
+	    continue;
+	}
+	rect[0] = itemPtr->x1;
+	rect[1] = itemPtr->y1;
+	rect[2] = itemPtr->x2;
+	rect[3] = itemPtr->y2;
+	where = PolygonToRect(polyPtr, numPoints, rect);
+	if (where > 0) {
+	    found = ((*itemPtr->typePtr->areaProc)((Tk_PathCanvas) canvasPtr,
+		    itemPtr, rect) >= 0);
+	} else if (where < 0) {
+	    found = 0;
+	} else {
+	    found = ItemPolygonSearch(canvasPtr, itemPtr, polyPtr, numPoints,
+		    rect, enclosed);
+	    if (enclosed) {
+		found = !found && ((*itemPtr->typePtr->areaProc)(
+			(Tk_PathCanvas) canvasPtr, itemPtr, rect) >= 0);
+	    }
+	}
+	if (found) {
+	    DoItem(interp, canvasPtr, itemPtr, uid);
 	}
     }
+    ckfree((char *) polyPtr);
     return TCL_OK;
 }
-
+
+/*
+ *--------------------------------------------------------------
+ *
+ * FindClosestMany --
+ *
+ *	This function implements the "closestmany" search for the "find"
+ *	and "addtag" options. It does the same thing as "closest" for
+ *	each point in a list, but the item tree is only walked once:
+ *	all visible items and their bounding boxes are collected into a
+ *	flat candidate array which is then bucketed into a uniform grid
+ *	shared by all points. Each point only looks at the cells around
+ *	it, ring by ring, until no remaining cell can hold an item that
+ *	beats the closest one found so far.
+ *
+ * Results:
+ *	A standard Tcl return value. If uid is NULL, then a list with one
+ *	item id for each point is returned in the interp's result. If no
+ *	item is visible an empty element is returned for each point.
+ *
+ * Side effects:
+ *	If uid is non-NULL, then all the items closest to any of the points
+ *	have that tag added to their lists of tags.
+ *
+ *--------------------------------------------------------------
+ */
+
+typedef struct ClosestCandidate {
+    int x1, y1, x2, y2;		/* Copy of the items bbox. */
+    Tk_PathItem *itemPtr;
+    int stamp;			/* Last point this candidate was tried
+				 * for, so items spanning several cells
+				 * are only measured once per point. */
+} ClosestCandidate;
+
+typedef struct ClosestGrid {
+    double x0, y0;		/* Top left corner of the grid. */
+    double cellWidth, cellHeight;
+    int nx, ny;			/* Number of cells in each direction. */
+    int *cellStart;		/* Index into cellCands of the first
+				 * candidate of each cell; nx*ny+1 long. */
+    int *cellCands;		/* Candidate indices, cell by cell. */
+    int *largeCands;		/* Candidates spanning too many cells to
+				 * be bucketed; tried for every point. */
+    int numLarge;
+} ClosestGrid;
+
+#define CLOSEST_STATIC_CANDIDATES 64
+#define CLOSEST_GRID_MAX_CELLS	1024	/* Cells in each direction. */
+#define CLOSEST_GRID_MAX_SPAN	16	/* Cells covered by a bucketed
+					 * candidate. */
+
+static int
+ClosestGridCell(
+    double coord, double origin, double cellSize, int numCells)
+{
+    double cell = floor((coord - origin) / cellSize);
+
+    if (cell < 0.0) {
+	return 0;
+    } else if (cell >= numCells) {
+	return numCells - 1;
+    }
+    return (int) cell;
+}
+
+/*
+ * Buckets all candidates but the first one, which is the root item, into
+ * the grid.
+ */
+
+static void
+ClosestGridBuild(
+    ClosestGrid *gridPtr,
+    ClosestCandidate *cands,
+    int numCands)
+{
+    ClosestCandidate *candPtr;
+    int i, j, k, i1, j1, i2, j2, numCells, numEntries, n;
+    double x1, y1, x2, y2;
+
+    x1 = y1 = DBL_MAX;
+    x2 = y2 = -DBL_MAX;
+    for (k = 1, candPtr = cands + 1; k < numCands; k++, candPtr++) {
+	x1 = MIN(x1, candPtr->x1);
+	y1 = MIN(y1, candPtr->y1);
+	x2 = MAX(x2, candPtr->x2);
+	y2 = MAX(y2, candPtr->y2);
+    }
+    n = (int) ceil(sqrt((double) numCands));
+    n = MAX(1, MIN(n, CLOSEST_GRID_MAX_CELLS));
+    gridPtr->nx = gridPtr->ny = n;
+    gridPtr->x0 = x1;
+    gridPtr->y0 = y1;
+    gridPtr->cellWidth = MAX((x2 - x1) / n, 1.0);
+    gridPtr->cellHeight = MAX((y2 - y1) / n, 1.0);
+    numCells = n * n;
+
+    /*
+     * Count the entries of each cell, turn the counts into start
+     * indices, then fill in the candidates.
+     */
+
+    gridPtr->cellStart = (int *) ckalloc((unsigned)
+	    ((numCells + 1) * sizeof(int)));
+    memset(gridPtr->cellStart, 0, (numCells + 1) * sizeof(int));
+    gridPtr->largeCands = (int *) ckalloc((unsigned)
+	    (MAX(numCands, 1) * sizeof(int)));
+    gridPtr->numLarge = 0;
+    numEntries = 0;
+    for (k = 1, candPtr = cands + 1; k < numCands; k++, candPtr++) {
+	i1 = ClosestGridCell(candPtr->x1, gridPtr->x0, gridPtr->cellWidth, n);
+	i2 = ClosestGridCell(candPtr->x2, gridPtr->x0, gridPtr->cellWidth, n);
+	j1 = ClosestGridCell(candPtr->y1, gridPtr->y0, gridPtr->cellHeight, n);
+	j2 = ClosestGridCell(candPtr->y2, gridPtr->y0, gridPtr->cellHeight, n);
+	if ((i2 - i1 + 1) * (j2 - j1 + 1) > CLOSEST_GRID_MAX_SPAN) {
+	    gridPtr->largeCands[gridPtr->numLarge++] = k;
+	    continue;
+	}
+	for (j = j1; j <= j2; j++) {
+	    for (i = i1; i <= i2; i++) {
+		gridPtr->cellStart[j * n + i + 1]++;
+		numEntries++;
+	    }
+	}
+    }
+    for (i = 0; i < numCells; i++) {
+	gridPtr->cellStart[i + 1] += gridPtr->cellStart[i];
+    }
+    gridPtr->cellCands = (int *) ckalloc((unsigned)
+	    (MAX(numEntries, 1) * sizeof(int)));
+    for (k = 1, candPtr = cands + 1; k < numCands; k++, candPtr++) {
+	i1 = ClosestGridCell(candPtr->x1, gridPtr->x0, gridPtr->cellWidth, n);
+	i2 = ClosestGridCell(candPtr->x2, gridPtr->x0, gridPtr->cellWidth, n);
+	j1 = ClosestGridCell(candPtr->y1, gridPtr->y0, gridPtr->cellHeight, n);
+	j2 = ClosestGridCell(candPtr->y2, gridPtr->y0, gridPtr->cellHeight, n);
+	if ((i2 - i1 + 1) * (j2 - j1 + 1) > CLOSEST_GRID_MAX_SPAN) {
+	    continue;
+	}
+	for (j = j1; j <= j2; j++) {
+	    for (i = i1; i <= i2; i++) {
+		gridPtr->cellCands[gridPtr->cellStart[j * n + i]++] = k;
+	    }
+	}
+    }
+
+    /*
+     * The fill pass moved each start index to the end of its cell, which
+     * is the start of the next one.
+     */
+
+    for (i = numCells; i > 0; i--) {
+	gridPtr->cellStart[i] = gridPtr->cellStart[i - 1];
+    }
+    gridPtr->cellStart[0] = 0;
+}
+
+/*
+ * Tries one candidate against the closest one so far. Same rules as for
+ * "closest": the bbox must overlap the search window, the smallest
+ * distance wins and ties go to the item highest up in the display list.
+ */
+
+typedef struct ClosestSearch {
+    TkPathCanvas *canvasPtr;
+    double coords[2];
+    double halo;
+    int stamp;
+    double closestDist;
+    ClosestCandidate *bestPtr;
+    double window;		/* Half the side of the search window:
+				 * closestDist + halo + 1. */
+} ClosestSearch;
+
+static void
+ClosestTry(
+    ClosestSearch *searchPtr,
+    ClosestCandidate *candPtr)
+{
+    double newDist;
+
+    if (candPtr->stamp == searchPtr->stamp) {
+	return;
+    }
+    candPtr->stamp = searchPtr->stamp;
+    if ((candPtr->x1 >= searchPtr->coords[0] + searchPtr->window)
+	    || (candPtr->x2 <= searchPtr->coords[0] - searchPtr->window)
+	    || (candPtr->y1 >= searchPtr->coords[1] + searchPtr->window)
+	    || (candPtr->y2 <= searchPtr->coords[1] - searchPtr->window)) {
+	return;
+    }
+    newDist = (*candPtr->itemPtr->typePtr->pointProc)(
+	    (Tk_PathCanvas) searchPtr->canvasPtr, candPtr->itemPtr,
+	    searchPtr->coords) - searchPtr->halo;
+    if (newDist < 0.0) {
+	newDist = 0.0;
+    }
+    if ((newDist < searchPtr->closestDist)
+	    || ((newDist == searchPtr->closestDist)
+	    && (candPtr > searchPtr->bestPtr))) {
+	searchPtr->closestDist = newDist;
+	searchPtr->bestPtr = candPtr;
+	searchPtr->window = newDist + searchPtr->halo + 1.0;
+    }
+}
+
+static int
+FindClosestMany(
+    Tcl_Interp *interp,		/* Interpreter for error reporting and result
+				 * storing. */
+    TkPathCanvas *canvasPtr,	/* Canvas whose items are to be searched. */
+    Tcl_Obj *pointsObj,		/* Flat list of x y coordinates. */
+    Tcl_Obj *haloObj,		/* Halo distance or NULL. */
+    Tk_Uid uid)			/* If non-NULL, gives new tag to set on all
+				 * found items; if NULL, then ids of found
+				 * items are returned in the interp's
+				 * result. */
+{
+    ClosestCandidate staticCands[CLOSEST_STATIC_CANDIDATES];
+    ClosestCandidate *cands = staticCands, *candPtr;
+    ClosestGrid grid;
+    ClosestSearch search;
+    Tk_PathItem *itemPtr;
+    Tcl_Obj **pointsv;
+    int numPoints, numCands, candSpace, i, j, k, r, cx, cy, result;
+    int iMin, iMax, jMin, jMax;
+    double halo, ringDist;
+
+    if (Tcl_ListObjGetElements(interp, pointsObj, &numPoints, &pointsv)
+	    != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (numPoints & 1) {
+	Tcl_AppendResult(interp, "coordinate list must have an even ",
+		"number of elements", NULL);
+	return TCL_ERROR;
+    }
+    halo = 0.0;
+    if (haloObj != NULL) {
+	if (Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr,
+		haloObj, &halo) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (halo < 0.0) {
+	    Tcl_AppendResult(interp, "can't have negative halo value \"",
+		    Tcl_GetString(haloObj), "\"", NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    /*
+     * Collect the candidates once, in display order.
+     */
+
+    numCands = 0;
+    candSpace = CLOSEST_STATIC_CANDIDATES;
+    for (itemPtr = canvasPtr->rootItemPtr; itemPtr != NULL;
+	    itemPtr = TkPathCanvasItemIteratorNext(itemPtr)) {
+	if (itemPtr->state == TK_PATHSTATE_HIDDEN ||
+		(itemPtr->state == TK_PATHSTATE_NULL &&
+		canvasPtr->canvas_state == TK_PATHSTATE_HIDDEN)) {
+	    continue;
+	}
+	if (numCands == candSpace) {
+	    ClosestCandidate *newCands;
+
+	    candSpace *= 2;
+	    newCands = (ClosestCandidate *)
+		    ckalloc((unsigned) (candSpace * sizeof(ClosestCandidate)));
+	    memcpy((void *) newCands, cands,
+		    numCands * sizeof(ClosestCandidate));
+	    if (cands != staticCands) {
+		ckfree((char *) cands);
+	    }
+	    cands = newCands;
+	}
+	candPtr = cands + numCands;
+	candPtr->x1 = itemPtr->x1;
+	candPtr->y1 = itemPtr->y1;
+	candPtr->x2 = itemPtr->x2;
+	candPtr->y2 = itemPtr->y2;
+	candPtr->itemPtr = itemPtr;
+	candPtr->stamp = -1;
+	numCands++;
+    }
+    if (numCands == 0) {
+	for (i = 0; i < numPoints; i += 2) {
+	    if (uid == NULL) {
+		Tcl_AppendElement(interp, "");
+	    }
+	}
+	return TCL_OK;
+    }
+    ClosestGridBuild(&grid, cands, numCands);
+
+    result = TCL_OK;
+    search.canvasPtr = canvasPtr;
+    search.halo = halo;
+    for (i = 0; i < numPoints; i += 2) {
+	if ((Tk_PathCanvasGetCoordFromObj(interp, (Tk_PathCanvas) canvasPtr,
+		pointsv[i], &search.coords[0]) != TCL_OK)
+		|| (Tk_PathCanvasGetCoordFromObj(interp,
+		(Tk_PathCanvas) canvasPtr, pointsv[i+1], &search.coords[1])
+		!= TCL_OK)) {
+	    result = TCL_ERROR;
+	    break;
+	}
+
+	/*
+	 * The first candidate is the root item which, like in "closest",
+	 * is the initial best one. Then come the candidates too large for
+	 * the grid.
+	 */
+
+	search.stamp = i;
+	search.bestPtr = cands;
+	search.closestDist = (*cands->itemPtr->typePtr->pointProc)(
+		(Tk_PathCanvas) canvasPtr, cands->itemPtr, search.coords)
+		- halo;
+	if (search.closestDist < 0.0) {
+	    search.closestDist = 0.0;
+	}
+	search.window = search.closestDist + halo + 1.0;
+	for (k = 0; k < grid.numLarge; k++) {
+	    ClosestTry(&search, cands + grid.largeCands[k]);
+	}
+
+	/*
+	 * Walk the cells in square rings around the cell of the point,
+	 * clipped to the grid. Before each ring, ringDist is the least
+	 * distance along either axis from the point to any of its cells;
+	 * once that is outside the search window no further ring can
+	 * contribute.
+	 */
+
+	cx = ClosestGridCell(search.coords[0], grid.x0, grid.cellWidth,
+		grid.nx);
+	cy = ClosestGridCell(search.coords[1], grid.y0, grid.cellHeight,
+		grid.ny);
+	for (r = 0; ; r++) {
+	    ringDist = DBL_MAX;
+	    if (r == 0) {
+		ringDist = 0.0;
+	    } else {
+		if (cx - r >= 0) {
+		    ringDist = MIN(ringDist, search.coords[0]
+			    - (grid.x0 + (cx - r + 1) * grid.cellWidth));
+		}
+		if (cx + r < grid.nx) {
+		    ringDist = MIN(ringDist, grid.x0 + (cx + r) * grid.cellWidth
+			    - search.coords[0]);
+		}
+		if (cy - r >= 0) {
+		    ringDist = MIN(ringDist, search.coords[1]
+			    - (grid.y0 + (cy - r + 1) * grid.cellHeight));
+		}
+		if (cy + r < grid.ny) {
+		    ringDist = MIN(ringDist, grid.y0 + (cy + r) * grid.cellHeight
+			    - search.coords[1]);
+		}
+	    }
+	    if (ringDist == DBL_MAX || ringDist > search.window) {
+		break;
+	    }
+	    iMin = MAX(cx - r, 0);
+	    iMax = MIN(cx + r, grid.nx - 1);
+	    jMin = MAX(cy - r, 0);
+	    jMax = MIN(cy + r, grid.ny - 1);
+	    for (j = jMin; j <= jMax; j++) {
+		int step = 1;
+
+		/*
+		 * Rows strictly inside the ring only have its two end cells.
+		 */
+
+		if ((j != cy - r) && (j != cy + r)) {
+		    step = MAX(2 * r, 1);
+		}
+		for (k = cx - r; k <= cx + r; k += step) {
+		    int *cellPtr, *endPtr;
+
+		    if (k < iMin || k > iMax) {
+			continue;
+		    }
+		    cellPtr = grid.cellCands + grid.cellStart[j * grid.nx + k];
+		    endPtr = grid.cellCands + grid.cellStart[j * grid.nx + k + 1];
+		    for (; cellPtr < endPtr; cellPtr++) {
+			ClosestTry(&search, cands + *cellPtr);
+		    }
+		}
+	    }
+	}
+	DoItem(interp, canvasPtr, search.bestPtr->itemPtr, uid);
+    }
+    ckfree((char *) grid.cellStart);
+    ckfree((char *) grid.cellCands);
+    ckfree((char *) grid.largeCands);
+    if (cands != staticCands) {
+	ckfree((char *) cands);
+    }
+    return result;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -5358,6 +7269,7 @@ RelinkItems(
     if (parentPtr->lastChildPtr == prevPtr) {
 	parentPtr->lastChildPtr = lastMovePtr;
     }
+    ItemDisplayOrder(rootItemPtr) = -1;
 
 #ifndef USE_OLD_TAG_SEARCH
     return TCL_OK;
@@ -5507,6 +7419,10 @@ PickCurrentItem(
     SearchUids *searchUids = GetStaticUids();
 #endif
 
+    if (canvasPtr->flags & ITEM_BBOX_DIRTY) {
+	UpdateItemBboxes(canvasPtr);
+    }
+
     /*
      * Check whether or not a button is down. If so, we'll log entry and exit
      * into and out of the current item, but not entry into any other item.
@@ -5641,6 +7557,15 @@ PickCurrentItem(
 		    break;
 		}
 	    }
+#ifdef USE_OLD_TAG_SEARCH
+	    if (!ItemHasTag(itemPtr, Tk_GetUid("current"))) {
+		TagIndexRemove(canvasPtr, itemPtr, Tk_GetUid("current"));
+	    }
+#else /* USE_OLD_TAG_SEARCH */
+	    if (!ItemHasTag(itemPtr, searchUids->currentUid)) {
+		TagIndexRemove(canvasPtr, itemPtr, searchUids->currentUid);
+	    }
+#endif /* USE_OLD_TAG_SEARCH */
 	}
 
 	/*
@@ -5674,9 +7599,9 @@ PickCurrentItem(
 	XEvent event;
 
 #ifdef USE_OLD_TAG_SEARCH
-	DoItem(NULL, canvasPtr->currentItemPtr, Tk_GetUid("current"));
+	DoItem(NULL, canvasPtr, canvasPtr->currentItemPtr, Tk_GetUid("current"));
 #else /* USE_OLD_TAG_SEARCH */
-	DoItem(NULL, canvasPtr->currentItemPtr, searchUids->currentUid);
+	DoItem(NULL, canvasPtr, canvasPtr->currentItemPtr, searchUids->currentUid);
 #endif /* USE_OLD_TAG_SEA */
 	if ((canvasPtr->currentItemPtr->redraw_flags & TK_ITEM_STATE_DEPENDANT &&
 		prevItemPtr != canvasPtr->currentItemPtr)) {
@@ -231,6 +231,15 @@ typedef struct TkPathCanvas {
 				 * Postscript for the canvas. NULL means no
 				 * Postscript is currently being generated. */
     Tcl_HashTable idTable;	/* Table of integer indices. */
+    Tcl_HashTable tagIndexTable;/* Maps a tag Uid to a hash table of
+				 * all items having this tag. */
+    struct ItemPool *itemPools;	/* Pools of item records, one per record
+				 * size, see ItemRecordAlloc. */
+    Tcl_HashTable useTable;	/* Maps the id of an item referenced by use
+				 * items to the list of those use items. */
+    struct UseRefs *changedRefsPtr;
+				/* Referenced items changed since the use
+				 * items were last updated. */
 // @@@ TODO: as pointers instead???
     Tcl_HashTable styleTable;	/* Table for styles.
 				 * This defines the namespace for style names. */
@@ -282,6 +291,18 @@ typedef struct TkPathCanvas {
  * BBOX_NOT_EMPTY -		1 means that the bounding box of the area that
  *				should be redrawn is not empty.
  * CANVAS_DELETED -
+ * USE_UPDATE_NEEDED -		1 means that an item referenced by use items
+ *				was changed or deleted, so the use items on
+ *				changedRefsPtr must get their bbox recomputed.
+ * DEFER_ITEM_BBOX -		1 means that a command changing many items
+ *				(itemconfigure, move, scale) is running, so
+ *				items only mark their bbox as dirty.
+ * KEEP_ITEM_BBOX -		1 means that the running itemconfigure only
+ *				sets options that cannot change the geometry,
+ *				so items keep their bbox as it is.
+ * ITEM_BBOX_DIRTY -		1 means that some items have ITEM_BBOX_DIRTY
+ *				set and need their bbox recomputed before it
+ *				is used.
  */
 
 #define REDRAW_PENDING		(1 << 0)
@@ -294,6 +315,10 @@ typedef struct TkPathCanvas {
 #define REPICK_IN_PROGRESS	(1 << 7)
 #define BBOX_NOT_EMPTY		(1 << 8)
 #define CANVAS_DELETED		(1 << 9)
+#define USE_UPDATE_NEEDED	(1 << 10)
+#define DEFER_ITEM_BBOX		(1 << 11)
+#define KEEP_ITEM_BBOX		(1 << 12)
+#define ITEM_BBOX_DIRTY		(1 << 13)
 
 /*
  * Flag bits for canvas items (redraw_flags):
@@ -302,9 +327,15 @@ typedef struct TkPathCanvas {
  *				are not yet registered using
  *				Tk_PathCanvasEventuallyRedraw(). It should still
  *				be done by the general canvas code.
+ * ITEM_REFERENCED -		1 means that the item is, or has been, the
+ *				geometry of some use item.
+ * BBOX_DIRTY -			1 means that the bbox of the item is out of
+ *				date and must be recomputed by its bboxProc.
  */
 
 #define FORCE_REDRAW		8
+#define ITEM_REFERENCED		16
+#define BBOX_DIRTY		32
 
 /*
  * This is an extended item record that is used for the new
@@ -316,10 +347,10 @@ typedef struct Tk_PathItemEx  {
     Tk_PathItem header;	    /* Generic stuff that's the same for all
                              * types.  MUST BE FIRST IN STRUCTURE. */
     Tk_PathCanvas canvas;   /* Canvas containing item. */
-    Tk_PathStyle style;	    /* Contains most drawing info. */
     Tcl_Obj *styleObj;	    /* Object with style name. */
     TkPathStyleInst *styleInst;
 			    /* The referenced style instance from styleObj. */
+    Tk_PathStyle style;	    /* Contains most drawing info. */
 
     /*
      *------------------------------------------------------------------
@@ -331,6 +362,29 @@ typedef struct Tk_PathItemEx  {
      */
 } Tk_PathItemEx;
 
+/*
+ * Lean items have no style options of their own, only a reference to a
+ * named style (-style) plus what they inherit from their parents. Their
+ * record starts with the fields below, which are the same as the first
+ * ones of Tk_PathItemEx, so code that only uses canvas, styleObj and
+ * styleInst may treat both alike. Item types using this record set
+ * TK_PATH_ITEMTYPE_LEAN in the flags (alwaysRedraw) of their type.
+ */
+
+typedef struct Tk_PathItemLean  {
+    Tk_PathItem header;	    /* Generic stuff that's the same for all
+                             * types.  MUST BE FIRST IN STRUCTURE. */
+    Tk_PathCanvas canvas;   /* Canvas containing item. */
+    Tcl_Obj *styleObj;	    /* Object with style name. */
+    TkPathStyleInst *styleInst;
+			    /* The referenced style instance from styleObj. */
+} Tk_PathItemLean;
+
+#define TK_PATH_ITEMTYPE_LEAN	(1 << 1)
+
+#define TkPathItemIsLean(itemPtr) \
+	((itemPtr)->typePtr->alwaysRedraw & TK_PATH_ITEMTYPE_LEAN)
+
 /*
  * Canvas-related functions that are shared among Tk modules but not exported
  * to the outside world:
@@ -344,6 +398,16 @@ MODULE_SCOPE int	    TkPathCanvTranslatePath(TkPathCanvas *canvPtr,
 MODULE_SCOPE Tk_PathTags *  TkPathAllocTagsFromObj(Tcl_Interp *interp, Tcl_Obj *valuePtr);
 MODULE_SCOPE int	    TkPathCanvasFindGroup(Tcl_Interp *interp, Tk_PathCanvas canvas, 
 				Tcl_Obj *parentObj, Tk_PathItem **parentPtrPtr);
+MODULE_SCOPE int	    TkPathCanvasFindItem(Tcl_Interp *interp, Tk_PathCanvas canvas, 
+				Tcl_Obj *tagObj, Tk_PathItem **itemPtrPtr);
+MODULE_SCOPE Tk_PathItem *  TkPathCanvasItemFromId(Tk_PathCanvas canvas, int id);
+MODULE_SCOPE void	    TkPathCanvasAddUseRef(Tk_PathCanvas canvas, int refId,
+				Tk_PathItem *useItemPtr);
+MODULE_SCOPE void	    TkPathCanvasRemoveUseRef(Tk_PathCanvas canvas, int refId,
+				Tk_PathItem *useItemPtr);
+MODULE_SCOPE int	    TkPathCanvasIsCoordsModifier(Tcl_Obj *objPtr);
+MODULE_SCOPE PathAtom *	    TkPathCanvasPathGeometry(Tk_PathItem *itemPtr,
+				int *maxNumSegmentsPtr, PathRect *bboxPtr);
 MODULE_SCOPE void	    TkPathCanvasSetParent(Tk_PathItem *parentPtr, Tk_PathItem *itemPtr);
 MODULE_SCOPE int	    TkPathCanvasGetDepth(Tk_PathItem *itemPtr);
 MODULE_SCOPE Tk_PathStyle   TkPathCanvasInheritStyle(Tk_PathItem *itemPtr, long flags);
@@ -357,6 +421,7 @@ MODULE_SCOPE void	    TkPathCanvasGroupBbox(Tk_PathCanvas canvas, Tk_PathItem *i
 				int *x1Ptr, int *y1Ptr, int *x2Ptr, int *y2Ptr);
 MODULE_SCOPE void	    TkPathCanvasUpdateGroupBbox(Tk_PathCanvas canvas, Tk_PathItem *itemPtr);
 MODULE_SCOPE void	    TkPathCanvasSetGroupDirtyBbox(Tk_PathItem *itemPtr);
+MODULE_SCOPE int	    TkPathCanvasDeferItemBbox(Tk_PathCanvas canvas, Tk_PathItem *itemPtr);
 MODULE_SCOPE Tk_PathItem *  TkPathCanvasItemIteratorNext(Tk_PathItem *itemPtr);
 MODULE_SCOPE Tk_PathItem *  TkPathCanvasItemIteratorPrev(Tk_PathItem *itemPtr);
 MODULE_SCOPE int	    TkPathCanvasItemExConfigure(Tcl_Interp *interp, Tk_PathCanvas canvas, 
@@ -393,13 +458,17 @@ MODULE_SCOPE Tk_PathItemType tkRectangleType, tkTextType, tkWindowType;
  
 MODULE_SCOPE Tk_PathItemType tkPathType;
 MODULE_SCOPE Tk_PathItemType tkPrectType;
+MODULE_SCOPE Tk_PathItemType tkLeanPrectType;
 MODULE_SCOPE Tk_PathItemType tkPlineType;
 MODULE_SCOPE Tk_PathItemType tkPolylineType;
 MODULE_SCOPE Tk_PathItemType tkPpolygonType;
 MODULE_SCOPE Tk_PathItemType tkCircleType;
 MODULE_SCOPE Tk_PathItemType tkEllipseType;
+MODULE_SCOPE Tk_PathItemType tkLeanCircleType;
+MODULE_SCOPE Tk_PathItemType tkLeanEllipseType;
 MODULE_SCOPE Tk_PathItemType tkPimageType;
 MODULE_SCOPE Tk_PathItemType tkPtextType;
 MODULE_SCOPE Tk_PathItemType tkGroupType;
+MODULE_SCOPE Tk_PathItemType tkUseType;
 
 #endif /* _TKPCANVAS */
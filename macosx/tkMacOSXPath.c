@@ -40,13 +40,6 @@
 #define FloatToFixed(a) ((Fixed)((float) (a) * fixed1))
 #endif
 
-extern int gAntiAlias;
-extern int gSurfaceCopyPremultiplyAlpha;
-extern int gDepixelize;
-
-/* For debugging. */
-extern Tcl_Interp *gInterp;
-
 const CGFloat kValidDomain[2] = {0, 1};
 const CGFloat kValidRange[8] = {0, 1, 0, 1, 0, 1, 0, 1};
 
@@ -57,6 +50,7 @@ typedef struct TkPathContext_ {
     CGContextRef    c;
     CGrafPtr        port;	/* QD graphics port, NULL for bitmaps. */
     char            *data;	/* bitmap data, NULL for windows. */
+    char            *photoData;	/* Straight alpha copy for photos, or NULL. */
     int             widthCode;  /* Used to depixelize the strokes:
                                  * 0: not integer width
                                  * 1: odd integer width
@@ -584,6 +578,7 @@ TkPathInitSurface(int width, int height)
     context->c = cgContext; 
     context->port = NULL;
     context->data = data;
+    context->photoData = NULL;
     context->clipRgn = NULL;
     // printf("...TkPathInitSurface()\n");
     return (TkPathContext) context;
@@ -950,6 +945,12 @@ TkPathImage(TkPathContext ctx, Tk_Image image, Tk_PhotoHandle photo,
     }
 }
 
+void
+TkPathImageChanged(Tk_PhotoHandle photo)
+{
+    /* Nothing is cached. */
+}
+
 void
 TkPathClosePath(TkPathContext ctx)
 {
@@ -1148,29 +1149,30 @@ TkPathSurfaceErase(TkPathContext ctx, double x, double y, double width, double h
 }
 
 void
-TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo)
+TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo,
+        int x, int y, int width, int height)
 {
     TkPathContext_ *context = (TkPathContext_ *) ctx;
     CGContextRef c = context->c;
     Tk_PhotoImageBlock block;
     unsigned char *data;
-    unsigned char *pixel;
-    int width, height;
     int bytesPerRow;
     
-    width = CGBitmapContextGetWidth(c);
-    height = CGBitmapContextGetHeight(c);
     data = CGBitmapContextGetData(c);
     bytesPerRow = CGBitmapContextGetBytesPerRow(c);
+    data += y*bytesPerRow + 4*x;
     
-    Tk_PhotoGetImage(photo, &block);    
-    pixel = (unsigned char *) ckalloc(height*bytesPerRow);
+    /* The bitmap is RGBA already so it is only converted to undo the alpha. */
     if (gSurfaceCopyPremultiplyAlpha) {
-        PathCopyBitsPremultipliedAlphaRGBA(data, pixel, width, height, bytesPerRow);
+        if (context->photoData == NULL) {
+            context->photoData = ckalloc(CGBitmapContextGetHeight(c)*bytesPerRow);
+        }
+        block.pixelPtr = (unsigned char *) context->photoData 
+                + y*bytesPerRow + 4*x;
+        PathCopyBitsPremultipliedAlphaRGBA(data, block.pixelPtr, width, height, bytesPerRow);
     } else {
-        memcpy(pixel, data, height*bytesPerRow);
+        block.pixelPtr = data;
     }
-    block.pixelPtr = pixel;
     block.width = width;
     block.height = height;
     block.pitch = bytesPerRow;
@@ -1180,7 +1182,16 @@ TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo
     block.offset[2] = 2;
     block.offset[3] = 3;
     // Should change this to check for errors...
-    Tk_PhotoPutBlock(interp, photo, &block, 0, 0, width, height, TK_PHOTO_COMPOSITE_OVERLAY);
+    Tk_PhotoPutBlock(interp, photo, &block, x, y, width, height, TK_PHOTO_COMPOSITE_OVERLAY);
+}
+
+int
+TkPathSurfaceToPng(Tcl_Interp *interp, TkPathContext ctx, Tcl_Channel chan,
+        int x, int y, int width, int height)
+{
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+            "writing png is not supported on this platform", -1));
+    return TCL_ERROR;
 }
 
 void		
@@ -1254,6 +1265,9 @@ TkPathFree(TkPathContext ctx)
     if (context->data) {
         ckfree(context->data);
     }
+    if (context->photoData) {
+        ckfree(context->photoData);
+    }
     ckfree((char *) ctx);
 }
 
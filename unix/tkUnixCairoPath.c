@@ -30,11 +30,6 @@
 #define GreenDoubleFromXColorPtr(xc)  ((double) ((((xc)->pixel >> 8) & 0xFF)) / 255.0)
 #define RedDoubleFromXColorPtr(xc)    ((double) ((((xc)->pixel >> 16) & 0xFF)) / 255.0)
 
-extern int gAntiAlias;
-extern int gSurfaceCopyPremultiplyAlpha;
-extern int gDepixelize;
-extern Tcl_Interp *gInterp;
-
 int kPathSmallEndian = 1;	/* Hardcoded. */
 
 /* @@@ Need to use cairo_image_surface_create_for_data() here since prior to 1.2
@@ -46,6 +41,7 @@ typedef struct PathSurfaceCairoRecord {
     int 			width;
     int				height;
     int 			stride;		/* the number of bytes between the start of rows in the buffer */
+    unsigned char*	photoData;	/* Straight alpha copy for photos, or NULL. */
 } PathSurfaceCairoRecord;
 
 /*
@@ -137,6 +133,7 @@ TkPathContext TkPathInitSurface(int width, int height)
     record->width = width;
     record->height = height;
     record->stride = stride;
+    record->photoData = NULL;
     c = cairo_create(surface);
     context->c = c;
     context->surface = surface;
@@ -292,33 +289,322 @@ cairo_filter_t convertInterpolationToCairoFilter(int interpolation)
     }
 }
 
-void
-TkPathImage(TkPathContext ctx, Tk_Image image, Tk_PhotoHandle photo,
-        double x, double y, double width0, double height0, double fillOpacity,
-        XColor *tintColor, double tintAmount, int interpolation, PathRect *srcRegion)
-{
-    TkPathContext_ *context = (TkPathContext_ *) ctx;
-    Tk_PhotoImageBlock block;
+/*
+ * Photos converted to cairo's premultiplied ARGB format are cached, since
+ * the conversion costs much more than painting the surface. Each photo
+ * has a short list of variants, one for each tint it is drawn with. The
+ * opacity is applied when painting and is not part of the key. The list
+ * is freed by TkPathImageChanged which the pimage item calls from its
+ * image changed proc, and when it lets go of the photo so that no entry
+ * outlives the items that would be told about changes to it.
+ *
+ * For drawing at small scales each variant also keeps a mip pyramid,
+ * where each level is half the size of the one before. The levels are
+ * made when first needed.
+ */
+
+typedef struct PathImageLevel {
     cairo_surface_t *surface;
-    cairo_format_t format;
-    unsigned char *data = NULL;
-    unsigned char *ptr = NULL;
+    unsigned char *data;
+    int width, height, stride;
+} PathImageLevel;
+
+#define PATH_IMAGE_MAX_LEVELS 12
+
+typedef struct PathImageCache {
+    PathImageLevel level[PATH_IMAGE_MAX_LEVELS];
+				/* Level 0 is the photo itself. */
+    int numLevels;		/* Number of levels made so far. */
+    unsigned char *pixelPtr;	/* The photo block that was converted, */
+    int width, height, pitch;	/* to detect a reused photo handle. */
+    unsigned long tintPixel;
+    double tintAmount;		/* 0.0 if not tinted. */
+    struct PathImageCache *nextPtr;
+} PathImageCache;
+
+#define PATH_IMAGE_CACHE_VARIANTS 4
+
+/*
+ * Photos belong to the thread of their interp, and so does the cache.
+ */
+
+typedef struct ThreadSpecificData {
+    Tcl_HashTable *imageCacheHashPtr;
+} ThreadSpecificData;
+
+static Tcl_ThreadDataKey dataKey;
+
+#define gImageCacheHashPtr (((ThreadSpecificData *) \
+	Tcl_GetThreadData(&dataKey, sizeof(ThreadSpecificData)))->imageCacheHashPtr)
+
+static void
+FreeImageCache(PathImageCache *cachePtr)
+{
+    PathImageCache *nextPtr;
+    int i;
+
+    while (cachePtr != NULL) {
+        nextPtr = cachePtr->nextPtr;
+        for (i = 0; i < cachePtr->numLevels; i++) {
+            cairo_surface_destroy(cachePtr->level[i].surface);
+            ckfree((char *) cachePtr->level[i].data);
+        }
+        ckfree((char *) cachePtr);
+        cachePtr = nextPtr;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ConvertPhotoBlock --
+ *
+ *	Converts the pixels of a photo to premultiplied ARGB in native
+ *	endian order, and tints them if tintColor is not NULL.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The pixels are stored in data, which has the pitch of the photo.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ConvertPhotoBlock(Tk_PhotoImageBlock *blockPtr, unsigned char *data,
+        XColor *tintColor, double tintAmount)
+{
+    unsigned char *ptr = data;
     unsigned char *srcPtr, *dstPtr;
     int srcR, srcG, srcB, srcA;		/* The source pixel offsets. */
     int dstR, dstG, dstB, dstA;		/* The destination pixel offsets. */
-    int pitch;
-    int iwidth, iheight;
+    int pitch = blockPtr->pitch;
+    int iwidth = blockPtr->width;
+    int iheight = blockPtr->height;
     int i, j;
-    double width, height;
-    cairo_filter_t filter;
 
-    /* Return value? */
-    Tk_PhotoGetImage(photo, &block);
-    iwidth = block.width;
-    iheight = block.height;
-    pitch = block.pitch;
-    width = (width0 == 0.0) ? (double) iwidth : width0;
-    height = (height0 == 0.0) ? (double) iheight : height0;
+    /* The offset array contains the offsets from the address of a 
+     * pixel to the addresses of the bytes containing the red, green, 
+     * blue and alpha (transparency) components.
+     *
+     * We need to copy pixel data from the source using the photo offsets
+     * to cairos ARGB format which is in *native* endian order; Switch!
+     */
+    srcR = blockPtr->offset[0];
+    srcG = blockPtr->offset[1]; 
+    srcB = blockPtr->offset[2];
+    srcA = blockPtr->offset[3];
+    dstR = 1;
+    dstG = 2;
+    dstB = 3;
+    dstA = 0;
+    if (kPathSmallEndian) {
+        dstR = 3-dstR, dstG = 3-dstG, dstB = 3-dstB, dstA = 3-dstA;
+    }
+
+    if (tintColor != NULL) {
+#ifdef TINT_INT_CALCULATION
+        /* calculate with integer arithmetic */
+        uint32_t tintR, tintG, tintB, uAmount, uRemain;
+        uAmount = (uint32_t)(tintAmount * 256.0);
+        uRemain = 256 - uAmount;
+        tintR = Red255FromXColorPtr(tintColor);
+        tintG = Green255FromXColorPtr(tintColor);
+        tintB = Blue255FromXColorPtr(tintColor);
+
+        for (i = 0; i < iheight; i++) {
+            srcPtr = blockPtr->pixelPtr + i*pitch;
+            dstPtr = ptr + i*pitch;
+            for (j = 0; j < iwidth; j++) {
+                // extract
+                uint32_t r = *(srcPtr+srcR);
+                uint32_t g = *(srcPtr+srcG);
+                uint32_t b = *(srcPtr+srcB);
+                uint32_t a = *(srcPtr+srcA);
+
+                // transform
+                uint32_t lumAmount = ((r * 6966 + g * 23436 + b * 2366) * uAmount) >> 23;  /* 0-256 */
+                r = (uRemain * r + lumAmount * tintR);
+                g = (uRemain * g + lumAmount * tintG);
+                b = (uRemain * b + lumAmount * tintB);
+
+                if (a != 255) {
+                    /* Cairo expects RGB premultiplied by alpha */
+                    r = r * a / 255;
+                    g = g * a / 255;
+                    b = b * a / 255;
+                }
+
+                // fix range
+                r = r>0xFFFF ? 0xFFFF : r;
+                g = g>0xFFFF ? 0xFFFF : g;
+                b = b>0xFFFF ? 0xFFFF : b;
+
+                // and put back
+                *(dstPtr+dstR) = r >> 8;
+                *(dstPtr+dstG) = g >> 8;
+                *(dstPtr+dstB) = b >> 8;
+                *(dstPtr+dstA) = a;
+                srcPtr += 4;
+                dstPtr += 4;
+            }
+        }
+#else
+        double tintR, tintG, tintB;
+        tintR = RedDoubleFromXColorPtr(tintColor);
+        tintG = GreenDoubleFromXColorPtr(tintColor);
+        tintB = BlueDoubleFromXColorPtr(tintColor);
+
+        for (i = 0; i < iheight; i++) {
+            srcPtr = blockPtr->pixelPtr + i*pitch;
+            dstPtr = ptr + i*pitch;
+            for (j = 0; j < iwidth; j++) {
+                // extract
+                int r = *(srcPtr+srcR);
+                int g = *(srcPtr+srcG);
+                int b = *(srcPtr+srcB);
+                int a = *(srcPtr+srcA);
+
+                // transform
+                int lum = (int)(0.2126*r + 0.7152*g + 0.0722*b);
+                r = (int)((1.0-tintAmount)*r + tintAmount*lum*tintR);
+                g = (int)((1.0-tintAmount)*g + tintAmount*lum*tintG);
+                b = (int)((1.0-tintAmount)*b + tintAmount*lum*tintB);
+
+                if (a != 255) {
+                    /* Cairo expects RGB premultiplied by alpha */
+                    r = r * a / 255;
+                    g = g * a / 255;
+                    b = b * a / 255;
+                }
+
+                // fix range
+                r = r<0 ? 0 : r>255 ? 255 : r;
+                g = g<0 ? 0 : g>255 ? 255 : g;
+                b = b<0 ? 0 : b>255 ? 255 : b;
+
+                // and put back
+                *(dstPtr+dstR) = r;
+                *(dstPtr+dstG) = g;
+                *(dstPtr+dstB) = b;
+                *(dstPtr+dstA) = a;
+                srcPtr += 4;
+                dstPtr += 4;
+            }
+        }
+#endif
+    } else if (kPathSmallEndian) {
+        PathCopyPhotoBitsPremultipliedBGRA(blockPtr, data);
+    } else {
+        for (i = 0; i < iheight; i++) {
+            srcPtr = blockPtr->pixelPtr + i*pitch;
+            dstPtr = ptr + i*pitch;
+            for (j = 0; j < iwidth; j++) {
+                unsigned int alpha = *(srcPtr+srcA);
+                *(dstPtr+dstA) = alpha;
+                if (alpha == 255) {
+                    *(dstPtr+dstR) = *(srcPtr+srcR);
+                    *(dstPtr+dstG) = *(srcPtr+srcG);
+                    *(dstPtr+dstB) = *(srcPtr+srcB);
+                } else {
+                    /* Cairo expects RGB premultiplied by alpha */
+                    *(dstPtr+dstR) = alpha * *(srcPtr+srcR) / 255;
+                    *(dstPtr+dstG) = alpha * *(srcPtr+srcG) / 255;
+                    *(dstPtr+dstB) = alpha * *(srcPtr+srcB) / 255;
+                }
+                srcPtr += 4;
+                dstPtr += 4;
+            }
+        }
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetImageCache --
+ *
+ *	Gets the cache entry with the pixels of a photo, converted and
+ *	tinted. Entries are cached per photo and tint.
+ *
+ * Results:
+ *	The entry, owned by the cache, or NULL if the photo has a
+ *	pixel format that isn't handled.
+ *
+ * Side effects:
+ *	May convert the photo and add it to the cache.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static PathImageCache *
+GetImageCache(Tk_PhotoHandle photo, Tk_PhotoImageBlock *blockPtr,
+        XColor *tintColor, double tintAmount)
+{
+    Tcl_HashEntry *hPtr;
+    PathImageCache *cachePtr, *prevPtr, *firstPtr;
+    PathImageLevel *levelPtr;
+    unsigned long tintPixel = 0;
+    int isNew, n;
+
+    if (blockPtr->pixelSize != 4) {
+        /* Could do something about this? */
+        fprintf(stderr, "TkPathImage: unaccepted pixel format: 1 pixel is %d bytes\n", 
+                blockPtr->pixelSize);
+        return NULL;
+    }
+    if ((tintColor != NULL) && (tintAmount > 0.0)) {
+        tintPixel = tintColor->pixel;
+        tintAmount = MIN(tintAmount, 1.0);
+    } else {
+        tintColor = NULL;
+        tintAmount = 0.0;
+    }
+    if (gImageCacheHashPtr == NULL) {
+        gImageCacheHashPtr = (Tcl_HashTable *) ckalloc(sizeof(Tcl_HashTable));
+        Tcl_InitHashTable(gImageCacheHashPtr, TCL_ONE_WORD_KEYS);
+    }
+    hPtr = Tcl_CreateHashEntry(gImageCacheHashPtr, (char *) photo, &isNew);
+    firstPtr = isNew ? NULL : (PathImageCache *) Tcl_GetHashValue(hPtr);
+    if ((firstPtr != NULL) && ((firstPtr->pixelPtr != blockPtr->pixelPtr)
+            || (firstPtr->width != blockPtr->width)
+            || (firstPtr->height != blockPtr->height)
+            || (firstPtr->pitch != blockPtr->pitch))) {
+        
+        /* Changed without us being told, or a new photo at the same address. */
+        FreeImageCache(firstPtr);
+        firstPtr = NULL;
+    }
+    for (cachePtr = firstPtr, prevPtr = NULL; cachePtr != NULL; 
+            prevPtr = cachePtr, cachePtr = cachePtr->nextPtr) {
+        if ((cachePtr->tintPixel == tintPixel) 
+                && (cachePtr->tintAmount == tintAmount)) {
+            if (prevPtr != NULL) {
+                /* Move to front so the least recently used is last. */
+                prevPtr->nextPtr = cachePtr->nextPtr;
+                cachePtr->nextPtr = firstPtr;
+                Tcl_SetHashValue(hPtr, cachePtr);
+            }
+            return cachePtr;
+        }
+    }
+    
+    /* Make room for the new variant by dropping the least recently used. */
+    for (cachePtr = firstPtr, n = 1; cachePtr != NULL; 
+            cachePtr = cachePtr->nextPtr, n++) {
+        if ((n == PATH_IMAGE_CACHE_VARIANTS-1) && (cachePtr->nextPtr != NULL)) {
+            FreeImageCache(cachePtr->nextPtr);
+            cachePtr->nextPtr = NULL;
+        }
+    }
+    cachePtr = (PathImageCache *) ckalloc(sizeof(PathImageCache));
+    levelPtr = &cachePtr->level[0];
+    levelPtr->data = (unsigned char *) ckalloc(blockPtr->pitch*blockPtr->height);
+    levelPtr->width = blockPtr->width;
+    levelPtr->height = blockPtr->height;
+    levelPtr->stride = blockPtr->pitch;
+    ConvertPhotoBlock(blockPtr, levelPtr->data, tintColor, tintAmount);
 
     /*
      * @format: the format of pixels in the buffer
@@ -338,164 +624,180 @@ TkPathImage(TkPathContext ctx, Tk_Image image, Tk_PhotoHandle photo,
      *   alpha is used. (That is, 50% transparent red is 0x80800000,
      *   not 0x80ff0000.)
      */
-    if (block.pixelSize == 4) {
-        format = CAIRO_FORMAT_ARGB32;
-        
-        /* The offset array contains the offsets from the address of a 
-         * pixel to the addresses of the bytes containing the red, green, 
-         * blue and alpha (transparency) components.
-         *
-         * We need to copy pixel data from the source using the photo offsets
-         * to cairos ARGB format which is in *native* endian order; Switch!
-         */
-        srcR = block.offset[0];
-        srcG = block.offset[1]; 
-        srcB = block.offset[2];
-        srcA = block.offset[3];
-        dstR = 1;
-        dstG = 2;
-        dstB = 3;
-        dstA = 0;
-        if (kPathSmallEndian) {
-            dstR = 3-dstR, dstG = 3-dstG, dstB = 3-dstB, dstA = 3-dstA;
-        }
+    levelPtr->surface = cairo_image_surface_create_for_data(
+            levelPtr->data,
+            CAIRO_FORMAT_ARGB32, 
+            blockPtr->width, blockPtr->height,
+            blockPtr->pitch);		/* stride */
+    cachePtr->numLevels = 1;
+    cachePtr->pixelPtr = blockPtr->pixelPtr;
+    cachePtr->width = blockPtr->width;
+    cachePtr->height = blockPtr->height;
+    cachePtr->pitch = blockPtr->pitch;
+    cachePtr->tintPixel = tintPixel;
+    cachePtr->tintAmount = tintAmount;
+    cachePtr->nextPtr = firstPtr;
+    Tcl_SetHashValue(hPtr, cachePtr);
+    return cachePtr;
+}
 
-        data = (unsigned char *) ckalloc(pitch*iheight);
-        ptr = data;
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetImageLevel --
+ *
+ *	Gets a level of the mip pyramid of a cached photo. Each level is
+ *	made from the one before by averaging 2x2 blocks of pixels, which
+ *	is right for premultiplied alpha. Odd sizes are rounded up and the
+ *	pixels of a last odd row or column are averaged 2x1 or 1x2, so a
+ *	level pixel always covers 2x2 pixels of the level before, and the
+ *	edges are kept. The pyramid ends at one pixel.
+ *
+ * Results:
+ *	The level asked for, or the smallest one if there are fewer.
+ *
+ * Side effects:
+ *	May make the missing levels.
+ *
+ *----------------------------------------------------------------------
+ */
 
-        if (tintColor && tintAmount > 0.0) {
-#ifdef TINT_INT_CALCULATION
-            /* calculate with integer arithmetic */
-            uint32_t tintR, tintG, tintB, uAmount, uRemain;
-            if (tintAmount > 1.0)
-                tintAmount = 1.0;
-            uAmount = (uint32_t)(tintAmount * 256.0);
-            uRemain = 256 - uAmount;
-            tintR = Red255FromXColorPtr(tintColor);
-            tintG = Green255FromXColorPtr(tintColor);
-            tintB = Blue255FromXColorPtr(tintColor);
-
-            for (i = 0; i < iheight; i++) {
-                srcPtr = block.pixelPtr + i*pitch;
-                dstPtr = ptr + i*pitch;
-                for (j = 0; j < iwidth; j++) {
-                    // extract
-                    uint32_t r = *(srcPtr+srcR);
-                    uint32_t g = *(srcPtr+srcG);
-                    uint32_t b = *(srcPtr+srcB);
-                    uint32_t a = *(srcPtr+srcA);
-
-                    // transform
-                    uint32_t lumAmount = ((r * 6966 + g * 23436 + b * 2366) * uAmount) >> 23;  /* 0-256 */
-                    r = (uRemain * r + lumAmount * tintR);
-                    g = (uRemain * g + lumAmount * tintG);
-                    b = (uRemain * b + lumAmount * tintB);
-
-                    if (a != 255) {
-                        /* Cairo expects RGB premultiplied by alpha */
-                        r = r * a / 255;
-                        g = g * a / 255;
-                        b = b * a / 255;
-                    }
-
-                    // fix range
-                    r = r>0xFFFF ? 0xFFFF : r;
-                    g = g>0xFFFF ? 0xFFFF : g;
-                    b = b>0xFFFF ? 0xFFFF : b;
-
-                    // and put back
-                    *(dstPtr+dstR) = r >> 8;
-                    *(dstPtr+dstG) = g >> 8;
-                    *(dstPtr+dstB) = b >> 8;
-                    *(dstPtr+dstA) = a;
-                    srcPtr += 4;
-                    dstPtr += 4;
-                }
-            }
-#else
-            double tintR, tintG, tintB;
-            if (tintAmount > 1.0)
-                tintAmount = 1.0;
-            tintR = RedDoubleFromXColorPtr(tintColor);
-            tintG = GreenDoubleFromXColorPtr(tintColor);
-            tintB = BlueDoubleFromXColorPtr(tintColor);
-
-            for (i = 0; i < iheight; i++) {
-                srcPtr = block.pixelPtr + i*pitch;
-                dstPtr = ptr + i*pitch;
-                for (j = 0; j < iwidth; j++) {
-                    // extract
-                    int r = *(srcPtr+srcR);
-                    int g = *(srcPtr+srcG);
-                    int b = *(srcPtr+srcB);
-                    int a = *(srcPtr+srcA);
-
-                    // transform
-                    int lum = (int)(0.2126*r + 0.7152*g + 0.0722*b);
-                    r = (int)((1.0-tintAmount)*r + tintAmount*lum*tintR);
-                    g = (int)((1.0-tintAmount)*g + tintAmount*lum*tintG);
-                    b = (int)((1.0-tintAmount)*b + tintAmount*lum*tintB);
-
-                    if (a != 255) {
-                        /* Cairo expects RGB premultiplied by alpha */
-                        r = r * a / 255;
-                        g = g * a / 255;
-                        b = b * a / 255;
-                    }
-
-                    // fix range
-                    r = r<0 ? 0 : r>255 ? 255 : r;
-                    g = g<0 ? 0 : g>255 ? 255 : g;
-                    b = b<0 ? 0 : b>255 ? 255 : b;
-
-                    // and put back
-                    *(dstPtr+dstR) = r;
-                    *(dstPtr+dstG) = g;
-                    *(dstPtr+dstB) = b;
-                    *(dstPtr+dstA) = a;
-                    srcPtr += 4;
-                    dstPtr += 4;
-                }
-            }
-#endif
-        } else {
-            for (i = 0; i < iheight; i++) {
-                srcPtr = block.pixelPtr + i*pitch;
-                dstPtr = ptr + i*pitch;
-                for (j = 0; j < iwidth; j++) {
-                    unsigned int alpha = *(srcPtr+srcA);
-                    *(dstPtr+dstA) = alpha;
-                    if (alpha == 255) {
-                        *(dstPtr+dstR) = *(srcPtr+srcR);
-                        *(dstPtr+dstG) = *(srcPtr+srcG);
-                        *(dstPtr+dstB) = *(srcPtr+srcB);
-                    } else {
-                        /* Cairo expects RGB premultiplied by alpha */
-                        *(dstPtr+dstR) = alpha * *(srcPtr+srcR) / 255;
-                        *(dstPtr+dstG) = alpha * *(srcPtr+srcG) / 255;
-                        *(dstPtr+dstB) = alpha * *(srcPtr+srcB) / 255;
-                    }
-                    srcPtr += 4;
-                    dstPtr += 4;
+static PathImageLevel *
+GetImageLevel(PathImageCache *cachePtr, int level)
+{
+    PathImageLevel *srcPtr, *dstPtr;
+    unsigned char *src0, *src1, *dst;
+    int i, j, k, right;
+
+    level = MIN(level, PATH_IMAGE_MAX_LEVELS-1);
+    while (cachePtr->numLevels <= level) {
+        srcPtr = &cachePtr->level[cachePtr->numLevels-1];
+        if ((srcPtr->width < 2) && (srcPtr->height < 2)) {
+            break;
+        }
+        dstPtr = srcPtr + 1;
+        dstPtr->width = (srcPtr->width + 1)/2;
+        dstPtr->height = (srcPtr->height + 1)/2;
+        dstPtr->stride = 4*dstPtr->width;
+        dstPtr->data = (unsigned char *) 
+                ckalloc(dstPtr->stride*dstPtr->height);
+        for (i = 0; i < dstPtr->height; i++) {
+            /* An odd last row or column is used twice. */
+            src0 = srcPtr->data + 2*i*srcPtr->stride;
+            src1 = (2*i+1 < srcPtr->height) ? src0 + srcPtr->stride : src0;
+            dst = dstPtr->data + i*dstPtr->stride;
+            for (j = 0; j < dstPtr->width; j++, src0 += 8, src1 += 8) {
+                right = (2*j+1 < srcPtr->width) ? 4 : 0;
+                for (k = 0; k < 4; k++) {
+                    *dst++ = (src0[k] + src0[k+right] + src1[k] 
+                            + src1[k+right] + 2) >> 2;
                 }
             }
         }
-    } else if (block.pixelSize == 3) {
-        /* Could do something about this? */
-        fprintf(stderr, "TkPathImage: unaccepted pixel format: 1 pixel is 3 bytes\n");
+        dstPtr->surface = cairo_image_surface_create_for_data(dstPtr->data,
+                CAIRO_FORMAT_ARGB32, dstPtr->width, dstPtr->height, 
+                dstPtr->stride);
+        cachePtr->numLevels++;
+    }
+    return &cachePtr->level[MIN(level, cachePtr->numLevels-1)];
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkPathImageChanged --
+ *
+ *	Called when the pixels of a photo have changed or the photo is
+ *	deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees the converted surfaces of the photo.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkPathImageChanged(Tk_PhotoHandle photo)
+{
+    Tcl_HashEntry *hPtr;
+
+    if (gImageCacheHashPtr == NULL) {
         return;
-    } else {
-        fprintf(stderr, "TkPathImage: unaccepted pixel format: 1 pixel is %d bytes\n", block.pixelSize);
+    }
+    hPtr = Tcl_FindHashEntry(gImageCacheHashPtr, (char *) photo);
+    if (hPtr != NULL) {
+        FreeImageCache((PathImageCache *) Tcl_GetHashValue(hPtr));
+        Tcl_DeleteHashEntry(hPtr);
+    }
+}
+
+void
+TkPathImage(TkPathContext ctx, Tk_Image image, Tk_PhotoHandle photo,
+        double x, double y, double width0, double height0, double fillOpacity,
+        XColor *tintColor, double tintAmount, int interpolation, PathRect *srcRegion)
+{
+    TkPathContext_ *context = (TkPathContext_ *) ctx;
+    Tk_PhotoImageBlock block;
+    PathImageCache *cachePtr;
+    PathImageLevel *levelPtr;
+    cairo_surface_t *surface;
+    cairo_matrix_t ctm;
+    int iwidth, iheight, level;
+    double width, height, scale, sx, sy, levelScale;
+    cairo_filter_t filter;
+
+    /* Return value? */
+    Tk_PhotoGetImage(photo, &block);
+    iwidth = block.width;
+    iheight = block.height;
+    width = (width0 == 0.0) ? (double) iwidth : width0;
+    height = (height0 == 0.0) ? (double) iheight : height0;
+    cachePtr = GetImageCache(photo, &block, tintColor, tintAmount);
+    if (cachePtr == NULL) {
         return;
     }
-    surface = cairo_image_surface_create_for_data(
-            ptr,
-            format, 
-            (int) iwidth, (int) iheight,
-            pitch);		/* stride */
+    cairo_get_matrix(context->c, &ctm);
+    
+    /*
+     * Pick the mip level whose pixels are closest to, but not smaller
+     * than, a device pixel. A tiled source region is drawn from the
+     * photo itself since the levels don't tile exactly.
+     */
+    level = 0;
+    if ((srcRegion == NULL) || ((srcRegion->x1 >= 0) && (srcRegion->y1 >= 0) 
+            && (srcRegion->x2 <= iwidth) && (srcRegion->y2 <= iheight))) {
+        if (srcRegion != NULL) {
+            sx = ((width0 == 0.0) ? 1.0 : width0/(srcRegion->x2 - srcRegion->x1));
+            sy = ((height0 == 0.0) ? 1.0 : height0/(srcRegion->y2 - srcRegion->y1));
+        } else {
+            sx = width/iwidth;
+            sy = height/iheight;
+        }
+        sx *= hypot(ctm.xx, ctm.yx);
+        sy *= hypot(ctm.xy, ctm.yy);
+        scale = MAX(sx, sy);
+        while ((scale > 0.0) && (scale <= 0.5) && (level < PATH_IMAGE_MAX_LEVELS-1)) {
+            scale *= 2.0;
+            level++;
+        }
+    }
+    levelPtr = GetImageLevel(cachePtr, level);
+    surface = levelPtr->surface;
+
+    /*
+     * A level pixel covers 2^level photo pixels in each direction. With
+     * odd sizes the level sticks out past the photo, so it is clipped.
+     */
+    levelScale = ldexp(1.0, (int) (levelPtr - cachePtr->level));
 
     filter = convertInterpolationToCairoFilter(interpolation);
-    if (width == (double)iwidth && height == (double)iheight && !srcRegion) {
+    if (width == (double)iwidth && height == (double)iheight && !srcRegion
+            && (levelPtr == &cachePtr->level[0])
+            && (ctm.xx == 1.0) && (ctm.yy == 1.0)
+            && (ctm.xy == 0.0) && (ctm.yx == 0.0)) {
         cairo_set_source_surface(context->c, surface, x, y);
         cairo_pattern_set_filter(cairo_get_source(context->c), filter);
         cairo_paint_with_alpha(context->c, fillOpacity);
@@ -518,7 +820,8 @@ TkPathImage(TkPathContext ctx, Tk_Image image, Tk_PhotoHandle photo,
         double yoffs = ycrop*yscale;
         cairo_translate (context->c, (x-xoffs), (y-yoffs));
 
-        cairo_matrix_init_scale (&matrix, 1.0/xscale, 1.0/yscale);
+        cairo_matrix_init_scale (&matrix, 
+                1.0/(levelScale*xscale), 1.0/(levelScale*yscale));
         cairo_pattern_set_matrix (pattern, &matrix);
 
         cairo_set_source (context->c, pattern);
@@ -529,20 +832,42 @@ TkPathImage(TkPathContext ctx, Tk_Image image, Tk_PhotoHandle photo,
 
         cairo_pattern_destroy (pattern);
     } else {
+        double x1 = x, y1 = y, x2 = x + width, y2 = y + height;
+        cairo_pattern_t *pattern;
+
+        /*
+         * Pimage tiles abut at fractional device positions when scaled.
+         * Without a rotation the clip is snapped to device pixels, so
+         * neighbours cover each pixel once, and the pattern is padded,
+         * so the filter doesn't fade the edges to transparent.
+         */
         cairo_save(context->c);
+        if ((ctm.xy == 0.0) && (ctm.yx == 0.0)) {
+            cairo_user_to_device(context->c, &x1, &y1);
+            cairo_user_to_device(context->c, &x2, &y2);
+            x1 = floor(x1 + 0.5);
+            y1 = floor(y1 + 0.5);
+            x2 = floor(x2 + 0.5);
+            y2 = floor(y2 + 0.5);
+            cairo_device_to_user(context->c, &x1, &y1);
+            cairo_device_to_user(context->c, &x2, &y2);
+        }
+        cairo_rectangle(context->c, x1, y1, x2 - x1, y2 - y1);
+        cairo_clip(context->c);
         cairo_translate(context->c, x, y);
-        cairo_scale(context->c, width/iwidth, height/iheight);
-        cairo_set_source_surface(context->c, surface, 0, 0);
-        cairo_pattern_set_filter(cairo_get_source(context->c), filter);
+        cairo_scale(context->c, levelScale*width/iwidth, 
+                levelScale*height/iheight);
+        pattern = cairo_pattern_create_for_surface(surface);
+        cairo_pattern_set_extend(pattern, CAIRO_EXTEND_PAD);
+        cairo_pattern_set_filter(pattern, filter);
+        cairo_set_source(context->c, pattern);
         cairo_paint_with_alpha(context->c, fillOpacity);
+        cairo_pattern_destroy(pattern);
         cairo_restore(context->c);
-        cairo_surface_destroy(surface);
-    }
-    if (data) {
-        ckfree((char *)data);
     }
 }
 
+
 void TkPathClosePath(TkPathContext ctx)
 {
     TkPathContext_ *context = (TkPathContext_ *) ctx;
@@ -725,47 +1050,125 @@ TkPathSurfaceErase(TkPathContext ctx, double dx, double dy, double dwidth, doubl
 }
 
 void
-TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo)
+TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo,
+        int x, int y, int width, int height)
 {
     TkPathContext_ *context = (TkPathContext_ *) ctx;
-    cairo_surface_t *surface = context->surface;
+    PathSurfaceCairoRecord *record = context->record;
     Tk_PhotoImageBlock block;
     unsigned char *data;
-    unsigned char *pixel;
-    int width, height;
     int stride;					/* Bytes per row. */
     
-    width = cairo_image_surface_get_width(surface);
-    height = cairo_image_surface_get_height(surface);
-    data = context->record->data;
-    stride = context->record->stride;
-    
-    Tk_PhotoGetImage(photo, &block);    
-    pixel = (unsigned char *) ckalloc(height*stride);
+    cairo_surface_flush(context->surface);
+    stride = record->stride;
+    data = record->data + y*stride + 4*x;
+    block.width = width;
+    block.height = height;
+    block.pitch = stride;
+    block.pixelSize = 4;
 
     if (gSurfaceCopyPremultiplyAlpha) {
+    
+        /*
+         * The pixels are converted to straight alpha in a buffer that is
+         * kept with the surface, at the same offset as in the surface.
+         */
+        if (record->photoData == NULL) {
+            record->photoData = (unsigned char *) ckalloc(record->height*stride);
+        }
+        block.pixelPtr = record->photoData + y*stride + 4*x;
         if (kPathSmallEndian) {
-            PathCopyBitsPremultipliedAlphaBGRA(data, pixel, width, height, stride);
+            PathCopyBitsPremultipliedAlphaBGRA(data, block.pixelPtr, width, height, stride);
         } else {
-            PathCopyBitsPremultipliedAlphaARGB(data, pixel, width, height, stride);
+            PathCopyBitsPremultipliedAlphaARGB(data, block.pixelPtr, width, height, stride);
         }
+        block.offset[0] = 0;
+        block.offset[1] = 1;
+        block.offset[2] = 2;
+        block.offset[3] = 3;
     } else {
+    
+        /* Only the channel order differs; Tk reorders while it copies. */
+        block.pixelPtr = data;
         if (kPathSmallEndian) {
-            PathCopyBitsBGRA(data, pixel, width, height, stride);
+            block.offset[0] = 2;
+            block.offset[1] = 1;
+            block.offset[2] = 0;
+            block.offset[3] = 3;
         } else {
-            PathCopyBitsARGB(data, pixel, width, height, stride);
+            block.offset[0] = 1;
+            block.offset[1] = 2;
+            block.offset[2] = 3;
+            block.offset[3] = 0;
         }
     }
-    block.pixelPtr = pixel;
-    block.width = width;
-    block.height = height;
-    block.pitch = stride;
-    block.pixelSize = 4;
-    block.offset[0] = 0;
-    block.offset[1] = 1;
-    block.offset[2] = 2;
-    block.offset[3] = 3;
-    Tk_PhotoPutBlock(interp, photo, &block, 0, 0, width, height, TK_PHOTO_COMPOSITE_OVERLAY);
+    Tk_PhotoPutBlock(interp, photo, &block, x, y, width, height, TK_PHOTO_COMPOSITE_OVERLAY);
+}
+
+#ifdef CAIRO_HAS_PNG_FUNCTIONS
+/*
+ * The png stream goes to a channel, or is collected in a DString.
+ */
+
+typedef struct PathPngStream {
+    Tcl_Channel chan;
+    Tcl_DString ds;
+} PathPngStream;
+
+static cairo_status_t
+WritePngProc(void *closure, const unsigned char *data, unsigned int length)
+{
+    PathPngStream *streamPtr = (PathPngStream *) closure;
+
+    if (streamPtr->chan != NULL) {
+        if (Tcl_Write(streamPtr->chan, (const char *) data, (int) length) < 0) {
+            return CAIRO_STATUS_WRITE_ERROR;
+        }
+    } else {
+        Tcl_DStringAppend(&streamPtr->ds, (const char *) data, (int) length);
+    }
+    return CAIRO_STATUS_SUCCESS;
+}
+#endif /* CAIRO_HAS_PNG_FUNCTIONS */
+
+int
+TkPathSurfaceToPng(Tcl_Interp *interp, TkPathContext ctx, Tcl_Channel chan,
+        int x, int y, int width, int height)
+{
+#ifdef CAIRO_HAS_PNG_FUNCTIONS
+    TkPathContext_ *context = (TkPathContext_ *) ctx;
+    PathSurfaceCairoRecord *record = context->record;
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    PathPngStream stream;
+    
+    /* The region is encoded in place from a surface sharing the pixels. */
+    cairo_surface_flush(context->surface);
+    surface = cairo_image_surface_create_for_data(
+            record->data + y*record->stride + 4*x, CAIRO_FORMAT_ARGB32, 
+            width, height, record->stride);
+    stream.chan = chan;
+    Tcl_DStringInit(&stream.ds);
+    status = cairo_surface_write_to_png_stream(surface, WritePngProc, &stream);
+    cairo_surface_destroy(surface);
+    if (status != CAIRO_STATUS_SUCCESS) {
+        Tcl_DStringFree(&stream.ds);
+        Tcl_AppendResult(interp, "error writing png: ", 
+                (chan != NULL) ? Tcl_PosixError(interp) : cairo_status_to_string(status),
+                (char *) NULL);
+        return TCL_ERROR;
+    }
+    if (chan == NULL) {
+        Tcl_SetObjResult(interp, Tcl_NewByteArrayObj(
+                (unsigned char *) Tcl_DStringValue(&stream.ds), Tcl_DStringLength(&stream.ds)));
+    }
+    Tcl_DStringFree(&stream.ds);
+    return TCL_OK;
+#else
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+            "writing png needs cairo built with png support", -1));
+    return TCL_ERROR;
+#endif
 }
 
 void TkPathClipToPath(TkPathContext ctx, int fillRule)
@@ -866,6 +1269,9 @@ void TkPathFree(TkPathContext ctx)
     cairo_surface_destroy(context->surface);
     if (context->record) {
         ckfree((char *) context->record->data);
+        if (context->record->photoData != NULL) {
+            ckfree((char *) context->record->photoData);
+        }
         ckfree((char *) context->record);
     }
     ckfree((char *) context);
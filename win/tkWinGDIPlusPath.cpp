@@ -25,10 +25,6 @@
 
 using namespace Gdiplus;
 
-extern Tcl_Interp *gInterp;
-extern "C" int gAntiAlias;
-extern "C" int gSurfaceCopyPremultiplyAlpha;
-
 #define MakeGDIPlusColor(xc, opacity)     Color(BYTE(opacity*255),              \
                                             BYTE(((xc)->pixel & 0xFF)),         \
                                             BYTE(((xc)->pixel >> 8) & 0xFF),    \
@@ -112,6 +108,7 @@ typedef struct PathSurfaceGDIpRecord {
     int     width;
     int     height;
     int     bytesPerRow;        /* the number of bytes between the start of rows in the buffer */
+    unsigned char *photoData;   /* Straight alpha copy for photos, or NULL. */
 } PathSurfaceGDIpRecord;
 
 /*
@@ -863,6 +860,7 @@ TkPathContext TkPathInitSurface(int width, int height)
     surface->height = height;
     /* Windows bitmaps are padded to 16-bit (word) boundaries */
     surface->bytesPerRow = 4*width;
+    surface->photoData = NULL;
 
     context->c = new PathC(memHdc);
     context->memHdc = memHdc;
@@ -972,6 +970,12 @@ TkPathImage(TkPathContext ctx, Tk_Image image, Tk_PhotoHandle photo,
     context->c->DrawImage(photo, (float) x, (float) y, (float) width, (float) height, fillOpacity, tintColor, tintAmount, interpolation, srcRegion);
 }
 
+void
+TkPathImageChanged(Tk_PhotoHandle photo)
+{
+    /* Nothing is cached. */
+}
+
 void
 TkPathClosePath(TkPathContext ctx)
 {
@@ -1084,38 +1088,54 @@ TkPathSurfaceErase(TkPathContext ctx, double dx, double dy, double dwidth, doubl
 }
 
 void
-TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo)
+TkPathSurfaceToPhoto(Tcl_Interp *interp, TkPathContext ctx, Tk_PhotoHandle photo,
+        int x, int y, int width, int height)
 {
     TkPathContext_ *context = (TkPathContext_ *) ctx;
     PathSurfaceGDIpRecord *surface = context->surface;
     Tk_PhotoImageBlock block;
     unsigned char *data;
-    unsigned char *pixel;
-    int width, height;
     int bytesPerRow;
 
-    width = surface->width;
-    height = surface->height;
-    data = (unsigned char *)surface->data;
     bytesPerRow = surface->bytesPerRow;
-
-    Tk_PhotoGetImage(photo, &block);
-    pixel = (unsigned char *)ckalloc(height*bytesPerRow);
-    if (gSurfaceCopyPremultiplyAlpha) {
-        PathCopyBitsPremultipliedAlphaBGRA(data, pixel, width, height, bytesPerRow);
-    } else {
-        PathCopyBitsBGRA(data, pixel, width, height, bytesPerRow);
-    }
-    block.pixelPtr = pixel;
+    data = (unsigned char *)surface->data + y*bytesPerRow + 4*x;
     block.width = width;
     block.height = height;
     block.pitch = bytesPerRow;
     block.pixelSize = 4;
-    block.offset[0] = 0;
-    block.offset[1] = 1;
-    block.offset[2] = 2;
-    block.offset[3] = 3;
-    Tk_PhotoPutBlock(interp, photo, &block, 0, 0, width, height, TK_PHOTO_COMPOSITE_OVERLAY);
+    if (gSurfaceCopyPremultiplyAlpha) {
+    
+        /*
+         * The pixels are converted to straight alpha in a buffer that is
+         * kept with the surface, at the same offset as in the surface.
+         */
+        if (surface->photoData == NULL) {
+            surface->photoData = (unsigned char *)ckalloc(surface->height*bytesPerRow);
+        }
+        block.pixelPtr = surface->photoData + y*bytesPerRow + 4*x;
+        PathCopyBitsPremultipliedAlphaBGRA(data, block.pixelPtr, width, height, bytesPerRow);
+        block.offset[0] = 0;
+        block.offset[1] = 1;
+        block.offset[2] = 2;
+        block.offset[3] = 3;
+    } else {
+        /* Only the channel order differs; Tk reorders while it copies. */
+        block.pixelPtr = data;
+        block.offset[0] = 2;
+        block.offset[1] = 1;
+        block.offset[2] = 0;
+        block.offset[3] = 3;
+    }
+    Tk_PhotoPutBlock(interp, photo, &block, x, y, width, height, TK_PHOTO_COMPOSITE_OVERLAY);
+}
+
+int
+TkPathSurfaceToPng(Tcl_Interp *interp, TkPathContext ctx, Tcl_Channel chan,
+        int x, int y, int width, int height)
+{
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+            "writing png is not supported on this platform", -1));
+    return TCL_ERROR;
 }
 
 void
@@ -1131,6 +1151,9 @@ TkPathFree(TkPathContext ctx)
     DeleteDC(context->memHdc);
     if (context->surface) {
         DeleteObject(context->surface->bitmap);
+        if (context->surface->photoData != NULL) {
+            ckfree((char *) context->surface->photoData);
+        }
         ckfree((char *) context->surface);
     }
     delete context->c;